@@ -0,0 +1,138 @@
+#include "AssetPack.h"
+#include <cstring>
+
+namespace vkn {
+
+	AssetPack::AssetPack(const std::string& path) {
+		file = new MappedFile(path);
+
+		if (file->getSize() < sizeof(PackHeader)) {
+			delete(file);
+			throw std::runtime_error(path + " is too small to be an asset pack!");
+		}
+		const PackHeader* header = reinterpret_cast<const PackHeader*>(file->getData());
+		if (header->magic != PACK_MAGIC || header->version != PACK_VERSION) {
+			delete(file);
+			throw std::runtime_error(path + " is not a version " + std::to_string(PACK_VERSION) + " asset pack!");
+		}
+		if (header->indexOffset > file->getSize() ||
+			(file->getSize() - header->indexOffset) / sizeof(PackEntry) < header->entryCount) {
+			delete(file);
+			throw std::runtime_error(path + " has a truncated index!");
+		}
+
+		//Only the index gets touched up front, blobs page in when used
+		const PackEntry* index = reinterpret_cast<const PackEntry*>(file->getData() + header->indexOffset);
+		for (uint32_t i = 0; i < header->entryCount; i++) {
+			const PackEntry& entry = index[i];
+			if (entry.offset > file->getSize() || entry.size > file->getSize() - entry.offset) {
+				delete(file);
+				throw std::runtime_error(path + " has an entry outside the file!");
+			}
+			std::string name(entry.name, strnlen(entry.name, PACK_NAME_LENGTH));
+			entries[name] = &entry;
+		}
+	}
+
+	AssetPack::~AssetPack() {
+		delete(file);
+	}
+
+	bool AssetPack::contains(const std::string& name) {
+		return entries.find(name) != entries.end();
+	}
+
+	const PackEntry& AssetPack::findEntry(const std::string& name, PackAssetType type) {
+		auto found = entries.find(name);
+		if (found == entries.end()) {
+			throw std::runtime_error("asset " + name + " is not in the pack!");
+		}
+		if (found->second->type != type) {
+			throw std::runtime_error("asset " + name + " is the wrong type!");
+		}
+		return *found->second;
+	}
+
+	void AssetPack::getShader(const std::string& name, const uint32_t*& code, size_t& size) {
+		const PackEntry& entry = findEntry(name, PackAssetType::Shader);
+		code = reinterpret_cast<const uint32_t*>(getBlob(entry));
+		size = static_cast<size_t>(entry.size);
+	}
+
+	TextureData* AssetPack::getTexture(const std::string& name) {
+		const PackEntry& entry = findEntry(name, PackAssetType::Texture);
+		const unsigned char* blob = getBlob(entry);
+		//The streamer copies straight out of the blob, so every mip has to be inside it
+		if (entry.size < sizeof(PackTexture)) {
+			throw std::runtime_error(name + " is too small for a texture header!");
+		}
+		const PackTexture* header = reinterpret_cast<const PackTexture*>(blob);
+		if (header->mipCount == 0 || (entry.size - sizeof(PackTexture)) / sizeof(PackMip) < header->mipCount) {
+			throw std::runtime_error(name + " has a truncated mip table!");
+		}
+		const PackMip* mips = reinterpret_cast<const PackMip*>(blob + sizeof(PackTexture));
+		VkFormat format = static_cast<VkFormat>(header->format);
+		for (uint32_t i = 0; i < header->mipCount; i++) {
+			if (mips[i].offset > entry.size || mips[i].size > entry.size - mips[i].offset ||
+				mips[i].size != TextureLoader::getMipSize(format, mips[i].width, mips[i].height)) {
+				throw std::runtime_error(name + " has mip " + std::to_string(i) + " outside its data!");
+			}
+		}
+
+		//Upload starts from the smallest mip, so get the OS reading the tail in now
+		file->prefetch(static_cast<size_t>(entry.offset), static_cast<size_t>(entry.size));
+
+		TextureData* data = new TextureData();
+		data->format = format;
+		data->width = header->width;
+		data->height = header->height;
+		data->source = blob;
+		for (uint32_t i = 0; i < header->mipCount; i++) {
+			data->mips.push_back({ mips[i].offset, mips[i].size, mips[i].width, mips[i].height });
+		}
+		return data;
+	}
+
+	MeshView AssetPack::getMesh(const std::string& name) {
+		const PackEntry& entry = findEntry(name, PackAssetType::Mesh);
+		const unsigned char* blob = getBlob(entry);
+		//The views go straight to the geometry pool, so everything they cover has to be inside the blob
+		if (entry.size < sizeof(PackMesh)) {
+			throw std::runtime_error(name + " is too small for a mesh header!");
+		}
+		const PackMesh* header = reinterpret_cast<const PackMesh*>(blob);
+		if (header->indexSize != 2 && header->indexSize != 4) {
+			throw std::runtime_error(name + " has " + std::to_string(header->indexSize) + " byte indices, a pack mesh needs 2 or 4!");
+		}
+		uint64_t vertexBytes = uint64_t(header->vertexCount) * header->vertexStride;
+		uint64_t indexBytes = uint64_t(header->indexCount) * header->indexSize;
+		if (header->vertexOffset > entry.size || vertexBytes > entry.size - header->vertexOffset ||
+			header->indexOffset > entry.size || indexBytes > entry.size - header->indexOffset) {
+			throw std::runtime_error(name + " has vertex or index data outside the blob!");
+		}
+		//LOD selection indexes straight into lods, so a bad count can't get past here
+		if (header->lodCount == 0 || header->lodCount > MAX_MESH_LODS) {
+			throw std::runtime_error(name + " has " + std::to_string(header->lodCount) + " LODs, a pack mesh needs 1 to " +
+				std::to_string(MAX_MESH_LODS) + "!");
+		}
+		for (uint32_t i = 0; i < header->lodCount; i++) {
+			const MeshLod& lod = header->lods[i];
+			if (lod.firstIndex > header->indexCount || lod.indexCount > header->indexCount - lod.firstIndex) {
+				throw std::runtime_error(name + " has LOD " + std::to_string(i) + " outside its indices!");
+			}
+		}
+
+		MeshView mesh;
+		mesh.vertices = blob + header->vertexOffset;
+		mesh.vertexCount = header->vertexCount;
+		mesh.vertexStride = header->vertexStride;
+		mesh.indices = blob + header->indexOffset;
+		mesh.indexCount = header->indexCount;
+		mesh.indexType = header->indexSize == 2 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+		mesh.boundsMin = glm::vec3(header->boundsMin[0], header->boundsMin[1], header->boundsMin[2]);
+		mesh.boundsMax = glm::vec3(header->boundsMax[0], header->boundsMax[1], header->boundsMax[2]);
+		mesh.lods = header->lods;
+		mesh.lodCount = header->lodCount;
+		return mesh;
+	}
+}
@@ -0,0 +1,128 @@
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#ifndef __ASSET_PACK_H__
+#define __ASSET_PACK_H__
+
+#include <string>
+#include <unordered_map>
+#include "MappedFile.h"
+#include "TextureLoader.h"
+#include "MeshLoader.h"
+#include <glm/glm.hpp>
+
+//On disk layout of a .vknpack, written by tools/AssetBaker.cpp. Little endian.
+//
+//  PackHeader
+//  asset blobs, each starting on a PACK_ALIGNMENT boundary
+//  PackEntry[entryCount] starting at indexOffset
+//
+//Everything is stored exactly as it gets uploaded, so loading is just a
+//lookup into the mapped file.
+
+namespace vkn {
+
+	const uint32_t PACK_MAGIC = 0x504E4B56; //"VKNP"
+	const uint32_t PACK_VERSION = 3;
+	//Covers SPIR-V words and every texel block size
+	const uint64_t PACK_ALIGNMENT = 16;
+	const uint32_t PACK_NAME_LENGTH = 64;
+
+	enum class PackAssetType : uint32_t {
+		Texture = 1,
+		Shader = 2,
+		Mesh = 3
+	};
+
+	struct PackHeader {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t entryCount;
+		uint32_t reserved;
+		uint64_t indexOffset;
+	};
+
+	struct PackEntry {
+		//Null terminated. Assets are named after the file they were baked from
+		char name[PACK_NAME_LENGTH];
+		PackAssetType type;
+		uint32_t reserved;
+		uint64_t offset;
+		uint64_t size;
+	};
+
+	//Texture blobs: this, then mipCount PackMips, then the mip data
+	struct PackTexture {
+		uint32_t format;
+		uint32_t width;
+		uint32_t height;
+		uint32_t mipCount;
+	};
+
+	struct PackMip {
+		//From the start of the blob, aligned to PACK_ALIGNMENT
+		uint64_t offset;
+		uint64_t size;
+		uint32_t width;
+		uint32_t height;
+	};
+
+	//Mesh blobs: this, then vertex data, then index data
+	struct PackMesh {
+		uint32_t vertexCount;
+		uint32_t vertexStride;
+		uint32_t indexCount;
+		//2 or 4
+		uint32_t indexSize;
+		uint64_t vertexOffset;
+		uint64_t indexOffset;
+		float boundsMin[3];
+		float boundsMax[3];
+		//Levels of detail, ranges inside the index data. Always at least one
+		uint32_t lodCount;
+		uint32_t reserved;
+		MeshLod lods[MAX_MESH_LODS];
+	};
+
+	//Pointers straight into the mapping
+	struct MeshView {
+		const void* vertices;
+		uint32_t vertexCount;
+		uint32_t vertexStride;
+		const void* indices;
+		uint32_t indexCount;
+		VkIndexType indexType;
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+		const MeshLod* lods;
+		uint32_t lodCount;
+	};
+
+	//Maps a baked asset pack and hands out views into it. Nothing is decoded or
+	//copied here, data goes from the mapped pages straight into staging memory.
+	//Anything handed out points into the mapping, so keep the pack alive until
+	//the GPU copies are done.
+	class AssetPack {
+	public:
+		AssetPack() {}
+		//Throws if the file is missing or isn't a pack we understand
+		AssetPack(const std::string& path);
+		~AssetPack();
+
+		bool contains(const std::string& name);
+
+		void getShader(const std::string& name, const uint32_t*& code, size_t& size);
+		//Returned data borrows the pack's memory, hand it to TextureStreamer::request
+		TextureData* getTexture(const std::string& name);
+		MeshView getMesh(const std::string& name);
+
+	private:
+		const PackEntry& findEntry(const std::string& name, PackAssetType type);
+		const unsigned char* getBlob(const PackEntry& entry) { return file->getData() + entry.offset; }
+
+		MappedFile* file = nullptr;
+		std::unordered_map<std::string, const PackEntry*> entries;
+	};
+}
+
+#endif
@@ -0,0 +1,214 @@
+#include "BindlessTable.h"
+#include <algorithm>
+
+namespace vkn {
+
+	BindlessTable::BindlessTable(LogicalDevice* logicalDevice, uint32_t frames, uint32_t textureCount, uint32_t samplerCount) {
+		device = logicalDevice;
+		framesInFlight = frames;
+
+		if (!device->isBindlessSupported()) {
+			throw std::runtime_error("bindless textures need VK_EXT_descriptor_indexing!");
+		}
+
+		//Update after bind arrays have their own (usually much larger) limits
+		VkPhysicalDeviceDescriptorIndexingProperties indexingProperties{};
+		indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+		VkPhysicalDeviceProperties2 properties{};
+		properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		properties.pNext = &indexingProperties;
+		vkGetPhysicalDeviceProperties2(device->getPhysicalDevice()->getPhysicalDevice(), &properties);
+
+		maxTextures = std::min({ textureCount, indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages,
+			indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages });
+		maxSamplers = std::min({ samplerCount, indexingProperties.maxDescriptorSetUpdateAfterBindSamplers,
+			indexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers });
+
+		std::vector<VkDescriptorSetLayoutBinding> bindings(2);
+		bindings[0].binding = 0;
+		bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+		bindings[0].descriptorCount = maxTextures;
+		bindings[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		bindings[1].binding = 1;
+		bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+		bindings[1].descriptorCount = maxSamplers;
+		bindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+		std::vector<VkDescriptorBindingFlags> bindingFlags = {
+			VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT,
+			VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT
+		};
+		layout = device->getDescriptorLayoutCache()->getLayout(bindings, VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT, bindingFlags);
+
+		VkDescriptorPoolSize poolSizes[2]{};
+		poolSizes[0].type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+		poolSizes[0].descriptorCount = maxTextures * framesInFlight;
+		poolSizes[1].type = VK_DESCRIPTOR_TYPE_SAMPLER;
+		poolSizes[1].descriptorCount = maxSamplers * framesInFlight;
+
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+		poolInfo.poolSizeCount = 2;
+		poolInfo.pPoolSizes = poolSizes;
+		poolInfo.maxSets = framesInFlight;
+
+		if (vkCreateDescriptorPool(device->getDevice(), &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create bindless descriptor pool!");
+		}
+
+		std::vector<VkDescriptorSetLayout> layouts(framesInFlight, layout);
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = pool;
+		allocInfo.descriptorSetCount = framesInFlight;
+		allocInfo.pSetLayouts = layouts.data();
+
+		descriptorSets.resize(framesInFlight);
+		if (vkAllocateDescriptorSets(device->getDevice(), &allocInfo, descriptorSets.data()) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate bindless descriptor sets!");
+		}
+
+		samplersWritten.resize(framesInFlight, 0);
+	}
+
+	BindlessTable::~BindlessTable() {
+		//Sets go with the pool
+		vkDestroyDescriptorPool(device->getDevice(), pool, nullptr);
+	}
+
+	uint32_t BindlessTable::addTexture(Texture* texture) {
+		uint32_t index = addTexture(texture->getImageView());
+		textures[index].texture = texture;
+		textures[index].version = texture->getVersion();
+		return index;
+	}
+
+	uint32_t BindlessTable::addTexture(VkImageView view) {
+		uint32_t index;
+		if (!freeTextures.empty()) {
+			index = freeTextures.back();
+			freeTextures.pop_back();
+		}
+		else {
+			if (textures.size() >= maxTextures) {
+				throw std::runtime_error("bindless texture table is full!");
+			}
+			index = static_cast<uint32_t>(textures.size());
+			textures.push_back({});
+		}
+
+		textures[index].view = view;
+		textures[index].texture = nullptr;
+		textures[index].version = 0;
+		markDirty(index);
+		return index;
+	}
+
+	void BindlessTable::updateTexture(uint32_t index, VkImageView view) {
+		textures[index].view = view;
+		markDirty(index);
+	}
+
+	void BindlessTable::removeTexture(uint32_t index) {
+		//Partially bound, so a stale descriptor is fine as long as nothing samples it
+		textures[index].view = VK_NULL_HANDLE;
+		textures[index].texture = nullptr;
+		freeTextures.push_back(index);
+	}
+
+	uint32_t BindlessTable::addSampler(VkSampler sampler) {
+		if (samplers.size() >= maxSamplers) {
+			throw std::runtime_error("bindless sampler table is full!");
+		}
+		samplers.push_back(sampler);
+		return static_cast<uint32_t>(samplers.size() - 1);
+	}
+
+	void BindlessTable::markDirty(uint32_t index) {
+		if (textures[index].dirtyFrames == 0) {
+			dirtyTextures.push_back(index);
+		}
+		textures[index].dirtyFrames = (1u << framesInFlight) - 1;
+	}
+
+	void BindlessTable::beginFrame(uint32_t frame) {
+		//Streamed textures swap views as mips land
+		for (uint32_t i = 0; i < textures.size(); i++) {
+			TextureSlot& slot = textures[i];
+			if (slot.texture != nullptr && slot.texture->getVersion() != slot.version) {
+				slot.version = slot.texture->getVersion();
+				slot.view = slot.texture->getImageView();
+				markDirty(i);
+			}
+		}
+
+		std::vector<VkDescriptorImageInfo> imageInfos;
+		std::vector<VkWriteDescriptorSet> writes;
+		//Reserve so the pointers handed to the writes stay put
+		imageInfos.reserve(dirtyTextures.size() + samplers.size());
+
+		uint32_t frameBit = 1u << frame;
+		for (size_t i = 0; i < dirtyTextures.size();) {
+			TextureSlot& slot = textures[dirtyTextures[i]];
+			if ((slot.dirtyFrames & frameBit) && slot.view != VK_NULL_HANDLE) {
+				VkDescriptorImageInfo imageInfo{};
+				imageInfo.imageView = slot.view;
+				imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+				imageInfos.push_back(imageInfo);
+
+				VkWriteDescriptorSet write{};
+				write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				write.dstSet = descriptorSets[frame];
+				write.dstBinding = 0;
+				write.dstArrayElement = dirtyTextures[i];
+				write.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+				write.descriptorCount = 1;
+				write.pImageInfo = &imageInfos.back();
+				writes.push_back(write);
+			}
+			slot.dirtyFrames &= ~frameBit;
+
+			if (slot.dirtyFrames == 0) {
+				dirtyTextures[i] = dirtyTextures.back();
+				dirtyTextures.pop_back();
+			}
+			else {
+				i++;
+			}
+		}
+
+		if (samplersWritten[frame] < samplers.size()) {
+			size_t first = imageInfos.size();
+			for (size_t i = samplersWritten[frame]; i < samplers.size(); i++) {
+				VkDescriptorImageInfo imageInfo{};
+				imageInfo.sampler = samplers[i];
+				imageInfos.push_back(imageInfo);
+			}
+
+			//New samplers are contiguous, so one write covers them all
+			VkWriteDescriptorSet write{};
+			write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			write.dstSet = descriptorSets[frame];
+			write.dstBinding = 1;
+			write.dstArrayElement = samplersWritten[frame];
+			write.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+			write.descriptorCount = static_cast<uint32_t>(samplers.size() - samplersWritten[frame]);
+			write.pImageInfo = &imageInfos[first];
+			writes.push_back(write);
+			samplersWritten[frame] = static_cast<uint32_t>(samplers.size());
+		}
+
+		if (!writes.empty()) {
+			vkUpdateDescriptorSets(device->getDevice(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+		}
+	}
+
+	VkPushConstantRange BindlessTable::getPushConstantRange() {
+		VkPushConstantRange range{};
+		range.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		range.offset = 0;
+		range.size = sizeof(MaterialPushConstants);
+		return range;
+	}
+}
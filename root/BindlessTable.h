@@ -0,0 +1,86 @@
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#ifndef __BINDLESS_TABLE_H__
+#define __BINDLESS_TABLE_H__
+
+#include <vector>
+#include "LogicalDevice.h"
+#include "TextureStreamer.h"
+
+namespace vkn {
+
+	//Pushed once per draw. Shaders use these to index straight into the table,
+	//so switching material never needs a descriptor set bind.
+	struct MaterialPushConstants {
+		uint32_t textureIndex;
+		uint32_t samplerIndex;
+	};
+
+	//One big descriptor set holding every texture and sampler in the scene.
+	//Needs VK_EXT_descriptor_indexing (check LogicalDevice::isBindlessSupported).
+	//
+	//Binding 0 is an array of sampled images and binding 1 an array of samplers.
+	//Both are partially bound, so unused slots can stay empty, and update after
+	//bind, so slots can be filled while the set is already bound.
+	//There is a copy of the set per frame in flight. Writes are queued and land in
+	//each copy when beginFrame is called for it, so a frame the GPU is still
+	//reading never has its descriptors changed underneath it.
+	class BindlessTable {
+	public:
+		BindlessTable() {}
+		BindlessTable(LogicalDevice* device, uint32_t framesInFlight, uint32_t maxTextures, uint32_t maxSamplers);
+		~BindlessTable();
+
+		//Returns the slot shaders use to find this texture. Streamed textures get
+		//their slot rewritten whenever a sharper mip becomes resident.
+		uint32_t addTexture(Texture* texture);
+		uint32_t addTexture(VkImageView view);
+		void updateTexture(uint32_t index, VkImageView view);
+		//The slot is reused by the next add, so stop drawing with it first
+		void removeTexture(uint32_t index);
+		uint32_t addSampler(VkSampler sampler);
+
+		//Call after the frame's fence has been waited on, before recording
+		void beginFrame(uint32_t frame);
+
+		VkDescriptorSetLayout getLayout() { return layout; }
+		VkDescriptorSet getDescriptorSet(uint32_t frame) { return descriptorSets[frame]; }
+		//Push constant range matching MaterialPushConstants, for pipeline creation
+		VkPushConstantRange getPushConstantRange();
+
+		uint32_t getMaxTextures() { return maxTextures; }
+		uint32_t getMaxSamplers() { return maxSamplers; }
+
+	private:
+		struct TextureSlot {
+			VkImageView view;
+			Texture* texture;
+			uint32_t version;
+			//One bit per frame whose set still needs this slot written
+			uint32_t dirtyFrames;
+		};
+
+		void markDirty(uint32_t index);
+
+		LogicalDevice* device;
+		uint32_t framesInFlight;
+		uint32_t maxTextures;
+		uint32_t maxSamplers;
+
+		VkDescriptorSetLayout layout;
+		VkDescriptorPool pool;
+		std::vector<VkDescriptorSet> descriptorSets;
+
+		std::vector<TextureSlot> textures;
+		std::vector<uint32_t> freeTextures;
+		//Slots touched since the last time every frame caught up
+		std::vector<uint32_t> dirtyTextures;
+
+		//Samplers are only ever appended, so each frame just tracks how far it got
+		std::vector<VkSampler> samplers;
+		std::vector<uint32_t> samplersWritten;
+	};
+}
+
+#endif
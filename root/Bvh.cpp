@@ -0,0 +1,445 @@
+#include "Bvh.h"
+#include <algorithm>
+#include <cfloat>
+#include <stdexcept>
+
+namespace vkn {
+
+	static const uint32_t SAH_BIN_COUNT = 12;
+	//Past this depth splits go down the middle, which keeps the traversal stacks bounded
+	static const uint32_t MAX_SAH_DEPTH = 32;
+	static const uint32_t MAX_STACK = 128;
+
+	static float surfaceArea(const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+		glm::vec3 extent = glm::max(boundsMax - boundsMin, glm::vec3(0.0f));
+		return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+	}
+
+	static bool boxTouchesSphere(const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::vec3& center, float radius) {
+		glm::vec3 offset = center - glm::clamp(center, boundsMin, boundsMax);
+		return glm::dot(offset, offset) <= radius * radius;
+	}
+
+	//Distance along the ray to where it enters the box, 0 when it starts inside.
+	//Returns false on a miss or when that's past maxDistance
+	static bool rayHitsBox(const glm::vec3& origin, const glm::vec3& inverseDirection, const glm::vec3& boundsMin, const glm::vec3& boundsMax,
+		float maxDistance, float& distance) {
+		glm::vec3 t0 = (boundsMin - origin) * inverseDirection;
+		glm::vec3 t1 = (boundsMax - origin) * inverseDirection;
+		glm::vec3 entry = glm::min(t0, t1);
+		glm::vec3 leave = glm::max(t0, t1);
+		float enter = std::max(std::max(entry.x, entry.y), std::max(entry.z, 0.0f));
+		float exit = std::min(std::min(leave.x, leave.y), std::min(leave.z, maxDistance));
+		distance = enter;
+		return enter <= exit;
+	}
+
+	BvhHandle Bvh::insert(const glm::vec3& boundsMin, const glm::vec3& boundsMax, uint32_t userData) {
+		Object object;
+		object.boundsMin = boundsMin;
+		object.boundsMax = boundsMax;
+		object.userData = userData;
+		object.leaf = ~0u;
+		object.alive = true;
+		object.moved = false;
+
+		BvhHandle handle;
+		if (!freeHandles.empty()) {
+			handle = freeHandles.back();
+			freeHandles.pop_back();
+			objects[handle] = object;
+		}
+		else {
+			handle = static_cast<BvhHandle>(objects.size());
+			objects.push_back(object);
+		}
+		objectCount++;
+		structureChanged = true;
+		return handle;
+	}
+
+	void Bvh::remove(BvhHandle handle) {
+		if (handle >= objects.size() || !objects[handle].alive) {
+			return;
+		}
+		objects[handle].alive = false;
+		freeHandles.push_back(handle);
+		objectCount--;
+		structureChanged = true;
+	}
+
+	void Bvh::setBounds(BvhHandle handle, const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+		Object& object = objects[handle];
+		object.boundsMin = boundsMin;
+		object.boundsMax = boundsMax;
+		if (!object.moved) {
+			object.moved = true;
+			movedObjects.push_back(handle);
+		}
+	}
+
+	void Bvh::update() {
+		//Inserted objects have no leaf yet and removed ones still sit in theirs
+		if (structureChanged) {
+			rebuild();
+			return;
+		}
+		for (BvhHandle handle : movedObjects) {
+			objects[handle].moved = false;
+			refit(objects[handle].leaf);
+		}
+		movedObjects.clear();
+
+		if (internalArea > builtArea * REBUILD_AREA_RATIO) {
+			rebuild();
+		}
+	}
+
+	void Bvh::rebuild() {
+		nodes.clear();
+		leafObjects.clear();
+		centroids.resize(objects.size());
+		for (BvhHandle handle = 0; handle < objects.size(); handle++) {
+			Object& object = objects[handle];
+			object.moved = false;
+			object.leaf = ~0u;
+			if (object.alive) {
+				leafObjects.push_back(handle);
+				centroids[handle] = (object.boundsMin + object.boundsMax) * 0.5f;
+			}
+		}
+		movedObjects.clear();
+		structureChanged = false;
+		internalArea = 0.0;
+		rebuildCount++;
+
+		if (!leafObjects.empty()) {
+			//Never more than 2n - 1 nodes
+			nodes.reserve(leafObjects.size() * 2);
+			Node root{};
+			root.parent = ~0u;
+			nodes.push_back(root);
+			build(0, 0, static_cast<uint32_t>(leafObjects.size()), 0);
+		}
+		builtArea = internalArea;
+	}
+
+	void Bvh::build(uint32_t nodeIndex, uint32_t begin, uint32_t end, uint32_t depth) {
+		glm::vec3 boundsMin(FLT_MAX);
+		glm::vec3 boundsMax(-FLT_MAX);
+		glm::vec3 centroidMin(FLT_MAX);
+		glm::vec3 centroidMax(-FLT_MAX);
+		for (uint32_t i = begin; i < end; i++) {
+			const Object& object = objects[leafObjects[i]];
+			boundsMin = glm::min(boundsMin, object.boundsMin);
+			boundsMax = glm::max(boundsMax, object.boundsMax);
+			centroidMin = glm::min(centroidMin, centroids[leafObjects[i]]);
+			centroidMax = glm::max(centroidMax, centroids[leafObjects[i]]);
+		}
+		nodes[nodeIndex].boundsMin = boundsMin;
+		nodes[nodeIndex].boundsMax = boundsMax;
+
+		uint32_t count = end - begin;
+		if (count <= MAX_LEAF_OBJECTS) {
+			nodes[nodeIndex].first = begin;
+			nodes[nodeIndex].count = count;
+			for (uint32_t i = begin; i < end; i++) {
+				objects[leafObjects[i]].leaf = nodeIndex;
+			}
+			return;
+		}
+
+		//Bin centroids along each axis and sweep for the cheapest split plane.
+		//Cost is relative to the node's area, with traversal and a box test both 1
+		float nodeArea = surfaceArea(boundsMin, boundsMax);
+		glm::vec3 centroidExtent = centroidMax - centroidMin;
+		float bestCost = FLT_MAX;
+		int bestAxis = -1;
+		uint32_t bestSplit = 0;
+		for (int axis = 0; axis < 3 && depth < MAX_SAH_DEPTH && nodeArea > 0.0f; axis++) {
+			if (centroidExtent[axis] <= 0.0f) {
+				continue;
+			}
+			float binScale = SAH_BIN_COUNT / centroidExtent[axis];
+			uint32_t binCounts[SAH_BIN_COUNT] = {};
+			glm::vec3 binMin[SAH_BIN_COUNT];
+			glm::vec3 binMax[SAH_BIN_COUNT];
+			for (uint32_t b = 0; b < SAH_BIN_COUNT; b++) {
+				binMin[b] = glm::vec3(FLT_MAX);
+				binMax[b] = glm::vec3(-FLT_MAX);
+			}
+			for (uint32_t i = begin; i < end; i++) {
+				const Object& object = objects[leafObjects[i]];
+				uint32_t bin = std::min(static_cast<uint32_t>((centroids[leafObjects[i]][axis] - centroidMin[axis]) * binScale), SAH_BIN_COUNT - 1);
+				binCounts[bin]++;
+				binMin[bin] = glm::min(binMin[bin], object.boundsMin);
+				binMax[bin] = glm::max(binMax[bin], object.boundsMax);
+			}
+
+			//Right side areas swept from the back, then the left side from the front
+			float rightArea[SAH_BIN_COUNT];
+			uint32_t rightCount[SAH_BIN_COUNT];
+			glm::vec3 sweepMin(FLT_MAX);
+			glm::vec3 sweepMax(-FLT_MAX);
+			uint32_t sweepCount = 0;
+			for (uint32_t b = SAH_BIN_COUNT - 1; b > 0; b--) {
+				sweepMin = glm::min(sweepMin, binMin[b]);
+				sweepMax = glm::max(sweepMax, binMax[b]);
+				sweepCount += binCounts[b];
+				rightArea[b] = sweepCount > 0 ? surfaceArea(sweepMin, sweepMax) : 0.0f;
+				rightCount[b] = sweepCount;
+			}
+			sweepMin = glm::vec3(FLT_MAX);
+			sweepMax = glm::vec3(-FLT_MAX);
+			sweepCount = 0;
+			for (uint32_t b = 0; b < SAH_BIN_COUNT - 1; b++) {
+				sweepMin = glm::min(sweepMin, binMin[b]);
+				sweepMax = glm::max(sweepMax, binMax[b]);
+				sweepCount += binCounts[b];
+				if (sweepCount == 0 || rightCount[b + 1] == 0) {
+					continue;
+				}
+				float cost = 1.0f + (surfaceArea(sweepMin, sweepMax) * sweepCount + rightArea[b + 1] * rightCount[b + 1]) / nodeArea;
+				if (cost < bestCost) {
+					bestCost = cost;
+					bestAxis = axis;
+					bestSplit = b + 1;
+				}
+			}
+		}
+
+		uint32_t middle;
+		if (bestAxis >= 0) {
+			float binScale = SAH_BIN_COUNT / centroidExtent[bestAxis];
+			float axisMin = centroidMin[bestAxis];
+			uint32_t* split = std::partition(leafObjects.data() + begin, leafObjects.data() + end, [&](uint32_t handle) {
+				uint32_t bin = std::min(static_cast<uint32_t>((centroids[handle][bestAxis] - axisMin) * binScale), SAH_BIN_COUNT - 1);
+				return bin < bestSplit;
+			});
+			middle = static_cast<uint32_t>(split - leafObjects.data());
+		}
+		else {
+			//Same centroids everywhere or too deep, halve by count along the widest axis
+			int axis = centroidExtent.x >= centroidExtent.y && centroidExtent.x >= centroidExtent.z ? 0 : (centroidExtent.y >= centroidExtent.z ? 1 : 2);
+			middle = begin + count / 2;
+			std::nth_element(leafObjects.data() + begin, leafObjects.data() + middle, leafObjects.data() + end, [&](uint32_t a, uint32_t b) {
+				return centroids[a][axis] < centroids[b][axis];
+			});
+		}
+
+		uint32_t left = static_cast<uint32_t>(nodes.size());
+		Node child{};
+		child.parent = nodeIndex;
+		nodes.push_back(child);
+		nodes.push_back(child);
+		nodes[nodeIndex].first = left;
+		nodes[nodeIndex].count = 0;
+		internalArea += surfaceArea(boundsMin, boundsMax);
+
+		build(left, begin, middle, depth + 1);
+		build(left + 1, middle, end, depth + 1);
+	}
+
+	void Bvh::setNodeBounds(uint32_t nodeIndex, const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+		Node& node = nodes[nodeIndex];
+		if (node.count == 0) {
+			internalArea += surfaceArea(boundsMin, boundsMax) - surfaceArea(node.boundsMin, node.boundsMax);
+		}
+		node.boundsMin = boundsMin;
+		node.boundsMax = boundsMax;
+	}
+
+	void Bvh::refit(uint32_t nodeIndex) {
+		const Node& leaf = nodes[nodeIndex];
+		glm::vec3 boundsMin(FLT_MAX);
+		glm::vec3 boundsMax(-FLT_MAX);
+		for (uint32_t i = leaf.first; i < leaf.first + leaf.count; i++) {
+			boundsMin = glm::min(boundsMin, objects[leafObjects[i]].boundsMin);
+			boundsMax = glm::max(boundsMax, objects[leafObjects[i]].boundsMax);
+		}
+
+		//Up to the root, or until a node comes out the same as it was
+		while (nodeIndex != ~0u) {
+			Node& node = nodes[nodeIndex];
+			if (node.count == 0) {
+				const Node& left = nodes[node.first];
+				const Node& right = nodes[node.first + 1];
+				boundsMin = glm::min(left.boundsMin, right.boundsMin);
+				boundsMax = glm::max(left.boundsMax, right.boundsMax);
+			}
+			if (boundsMin == node.boundsMin && boundsMax == node.boundsMax) {
+				break;
+			}
+			setNodeBounds(nodeIndex, boundsMin, boundsMax);
+			nodeIndex = node.parent;
+		}
+	}
+
+	void Bvh::collect(uint32_t nodeIndex, std::vector<uint32_t>& out) const {
+		uint32_t stack[MAX_STACK];
+		uint32_t stackSize = 0;
+		stack[stackSize++] = nodeIndex;
+		while (stackSize > 0) {
+			const Node& node = nodes[stack[--stackSize]];
+			if (node.count == 0) {
+				stack[stackSize++] = node.first;
+				stack[stackSize++] = node.first + 1;
+				continue;
+			}
+			for (uint32_t i = node.first; i < node.first + node.count; i++) {
+				const Object& object = objects[leafObjects[i]];
+				if (object.alive) {
+					out.push_back(object.userData);
+				}
+			}
+		}
+	}
+
+	void Bvh::queryFrustum(const Frustum& frustum, std::vector<uint32_t>& out) const {
+		out.clear();
+		if (nodes.empty()) {
+			return;
+		}
+
+		//Each entry carries the planes its box still straddles, a plane the parent
+		//was wholly inside of can't cut any of its children
+		struct Entry {
+			uint32_t node;
+			uint32_t planeMask;
+		};
+		Entry stack[MAX_STACK];
+		uint32_t stackSize = 0;
+		stack[stackSize++] = { 0, 0x3F };
+		while (stackSize > 0) {
+			Entry entry = stack[--stackSize];
+			const Node& node = nodes[entry.node];
+
+			bool outside = false;
+			uint32_t planeMask = entry.planeMask;
+			for (int p = 0; p < 6 && !outside; p++) {
+				if ((planeMask & (1u << p)) == 0) {
+					continue;
+				}
+				const glm::vec4& plane = frustum.planes[p];
+				glm::vec3 normal = glm::vec3(plane);
+				glm::vec3 farCorner(plane.x >= 0.0f ? node.boundsMax.x : node.boundsMin.x,
+					plane.y >= 0.0f ? node.boundsMax.y : node.boundsMin.y,
+					plane.z >= 0.0f ? node.boundsMax.z : node.boundsMin.z);
+				glm::vec3 nearCorner(plane.x >= 0.0f ? node.boundsMin.x : node.boundsMax.x,
+					plane.y >= 0.0f ? node.boundsMin.y : node.boundsMax.y,
+					plane.z >= 0.0f ? node.boundsMin.z : node.boundsMax.z);
+				if (glm::dot(normal, farCorner) + plane.w < 0.0f) {
+					outside = true;
+				}
+				else if (glm::dot(normal, nearCorner) + plane.w >= 0.0f) {
+					planeMask &= ~(1u << p);
+				}
+			}
+			if (outside) {
+				continue;
+			}
+			if (planeMask == 0) {
+				collect(entry.node, out);
+				continue;
+			}
+			if (node.count == 0) {
+				stack[stackSize++] = { node.first, planeMask };
+				stack[stackSize++] = { node.first + 1, planeMask };
+				continue;
+			}
+			for (uint32_t i = node.first; i < node.first + node.count; i++) {
+				const Object& object = objects[leafObjects[i]];
+				if (object.alive && frustum.intersectsBox(object.boundsMin, object.boundsMax)) {
+					out.push_back(object.userData);
+				}
+			}
+		}
+	}
+
+	void Bvh::querySphere(const glm::vec3& center, float radius, std::vector<uint32_t>& out) const {
+		out.clear();
+		if (nodes.empty()) {
+			return;
+		}
+
+		uint32_t stack[MAX_STACK];
+		uint32_t stackSize = 0;
+		stack[stackSize++] = 0;
+		while (stackSize > 0) {
+			const Node& node = nodes[stack[--stackSize]];
+			if (!boxTouchesSphere(node.boundsMin, node.boundsMax, center, radius)) {
+				continue;
+			}
+			if (node.count == 0) {
+				stack[stackSize++] = node.first;
+				stack[stackSize++] = node.first + 1;
+				continue;
+			}
+			for (uint32_t i = node.first; i < node.first + node.count; i++) {
+				const Object& object = objects[leafObjects[i]];
+				if (object.alive && boxTouchesSphere(object.boundsMin, object.boundsMax, center, radius)) {
+					out.push_back(object.userData);
+				}
+			}
+		}
+	}
+
+	bool Bvh::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, BvhRayHit& hit) const {
+		if (nodes.empty()) {
+			return false;
+		}
+
+		//Zero components turn into infinities, which the slab test handles
+		glm::vec3 inverseDirection = 1.0f / direction;
+		float nearest = maxDistance;
+		bool found = false;
+
+		uint32_t stack[MAX_STACK];
+		uint32_t stackSize = 0;
+		float rootDistance;
+		if (!rayHitsBox(origin, inverseDirection, nodes[0].boundsMin, nodes[0].boundsMax, nearest, rootDistance)) {
+			return false;
+		}
+		stack[stackSize++] = 0;
+		while (stackSize > 0) {
+			const Node& node = nodes[stack[--stackSize]];
+			float distance;
+			//Tested again, something nearer may have turned up since it was pushed
+			if (!rayHitsBox(origin, inverseDirection, node.boundsMin, node.boundsMax, nearest, distance)) {
+				continue;
+			}
+			if (node.count == 0) {
+				//Nearer child on top so it's visited first and shrinks the search
+				float leftDistance;
+				float rightDistance;
+				const Node& left = nodes[node.first];
+				const Node& right = nodes[node.first + 1];
+				bool hitLeft = rayHitsBox(origin, inverseDirection, left.boundsMin, left.boundsMax, nearest, leftDistance);
+				bool hitRight = rayHitsBox(origin, inverseDirection, right.boundsMin, right.boundsMax, nearest, rightDistance);
+				if (hitLeft && hitRight) {
+					bool leftFirst = leftDistance <= rightDistance;
+					stack[stackSize++] = leftFirst ? node.first + 1 : node.first;
+					stack[stackSize++] = leftFirst ? node.first : node.first + 1;
+				}
+				else if (hitLeft) {
+					stack[stackSize++] = node.first;
+				}
+				else if (hitRight) {
+					stack[stackSize++] = node.first + 1;
+				}
+				continue;
+			}
+			for (uint32_t i = node.first; i < node.first + node.count; i++) {
+				const Object& object = objects[leafObjects[i]];
+				if (object.alive && rayHitsBox(origin, inverseDirection, object.boundsMin, object.boundsMax, nearest, distance) && (!found || distance < nearest)) {
+					nearest = distance;
+					found = true;
+					hit.handle = leafObjects[i];
+					hit.userData = object.userData;
+					hit.distance = distance;
+				}
+			}
+		}
+		return found;
+	}
+}
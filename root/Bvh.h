@@ -0,0 +1,107 @@
+#ifndef __BVH_H__
+#define __BVH_H__
+
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "Frustum.h"
+
+namespace vkn {
+
+	typedef uint32_t BvhHandle;
+	const BvhHandle INVALID_BVH_HANDLE = ~0u;
+
+	struct BvhRayHit {
+		BvhHandle handle = INVALID_BVH_HANDLE;
+		uint32_t userData = 0;
+		//Along the ray, in units of the direction's length
+		float distance = 0.0f;
+	};
+
+	//Bounding volume hierarchy over axis aligned boxes, for culling, picking and
+	//range queries that only look at the part of the scene they could touch.
+	//
+	//Built top down with a binned surface area heuristic. Objects that move are
+	//refitted in place by walking up from their leaf, which keeps queries correct
+	//but lets the tree get worse. update() rebuilds once refitting has grown the
+	//summed area of the internal nodes too far past what the build produced, and
+	//after anything was inserted or removed.
+	//
+	//Queries hand back the userData each object was inserted with. They only read
+	//the tree, so several can run at once between updates.
+	class Bvh {
+	public:
+		Bvh() {}
+
+		//Not part of the tree until the next update()
+		BvhHandle insert(const glm::vec3& boundsMin, const glm::vec3& boundsMax, uint32_t userData);
+		void remove(BvhHandle handle);
+		//Refitted on the next update()
+		void setBounds(BvhHandle handle, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+
+		//Refits what moved, or rebuilds when that's not enough
+		void update();
+		void rebuild();
+
+		//Replaces out with everything touching the frustum. Subtrees entirely inside
+		//it go in without testing what's under them
+		void queryFrustum(const Frustum& frustum, std::vector<uint32_t>& out) const;
+		//Replaces out with everything whose box touches the sphere
+		void querySphere(const glm::vec3& center, float radius, std::vector<uint32_t>& out) const;
+		//Nearest box the ray enters (or starts in) before maxDistance
+		bool raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, BvhRayHit& hit) const;
+
+		uint32_t getObjectCount() { return objectCount; }
+		uint32_t getNodeCount() { return static_cast<uint32_t>(nodes.size()); }
+		uint32_t getRebuildCount() { return rebuildCount; }
+
+		//Leaves hold at most this many objects
+		static const uint32_t MAX_LEAF_OBJECTS = 4;
+		//Internal area this many times the built tree's triggers a rebuild
+		static constexpr float REBUILD_AREA_RATIO = 1.5f;
+
+	private:
+		//32 bytes plus the parent. Children are always allocated as a pair, left at
+		//first and right at first + 1, and always after their parent
+		struct Node {
+			glm::vec3 boundsMin;
+			//Left child, or the first entry in leafObjects for a leaf
+			uint32_t first;
+			glm::vec3 boundsMax;
+			//0 for internal nodes
+			uint32_t count;
+			uint32_t parent;
+		};
+
+		struct Object {
+			glm::vec3 boundsMin;
+			glm::vec3 boundsMax;
+			uint32_t userData;
+			uint32_t leaf;
+			bool alive;
+			bool moved;
+		};
+
+		void build(uint32_t nodeIndex, uint32_t begin, uint32_t end, uint32_t depth);
+		void refit(uint32_t nodeIndex);
+		void setNodeBounds(uint32_t nodeIndex, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+		void collect(uint32_t nodeIndex, std::vector<uint32_t>& out) const;
+
+		std::vector<Node> nodes;
+		std::vector<uint32_t> leafObjects;
+		std::vector<Object> objects;
+		std::vector<BvhHandle> freeHandles;
+		std::vector<BvhHandle> movedObjects;
+		//Scratch for the build, centroids of leafObjects
+		std::vector<glm::vec3> centroids;
+
+		uint32_t objectCount = 0;
+		uint32_t rebuildCount = 0;
+		bool structureChanged = false;
+		//Sum of internal node surface areas, the part of the SAH cost refits change
+		double internalArea = 0.0;
+		double builtArea = 0.0;
+	};
+}
+
+#endif
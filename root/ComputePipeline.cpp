@@ -0,0 +1,108 @@
+#include "ComputePipeline.h"
+
+#include <fstream>
+#include <stdexcept>
+
+namespace vkn {
+
+	ComputePipeline::ComputePipeline(LogicalDevice* logicalDevice) {
+		device = logicalDevice;
+	}
+
+	std::vector<char> ComputePipeline::readShaderFile(const std::string& filename) {
+		std::ifstream file(filename, std::ios::ate | std::ios::binary);
+		if (!file.is_open()) {
+			throw std::runtime_error("failed to open file");
+		}
+		size_t fileSize = (size_t)file.tellg();
+		std::vector<char> buffer(fileSize);
+
+		file.seekg(0);
+		file.read(buffer.data(), fileSize);
+		file.close();
+
+		return buffer;
+	}
+
+	VkShaderModule ComputePipeline::createShaderModule(const uint32_t* code, size_t size) {
+		VkShaderModuleCreateInfo createInfo{};
+		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		createInfo.codeSize = size;
+		createInfo.pCode = code;
+
+		VkShaderModule shaderModule;
+		if (vkCreateShaderModule(device->getDevice(), &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create valid shader module!");
+		}
+		return shaderModule;
+	}
+
+	void ComputePipeline::setComputeShader(std::string compute) {
+		std::vector<char> shaderCode = readShaderFile(compute);
+		computeShader = createShaderModule(reinterpret_cast<const uint32_t*>(shaderCode.data()), shaderCode.size());
+	}
+
+	void ComputePipeline::setComputeShader(const uint32_t* code, size_t size) {
+		computeShader = createShaderModule(code, size);
+	}
+
+	void ComputePipeline::setSpecializationConstant(uint32_t id, uint32_t value) {
+		VkSpecializationMapEntry entry{};
+		entry.constantID = id;
+		entry.offset = static_cast<uint32_t>(specializationData.size() * sizeof(uint32_t));
+		entry.size = sizeof(uint32_t);
+		specializationEntries.push_back(entry);
+		specializationData.push_back(value);
+	}
+
+	void ComputePipeline::buildPipeline(const std::vector<VkDescriptorSetLayout>& layouts, const std::vector<VkPushConstantRange>& pushConstantRanges) {
+		if (computeShader == VK_NULL_HANDLE) {
+			throw std::runtime_error("compute pipeline has no shader!");
+		}
+
+		VkPipelineShaderStageCreateInfo stageInfo{};
+		stageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		stageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		stageInfo.module = computeShader;
+		stageInfo.pName = "main";
+
+		VkSpecializationInfo specializationInfo{};
+		specializationInfo.mapEntryCount = static_cast<uint32_t>(specializationEntries.size());
+		specializationInfo.pMapEntries = specializationEntries.data();
+		specializationInfo.dataSize = specializationData.size() * sizeof(uint32_t);
+		specializationInfo.pData = specializationData.data();
+		stageInfo.pSpecializationInfo = specializationEntries.empty() ? nullptr : &specializationInfo;
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(layouts.size());
+		pipelineLayoutInfo.pSetLayouts = layouts.empty() ? nullptr : layouts.data();
+		pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size());
+		pipelineLayoutInfo.pPushConstantRanges = pushConstantRanges.empty() ? nullptr : pushConstantRanges.data();
+
+		if (vkCreatePipelineLayout(device->getDevice(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create compute pipelineLayout!");
+		}
+
+		VkComputePipelineCreateInfo pipelineInfo{};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.stage = stageInfo;
+		pipelineInfo.layout = pipelineLayout;
+		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+		pipelineInfo.basePipelineIndex = -1;
+
+		if (vkCreateComputePipelines(device->getDevice(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &computePipeline) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create compute pipeline!");
+		}
+	}
+
+	void ComputePipeline::bind(VkCommandBuffer commandBuffer) {
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline);
+	}
+
+	ComputePipeline::~ComputePipeline() {
+		vkDestroyPipeline(device->getDevice(), computePipeline, nullptr);
+		vkDestroyPipelineLayout(device->getDevice(), pipelineLayout, nullptr);
+		vkDestroyShaderModule(device->getDevice(), computeShader, nullptr);
+	}
+}
@@ -0,0 +1,51 @@
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#ifndef __COMPUTE_PIPELINE_H__
+#define __COMPUTE_PIPELINE_H__
+
+#include <string>
+#include <vector>
+#include "LogicalDevice.h"
+
+namespace vkn {
+
+	//A single compute shader and its layout. Built the same way as
+	//GraphicsPipeline: set the shader, then buildPipeline with the set layouts
+	//and push constant ranges whatever owns the resources hands out.
+	//Specialization constants, workgroup sizes included, go in before the build.
+	class ComputePipeline {
+	public:
+		ComputePipeline() {}
+		ComputePipeline(LogicalDevice* device);
+		~ComputePipeline();
+
+		void setComputeShader(std::string compute);
+		//SPIR-V already in memory, e.g. out of an AssetPack. Nothing is copied.
+		void setComputeShader(const uint32_t* code, size_t size);
+		//constant_id in the shader. Bools take 0 or 1, local_size_x_id and friends work the same way
+		void setSpecializationConstant(uint32_t id, uint32_t value);
+
+		void buildPipeline(const std::vector<VkDescriptorSetLayout>& layouts, const std::vector<VkPushConstantRange>& pushConstantRanges);
+		VkPipeline getPipeline() { return computePipeline; }
+		VkPipelineLayout getPipelineLayout() { return pipelineLayout; }
+
+		void bind(VkCommandBuffer commandBuffer);
+		//Group counts to cover count invocations with groupSize wide groups
+		static uint32_t getGroupCount(uint32_t count, uint32_t groupSize) { return (count + groupSize - 1) / groupSize; }
+
+	private:
+		std::vector<char> readShaderFile(const std::string& filename);
+		VkShaderModule createShaderModule(const uint32_t* code, size_t size);
+
+		LogicalDevice* device;
+		VkShaderModule computeShader = VK_NULL_HANDLE;
+		std::vector<VkSpecializationMapEntry> specializationEntries;
+		std::vector<uint32_t> specializationData;
+
+		VkPipeline computePipeline = VK_NULL_HANDLE;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	};
+}
+
+#endif
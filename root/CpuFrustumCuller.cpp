@@ -0,0 +1,198 @@
+#include "CpuFrustumCuller.h"
+#include <algorithm>
+#include <cfloat>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define VKN_CULL_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+//MSVC lets any function use any intrinsic, GCC and Clang need to be told per function
+#if defined(VKN_CULL_X86) && (defined(__GNUC__) || defined(__clang__))
+#define VKN_TARGET_AVX __attribute__((target("avx")))
+#else
+#define VKN_TARGET_AVX
+#endif
+
+namespace vkn {
+
+	//A radius nothing can be inside of, for the padding at the end of the arrays
+	static const float NEVER_VISIBLE = -FLT_MAX;
+
+	static uint32_t roundUp(uint32_t count, uint32_t multiple) {
+		return (count + multiple - 1) / multiple * multiple;
+	}
+
+	static uint32_t cullScalar(const Frustum& frustum, const float* x, const float* y, const float* z, const float* r,
+		uint32_t count, uint32_t* visible) {
+		uint32_t visibleCount = 0;
+		for (uint32_t i = 0; i < count; i++) {
+			bool inside = true;
+			for (const glm::vec4& plane : frustum.planes) {
+				inside &= plane.x * x[i] + plane.y * y[i] + plane.z * z[i] + plane.w >= -r[i];
+			}
+			//Written every time and only kept when inside, no branch to mispredict
+			visible[visibleCount] = i;
+			visibleCount += inside ? 1 : 0;
+		}
+		return visibleCount;
+	}
+
+#ifdef VKN_CULL_X86
+	static uint32_t cullSSE(const Frustum& frustum, const float* x, const float* y, const float* z, const float* r,
+		uint32_t count, uint32_t* visible) {
+		__m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+		for (int p = 0; p < 6; p++) {
+			planeX[p] = _mm_set1_ps(frustum.planes[p].x);
+			planeY[p] = _mm_set1_ps(frustum.planes[p].y);
+			planeZ[p] = _mm_set1_ps(frustum.planes[p].z);
+			planeW[p] = _mm_set1_ps(frustum.planes[p].w);
+		}
+
+		uint32_t visibleCount = 0;
+		for (uint32_t i = 0; i < count; i += 4) {
+			__m128 cx = _mm_loadu_ps(x + i);
+			__m128 cy = _mm_loadu_ps(y + i);
+			__m128 cz = _mm_loadu_ps(z + i);
+			__m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(r + i));
+			__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (int p = 0; p < 6; p++) {
+				__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], cx), _mm_mul_ps(planeY[p], cy)),
+					_mm_add_ps(_mm_mul_ps(planeZ[p], cz), planeW[p]));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negRadius));
+			}
+			uint32_t mask = static_cast<uint32_t>(_mm_movemask_ps(inside));
+			for (uint32_t lane = 0; lane < 4; lane++) {
+				visible[visibleCount] = i + lane;
+				visibleCount += (mask >> lane) & 1;
+			}
+		}
+		return visibleCount;
+	}
+
+	VKN_TARGET_AVX static uint32_t cullAVX(const Frustum& frustum, const float* x, const float* y, const float* z, const float* r,
+		uint32_t count, uint32_t* visible) {
+		__m256 planeX[6], planeY[6], planeZ[6], planeW[6];
+		for (int p = 0; p < 6; p++) {
+			planeX[p] = _mm256_set1_ps(frustum.planes[p].x);
+			planeY[p] = _mm256_set1_ps(frustum.planes[p].y);
+			planeZ[p] = _mm256_set1_ps(frustum.planes[p].z);
+			planeW[p] = _mm256_set1_ps(frustum.planes[p].w);
+		}
+
+		uint32_t visibleCount = 0;
+		for (uint32_t i = 0; i < count; i += 8) {
+			__m256 cx = _mm256_loadu_ps(x + i);
+			__m256 cy = _mm256_loadu_ps(y + i);
+			__m256 cz = _mm256_loadu_ps(z + i);
+			__m256 negRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(r + i));
+			__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+			for (int p = 0; p < 6; p++) {
+				__m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(planeX[p], cx), _mm256_mul_ps(planeY[p], cy)),
+					_mm256_add_ps(_mm256_mul_ps(planeZ[p], cz), planeW[p]));
+				inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negRadius, _CMP_GE_OQ));
+			}
+			uint32_t mask = static_cast<uint32_t>(_mm256_movemask_ps(inside));
+			for (uint32_t lane = 0; lane < 8; lane++) {
+				visible[visibleCount] = i + lane;
+				visibleCount += (mask >> lane) & 1;
+			}
+		}
+		return visibleCount;
+	}
+#endif
+
+	CpuFrustumCuller::CpuFrustumCuller(uint32_t capacity) {
+		uint32_t padded = roundUp(capacity, LANE_PADDING);
+		centerX.reserve(padded);
+		centerY.reserve(padded);
+		centerZ.reserve(padded);
+		radii.reserve(padded);
+		kernel = detectKernel();
+	}
+
+	CullKernel CpuFrustumCuller::detectKernel() {
+#ifdef VKN_CULL_X86
+#if defined(_MSC_VER)
+		//AVX needs the CPU to have it and the OS to save the wider registers
+		int info[4];
+		__cpuid(info, 1);
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		bool avx = (info[2] & (1 << 28)) != 0;
+		if (osxsave && avx && (_xgetbv(0) & 6) == 6) {
+			return CullKernel::AVX;
+		}
+#else
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx")) {
+			return CullKernel::AVX;
+		}
+#endif
+		return CullKernel::SSE;
+#else
+		return CullKernel::Scalar;
+#endif
+	}
+
+	void CpuFrustumCuller::setKernel(CullKernel kernel) {
+		this->kernel = std::min(kernel, detectKernel());
+	}
+
+	void CpuFrustumCuller::resize(uint32_t count) {
+		uint32_t padded = roundUp(count, LANE_PADDING);
+		//Whatever was padding before may be in range now, and the new padding has to fail
+		centerX.resize(padded, 0.0f);
+		centerY.resize(padded, 0.0f);
+		centerZ.resize(padded, 0.0f);
+		radii.resize(padded, NEVER_VISIBLE);
+		std::fill(radii.begin() + std::min(this->count, count), radii.end(), NEVER_VISIBLE);
+		this->count = count;
+	}
+
+	void CpuFrustumCuller::setSphere(uint32_t index, const glm::vec3& center, float radius) {
+		centerX[index] = center.x;
+		centerY[index] = center.y;
+		centerZ[index] = center.z;
+		radii[index] = radius;
+	}
+
+	void CpuFrustumCuller::transformSpheres(const glm::vec3& localCenter, float localRadius, const glm::mat4* transforms, uint32_t count,
+		uint32_t first, size_t stride) {
+		const unsigned char* source = reinterpret_cast<const unsigned char*>(transforms);
+		for (uint32_t i = 0; i < count; i++) {
+			const glm::mat4& transform = *reinterpret_cast<const glm::mat4*>(source + stride * i);
+			glm::vec3 center = glm::vec3(transform * glm::vec4(localCenter, 1.0f));
+			//Largest axis scale keeps the sphere conservative under non uniform scaling
+			float scale = std::max(glm::length(glm::vec3(transform[0])), std::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+			centerX[first + i] = center.x;
+			centerY[first + i] = center.y;
+			centerZ[first + i] = center.z;
+			radii[first + i] = localRadius * scale;
+		}
+	}
+
+	uint32_t CpuFrustumCuller::cull(const Frustum& frustum, std::vector<uint32_t>& visible) {
+		//Every lane gets written before it's known whether it's kept
+		uint32_t padded = roundUp(count, LANE_PADDING);
+		visible.resize(padded);
+		uint32_t visibleCount;
+		switch (kernel) {
+#ifdef VKN_CULL_X86
+		case CullKernel::AVX:
+			visibleCount = cullAVX(frustum, centerX.data(), centerY.data(), centerZ.data(), radii.data(), padded, visible.data());
+			break;
+		case CullKernel::SSE:
+			visibleCount = cullSSE(frustum, centerX.data(), centerY.data(), centerZ.data(), radii.data(), padded, visible.data());
+			break;
+#endif
+		default:
+			visibleCount = cullScalar(frustum, centerX.data(), centerY.data(), centerZ.data(), radii.data(), count, visible.data());
+			break;
+		}
+		visible.resize(visibleCount);
+		return visibleCount;
+	}
+}
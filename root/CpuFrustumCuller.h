@@ -0,0 +1,64 @@
+#ifndef __CPU_FRUSTUM_CULLER_H__
+#define __CPU_FRUSTUM_CULLER_H__
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <glm/glm.hpp>
+#include "Frustum.h"
+
+namespace vkn {
+
+	enum class CullKernel {
+		Scalar,
+		SSE,
+		AVX
+	};
+
+	//Frustum culling on the CPU for when FrustumCuller can't run. Bounding
+	//spheres are kept as four separate float arrays (x, y, z, radius), so one
+	//SIMD load picks up the same component of 4 (SSE) or 8 (AVX) spheres and
+	//each plane test covers them all at once. The widest kernel the CPU can run
+	//is picked at startup, anything that isn't x86 gets the scalar loop.
+	//
+	//Not thread safe, but separate cullers can run on separate threads.
+	class CpuFrustumCuller {
+	public:
+		CpuFrustumCuller() : CpuFrustumCuller(0) {}
+		CpuFrustumCuller(uint32_t capacity);
+
+		//Spheres past the old count start out never visible until they're set
+		void resize(uint32_t count);
+		void setSphere(uint32_t index, const glm::vec3& center, float radius);
+		//Moves a local sphere by count transforms and stores the results from first
+		//on, same as FrustumCull.comp does. stride is the distance in bytes between
+		//transforms, so they can be read straight out of a bigger struct
+		void transformSpheres(const glm::vec3& localCenter, float localRadius, const glm::mat4* transforms, uint32_t count,
+			uint32_t first = 0, size_t stride = sizeof(glm::mat4));
+
+		//Fills visible with the index of every sphere that touches the frustum, in
+		//order. Returns how many there were
+		uint32_t cull(const Frustum& frustum, std::vector<uint32_t>& visible);
+
+		uint32_t getCount() { return count; }
+		CullKernel getKernel() { return kernel; }
+		//Forces a narrower kernel, mostly for comparing them. Asking for one the CPU
+		//doesn't have falls back to the best one it does
+		void setKernel(CullKernel kernel);
+
+		static CullKernel detectKernel();
+
+	private:
+		//Arrays are padded to this so every kernel can run whole batches
+		static const uint32_t LANE_PADDING = 8;
+
+		uint32_t count = 0;
+		CullKernel kernel = CullKernel::Scalar;
+		std::vector<float> centerX;
+		std::vector<float> centerY;
+		std::vector<float> centerZ;
+		std::vector<float> radii;
+	};
+}
+
+#endif
@@ -0,0 +1,89 @@
+#include "DescriptorAllocator.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace vkn {
+
+	DescriptorAllocator::DescriptorAllocator(LogicalDevice* device, const std::vector<DescriptorPoolRatio>& ratios, uint32_t initialSets) {
+		this->device = device;
+		this->ratios = ratios;
+		setsPerPool = std::max(initialSets, 1u);
+		readyPools.push_back(createPool(setsPerPool));
+	}
+
+	DescriptorAllocator::~DescriptorAllocator() {
+		//Sets go with the pools
+		for (VkDescriptorPool pool : readyPools) {
+			vkDestroyDescriptorPool(device->getDevice(), pool, nullptr);
+		}
+		for (VkDescriptorPool pool : fullPools) {
+			vkDestroyDescriptorPool(device->getDevice(), pool, nullptr);
+		}
+	}
+
+	VkDescriptorPool DescriptorAllocator::createPool(uint32_t setCount) {
+		std::vector<VkDescriptorPoolSize> poolSizes;
+		for (const DescriptorPoolRatio& ratio : ratios) {
+			VkDescriptorPoolSize poolSize{};
+			poolSize.type = ratio.type;
+			poolSize.descriptorCount = std::max(static_cast<uint32_t>(ratio.ratio * setCount), 1u);
+			poolSizes.push_back(poolSize);
+		}
+
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.maxSets = setCount;
+		poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+		poolInfo.pPoolSizes = poolSizes.data();
+
+		VkDescriptorPool pool;
+		if (vkCreateDescriptorPool(device->getDevice(), &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create descriptor pool!");
+		}
+		return pool;
+	}
+
+	//A pool left over from before the last reset if there is one, otherwise a bigger new one
+	VkDescriptorPool DescriptorAllocator::takePool() {
+		if (!readyPools.empty()) {
+			return readyPools.back();
+		}
+		setsPerPool = std::min(setsPerPool + setsPerPool / 2, MAX_SETS_PER_POOL);
+		readyPools.push_back(createPool(setsPerPool));
+		return readyPools.back();
+	}
+
+	VkDescriptorSet DescriptorAllocator::allocate(VkDescriptorSetLayout layout, const void* next) {
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.pNext = next;
+		allocInfo.descriptorPool = takePool();
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &layout;
+
+		VkDescriptorSet set;
+		VkResult result = vkAllocateDescriptorSets(device->getDevice(), &allocInfo, &set);
+		//Full, or too fragmented to fit this layout. Either way it's done for until the next reset
+		if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL) {
+			fullPools.push_back(readyPools.back());
+			readyPools.pop_back();
+			allocInfo.descriptorPool = takePool();
+			result = vkAllocateDescriptorSets(device->getDevice(), &allocInfo, &set);
+		}
+		if (result != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate descriptor set!");
+		}
+		return set;
+	}
+
+	void DescriptorAllocator::reset() {
+		for (VkDescriptorPool pool : readyPools) {
+			vkResetDescriptorPool(device->getDevice(), pool, 0);
+		}
+		for (VkDescriptorPool pool : fullPools) {
+			vkResetDescriptorPool(device->getDevice(), pool, 0);
+			readyPools.push_back(pool);
+		}
+		fullPools.clear();
+	}
+}
@@ -0,0 +1,55 @@
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#ifndef __DESCRIPTOR_ALLOCATOR_H__
+#define __DESCRIPTOR_ALLOCATOR_H__
+
+#include <vector>
+#include "LogicalDevice.h"
+
+namespace vkn {
+
+	//How many descriptors of a type each pool gets per set it can hold
+	struct DescriptorPoolRatio {
+		VkDescriptorType type;
+		float ratio;
+	};
+
+	//Hands out descriptor sets from a list of pools, starting another one
+	//whenever the current pool runs out instead of failing. Each new pool holds
+	//half again as many sets as the last, up to MAX_SETS_PER_POOL.
+	//
+	//Sets are never freed one at a time. reset() takes every pool back with
+	//vkResetDescriptorPool, so keep one allocator per frame in flight for sets
+	//that only live a frame and reset it once that frame's fence has signalled.
+	class DescriptorAllocator {
+	public:
+		static const uint32_t MAX_SETS_PER_POOL = 4096;
+
+		DescriptorAllocator() {}
+		DescriptorAllocator(LogicalDevice* device, const std::vector<DescriptorPoolRatio>& ratios, uint32_t initialSets = 16);
+		~DescriptorAllocator();
+
+		//next is chained onto the VkDescriptorSetAllocateInfo, e.g. for variable
+		//descriptor counts. Throws if even a fresh pool can't fit the layout
+		VkDescriptorSet allocate(VkDescriptorSetLayout layout, const void* next = nullptr);
+		//Every set allocated so far is invalid afterwards
+		void reset();
+
+		uint32_t getPoolCount() { return static_cast<uint32_t>(readyPools.size() + fullPools.size()); }
+
+	private:
+		VkDescriptorPool takePool();
+		VkDescriptorPool createPool(uint32_t setCount);
+
+		LogicalDevice* device;
+		std::vector<DescriptorPoolRatio> ratios;
+		uint32_t setsPerPool;
+
+		//readyPools.back() is the one being allocated from
+		std::vector<VkDescriptorPool> readyPools;
+		std::vector<VkDescriptorPool> fullPools;
+	};
+}
+
+#endif
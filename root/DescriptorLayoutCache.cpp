@@ -0,0 +1,108 @@
+#include "DescriptorLayoutCache.h"
+#include "LogicalDevice.h"
+#include "Hash.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace vkn {
+
+	DescriptorLayoutCache::DescriptorLayoutCache(LogicalDevice* logicalDevice) {
+		device = logicalDevice;
+	}
+
+	DescriptorLayoutCache::~DescriptorLayoutCache() {
+		for (auto& entry : layouts) {
+			vkDestroyDescriptorSetLayout(device->getDevice(), entry.second, nullptr);
+		}
+	}
+
+	bool DescriptorLayoutCache::BindingKey::operator==(const BindingKey& other) const {
+		return binding == other.binding && type == other.type && count == other.count &&
+			stageFlags == other.stageFlags && bindingFlags == other.bindingFlags && firstSampler == other.firstSampler;
+	}
+
+	bool DescriptorLayoutCache::LayoutKey::operator==(const LayoutKey& other) const {
+		return flags == other.flags && bindings == other.bindings && immutableSamplers == other.immutableSamplers;
+	}
+
+	size_t DescriptorLayoutCache::LayoutKeyHash::operator()(const LayoutKey& key) const {
+		size_t hash = 0;
+		hashCombine(hash, key.flags);
+		for (const BindingKey& binding : key.bindings) {
+			hashCombine(hash, binding.binding);
+			hashCombine(hash, binding.type);
+			hashCombine(hash, binding.count);
+			hashCombine(hash, binding.stageFlags);
+			hashCombine(hash, binding.bindingFlags);
+		}
+		for (VkSampler sampler : key.immutableSamplers) {
+			hashCombine(hash, sampler);
+		}
+		return hash;
+	}
+
+	VkDescriptorSetLayout DescriptorLayoutCache::getLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings,
+		VkDescriptorSetLayoutCreateFlags flags, const std::vector<VkDescriptorBindingFlags>& bindingFlags) {
+		if (!bindingFlags.empty() && bindingFlags.size() != bindings.size()) {
+			throw std::runtime_error("descriptor binding flags don't match the bindings!");
+		}
+
+		//Sort a copy so the same bindings listed in another order share a layout.
+		//Flags have to move with their binding
+		std::vector<uint32_t> order(bindings.size());
+		for (uint32_t i = 0; i < order.size(); i++) {
+			order[i] = i;
+		}
+		std::sort(order.begin(), order.end(), [&bindings](uint32_t a, uint32_t b) { return bindings[a].binding < bindings[b].binding; });
+
+		LayoutKey key;
+		key.flags = flags;
+		key.bindings.reserve(bindings.size());
+		for (uint32_t i : order) {
+			const VkDescriptorSetLayoutBinding& binding = bindings[i];
+			BindingKey bindingKey;
+			bindingKey.binding = binding.binding;
+			bindingKey.type = binding.descriptorType;
+			bindingKey.count = binding.descriptorCount;
+			bindingKey.stageFlags = binding.stageFlags;
+			bindingKey.bindingFlags = bindingFlags.empty() ? 0 : bindingFlags[i];
+			bindingKey.firstSampler = ~0u;
+			//Only sampler types look at pImmutableSamplers
+			bool samplerType = binding.descriptorType == VK_DESCRIPTOR_TYPE_SAMPLER ||
+				binding.descriptorType == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			if (samplerType && binding.pImmutableSamplers != nullptr) {
+				bindingKey.firstSampler = static_cast<uint32_t>(key.immutableSamplers.size());
+				key.immutableSamplers.insert(key.immutableSamplers.end(), binding.pImmutableSamplers,
+					binding.pImmutableSamplers + binding.descriptorCount);
+			}
+			key.bindings.push_back(bindingKey);
+		}
+
+		std::lock_guard<std::mutex> lock(layoutMutex);
+
+		auto found = layouts.find(key);
+		if (found != layouts.end()) {
+			return found->second;
+		}
+
+		VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+		bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+		bindingFlagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+		bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.pNext = bindingFlags.empty() ? nullptr : &bindingFlagsInfo;
+		layoutInfo.flags = flags;
+		layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+		layoutInfo.pBindings = bindings.data();
+
+		VkDescriptorSetLayout layout;
+		if (vkCreateDescriptorSetLayout(device->getDevice(), &layoutInfo, nullptr, &layout) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create descriptor set layout!");
+		}
+		layouts.emplace(std::move(key), layout);
+		return layout;
+	}
+}
@@ -0,0 +1,66 @@
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#ifndef __DESCRIPTOR_LAYOUT_CACHE_H__
+#define __DESCRIPTOR_LAYOUT_CACHE_H__
+
+#include <unordered_map>
+#include <vector>
+#include <mutex>
+
+namespace vkn {
+
+	class LogicalDevice;
+
+	//Hands out one shared VkDescriptorSetLayout per unique set of bindings, the
+	//same way SamplerCache does for samplers. Bindings are compared after sorting
+	//by binding number, so the order they're listed in doesn't matter.
+	//Owned by LogicalDevice, and everything it returns lives until the device goes.
+	//Don't vkDestroyDescriptorSetLayout anything that came from here.
+	class DescriptorLayoutCache {
+	public:
+		DescriptorLayoutCache() {}
+		DescriptorLayoutCache(LogicalDevice* device);
+		~DescriptorLayoutCache();
+
+		//bindingFlags is either empty or one entry per binding, in the same order
+		//as bindings. It gets chained on as VkDescriptorSetLayoutBindingFlagsCreateInfo
+		VkDescriptorSetLayout getLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings,
+			VkDescriptorSetLayoutCreateFlags flags = 0, const std::vector<VkDescriptorBindingFlags>& bindingFlags = {});
+
+		uint32_t getLayoutCount() { return static_cast<uint32_t>(layouts.size()); }
+
+	private:
+		struct BindingKey {
+			uint32_t binding;
+			VkDescriptorType type;
+			uint32_t count;
+			VkShaderStageFlags stageFlags;
+			VkDescriptorBindingFlags bindingFlags;
+			//Index of the first of this binding's samplers in LayoutKey::immutableSamplers,
+			//or ~0u without any
+			uint32_t firstSampler;
+
+			bool operator==(const BindingKey& other) const;
+		};
+
+		struct LayoutKey {
+			VkDescriptorSetLayoutCreateFlags flags;
+			std::vector<BindingKey> bindings;
+			//Samplers are cached too, so the handle is enough to tell them apart
+			std::vector<VkSampler> immutableSamplers;
+
+			bool operator==(const LayoutKey& other) const;
+		};
+
+		struct LayoutKeyHash {
+			size_t operator()(const LayoutKey& key) const;
+		};
+
+		LogicalDevice* device;
+		std::mutex layoutMutex;
+		std::unordered_map<LayoutKey, VkDescriptorSetLayout, LayoutKeyHash> layouts;
+	};
+}
+
+#endif
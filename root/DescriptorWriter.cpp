@@ -0,0 +1,164 @@
+#include "DescriptorWriter.h"
+#include <stdexcept>
+
+namespace vkn {
+
+	static bool isImageType(VkDescriptorType type) {
+		return type == VK_DESCRIPTOR_TYPE_SAMPLER || type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER ||
+			type == VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE || type == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE ||
+			type == VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+	}
+
+	static bool isTexelBufferType(VkDescriptorType type) {
+		return type == VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER || type == VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER;
+	}
+
+	DescriptorWriter::DescriptorWriter(LogicalDevice* device) {
+		this->device = device;
+	}
+
+	uint32_t DescriptorWriter::addWrite(VkDescriptorSet set, uint32_t binding, uint32_t arrayElement, VkDescriptorType type, uint32_t count) {
+		VkWriteDescriptorSet write{};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = set;
+		write.dstBinding = binding;
+		write.dstArrayElement = arrayElement;
+		write.descriptorType = type;
+		write.descriptorCount = count;
+		writes.push_back(write);
+		return static_cast<uint32_t>(writes.size() - 1);
+	}
+
+	void DescriptorWriter::writeBuffers(VkDescriptorSet set, uint32_t binding, uint32_t arrayElement, VkDescriptorType type,
+		const VkDescriptorBufferInfo* infos, uint32_t count) {
+		addWrite(set, binding, arrayElement, type, count);
+		firstInfos.push_back(static_cast<uint32_t>(bufferInfos.size()));
+		bufferInfos.insert(bufferInfos.end(), infos, infos + count);
+	}
+
+	void DescriptorWriter::writeImages(VkDescriptorSet set, uint32_t binding, uint32_t arrayElement, VkDescriptorType type,
+		const VkDescriptorImageInfo* infos, uint32_t count) {
+		addWrite(set, binding, arrayElement, type, count);
+		firstInfos.push_back(static_cast<uint32_t>(imageInfos.size()));
+		imageInfos.insert(imageInfos.end(), infos, infos + count);
+	}
+
+	void DescriptorWriter::writeTexelBuffers(VkDescriptorSet set, uint32_t binding, uint32_t arrayElement, VkDescriptorType type,
+		const VkBufferView* views, uint32_t count) {
+		addWrite(set, binding, arrayElement, type, count);
+		firstInfos.push_back(static_cast<uint32_t>(texelBufferViews.size()));
+		texelBufferViews.insert(texelBufferViews.end(), views, views + count);
+	}
+
+	void DescriptorWriter::writeBuffer(VkDescriptorSet set, uint32_t binding, VkDescriptorType type, VkBuffer buffer,
+		VkDeviceSize offset, VkDeviceSize range) {
+		VkDescriptorBufferInfo info{};
+		info.buffer = buffer;
+		info.offset = offset;
+		info.range = range;
+		writeBuffers(set, binding, 0, type, &info, 1);
+	}
+
+	void DescriptorWriter::writeImage(VkDescriptorSet set, uint32_t binding, VkDescriptorType type, VkImageView view,
+		VkImageLayout layout, VkSampler sampler) {
+		VkDescriptorImageInfo info{};
+		info.sampler = sampler;
+		info.imageView = view;
+		info.imageLayout = layout;
+		writeImages(set, binding, 0, type, &info, 1);
+	}
+
+	void DescriptorWriter::flush() {
+		if (writes.empty()) {
+			return;
+		}
+		for (size_t i = 0; i < writes.size(); i++) {
+			VkWriteDescriptorSet& write = writes[i];
+			if (isImageType(write.descriptorType)) {
+				write.pImageInfo = &imageInfos[firstInfos[i]];
+			}
+			else if (isTexelBufferType(write.descriptorType)) {
+				write.pTexelBufferView = &texelBufferViews[firstInfos[i]];
+			}
+			else {
+				write.pBufferInfo = &bufferInfos[firstInfos[i]];
+			}
+		}
+		vkUpdateDescriptorSets(device->getDevice(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+		clear();
+	}
+
+	void DescriptorWriter::clear() {
+		writes.clear();
+		firstInfos.clear();
+		bufferInfos.clear();
+		imageInfos.clear();
+		texelBufferViews.clear();
+	}
+
+	DescriptorTemplate::DescriptorTemplate(LogicalDevice* device, VkDescriptorSetLayout layout, const std::vector<VkDescriptorUpdateTemplateEntry>& entries) {
+		this->device = device;
+		this->entries = entries;
+		fallback = DescriptorWriter(device);
+
+		//Templates are core in 1.1, and the instance asks for 1.1 already
+		if (device->getProperties().apiVersion < VK_API_VERSION_1_1) {
+			return;
+		}
+
+		VkDescriptorUpdateTemplateCreateInfo templateInfo{};
+		templateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO;
+		templateInfo.descriptorUpdateEntryCount = static_cast<uint32_t>(entries.size());
+		templateInfo.pDescriptorUpdateEntries = entries.data();
+		templateInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+		templateInfo.descriptorSetLayout = layout;
+
+		if (vkCreateDescriptorUpdateTemplate(device->getDevice(), &templateInfo, nullptr, &updateTemplate) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create descriptor update template!");
+		}
+	}
+
+	DescriptorTemplate::~DescriptorTemplate() {
+		if (updateTemplate != VK_NULL_HANDLE) {
+			vkDestroyDescriptorUpdateTemplate(device->getDevice(), updateTemplate, nullptr);
+		}
+	}
+
+	void DescriptorTemplate::update(VkDescriptorSet set, const void* data) {
+		if (updateTemplate != VK_NULL_HANDLE) {
+			vkUpdateDescriptorSetWithTemplate(device->getDevice(), set, updateTemplate, data);
+			return;
+		}
+
+		//Same walk over the struct the driver would do, one write per entry
+		const char* bytes = static_cast<const char*>(data);
+		std::vector<VkDescriptorBufferInfo> bufferInfos;
+		std::vector<VkDescriptorImageInfo> imageInfos;
+		std::vector<VkBufferView> texelBufferViews;
+		for (const VkDescriptorUpdateTemplateEntry& entry : entries) {
+			const char* first = bytes + entry.offset;
+			if (isImageType(entry.descriptorType)) {
+				imageInfos.resize(entry.descriptorCount);
+				for (uint32_t i = 0; i < entry.descriptorCount; i++) {
+					imageInfos[i] = *reinterpret_cast<const VkDescriptorImageInfo*>(first + i * entry.stride);
+				}
+				fallback.writeImages(set, entry.dstBinding, entry.dstArrayElement, entry.descriptorType, imageInfos.data(), entry.descriptorCount);
+			}
+			else if (isTexelBufferType(entry.descriptorType)) {
+				texelBufferViews.resize(entry.descriptorCount);
+				for (uint32_t i = 0; i < entry.descriptorCount; i++) {
+					texelBufferViews[i] = *reinterpret_cast<const VkBufferView*>(first + i * entry.stride);
+				}
+				fallback.writeTexelBuffers(set, entry.dstBinding, entry.dstArrayElement, entry.descriptorType, texelBufferViews.data(), entry.descriptorCount);
+			}
+			else {
+				bufferInfos.resize(entry.descriptorCount);
+				for (uint32_t i = 0; i < entry.descriptorCount; i++) {
+					bufferInfos[i] = *reinterpret_cast<const VkDescriptorBufferInfo*>(first + i * entry.stride);
+				}
+				fallback.writeBuffers(set, entry.dstBinding, entry.dstArrayElement, entry.descriptorType, bufferInfos.data(), entry.descriptorCount);
+			}
+		}
+		fallback.flush();
+	}
+}
@@ -0,0 +1,76 @@
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#ifndef __DESCRIPTOR_WRITER_H__
+#define __DESCRIPTOR_WRITER_H__
+
+#include <vector>
+#include "LogicalDevice.h"
+
+namespace vkn {
+
+	//Collects descriptor writes, for any number of sets, and hands them to the
+	//driver in one vkUpdateDescriptorSets call on flush. Infos are copied in, so
+	//nothing passed to the write calls has to outlive them.
+	class DescriptorWriter {
+	public:
+		DescriptorWriter() {}
+		DescriptorWriter(LogicalDevice* device);
+
+		void writeBuffers(VkDescriptorSet set, uint32_t binding, uint32_t arrayElement, VkDescriptorType type,
+			const VkDescriptorBufferInfo* infos, uint32_t count);
+		void writeImages(VkDescriptorSet set, uint32_t binding, uint32_t arrayElement, VkDescriptorType type,
+			const VkDescriptorImageInfo* infos, uint32_t count);
+		void writeTexelBuffers(VkDescriptorSet set, uint32_t binding, uint32_t arrayElement, VkDescriptorType type,
+			const VkBufferView* views, uint32_t count);
+
+		void writeBuffer(VkDescriptorSet set, uint32_t binding, VkDescriptorType type, VkBuffer buffer,
+			VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+		//Leave sampler null for bindings with an immutable one, or that don't sample
+		void writeImage(VkDescriptorSet set, uint32_t binding, VkDescriptorType type, VkImageView view,
+			VkImageLayout layout, VkSampler sampler = VK_NULL_HANDLE);
+
+		//Everything written since the last flush, in order
+		void flush();
+		void clear();
+
+		uint32_t getPendingWrites() { return static_cast<uint32_t>(writes.size()); }
+
+	private:
+		//Infos are only pointed at on flush, the vectors can move until then
+		uint32_t addWrite(VkDescriptorSet set, uint32_t binding, uint32_t arrayElement, VkDescriptorType type, uint32_t count);
+
+		LogicalDevice* device;
+		std::vector<VkWriteDescriptorSet> writes;
+		//Index of each write's first info in whichever vector its type uses
+		std::vector<uint32_t> firstInfos;
+		std::vector<VkDescriptorBufferInfo> bufferInfos;
+		std::vector<VkDescriptorImageInfo> imageInfos;
+		std::vector<VkBufferView> texelBufferViews;
+	};
+
+	//Writes every set of one layout from a struct of the caller's, laid out as
+	//the entries describe (offset and stride in bytes, of VkDescriptorImageInfo,
+	//VkDescriptorBufferInfo or VkBufferView depending on the type). Uses a
+	//descriptor update template on Vulkan 1.1 devices, so the driver walks the
+	//struct directly. Older devices get the same writes through a DescriptorWriter.
+	class DescriptorTemplate {
+	public:
+		DescriptorTemplate() {}
+		DescriptorTemplate(LogicalDevice* device, VkDescriptorSetLayout layout, const std::vector<VkDescriptorUpdateTemplateEntry>& entries);
+		~DescriptorTemplate();
+
+		void update(VkDescriptorSet set, const void* data);
+
+		//False when falling back to vkUpdateDescriptorSets
+		bool isNative() { return updateTemplate != VK_NULL_HANDLE; }
+
+	private:
+		LogicalDevice* device;
+		std::vector<VkDescriptorUpdateTemplateEntry> entries;
+		VkDescriptorUpdateTemplate updateTemplate = VK_NULL_HANDLE;
+		DescriptorWriter fallback;
+	};
+}
+
+#endif
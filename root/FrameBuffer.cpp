@@ -9,13 +9,31 @@ namespace vkn {
 		VkImageView imageViewBind) {
 
 		device = vknDevice;
+		createFrameBuffer(renderPass, width, height, layers, { imageViewBind });
+	}
+
+	FrameBuffer::FrameBuffer(vkn::LogicalDevice* vknDevice,
+		vkn::RenderPass* renderPass,
+		uint32_t width,
+		uint32_t height,
+		uint32_t layers,
+		const std::vector<VkImageView>& attachments) {
+
+		device = vknDevice;
+		createFrameBuffer(renderPass, width, height, layers, attachments);
+	}
+
+	void FrameBuffer::createFrameBuffer(vkn::RenderPass* renderPass, uint32_t width, uint32_t height, uint32_t layers,
+		const std::vector<VkImageView>& attachments) {
+		if (attachments.size() != renderPass->getAttachmentCount()) {
+			throw std::runtime_error("framebuffer attachments don't match the render pass!");
+		}
 
 		VkFramebufferCreateInfo framebufferInfo{};
 		framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
 		framebufferInfo.renderPass = renderPass->getRenderPass();
-		//This is fine as one for now, but we could bump it up later
-		framebufferInfo.attachmentCount = 1;
-		framebufferInfo.pAttachments = &imageViewBind;
+		framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+		framebufferInfo.pAttachments = attachments.data();
 		framebufferInfo.width = width;
 		framebufferInfo.height = height;
 		framebufferInfo.layers = layers;
@@ -4,6 +4,7 @@
 #ifndef __FRAME_BUFFER_H__
 #define __FRAME_BUFFER_H__
 
+#include <vector>
 #include "LogicalDevice.h"
 #include "RenderPass.h"
 
@@ -17,11 +18,21 @@ namespace vkn {
 			uint32_t height,
 			uint32_t layers,
 			VkImageView imageViewBind);
+		//Views in the render pass's attachment order, color then depth
+		FrameBuffer(vkn::LogicalDevice* vknDevice,
+			vkn::RenderPass* renderPass,
+			uint32_t width,
+			uint32_t height,
+			uint32_t layers,
+			const std::vector<VkImageView>& attachments);
 		~FrameBuffer();
 
 		VkFramebuffer getFrameBuffer() { return buffer; }
 
 	private:
+		void createFrameBuffer(vkn::RenderPass* renderPass, uint32_t width, uint32_t height, uint32_t layers,
+			const std::vector<VkImageView>& attachments);
+
 		vkn::LogicalDevice* device;
 		VkFramebuffer buffer;
 
@@ -0,0 +1,52 @@
+#include "Frustum.h"
+
+namespace vkn {
+
+	Frustum Frustum::fromMatrix(const glm::mat4& clip) {
+		//glm is column major, so row i is (clip[0][i], clip[1][i], clip[2][i], clip[3][i])
+		glm::vec4 rows[4];
+		for (int i = 0; i < 4; i++) {
+			rows[i] = glm::vec4(clip[0][i], clip[1][i], clip[2][i], clip[3][i]);
+		}
+
+		Frustum frustum;
+		frustum.planes[0] = rows[3] + rows[0];
+		frustum.planes[1] = rows[3] - rows[0];
+		frustum.planes[2] = rows[3] + rows[1];
+		frustum.planes[3] = rows[3] - rows[1];
+		//z >= 0 rather than z >= -w
+		frustum.planes[4] = rows[2];
+		frustum.planes[5] = rows[3] - rows[2];
+
+		//Normalized so sphere tests can compare against the radius directly
+		for (glm::vec4& plane : frustum.planes) {
+			float length = glm::length(glm::vec3(plane));
+			if (length > 0.0f) {
+				plane /= length;
+			}
+		}
+		return frustum;
+	}
+
+	bool Frustum::intersectsSphere(const glm::vec3& center, float radius) const {
+		for (const glm::vec4& plane : planes) {
+			if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool Frustum::intersectsBox(const glm::vec3& boundsMin, const glm::vec3& boundsMax) const {
+		for (const glm::vec4& plane : planes) {
+			//The corner furthest along the plane normal
+			glm::vec3 corner(plane.x >= 0.0f ? boundsMax.x : boundsMin.x,
+				plane.y >= 0.0f ? boundsMax.y : boundsMin.y,
+				plane.z >= 0.0f ? boundsMax.z : boundsMin.z);
+			if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f) {
+				return false;
+			}
+		}
+		return true;
+	}
+}
@@ -0,0 +1,25 @@
+#ifndef __FRUSTUM_H__
+#define __FRUSTUM_H__
+
+#include <glm/glm.hpp>
+
+namespace vkn {
+
+	//Six planes, (normal, distance) with normals pointing inwards, so a point p
+	//is inside a plane when dot(normal, p) + distance >= 0. Order is left,
+	//right, bottom, top, near, far. Uploaded as is for FrustumCull.comp.
+	struct Frustum {
+		glm::vec4 planes[6];
+
+		//Pulls the planes out of a clip matrix (Gribb/Hartmann). Assumes Vulkan's
+		//0 to 1 depth range. Pass proj * view for world space planes or
+		//proj * view * model for planes in that model's space
+		static Frustum fromMatrix(const glm::mat4& clip);
+
+		//Conservative, may report true for things just outside a corner
+		bool intersectsSphere(const glm::vec3& center, float radius) const;
+		bool intersectsBox(const glm::vec3& boundsMin, const glm::vec3& boundsMax) const;
+	};
+}
+
+#endif
@@ -0,0 +1,304 @@
+#include "FrustumCuller.h"
+#include "DescriptorWriter.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace vkn {
+
+	static const uint32_t CULL_GROUP_SIZE = 64;
+	//Storage buffers 0 instances in, 1 batches, 2 instances out, 3 draw commands,
+	//4 draw counts, then 5 the uniforms. Occlusion adds 6 the retest list and 7
+	//the depth pyramid
+	static const uint32_t STORAGE_BINDINGS = 5;
+	static const uint32_t UNIFORM_BINDING = 5;
+	static const uint32_t RETEST_BINDING = 6;
+	static const uint32_t PYRAMID_BINDING = 7;
+
+	static const uint32_t PHASE_CULL = 0;
+	static const uint32_t PHASE_EMIT = 1;
+	static const uint32_t PHASE_RETEST = 2;
+	static const uint32_t PHASE_EMIT_LATE = 3;
+
+	FrustumCuller::FrustumCuller(LogicalDevice* device, InstanceBatcher* batcher, uint32_t framesInFlight, uint32_t maxBatches, HiZPyramid* pyramid) {
+		this->device = device;
+		this->batcher = batcher;
+		this->maxBatches = maxBatches;
+		this->pyramid = pyramid;
+
+		std::vector<VkDescriptorSetLayoutBinding> bindings(pyramid != nullptr ? PYRAMID_BINDING + 1 : UNIFORM_BINDING + 1);
+		for (uint32_t i = 0; i < bindings.size(); i++) {
+			bindings[i].binding = i;
+			bindings[i].descriptorType = i == UNIFORM_BINDING ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			bindings[i].descriptorCount = 1;
+			bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		}
+		if (pyramid != nullptr) {
+			bindings[PYRAMID_BINDING] = device->getSamplerCache()->getImmutableSamplerBinding(PYRAMID_BINDING,
+				VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, HiZPyramid::getSamplerCreateInfo());
+		}
+		layout = device->getDescriptorLayoutCache()->getLayout(bindings);
+
+		VkDescriptorPoolSize poolSizes[3]{};
+		poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		poolSizes[0].descriptorCount = (pyramid != nullptr ? STORAGE_BINDINGS + 1 : STORAGE_BINDINGS) * framesInFlight;
+		poolSizes[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		poolSizes[1].descriptorCount = framesInFlight;
+		poolSizes[2].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		poolSizes[2].descriptorCount = framesInFlight;
+
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.poolSizeCount = pyramid != nullptr ? 3 : 2;
+		poolInfo.pPoolSizes = poolSizes;
+		poolInfo.maxSets = framesInFlight;
+
+		if (vkCreateDescriptorPool(device->getDevice(), &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create culling descriptor pool!");
+		}
+
+		std::vector<VkDescriptorSetLayout> layouts(framesInFlight, layout);
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = pool;
+		allocInfo.descriptorSetCount = framesInFlight;
+		allocInfo.pSetLayouts = layouts.data();
+
+		descriptorSets.resize(framesInFlight);
+		if (vkAllocateDescriptorSets(device->getDevice(), &allocInfo, descriptorSets.data()) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate culling descriptor sets!");
+		}
+
+		draws = new IndirectDrawBuffer(device, framesInFlight, maxBatches * 2, false, maxBatches * 2);
+
+		VkDeviceSize batchSize = sizeof(CullBatch) * VkDeviceSize(maxBatches);
+		VkDeviceSize instanceSize = sizeof(InstanceData) * VkDeviceSize(batcher->getMaxInstances());
+		VkDeviceSize retestSize = sizeof(uint32_t) * VkDeviceSize(batcher->getMaxInstances());
+		batchBuffers.resize(framesInFlight);
+		batchMemory.resize(framesInFlight);
+		batchMapped.resize(framesInFlight);
+		uniformBuffers.resize(framesInFlight);
+		uniformMemory.resize(framesInFlight);
+		uniformMapped.resize(framesInFlight);
+		culledBuffers.resize(framesInFlight);
+		culledMemory.resize(framesInFlight);
+		if (pyramid != nullptr) {
+			retestBuffers.resize(framesInFlight);
+			retestMemory.resize(framesInFlight);
+		}
+		DescriptorWriter writer(device);
+		for (uint32_t i = 0; i < framesInFlight; i++) {
+			void* data;
+			device->createBuffer(batchSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, batchBuffers[i], batchMemory[i]);
+			vkMapMemory(device->getDevice(), batchMemory[i], 0, batchSize, 0, &data);
+			batchMapped[i] = static_cast<CullBatch*>(data);
+			device->createBuffer(sizeof(CullUniforms), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, uniformBuffers[i], uniformMemory[i]);
+			vkMapMemory(device->getDevice(), uniformMemory[i], 0, sizeof(CullUniforms), 0, &data);
+			uniformMapped[i] = static_cast<CullUniforms*>(data);
+			device->createBuffer(instanceSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, culledBuffers[i], culledMemory[i]);
+			if (pyramid != nullptr) {
+				device->createBuffer(retestSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+					retestBuffers[i], retestMemory[i]);
+			}
+
+			//Every buffer stays put, so the sets are written once
+			VkBuffer buffers[RETEST_BINDING + 1]{};
+			buffers[0] = batcher->getInstanceBuffer(i);
+			buffers[1] = batchBuffers[i];
+			buffers[2] = culledBuffers[i];
+			buffers[3] = draws->getDrawBuffer(i);
+			buffers[4] = draws->getCountBuffer(i);
+			buffers[UNIFORM_BINDING] = uniformBuffers[i];
+			uint32_t bufferCount = UNIFORM_BINDING + 1;
+			if (pyramid != nullptr) {
+				buffers[RETEST_BINDING] = retestBuffers[i];
+				bufferCount++;
+			}
+			for (uint32_t b = 0; b < bufferCount; b++) {
+				writer.writeBuffer(descriptorSets[i], b, b == UNIFORM_BINDING ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+					buffers[b]);
+			}
+		}
+		writer.flush();
+		updatePyramid();
+	}
+
+	FrustumCuller::~FrustumCuller() {
+		for (size_t i = 0; i < batchBuffers.size(); i++) {
+			vkUnmapMemory(device->getDevice(), batchMemory[i]);
+			vkDestroyBuffer(device->getDevice(), batchBuffers[i], nullptr);
+			vkFreeMemory(device->getDevice(), batchMemory[i], nullptr);
+			vkUnmapMemory(device->getDevice(), uniformMemory[i]);
+			vkDestroyBuffer(device->getDevice(), uniformBuffers[i], nullptr);
+			vkFreeMemory(device->getDevice(), uniformMemory[i], nullptr);
+			vkDestroyBuffer(device->getDevice(), culledBuffers[i], nullptr);
+			vkFreeMemory(device->getDevice(), culledMemory[i], nullptr);
+		}
+		for (size_t i = 0; i < retestBuffers.size(); i++) {
+			vkDestroyBuffer(device->getDevice(), retestBuffers[i], nullptr);
+			vkFreeMemory(device->getDevice(), retestMemory[i], nullptr);
+		}
+		delete(draws);
+		//Sets go with the pool
+		vkDestroyDescriptorPool(device->getDevice(), pool, nullptr);
+	}
+
+	VkPushConstantRange FrustumCuller::getPushConstantRange() {
+		VkPushConstantRange range{};
+		range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		range.offset = 0;
+		range.size = sizeof(CullPushConstants);
+		return range;
+	}
+
+	void FrustumCuller::updatePyramid() {
+		if (pyramid == nullptr) {
+			return;
+		}
+		DescriptorWriter writer(device);
+		for (VkDescriptorSet set : descriptorSets) {
+			writer.writeImage(set, PYRAMID_BINDING, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, pyramid->getView(), VK_IMAGE_LAYOUT_GENERAL);
+		}
+		writer.flush();
+	}
+
+	void FrustumCuller::cull(VkCommandBuffer commandBuffer, uint32_t frame, ComputePipeline* pipeline, const glm::mat4& clip) {
+		currentFrame = frame;
+		draws->beginFrame(frame);
+
+		const std::vector<InstanceBatcher::Batch>& batches = batcher->getBatches();
+		if (batches.size() > maxBatches) {
+			throw std::runtime_error("too many batches to cull!");
+		}
+
+		//Batches and their runs are all the CPU has to write
+		GeometryPool* geometry = batcher->getGeometry();
+		bool quantized = geometry->getLayout().isQuantized();
+		batchCount = static_cast<uint32_t>(batches.size());
+		largestBatch = 0;
+		runs.clear();
+		for (size_t i = 0; i < batches.size(); i++) {
+			const InstanceBatcher::Batch& batch = batches[i];
+			const PooledMesh& mesh = geometry->getMesh(batch.mesh);
+			if (runs.empty() || runs.back().material.textureIndex != batch.material.textureIndex ||
+				runs.back().material.samplerIndex != batch.material.samplerIndex) {
+				runs.push_back({ batch.material, static_cast<uint32_t>(i), 0 });
+			}
+			runs.back().batchCount++;
+
+			glm::vec3 center = (mesh.boundsMin + mesh.boundsMax) * 0.5f;
+			float radius = glm::length(mesh.boundsMax - mesh.boundsMin) * 0.5f;
+			//Instance transforms already include the dequantize matrix
+			if (quantized) {
+				center = (center - mesh.quantization.offset) / mesh.quantization.scale;
+				radius /= mesh.quantization.scale;
+			}
+
+			//The LOD was already picked on the CPU when the batch was made
+			const MeshLod& level = mesh.lods[std::min(batch.lod, mesh.lodCount - 1)];
+			CullBatch cullBatch{};
+			cullBatch.sphere = glm::vec4(center, radius);
+			cullBatch.indexCount = level.indexCount;
+			cullBatch.firstIndex = level.firstIndex;
+			cullBatch.vertexOffset = mesh.vertexOffset;
+			cullBatch.firstInstance = batch.firstInstance;
+			cullBatch.instanceCount = batch.instanceCount;
+			cullBatch.drawSlot = runs.back().firstBatch;
+			cullBatch.countSlot = static_cast<uint32_t>(runs.size() - 1);
+			batchMapped[frame][i] = cullBatch;
+			largestBatch = std::max(largestBatch, batch.instanceCount);
+		}
+
+		CullUniforms uniforms{};
+		uniforms.clip = clip;
+		Frustum frustum = Frustum::fromMatrix(clip);
+		for (int i = 0; i < 6; i++) {
+			uniforms.planes[i] = frustum.planes[i];
+		}
+		//Until it's been built once there's nothing to test against
+		if (pyramid != nullptr && pyramid->isBuilt()) {
+			uniforms.pyramidSize = glm::vec2(static_cast<float>(pyramid->getWidth()), static_cast<float>(pyramid->getHeight()));
+			uniforms.pyramidLevels = pyramid->getMipLevels();
+			uniforms.occlusion = 1;
+		}
+		*uniformMapped[frame] = uniforms;
+
+		draws->resetCount(commandBuffer);
+		if (batchCount == 0) {
+			return;
+		}
+
+		pipeline->bind(commandBuffer);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->getPipelineLayout(),
+			0, 1, &descriptorSets[frame], 0, nullptr);
+		dispatch(commandBuffer, pipeline, PHASE_CULL);
+		dispatch(commandBuffer, pipeline, PHASE_EMIT);
+	}
+
+	void FrustumCuller::cullLate(VkCommandBuffer commandBuffer, ComputePipeline* pipeline) {
+		if (pyramid == nullptr || batchCount == 0) {
+			return;
+		}
+		pipeline->bind(commandBuffer);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->getPipelineLayout(),
+			0, 1, &descriptorSets[currentFrame], 0, nullptr);
+		dispatch(commandBuffer, pipeline, PHASE_RETEST);
+		dispatch(commandBuffer, pipeline, PHASE_EMIT_LATE);
+	}
+
+	void FrustumCuller::dispatch(VkCommandBuffer commandBuffer, ComputePipeline* pipeline, uint32_t phase) {
+		CullPushConstants constants;
+		constants.batchCount = batchCount;
+		constants.phase = phase;
+		constants.lateOffset = maxBatches;
+		vkCmdPushConstants(commandBuffer, pipeline->getPipelineLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		if (phase == PHASE_CULL || phase == PHASE_RETEST) {
+			//One row of groups per batch
+			vkCmdDispatch(commandBuffer, ComputePipeline::getGroupCount(largestBatch, CULL_GROUP_SIZE), batchCount, 1);
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				0, 1, &barrier, 0, nullptr, 0, nullptr);
+			return;
+		}
+
+		vkCmdDispatch(commandBuffer, ComputePipeline::getGroupCount(batchCount, CULL_GROUP_SIZE), 1, 1);
+		//Commands and counts are read by the draw, the compacted instances by
+		//vertex input. The late pass reads the batches again
+		barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 1, &barrier, 0, nullptr, 0, nullptr);
+	}
+
+	void FrustumCuller::draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, bool pushMaterial) {
+		drawRuns(commandBuffer, pipelineLayout, pushMaterial, 0);
+	}
+
+	void FrustumCuller::drawLate(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, bool pushMaterial) {
+		if (pyramid == nullptr) {
+			return;
+		}
+		drawRuns(commandBuffer, pipelineLayout, pushMaterial, maxBatches);
+	}
+
+	void FrustumCuller::drawRuns(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, bool pushMaterial, uint32_t offset) {
+		batcher->getGeometry()->bind(commandBuffer);
+		VkBuffer buffers[] = { culledBuffers[currentFrame] };
+		VkDeviceSize offsets[] = { 0 };
+		vkCmdBindVertexBuffers(commandBuffer, 1, 1, buffers, offsets);
+
+		for (size_t i = 0; i < runs.size(); i++) {
+			if (pushMaterial) {
+				vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT,
+					0, sizeof(MaterialPushConstants), &runs[i].material);
+			}
+			draws->drawIndirectCount(commandBuffer, offset + runs[i].firstBatch, runs[i].batchCount, offset + static_cast<uint32_t>(i));
+		}
+	}
+}
@@ -0,0 +1,134 @@
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#ifndef __FRUSTUM_CULLER_H__
+#define __FRUSTUM_CULLER_H__
+
+#include <vector>
+#include "LogicalDevice.h"
+#include "ComputePipeline.h"
+#include "InstanceBatcher.h"
+#include "IndirectDrawBuffer.h"
+#include "HiZPyramid.h"
+#include "Frustum.h"
+
+namespace vkn {
+
+	//Culls an InstanceBatcher's instances on the GPU with FrustumCull.comp.
+	//  1. every instance's bounding sphere is tested, survivors are copied into
+	//     a compacted instance buffer at their batch's range
+	//  2. every batch with survivors appends one indirect command to its
+	//     material run, so empty batches cost nothing to draw
+	//Drawing then needs one vkCmdDrawIndexedIndirectCount per material. The CPU
+	//never looks at individual instances.
+	//
+	//Given a HiZPyramid it also occlusion culls, in two phases. cull tests
+	//against the pyramid built from last frame's depth and draw draws what
+	//passed. Once the pyramid has been rebuilt from that depth, cullLate
+	//retests only what the old pyramid hid and drawLate draws whatever turned
+	//out visible after all, so nothing pops in when the view changes. That
+	//needs the shader built with -DOCCLUSION (occlusionCull.spv).
+	//
+	//The pipeline is built by the caller (so its shader can come from an asset
+	//pack) with getLayout and getPushConstantRange.
+	class FrustumCuller {
+	public:
+		FrustumCuller() {}
+		FrustumCuller(LogicalDevice* device, InstanceBatcher* batcher, uint32_t framesInFlight, uint32_t maxBatches, HiZPyramid* pyramid = nullptr);
+		~FrustumCuller();
+
+		VkDescriptorSetLayout getLayout() { return layout; }
+		VkPushConstantRange getPushConstantRange();
+		//Call after the pyramid has been resized, with nothing in flight
+		void updatePyramid();
+
+		//Records the culling passes, outside a render pass and after everything
+		//for the frame has been submitted to the batcher. clip takes what the
+		//instance transforms output to clip space
+		void cull(VkCommandBuffer commandBuffer, uint32_t frame, ComputePipeline* pipeline, const glm::mat4& clip);
+		//After the pyramid has been rebuilt, outside a render pass. Does nothing
+		//without a pyramid
+		void cullLate(VkCommandBuffer commandBuffer, ComputePipeline* pipeline);
+		//Draws what survived, inside the render pass. Same material rules as
+		//InstanceBatcher::record
+		void draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, bool pushMaterial);
+		void drawLate(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, bool pushMaterial);
+
+	private:
+		//Matches Batch in FrustumCull.comp (std430)
+		struct CullBatch {
+			//Bounding sphere in the space the instance transforms expect
+			glm::vec4 sphere;
+			uint32_t indexCount;
+			uint32_t firstIndex;
+			int32_t vertexOffset;
+			uint32_t firstInstance;
+			uint32_t instanceCount;
+			uint32_t visibleCount;
+			//Where this batch's run starts in the command buffer, and its count slot
+			uint32_t drawSlot;
+			uint32_t countSlot;
+			//Hidden by last frame's pyramid, and of those visible in this frame's
+			uint32_t retestCount;
+			uint32_t lateCount;
+			uint32_t padding[2];
+		};
+
+		//Matches CullUniforms (std140)
+		struct CullUniforms {
+			glm::mat4 clip;
+			glm::vec4 planes[6];
+			glm::vec2 pyramidSize;
+			uint32_t pyramidLevels;
+			uint32_t occlusion;
+		};
+
+		struct CullPushConstants {
+			uint32_t batchCount;
+			uint32_t phase;
+			//Late commands and counts sit this far after the early ones
+			uint32_t lateOffset;
+		};
+
+		struct MaterialRun {
+			MaterialPushConstants material;
+			uint32_t firstBatch;
+			uint32_t batchCount;
+		};
+
+		void dispatch(VkCommandBuffer commandBuffer, ComputePipeline* pipeline, uint32_t phase);
+		void drawRuns(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, bool pushMaterial, uint32_t offset);
+
+		LogicalDevice* device;
+		InstanceBatcher* batcher;
+		HiZPyramid* pyramid;
+		uint32_t maxBatches;
+		uint32_t currentFrame = 0;
+		uint32_t batchCount = 0;
+		uint32_t largestBatch = 0;
+
+		VkDescriptorSetLayout layout;
+		VkDescriptorPool pool;
+		std::vector<VkDescriptorSet> descriptorSets;
+
+		std::vector<VkBuffer> batchBuffers;
+		std::vector<VkDeviceMemory> batchMemory;
+		std::vector<CullBatch*> batchMapped;
+		std::vector<VkBuffer> uniformBuffers;
+		std::vector<VkDeviceMemory> uniformMemory;
+		std::vector<CullUniforms*> uniformMapped;
+		//Compacted copies of the batcher's instance buffers, bound for drawing instead
+		std::vector<VkBuffer> culledBuffers;
+		std::vector<VkDeviceMemory> culledMemory;
+		//Instances the early pass left for cullLate, occlusion only
+		std::vector<VkBuffer> retestBuffers;
+		std::vector<VkDeviceMemory> retestMemory;
+		//A command slot per batch and a count per material run, twice over for
+		//the late pass
+		IndirectDrawBuffer* draws = nullptr;
+
+		std::vector<MaterialRun> runs;
+	};
+}
+
+#endif
@@ -0,0 +1,282 @@
+#include "GeometryPool.h"
+#include "MeshOptimizer.h"
+#include <stdexcept>
+#include <cstring>
+#include <algorithm>
+
+namespace vkn {
+
+	GeometryPool::GeometryPool(LogicalDevice* device, uint32_t queueFamilyIndex, VkQueue queue, const VertexLayout& layout,
+		uint32_t vertexCapacity, uint32_t indexCapacity, VkIndexType indexType) {
+		this->device = device;
+		this->queue = queue;
+		this->layout = layout;
+		this->indexType = indexType;
+
+		device->createBuffer(VkDeviceSize(vertexCapacity) * layout.getStride(), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexMemory);
+		device->createBuffer(VkDeviceSize(indexCapacity) * MeshOptimizer::getIndexSize(indexType), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexMemory);
+		freeVertices.push_back({ 0, vertexCapacity });
+		freeIndices.push_back({ 0, indexCapacity });
+		freeVertexCount = vertexCapacity;
+		freeIndexCount = indexCapacity;
+
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+		poolInfo.queueFamilyIndex = queueFamilyIndex;
+		if (vkCreateCommandPool(device->getDevice(), &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create geometry upload command pool!");
+		}
+
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = commandPool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandBufferCount = 1;
+		if (vkAllocateCommandBuffers(device->getDevice(), &allocInfo, &commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate geometry upload command buffer!");
+		}
+
+		VkFenceCreateInfo fenceInfo{};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		if (vkCreateFence(device->getDevice(), &fenceInfo, nullptr, &uploadFence) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create geometry upload fence!");
+		}
+	}
+
+	GeometryPool::~GeometryPool() {
+		for (PendingUpload& upload : pendingUploads) {
+			vkDestroyBuffer(device->getDevice(), upload.stagingBuffer, nullptr);
+			vkFreeMemory(device->getDevice(), upload.stagingMemory, nullptr);
+		}
+		vkDestroyFence(device->getDevice(), uploadFence, nullptr);
+		vkDestroyCommandPool(device->getDevice(), commandPool, nullptr);
+
+		vkDestroyBuffer(device->getDevice(), indexBuffer, nullptr);
+		vkFreeMemory(device->getDevice(), indexMemory, nullptr);
+		vkDestroyBuffer(device->getDevice(), vertexBuffer, nullptr);
+		vkFreeMemory(device->getDevice(), vertexMemory, nullptr);
+	}
+
+	MeshHandle GeometryPool::addMesh(const Vertex* vertices, uint32_t vertexCount, const void* indices, VkIndexType sourceIndexType,
+		uint32_t indexCount, const glm::vec3& boundsMin, const glm::vec3& boundsMax, const MeshLod* lods, uint32_t lodCount) {
+		if (lodCount > MAX_MESH_LODS) {
+			throw std::runtime_error("mesh has too many LODs!");
+		}
+		if (indexType == VK_INDEX_TYPE_UINT16 && vertexCount > 0xFFFF) {
+			throw std::runtime_error("mesh has too many vertices for a 16 bit geometry pool!");
+		}
+
+		uint32_t vertexOffset = allocateRange(freeVertices, vertexCount);
+		if (vertexOffset == ~0u) {
+			throw std::runtime_error("geometry pool is out of vertex space!");
+		}
+		uint32_t firstIndex = allocateRange(freeIndices, indexCount);
+		if (firstIndex == ~0u) {
+			freeRange(freeVertices, vertexOffset, vertexCount);
+			throw std::runtime_error("geometry pool is out of index space!");
+		}
+		freeVertexCount -= vertexCount;
+		freeIndexCount -= indexCount;
+
+		PooledMesh mesh;
+		mesh.firstIndex = firstIndex;
+		mesh.indexCount = indexCount;
+		if (lodCount == 0) {
+			mesh.lods[0].firstIndex = firstIndex;
+			mesh.lods[0].indexCount = indexCount;
+			mesh.lodCount = 1;
+		}
+		else {
+			for (uint32_t i = 0; i < lodCount; i++) {
+				mesh.lods[i] = lods[i];
+				mesh.lods[i].firstIndex += firstIndex;
+			}
+			mesh.lodCount = lodCount;
+		}
+		mesh.vertexOffset = static_cast<int32_t>(vertexOffset);
+		mesh.vertexCount = vertexCount;
+		mesh.quantization = VertexQuantization::fromBounds(boundsMin, boundsMax);
+		mesh.boundsMin = boundsMin;
+		mesh.boundsMax = boundsMax;
+		mesh.alive = true;
+
+		//Packed and converted straight into staging, then copied over on flush()
+		uint32_t indexSize = MeshOptimizer::getIndexSize(indexType);
+		PendingUpload upload;
+		upload.vertexBytes = VkDeviceSize(vertexCount) * layout.getStride();
+		upload.indexBytes = VkDeviceSize(indexCount) * indexSize;
+		upload.vertexDst = VkDeviceSize(vertexOffset) * layout.getStride();
+		upload.indexDst = VkDeviceSize(firstIndex) * indexSize;
+		device->createBuffer(upload.vertexBytes + upload.indexBytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, upload.stagingBuffer, upload.stagingMemory);
+
+		void* data;
+		vkMapMemory(device->getDevice(), upload.stagingMemory, 0, upload.vertexBytes + upload.indexBytes, 0, &data);
+		layout.pack(vertices, vertexCount, mesh.quantization, data);
+		unsigned char* indexData = static_cast<unsigned char*>(data) + upload.vertexBytes;
+		if (sourceIndexType == indexType) {
+			memcpy(indexData, indices, static_cast<size_t>(upload.indexBytes));
+		}
+		else if (sourceIndexType == VK_INDEX_TYPE_UINT32) {
+			MeshOptimizer::writeIndices(static_cast<const uint32_t*>(indices), indexCount, indexType, indexData);
+		}
+		else {
+			const uint16_t* source = static_cast<const uint16_t*>(indices);
+			uint32_t* widened = reinterpret_cast<uint32_t*>(indexData);
+			for (uint32_t i = 0; i < indexCount; i++) {
+				widened[i] = source[i];
+			}
+		}
+		vkUnmapMemory(device->getDevice(), upload.stagingMemory);
+		pendingUploads.push_back(upload);
+
+		MeshHandle handle;
+		if (!freeHandles.empty()) {
+			handle = freeHandles.back();
+			freeHandles.pop_back();
+			meshes[handle] = mesh;
+		}
+		else {
+			handle = static_cast<MeshHandle>(meshes.size());
+			meshes.push_back(mesh);
+		}
+		return handle;
+	}
+
+	MeshHandle GeometryPool::addMesh(const MeshData& mesh) {
+		return addMesh(mesh.vertices.data(), static_cast<uint32_t>(mesh.vertices.size()), mesh.indices.data(), VK_INDEX_TYPE_UINT32,
+			static_cast<uint32_t>(mesh.indices.size()), mesh.info.boundsMin, mesh.info.boundsMax, mesh.lods.data(), static_cast<uint32_t>(mesh.lods.size()));
+	}
+
+	void GeometryPool::removeMesh(MeshHandle handle) {
+		if (handle >= meshes.size() || !meshes[handle].alive) {
+			return;
+		}
+		meshes[handle].alive = false;
+		retiredMeshes.push_back(handle);
+	}
+
+	void GeometryPool::flush() {
+		//Frames in flight may still be drawing retired meshes, so wait them out
+		//before their space can be handed to new uploads. Static geometry is
+		//rarely removed, so this is cheaper than tracking every frame
+		if (!retiredMeshes.empty()) {
+			vkQueueWaitIdle(queue);
+			for (MeshHandle handle : retiredMeshes) {
+				PooledMesh& mesh = meshes[handle];
+				freeRange(freeVertices, static_cast<uint32_t>(mesh.vertexOffset), mesh.vertexCount);
+				freeRange(freeIndices, mesh.firstIndex, mesh.indexCount);
+				freeVertexCount += mesh.vertexCount;
+				freeIndexCount += mesh.indexCount;
+				freeHandles.push_back(handle);
+			}
+			retiredMeshes.clear();
+		}
+
+		if (pendingUploads.empty()) {
+			return;
+		}
+
+		vkResetCommandBuffer(commandBuffer, 0);
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+		for (PendingUpload& upload : pendingUploads) {
+			VkBufferCopy copyRegion{};
+			if (upload.vertexBytes > 0) {
+				copyRegion.srcOffset = 0;
+				copyRegion.dstOffset = upload.vertexDst;
+				copyRegion.size = upload.vertexBytes;
+				vkCmdCopyBuffer(commandBuffer, upload.stagingBuffer, vertexBuffer, 1, &copyRegion);
+			}
+			if (upload.indexBytes > 0) {
+				copyRegion.srcOffset = upload.vertexBytes;
+				copyRegion.dstOffset = upload.indexDst;
+				copyRegion.size = upload.indexBytes;
+				vkCmdCopyBuffer(commandBuffer, upload.stagingBuffer, indexBuffer, 1, &copyRegion);
+			}
+		}
+
+		//Make the copies visible to vertex input for every later submission
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+			0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+		vkEndCommandBuffer(commandBuffer);
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &commandBuffer;
+		if (vkQueueSubmit(queue, 1, &submitInfo, uploadFence) != VK_SUCCESS) {
+			throw std::runtime_error("failed to submit geometry upload!");
+		}
+		vkWaitForFences(device->getDevice(), 1, &uploadFence, VK_TRUE, UINT64_MAX);
+		vkResetFences(device->getDevice(), 1, &uploadFence);
+
+		for (PendingUpload& upload : pendingUploads) {
+			vkDestroyBuffer(device->getDevice(), upload.stagingBuffer, nullptr);
+			vkFreeMemory(device->getDevice(), upload.stagingMemory, nullptr);
+		}
+		pendingUploads.clear();
+	}
+
+	void GeometryPool::bind(VkCommandBuffer commandBuffer) {
+		VkBuffer vertexBuffers[] = { vertexBuffer };
+		VkDeviceSize offsets[] = { 0 };
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+		vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, indexType);
+	}
+
+	void GeometryPool::draw(VkCommandBuffer commandBuffer, MeshHandle handle, uint32_t instanceCount, uint32_t firstInstance, uint32_t lod) {
+		const PooledMesh& mesh = meshes[handle];
+		const MeshLod& level = mesh.lods[std::min(lod, mesh.lodCount - 1)];
+		vkCmdDrawIndexed(commandBuffer, level.indexCount, instanceCount, level.firstIndex, mesh.vertexOffset, firstInstance);
+	}
+
+	uint32_t GeometryPool::allocateRange(std::vector<Range>& freeRanges, uint32_t count) {
+		for (size_t i = 0; i < freeRanges.size(); i++) {
+			Range& range = freeRanges[i];
+			if (range.count < count) {
+				continue;
+			}
+			uint32_t offset = range.offset;
+			range.offset += count;
+			range.count -= count;
+			if (range.count == 0) {
+				freeRanges.erase(freeRanges.begin() + i);
+			}
+			return offset;
+		}
+		return ~0u;
+	}
+
+	void GeometryPool::freeRange(std::vector<Range>& freeRanges, uint32_t offset, uint32_t count) {
+		if (count == 0) {
+			return;
+		}
+		size_t i = 0;
+		while (i < freeRanges.size() && freeRanges[i].offset < offset) {
+			i++;
+		}
+		freeRanges.insert(freeRanges.begin() + i, { offset, count });
+
+		//Merge with the next range, then the previous one
+		if (i + 1 < freeRanges.size() && freeRanges[i].offset + freeRanges[i].count == freeRanges[i + 1].offset) {
+			freeRanges[i].count += freeRanges[i + 1].count;
+			freeRanges.erase(freeRanges.begin() + i + 1);
+		}
+		if (i > 0 && freeRanges[i - 1].offset + freeRanges[i - 1].count == freeRanges[i].offset) {
+			freeRanges[i - 1].count += freeRanges[i].count;
+			freeRanges.erase(freeRanges.begin() + i);
+		}
+	}
+}
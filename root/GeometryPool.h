@@ -0,0 +1,120 @@
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#ifndef __GEOMETRY_POOL_H__
+#define __GEOMETRY_POOL_H__
+
+#include <vector>
+#include "LogicalDevice.h"
+#include "VertexLayout.h"
+#include "MeshLoader.h"
+
+namespace vkn {
+
+	typedef uint32_t MeshHandle;
+	const MeshHandle INVALID_MESH = ~0u;
+
+	//Where a mesh lives inside the pool's buffers. Indices are mesh local, so
+	//draws pass vertexOffset through to vkCmdDrawIndexed
+	struct PooledMesh {
+		//The whole index allocation, every LOD back to back
+		uint32_t firstIndex = 0;
+		uint32_t indexCount = 0;
+		//firstIndex is absolute here, ready for a draw. Level 0 is the full mesh
+		MeshLod lods[MAX_MESH_LODS];
+		uint32_t lodCount = 1;
+		int32_t vertexOffset = 0;
+		uint32_t vertexCount = 0;
+		//Fold getDequantizeMatrix() into the model matrix when the layout is quantized
+		VertexQuantization quantization;
+		glm::vec3 boundsMin = glm::vec3(0.0f);
+		glm::vec3 boundsMax = glm::vec3(0.0f);
+		bool alive = false;
+	};
+
+	//Every static mesh suballocated out of one big vertex buffer and one big index
+	//buffer, so the whole scene is a single bind and any mesh can be drawn by
+	//(firstIndex, vertexOffset). Vertices are stored in one VertexLayout.
+	//
+	//Uploads queue up until flush(), which copies everything in one submit and
+	//waits for it. Removed meshes keep their space until the next flush() has
+	//made sure the GPU is done with them.
+	class GeometryPool {
+	public:
+		GeometryPool() {}
+		//Capacities are in vertices and indices. 16 bit indices work for any mesh
+		//under 65536 vertices, however big the pool is
+		GeometryPool(LogicalDevice* device, uint32_t queueFamilyIndex, VkQueue queue, const VertexLayout& layout,
+			uint32_t vertexCapacity, uint32_t indexCapacity, VkIndexType indexType = VK_INDEX_TYPE_UINT32);
+		~GeometryPool();
+
+		//indices are relative to the mesh's first vertex, in either index type.
+		//lods index into indices, without any the whole thing is one level.
+		//Throws when the pool is full or the mesh doesn't fit the pool's index type
+		MeshHandle addMesh(const Vertex* vertices, uint32_t vertexCount, const void* indices, VkIndexType sourceIndexType,
+			uint32_t indexCount, const glm::vec3& boundsMin, const glm::vec3& boundsMax, const MeshLod* lods = nullptr, uint32_t lodCount = 0);
+		MeshHandle addMesh(const MeshData& mesh);
+		void removeMesh(MeshHandle handle);
+		const PooledMesh& getMesh(MeshHandle handle) { return meshes[handle]; }
+
+		//Uploads everything added since the last flush. Blocks until the copies are done
+		void flush();
+
+		//Binds both buffers, once per command buffer is all that's needed
+		void bind(VkCommandBuffer commandBuffer);
+		void draw(VkCommandBuffer commandBuffer, MeshHandle handle, uint32_t instanceCount = 1, uint32_t firstInstance = 0, uint32_t lod = 0);
+
+		VkBuffer getVertexBuffer() { return vertexBuffer; }
+		VkBuffer getIndexBuffer() { return indexBuffer; }
+		VkIndexType getIndexType() { return indexType; }
+		const VertexLayout& getLayout() { return layout; }
+		uint32_t getFreeVertices() { return freeVertexCount; }
+		uint32_t getFreeIndices() { return freeIndexCount; }
+
+	private:
+		struct Range {
+			uint32_t offset;
+			uint32_t count;
+		};
+
+		struct PendingUpload {
+			VkBuffer stagingBuffer;
+			VkDeviceMemory stagingMemory;
+			VkDeviceSize vertexBytes;
+			VkDeviceSize indexBytes;
+			VkDeviceSize vertexDst;
+			VkDeviceSize indexDst;
+		};
+
+		//First fit out of a list kept sorted by offset. Returns ~0u when nothing fits
+		static uint32_t allocateRange(std::vector<Range>& freeRanges, uint32_t count);
+		//Puts a range back, merging with its neighbours
+		static void freeRange(std::vector<Range>& freeRanges, uint32_t offset, uint32_t count);
+
+		LogicalDevice* device;
+		VkQueue queue;
+		VertexLayout layout;
+		VkIndexType indexType;
+
+		VkBuffer vertexBuffer;
+		VkDeviceMemory vertexMemory;
+		VkBuffer indexBuffer;
+		VkDeviceMemory indexMemory;
+
+		VkCommandPool commandPool;
+		VkCommandBuffer commandBuffer;
+		VkFence uploadFence;
+
+		std::vector<Range> freeVertices;
+		std::vector<Range> freeIndices;
+		uint32_t freeVertexCount = 0;
+		uint32_t freeIndexCount = 0;
+
+		std::vector<PooledMesh> meshes;
+		std::vector<MeshHandle> freeHandles;
+		std::vector<MeshHandle> retiredMeshes;
+		std::vector<PendingUpload> pendingUploads;
+	};
+}
+
+#endif
@@ -3,6 +3,7 @@
 
 #include <iostream>
 #include <fstream>
+#include <algorithm>
 
 namespace vkn {
 
@@ -30,10 +31,14 @@ namespace vkn {
 	}
 
 	VkShaderModule GraphicsPipeline::createShaderModule(const std::vector<char>& code) {
+		return createShaderModule(reinterpret_cast<const uint32_t*>(code.data()), code.size());
+	}
+
+	VkShaderModule GraphicsPipeline::createShaderModule(const uint32_t* code, size_t size) {
 		VkShaderModuleCreateInfo createInfo{};
 		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-		createInfo.codeSize = code.size();
-		createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+		createInfo.codeSize = size;
+		createInfo.pCode = code;
 
 		VkShaderModule shaderModule;
 		if (vkCreateShaderModule(device->getDevice(), &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
@@ -44,7 +49,7 @@ namespace vkn {
 
 	void GraphicsPipeline::setVertexShader(std::string vertex) {
 		std::vector<char> shaderCode = readShaderFile(vertex);
-		vertexShader = createShaderModule(shaderCode);
+		setVertexShader(reinterpret_cast<const uint32_t*>(shaderCode.data()), shaderCode.size());
 	}
 
 
@@ -55,7 +60,17 @@ namespace vkn {
 
 	void GraphicsPipeline::setFragmentShader(std::string frag) {
 		std::vector<char> shaderCode = readShaderFile(frag);
-		fragmentShader = createShaderModule(shaderCode);
+		setFragmentShader(reinterpret_cast<const uint32_t*>(shaderCode.data()), shaderCode.size());
+	}
+
+	void GraphicsPipeline::setVertexShader(const uint32_t* code, size_t size) {
+		vertexReflection = SpirvReflection(code, size);
+		vertexShader = createShaderModule(code, size);
+	}
+
+	void GraphicsPipeline::setFragmentShader(const uint32_t* code, size_t size) {
+		fragmentReflection = SpirvReflection(code, size);
+		fragmentShader = createShaderModule(code, size);
 	}
 
 	void GraphicsPipeline::addBindingDescription(VkVertexInputBindingDescription bind) {
@@ -66,8 +81,100 @@ namespace vkn {
 		attributeDescriptions.push_back(attr);
 	}
 
-	//TODO Add stuff for tesselation shading
+	void GraphicsPipeline::setVertexLayout(const VertexLayout& layout, uint32_t binding) {
+		addBindingDescription(layout.getBindingDescription(binding));
+		for (const VkVertexInputAttributeDescription& attribute : layout.getAttributeDescriptions(binding)) {
+			addAttributeDescription(attribute);
+		}
+	}
+
+	void GraphicsPipeline::setDepthState(bool testEnable, bool writeEnable, VkCompareOp compareOp) {
+		depthTestEnable = testEnable;
+		depthWriteEnable = writeEnable;
+		depthCompareOp = compareOp;
+	}
+
+	void GraphicsPipeline::setSampleCount(VkSampleCountFlagBits samples) {
+		sampleCount = samples;
+	}
+
 	void GraphicsPipeline::buildPipeline(VkDescriptorSetLayout layout) {
+		buildPipeline(std::vector<VkDescriptorSetLayout>{ layout }, {});
+	}
+
+	void GraphicsPipeline::buildReflectedPipeline(const std::map<uint32_t, VkDescriptorSetLayout>& externalSets) {
+		for (const ReflectedInput& input : vertexReflection.getInputs()) {
+			bool supplied = false;
+			for (const VkVertexInputAttributeDescription& attribute : attributeDescriptions) {
+				supplied = supplied || attribute.location == input.location;
+			}
+			if (!supplied) {
+				throw std::runtime_error("vertex shader input " + std::to_string(input.location) + " has no attribute!");
+			}
+		}
+
+		std::vector<SpirvReflection*> stages = { &vertexReflection };
+		if (fragmentShader != VK_NULL_HANDLE) {
+			stages.push_back(&fragmentReflection);
+		}
+
+		//Bindings by set. A binding both stages use is one binding with both stage bits
+		std::map<uint32_t, std::vector<VkDescriptorSetLayoutBinding>> sets;
+		std::vector<VkPushConstantRange> pushConstantRanges;
+		for (SpirvReflection* stage : stages) {
+			for (const ReflectedBinding& reflected : stage->getBindings()) {
+				if (externalSets.count(reflected.set) > 0) {
+					continue;
+				}
+				if (reflected.count == 0) {
+					throw std::runtime_error("runtime sized descriptor array needs an external set layout!");
+				}
+				std::vector<VkDescriptorSetLayoutBinding>& bindings = sets[reflected.set];
+				auto found = std::find_if(bindings.begin(), bindings.end(),
+					[&reflected](const VkDescriptorSetLayoutBinding& binding) { return binding.binding == reflected.binding; });
+				if (found != bindings.end()) {
+					if (found->descriptorType != reflected.type || found->descriptorCount != reflected.count) {
+						throw std::runtime_error("shader stages disagree about a descriptor binding!");
+					}
+					found->stageFlags |= stage->getStage();
+					continue;
+				}
+				VkDescriptorSetLayoutBinding binding{};
+				binding.binding = reflected.binding;
+				binding.descriptorType = reflected.type;
+				binding.descriptorCount = reflected.count;
+				binding.stageFlags = stage->getStage();
+				bindings.push_back(binding);
+			}
+			if (stage->hasPushConstants()) {
+				pushConstantRanges.push_back(stage->getPushConstantRange());
+			}
+		}
+
+		//Sets in between the ones used still need a layout, an empty one does
+		uint32_t setCount = 0;
+		if (!sets.empty()) {
+			setCount = sets.rbegin()->first + 1;
+		}
+		if (!externalSets.empty()) {
+			setCount = std::max(setCount, externalSets.rbegin()->first + 1);
+		}
+		setLayouts.clear();
+		for (uint32_t set = 0; set < setCount; set++) {
+			auto external = externalSets.find(set);
+			if (external != externalSets.end()) {
+				setLayouts.push_back(external->second);
+			}
+			else {
+				setLayouts.push_back(device->getDescriptorLayoutCache()->getLayout(sets[set]));
+			}
+		}
+
+		buildPipeline(setLayouts, pushConstantRanges);
+	}
+
+	//TODO Add stuff for tesselation shading
+	void GraphicsPipeline::buildPipeline(const std::vector<VkDescriptorSetLayout>& layouts, const std::vector<VkPushConstantRange>& pushConstantRanges) {
 		//Create Shader Stages
 		VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
 		vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -85,7 +192,9 @@ namespace vkn {
 		fragShaderStageInfo.pSpecializationInfo = nullptr;
 
 		//These now go into an array
+		//No fragment shader is fine for depth only passes
 		VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
+		uint32_t stageCount = fragmentShader != VK_NULL_HANDLE ? 2 : 1;
 
 		//Parameters that we will allow to be changed at runtime
 		std::vector<VkDynamicState> dynamicStates = {
@@ -137,11 +246,11 @@ namespace vkn {
 		rasterizer.depthBiasSlopeFactor = 0.0f; //Optional
 
 		//Multisampling stage (antialiasing)
-		//Disabled for now. Enabling requires a GPU feature
+		//Per pixel shading, only coverage and depth are per sample
 		VkPipelineMultisampleStateCreateInfo multisampling{};
 		multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
 		multisampling.sampleShadingEnable = VK_FALSE;
-		multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+		multisampling.rasterizationSamples = sampleCount;
 		multisampling.minSampleShading = 1.0f; //Optional
 		multisampling.pSampleMask = nullptr; //Optional
 		multisampling.alphaToCoverageEnable = VK_FALSE; //Optional;
@@ -189,22 +298,33 @@ namespace vkn {
 		colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
 		colorBlending.logicOpEnable = VK_FALSE; //Con combine fragments with bitwise logic
 		colorBlending.logicOp = VK_LOGIC_OP_COPY; //Optional
-		colorBlending.attachmentCount = 1;
+		colorBlending.attachmentCount = renderPass->hasColor() ? 1 : 0;
 		colorBlending.pAttachments = &colorBlendAttachment; //A vector of all attatchments;
 		colorBlending.blendConstants[0] = 0.0f; //Optional
 		colorBlending.blendConstants[1] = 0.0f; //Optional
 		colorBlending.blendConstants[2] = 0.0f; //Optional
 		colorBlending.blendConstants[3] = 0.0f; //Optional
 
+		//Depth testing. Objects behind what's already been drawn are thrown out before shading
+		VkPipelineDepthStencilStateCreateInfo depthStencil{};
+		depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+		depthStencil.depthTestEnable = depthTestEnable ? VK_TRUE : VK_FALSE;
+		depthStencil.depthWriteEnable = depthWriteEnable ? VK_TRUE : VK_FALSE;
+		depthStencil.depthCompareOp = depthCompareOp; //Lower depth is closer
+		depthStencil.depthBoundsTestEnable = VK_FALSE;
+		depthStencil.minDepthBounds = 0.0f; //Optional
+		depthStencil.maxDepthBounds = 1.0f; //Optional
+		depthStencil.stencilTestEnable = VK_FALSE;
+
 		//Any uniform variables (things that can be passed into a shader as a global
 		// without the need for recreation of recompilation) need to be set up here
 		//Even if we don't have any.
 		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
 		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-		pipelineLayoutInfo.setLayoutCount = 1;
-		pipelineLayoutInfo.pSetLayouts = &layout;
-		pipelineLayoutInfo.pushConstantRangeCount = 0; //Push constants are another way of passing data to a shader
-		pipelineLayoutInfo.pPushConstantRanges = nullptr;
+		pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(layouts.size());
+		pipelineLayoutInfo.pSetLayouts = layouts.data();
+		pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size()); //Push constants are another way of passing data to a shader
+		pipelineLayoutInfo.pPushConstantRanges = pushConstantRanges.empty() ? nullptr : pushConstantRanges.data();
 
 		if (vkCreatePipelineLayout(device->getDevice(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
 			throw std::runtime_error("Failed to create pipelineLayout!");
@@ -212,14 +332,14 @@ namespace vkn {
 
 		VkGraphicsPipelineCreateInfo pipelineInfo{};
 		pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-		pipelineInfo.stageCount = 2; //The number of custom stages
+		pipelineInfo.stageCount = stageCount; //The number of custom stages
 		pipelineInfo.pStages = shaderStages; //The custom stages themselves
 		pipelineInfo.pVertexInputState = &vertexCreateInfo;
 		pipelineInfo.pInputAssemblyState = &inputAssembly;
 		pipelineInfo.pViewportState = &viewportState;
 		pipelineInfo.pRasterizationState = &rasterizer;
 		pipelineInfo.pMultisampleState = &multisampling;
-		pipelineInfo.pDepthStencilState = nullptr;
+		pipelineInfo.pDepthStencilState = renderPass->hasDepth() ? &depthStencil : nullptr;
 		pipelineInfo.pColorBlendState = &colorBlending;
 		pipelineInfo.pDynamicState = &dynamicState;
 		pipelineInfo.layout = pipelineLayout;
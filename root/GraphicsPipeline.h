@@ -6,8 +6,11 @@
 
 #include <string>
 #include <vector>
+#include <map>
 #include "LogicalDevice.h"
 #include "RenderPass.h"
+#include "VertexLayout.h"
+#include "SpirvReflection.h"
 
 //This is where the meat of the application is.
 //So much possibility here for cleanup and customization
@@ -23,17 +26,40 @@ namespace vkn{
 		void setVertexShader(std::string vertex);
 		void setTesselationShader(std::string tesselation);
 		void setFragmentShader(std::string fragment);
+		//SPIR-V already in memory, e.g. out of an AssetPack. Nothing is copied.
+		void setVertexShader(const uint32_t* code, size_t size);
+		void setFragmentShader(const uint32_t* code, size_t size);
 		void addBindingDescription(VkVertexInputBindingDescription bind);
 		void addAttributeDescription(VkVertexInputAttributeDescription attr);
+		//Adds the binding and every attribute the layout describes
+		void setVertexLayout(const VertexLayout& layout, uint32_t binding = 0);
+		//Off unless set. Only does anything when the render pass has depth.
+		//A pass drawn after a depth pre-pass tests EQUAL with writes off
+		void setDepthState(bool testEnable, bool writeEnable, VkCompareOp compareOp = VK_COMPARE_OP_LESS);
+		//Has to match the render pass's attachments
+		void setSampleCount(VkSampleCountFlagBits samples);
 
 		void buildPipeline(VkDescriptorSetLayout layout);
+		//Set layouts go in set order. Push constants are how bindless draws pick their material
+		void buildPipeline(const std::vector<VkDescriptorSetLayout>& layouts, const std::vector<VkPushConstantRange>& pushConstantRanges);
+		//Set layouts and push constant ranges come from reflecting the shaders. Only
+		//bindings the shaders use are declared, each with just the stages using it,
+		//and layouts come out of the device's cache so pipelines with the same
+		//bindings share them. Sets in externalSets are used as given instead, for
+		//anything reflection can't describe (runtime sized arrays, binding flags).
+		//Throws if the vertex shader reads a location no attribute supplies
+		void buildReflectedPipeline(const std::map<uint32_t, VkDescriptorSetLayout>& externalSets = {});
 		VkPipeline getPipeline() { return graphicsPipeline; }
 		VkPipelineLayout getPipelineLayout() { return pipelineLayout; }
+		//From buildReflectedPipeline, in set order
+		const std::vector<VkDescriptorSetLayout>& getDescriptorSetLayouts() { return setLayouts; }
+		VkDescriptorSetLayout getDescriptorSetLayout(uint32_t set) { return setLayouts[set]; }
 
 
 	private:
 		std::vector<char> readShaderFile(const std::string& filename);
 		VkShaderModule createShaderModule(const std::vector<char>& code);
+		VkShaderModule createShaderModule(const uint32_t* code, size_t size);
 
 		LogicalDevice *device;
 		VkShaderModule vertexShader = VK_NULL_HANDLE;
@@ -41,6 +67,14 @@ namespace vkn{
 		VkShaderModule fragmentShader = VK_NULL_HANDLE;
 		VkShaderModule tesselationShader = VK_NULL_HANDLE;
 		VkShaderModule geometryShader = VK_NULL_HANDLE;
+		SpirvReflection vertexReflection;
+		SpirvReflection fragmentReflection;
+		std::vector<VkDescriptorSetLayout> setLayouts;
+
+		bool depthTestEnable = false;
+		bool depthWriteEnable = false;
+		VkCompareOp depthCompareOp = VK_COMPARE_OP_LESS;
+		VkSampleCountFlagBits sampleCount = VK_SAMPLE_COUNT_1_BIT;
 
 		VkPipeline graphicsPipeline;
 		VkPipelineLayout pipelineLayout;
@@ -0,0 +1,16 @@
+#ifndef __HASH_H__
+#define __HASH_H__
+
+#include <cstddef>
+#include <functional>
+
+namespace vkn {
+
+	//Boost style hash_combine, for hashing cache keys field by field
+	template<typename T>
+	inline void hashCombine(size_t& hash, const T& value) {
+		hash ^= std::hash<T>()(value) + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+	}
+}
+
+#endif
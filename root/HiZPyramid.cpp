@@ -0,0 +1,207 @@
+#include "HiZPyramid.h"
+#include "DescriptorWriter.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace vkn {
+
+	static const uint32_t DOWNSAMPLE_GROUP_SIZE = 8;
+
+	HiZPyramid::HiZPyramid(LogicalDevice* device, uint32_t depthWidth, uint32_t depthHeight, VkImageView depthView) {
+		this->device = device;
+
+		//0 the level being read, 1 the level being written
+		std::vector<VkDescriptorSetLayoutBinding> bindings(2);
+		bindings[0] = device->getSamplerCache()->getImmutableSamplerBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			VK_SHADER_STAGE_COMPUTE_BIT, getSamplerCreateInfo());
+		bindings[1].binding = 1;
+		bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		bindings[1].descriptorCount = 1;
+		bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		layout = device->getDescriptorLayoutCache()->getLayout(bindings);
+
+		createPyramid(depthWidth, depthHeight, depthView);
+	}
+
+	HiZPyramid::~HiZPyramid() {
+		destroyPyramid();
+	}
+
+	void HiZPyramid::resize(uint32_t depthWidth, uint32_t depthHeight, VkImageView depthView) {
+		destroyPyramid();
+		createPyramid(depthWidth, depthHeight, depthView);
+	}
+
+	VkPushConstantRange HiZPyramid::getPushConstantRange() {
+		VkPushConstantRange range{};
+		range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		range.offset = 0;
+		range.size = sizeof(DownsamplePushConstants);
+		return range;
+	}
+
+	VkSamplerCreateInfo HiZPyramid::getSamplerCreateInfo() {
+		VkSamplerCreateInfo samplerInfo{};
+		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		samplerInfo.magFilter = VK_FILTER_NEAREST;
+		samplerInfo.minFilter = VK_FILTER_NEAREST;
+		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.anisotropyEnable = VK_FALSE;
+		samplerInfo.maxAnisotropy = 1.0f;
+		samplerInfo.compareEnable = VK_FALSE;
+		samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+		samplerInfo.minLod = 0.0f;
+		samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+		samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+		samplerInfo.unnormalizedCoordinates = VK_FALSE;
+		return samplerInfo;
+	}
+
+	void HiZPyramid::createPyramid(uint32_t depthWidth, uint32_t depthHeight, VkImageView depthView) {
+		this->depthWidth = depthWidth;
+		this->depthHeight = depthHeight;
+		width = std::max(1u, (depthWidth + 1) / 2);
+		height = std::max(1u, (depthHeight + 1) / 2);
+		mipLevels = 1;
+		while ((std::max(width, height) >> mipLevels) > 0) {
+			mipLevels++;
+		}
+		built = false;
+		transitioned = false;
+
+		device->createImage(width, height, mipLevels, VK_FORMAT_R32_SFLOAT, VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, pyramidImage, pyramidMemory);
+
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = pyramidImage;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = VK_FORMAT_R32_SFLOAT;
+		viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		viewInfo.subresourceRange.baseMipLevel = 0;
+		viewInfo.subresourceRange.levelCount = mipLevels;
+		viewInfo.subresourceRange.baseArrayLayer = 0;
+		viewInfo.subresourceRange.layerCount = 1;
+		if (vkCreateImageView(device->getDevice(), &viewInfo, nullptr, &pyramidView) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create depth pyramid view!");
+		}
+
+		mipViews.resize(mipLevels);
+		for (uint32_t i = 0; i < mipLevels; i++) {
+			viewInfo.subresourceRange.baseMipLevel = i;
+			viewInfo.subresourceRange.levelCount = 1;
+			if (vkCreateImageView(device->getDevice(), &viewInfo, nullptr, &mipViews[i]) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create depth pyramid view!");
+			}
+		}
+
+		//The sampler is immutable, so only the image and storage bindings need counting
+		VkDescriptorPoolSize poolSizes[2]{};
+		poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		poolSizes[0].descriptorCount = mipLevels;
+		poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		poolSizes[1].descriptorCount = mipLevels;
+
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.poolSizeCount = 2;
+		poolInfo.pPoolSizes = poolSizes;
+		poolInfo.maxSets = mipLevels;
+
+		if (vkCreateDescriptorPool(device->getDevice(), &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create depth pyramid descriptor pool!");
+		}
+
+		std::vector<VkDescriptorSetLayout> layouts(mipLevels, layout);
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = pool;
+		allocInfo.descriptorSetCount = mipLevels;
+		allocInfo.pSetLayouts = layouts.data();
+
+		descriptorSets.resize(mipLevels);
+		if (vkAllocateDescriptorSets(device->getDevice(), &allocInfo, descriptorSets.data()) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate depth pyramid descriptor sets!");
+		}
+
+		//Every level's sets in one update
+		DescriptorWriter writer(device);
+		for (uint32_t i = 0; i < mipLevels; i++) {
+			writer.writeImage(descriptorSets[i], 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, i == 0 ? depthView : mipViews[i - 1],
+				i == 0 ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL);
+			writer.writeImage(descriptorSets[i], 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, mipViews[i], VK_IMAGE_LAYOUT_GENERAL);
+		}
+		writer.flush();
+	}
+
+	void HiZPyramid::destroyPyramid() {
+		//Sets go with the pool
+		vkDestroyDescriptorPool(device->getDevice(), pool, nullptr);
+		for (VkImageView view : mipViews) {
+			vkDestroyImageView(device->getDevice(), view, nullptr);
+		}
+		mipViews.clear();
+		vkDestroyImageView(device->getDevice(), pyramidView, nullptr);
+		vkDestroyImage(device->getDevice(), pyramidImage, nullptr);
+		vkFreeMemory(device->getDevice(), pyramidMemory, nullptr);
+	}
+
+	void HiZPyramid::build(VkCommandBuffer commandBuffer, ComputePipeline* pipeline) {
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = pyramidImage;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = mipLevels;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = 1;
+
+		//Last frame's culling may still be reading the pyramid. The first build
+		//also gets it out of UNDEFINED
+		barrier.oldLayout = transitioned ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		barrier.srcAccessMask = transitioned ? VK_ACCESS_SHADER_READ_BIT : 0;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 0, nullptr, 0, nullptr, 1, &barrier);
+		transitioned = true;
+
+		pipeline->bind(commandBuffer);
+		barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+		barrier.subresourceRange.levelCount = 1;
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		uint32_t inputWidth = depthWidth;
+		uint32_t inputHeight = depthHeight;
+		for (uint32_t i = 0; i < mipLevels; i++) {
+			uint32_t outputWidth = std::max(1u, width >> i);
+			uint32_t outputHeight = std::max(1u, height >> i);
+
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->getPipelineLayout(),
+				0, 1, &descriptorSets[i], 0, nullptr);
+			DownsamplePushConstants constants;
+			constants.inputWidth = static_cast<int32_t>(inputWidth);
+			constants.inputHeight = static_cast<int32_t>(inputHeight);
+			constants.outputWidth = static_cast<int32_t>(outputWidth);
+			constants.outputHeight = static_cast<int32_t>(outputHeight);
+			vkCmdPushConstants(commandBuffer, pipeline->getPipelineLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+			vkCmdDispatch(commandBuffer, ComputePipeline::getGroupCount(outputWidth, DOWNSAMPLE_GROUP_SIZE),
+				ComputePipeline::getGroupCount(outputHeight, DOWNSAMPLE_GROUP_SIZE), 1);
+
+			//The next level reads this one, and culling reads all of them
+			barrier.subresourceRange.baseMipLevel = i;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+			inputWidth = outputWidth;
+			inputHeight = outputHeight;
+		}
+		built = true;
+	}
+}
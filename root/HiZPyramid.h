@@ -0,0 +1,83 @@
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#ifndef __HIZ_PYRAMID_H__
+#define __HIZ_PYRAMID_H__
+
+#include <vector>
+#include "LogicalDevice.h"
+#include "ComputePipeline.h"
+
+namespace vkn {
+
+	//Hierarchical depth: an R32 mip chain where every texel holds the farthest
+	//depth under it, built from a depth buffer by HiZDownsample.comp. Mip 0 is
+	//half the depth buffer's size. A box whose nearest depth is behind the
+	//pyramid's value over its footprint is hidden.
+	//
+	//Depth is expected the usual way round, 0 near and 1 far. The image stays in
+	//VK_IMAGE_LAYOUT_GENERAL, written as a storage image and read with texelFetch.
+	//The downsample pipeline is built by the caller with getLayout and
+	//getPushConstantRange, like FrustumCuller.
+	class HiZPyramid {
+	public:
+		HiZPyramid() {}
+		//depthView has to stay valid until the next resize
+		HiZPyramid(LogicalDevice* device, uint32_t depthWidth, uint32_t depthHeight, VkImageView depthView);
+		~HiZPyramid();
+
+		//Swapchain recreation. Contents are gone until the next build
+		void resize(uint32_t depthWidth, uint32_t depthHeight, VkImageView depthView);
+
+		VkDescriptorSetLayout getLayout() { return layout; }
+		VkPushConstantRange getPushConstantRange();
+		//Nearest, clamped. Sets that read the pyramid bake this in as an immutable sampler
+		static VkSamplerCreateInfo getSamplerCreateInfo();
+
+		//Downsamples the depth buffer through every level. The depth image has to
+		//be in VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL with its writes
+		//finished (the render pass's final layout and outgoing dependency). Leaves
+		//the pyramid readable by compute shaders
+		void build(VkCommandBuffer commandBuffer, ComputePipeline* pipeline);
+		//False until build has been recorded since the last resize
+		bool isBuilt() { return built; }
+
+		VkImageView getView() { return pyramidView; }
+		uint32_t getWidth() { return width; }
+		uint32_t getHeight() { return height; }
+		uint32_t getMipLevels() { return mipLevels; }
+
+	private:
+		struct DownsamplePushConstants {
+			int32_t inputWidth;
+			int32_t inputHeight;
+			int32_t outputWidth;
+			int32_t outputHeight;
+		};
+
+		void createPyramid(uint32_t depthWidth, uint32_t depthHeight, VkImageView depthView);
+		void destroyPyramid();
+
+		LogicalDevice* device;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t mipLevels = 0;
+		uint32_t depthWidth = 0;
+		uint32_t depthHeight = 0;
+		bool built = false;
+		//The image starts out UNDEFINED and gets moved to GENERAL by the first build
+		bool transitioned = false;
+
+		VkImage pyramidImage = VK_NULL_HANDLE;
+		VkDeviceMemory pyramidMemory = VK_NULL_HANDLE;
+		VkImageView pyramidView = VK_NULL_HANDLE;
+		std::vector<VkImageView> mipViews;
+
+		VkDescriptorSetLayout layout;
+		VkDescriptorPool pool = VK_NULL_HANDLE;
+		//One per level, reading the level above (or the depth buffer) and writing this one
+		std::vector<VkDescriptorSet> descriptorSets;
+	};
+}
+
+#endif
@@ -0,0 +1,134 @@
+#include "IndirectDrawBuffer.h"
+#include <stdexcept>
+#include <cstring>
+#include <algorithm>
+
+namespace vkn {
+
+	IndirectDrawBuffer::IndirectDrawBuffer(LogicalDevice* device, uint32_t framesInFlight, uint32_t maxDraws, bool hostWritable, uint32_t countSlots) {
+		this->device = device;
+		this->maxDraws = maxDraws;
+		this->countSlots = countSlots;
+		this->hostWritable = hostWritable;
+
+		if (device->isDrawIndirectCountSupported()) {
+			cmdDrawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(
+				vkGetDeviceProcAddr(device->getDevice(), "vkCmdDrawIndexedIndirectCountKHR"));
+		}
+
+		VkBufferUsageFlags usage = VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		VkMemoryPropertyFlags properties = hostWritable ? VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+			: VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+		VkDeviceSize bufferSize = sizeof(VkDrawIndexedIndirectCommand) * VkDeviceSize(maxDraws);
+
+		drawBuffers.resize(framesInFlight);
+		drawMemory.resize(framesInFlight);
+		countBuffers.resize(framesInFlight);
+		countMemory.resize(framesInFlight);
+		drawMapped.resize(framesInFlight, nullptr);
+		countMapped.resize(framesInFlight, nullptr);
+		for (uint32_t i = 0; i < framesInFlight; i++) {
+			device->createBuffer(bufferSize, usage, properties, drawBuffers[i], drawMemory[i]);
+			device->createBuffer(sizeof(uint32_t) * countSlots, usage, properties, countBuffers[i], countMemory[i]);
+			if (hostWritable) {
+				void* data;
+				vkMapMemory(device->getDevice(), drawMemory[i], 0, bufferSize, 0, &data);
+				drawMapped[i] = static_cast<VkDrawIndexedIndirectCommand*>(data);
+				vkMapMemory(device->getDevice(), countMemory[i], 0, sizeof(uint32_t) * countSlots, 0, &data);
+				countMapped[i] = static_cast<uint32_t*>(data);
+			}
+		}
+	}
+
+	IndirectDrawBuffer::~IndirectDrawBuffer() {
+		for (size_t i = 0; i < drawBuffers.size(); i++) {
+			if (hostWritable) {
+				vkUnmapMemory(device->getDevice(), drawMemory[i]);
+				vkUnmapMemory(device->getDevice(), countMemory[i]);
+			}
+			vkDestroyBuffer(device->getDevice(), drawBuffers[i], nullptr);
+			vkFreeMemory(device->getDevice(), drawMemory[i], nullptr);
+			vkDestroyBuffer(device->getDevice(), countBuffers[i], nullptr);
+			vkFreeMemory(device->getDevice(), countMemory[i], nullptr);
+		}
+	}
+
+	void IndirectDrawBuffer::beginFrame(uint32_t frame) {
+		currentFrame = frame;
+		drawCount = 0;
+		if (hostWritable) {
+			memset(countMapped[frame], 0, sizeof(uint32_t) * countSlots);
+		}
+	}
+
+	uint32_t IndirectDrawBuffer::addDraw(const PooledMesh& mesh, uint32_t instanceCount, uint32_t firstInstance, uint32_t lod) {
+		if (!hostWritable) {
+			throw std::runtime_error("indirect draw buffer is written by the GPU!");
+		}
+		if (drawCount >= maxDraws) {
+			throw std::runtime_error("indirect draw buffer is full!");
+		}
+
+		const MeshLod& level = mesh.lods[std::min(lod, mesh.lodCount - 1)];
+		VkDrawIndexedIndirectCommand command;
+		command.indexCount = level.indexCount;
+		command.instanceCount = instanceCount;
+		command.firstIndex = level.firstIndex;
+		command.vertexOffset = mesh.vertexOffset;
+		command.firstInstance = firstInstance;
+		drawMapped[currentFrame][drawCount] = command;
+		//Kept up to date so drawIndirectCount works for CPU written commands too
+		*countMapped[currentFrame] = drawCount + 1;
+		return drawCount++;
+	}
+
+	void IndirectDrawBuffer::draw(VkCommandBuffer commandBuffer, uint32_t firstDraw, uint32_t drawCount) {
+		if (drawCount == 0) {
+			return;
+		}
+		uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+		VkDeviceSize offset = VkDeviceSize(firstDraw) * stride;
+		if (device->getEnabledFeatures().multiDrawIndirect) {
+			vkCmdDrawIndexedIndirect(commandBuffer, drawBuffers[currentFrame], offset, drawCount, stride);
+			return;
+		}
+		for (uint32_t i = 0; i < drawCount; i++) {
+			vkCmdDrawIndexedIndirect(commandBuffer, drawBuffers[currentFrame], offset + VkDeviceSize(i) * stride, 1, stride);
+		}
+	}
+
+	void IndirectDrawBuffer::drawIndirectCount(VkCommandBuffer commandBuffer, uint32_t firstDraw, uint32_t maxDrawCount, uint32_t countSlot) {
+		if (cmdDrawIndexedIndirectCount == nullptr) {
+			draw(commandBuffer, firstDraw, maxDrawCount);
+			return;
+		}
+		uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+		cmdDrawIndexedIndirectCount(commandBuffer, drawBuffers[currentFrame], VkDeviceSize(firstDraw) * stride, countBuffers[currentFrame],
+			VkDeviceSize(countSlot) * sizeof(uint32_t), maxDrawCount, stride);
+	}
+
+	void IndirectDrawBuffer::resetCount(VkCommandBuffer commandBuffer) {
+		std::vector<VkBufferMemoryBarrier> barriers;
+		VkBufferMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.offset = 0;
+		barrier.size = VK_WHOLE_SIZE;
+
+		vkCmdFillBuffer(commandBuffer, countBuffers[currentFrame], 0, VK_WHOLE_SIZE, 0);
+		barrier.buffer = countBuffers[currentFrame];
+		barriers.push_back(barrier);
+		//Everything up to maxDrawCount gets drawn without a GPU side count
+		if (cmdDrawIndexedIndirectCount == nullptr) {
+			vkCmdFillBuffer(commandBuffer, drawBuffers[currentFrame], 0, VK_WHOLE_SIZE, 0);
+			barrier.buffer = drawBuffers[currentFrame];
+			barriers.push_back(barrier);
+		}
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr);
+	}
+}
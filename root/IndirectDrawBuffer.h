@@ -0,0 +1,74 @@
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#ifndef __INDIRECT_DRAW_BUFFER_H__
+#define __INDIRECT_DRAW_BUFFER_H__
+
+#include <vector>
+#include "LogicalDevice.h"
+#include "GeometryPool.h"
+
+namespace vkn {
+
+	//Per frame arrays of VkDrawIndexedIndirectCommand plus a draw count, so a
+	//whole scene goes out in one vkCmdDrawIndexedIndirect(Count) no matter how
+	//many objects are in it. Draws find their own data through gl_InstanceIndex
+	//(firstInstance) or gl_DrawIndex.
+	//
+	//Host writable buffers are filled on the CPU with addDraw. Otherwise they're
+	//device local and meant to be written by a compute shader, both buffers are
+	//storage buffers for that. resetCount zeroes the count before the shader runs.
+	//There can be several counts, each for its own range of commands, so draws
+	//that need different state in between can still be GPU written.
+	class IndirectDrawBuffer {
+	public:
+		IndirectDrawBuffer() {}
+		IndirectDrawBuffer(LogicalDevice* device, uint32_t framesInFlight, uint32_t maxDraws, bool hostWritable = true, uint32_t countSlots = 1);
+		~IndirectDrawBuffer();
+
+		//Call after the frame's fence has been waited on
+		void beginFrame(uint32_t frame);
+		//Host writable only. Returns the draw's index, which is its gl_DrawIndex
+		//when everything goes out in one call. Throws once the buffer is full
+		uint32_t addDraw(const PooledMesh& mesh, uint32_t instanceCount, uint32_t firstInstance, uint32_t lod = 0);
+
+		//Draws [firstDraw, firstDraw + drawCount) from this frame's buffer. Without
+		//multiDrawIndirect that's one call per command
+		void draw(VkCommandBuffer commandBuffer, uint32_t firstDraw, uint32_t drawCount);
+		//Everything addDraw wrote this frame
+		void draw(VkCommandBuffer commandBuffer) { draw(commandBuffer, 0, drawCount); }
+		//The GPU reads how many of the maxDrawCount commands from firstDraw to draw
+		//out of a count slot. Without VK_KHR_draw_indirect_count all of them are
+		//issued, resetCount zeroes the commands too in that case so unwritten
+		//ones draw nothing
+		void drawIndirectCount(VkCommandBuffer commandBuffer, uint32_t firstDraw, uint32_t maxDrawCount, uint32_t countSlot = 0);
+		void drawIndirectCount(VkCommandBuffer commandBuffer) { drawIndirectCount(commandBuffer, 0, maxDraws); }
+		//Zeroes this frame's counts and makes that visible to compute shaders
+		void resetCount(VkCommandBuffer commandBuffer);
+
+		VkBuffer getDrawBuffer(uint32_t frame) { return drawBuffers[frame]; }
+		VkBuffer getCountBuffer(uint32_t frame) { return countBuffers[frame]; }
+		uint32_t getMaxDraws() { return maxDraws; }
+		uint32_t getDrawCount() { return drawCount; }
+
+	private:
+		LogicalDevice* device;
+		uint32_t maxDraws;
+		uint32_t countSlots;
+		bool hostWritable;
+		//Extension entry point, null when it isn't available
+		PFN_vkCmdDrawIndexedIndirectCountKHR cmdDrawIndexedIndirectCount = nullptr;
+
+		std::vector<VkBuffer> drawBuffers;
+		std::vector<VkDeviceMemory> drawMemory;
+		std::vector<VkBuffer> countBuffers;
+		std::vector<VkDeviceMemory> countMemory;
+		std::vector<VkDrawIndexedIndirectCommand*> drawMapped;
+		std::vector<uint32_t*> countMapped;
+
+		uint32_t currentFrame = 0;
+		uint32_t drawCount = 0;
+	};
+}
+
+#endif
@@ -0,0 +1,202 @@
+#include "InstanceBatcher.h"
+#include <glm/gtc/packing.hpp>
+#include <stdexcept>
+#include <algorithm>
+#include <cfloat>
+
+namespace vkn {
+
+	InstanceBatcher::InstanceBatcher(LogicalDevice* device, GeometryPool* geometry, uint32_t framesInFlight, uint32_t maxInstances) {
+		this->device = device;
+		this->geometry = geometry;
+		this->maxInstances = maxInstances;
+
+		//Rewritten every frame, so it stays host visible rather than being staged.
+		//Also a storage buffer so FrustumCuller can read it
+		VkDeviceSize bufferSize = sizeof(InstanceData) * VkDeviceSize(maxInstances);
+		instanceBuffers.resize(framesInFlight);
+		instanceMemory.resize(framesInFlight);
+		instanceMapped.resize(framesInFlight);
+		for (uint32_t i = 0; i < framesInFlight; i++) {
+			device->createBuffer(bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, instanceBuffers[i], instanceMemory[i]);
+			void* data;
+			vkMapMemory(device->getDevice(), instanceMemory[i], 0, bufferSize, 0, &data);
+			instanceMapped[i] = static_cast<InstanceData*>(data);
+		}
+	}
+
+	InstanceBatcher::~InstanceBatcher() {
+		for (size_t i = 0; i < instanceBuffers.size(); i++) {
+			vkUnmapMemory(device->getDevice(), instanceMemory[i]);
+			vkDestroyBuffer(device->getDevice(), instanceBuffers[i], nullptr);
+			vkFreeMemory(device->getDevice(), instanceMemory[i], nullptr);
+		}
+	}
+
+	VkVertexInputBindingDescription InstanceBatcher::getBindingDescription(uint32_t binding) {
+		VkVertexInputBindingDescription bindingDescription{};
+		bindingDescription.binding = binding;
+		bindingDescription.stride = sizeof(InstanceData);
+		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+		return bindingDescription;
+	}
+
+	std::vector<VkVertexInputAttributeDescription> InstanceBatcher::getAttributeDescriptions(uint32_t binding) {
+		//Locations 0 to 3 belong to the vertex layout
+		std::vector<VkVertexInputAttributeDescription> attributeDescriptions(4);
+		for (uint32_t i = 0; i < 3; i++) {
+			attributeDescriptions[i].binding = binding;
+			attributeDescriptions[i].location = 4 + i;
+			attributeDescriptions[i].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+			attributeDescriptions[i].offset = offsetof(InstanceData, rows) + i * sizeof(glm::vec4);
+		}
+		attributeDescriptions[3].binding = binding;
+		attributeDescriptions[3].location = 7;
+		attributeDescriptions[3].format = VK_FORMAT_R8G8B8A8_UNORM;
+		attributeDescriptions[3].offset = offsetof(InstanceData, color);
+		return attributeDescriptions;
+	}
+
+	void InstanceBatcher::beginFrame(uint32_t frame) {
+		currentFrame = frame;
+		instanceCount = 0;
+		batches.clear();
+	}
+
+	void InstanceBatcher::setLodSelection(const glm::vec3& cameraPosition, float pixelsPerUnit, float maxPixelError) {
+		lodSelection = true;
+		this->cameraPosition = cameraPosition;
+		this->pixelsPerUnit = pixelsPerUnit;
+		this->maxPixelError = maxPixelError;
+	}
+
+	//Coarsest level whose object space error, scaled and projected from the
+	//nearest point of the instance's bounding sphere, is still small enough.
+	//distance is set to how far that point is
+	static uint32_t selectLod(const PooledMesh& mesh, const glm::mat4& transform, const glm::vec3& cameraPosition,
+		float pixelsPerUnit, float maxPixelError, float& distance) {
+		glm::vec3 center = glm::vec3(transform * glm::vec4((mesh.boundsMin + mesh.boundsMax) * 0.5f, 1.0f));
+		float scale = glm::max(glm::length(glm::vec3(transform[0])), glm::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+		float radius = glm::length(mesh.boundsMax - mesh.boundsMin) * 0.5f * scale;
+		//Inside the sphere is as close as it gets
+		distance = glm::max(glm::length(center - cameraPosition) - radius, 1e-4f);
+		float maxError = maxPixelError * distance / (scale * pixelsPerUnit);
+
+		uint32_t lod = 0;
+		while (lod + 1 < mesh.lodCount && mesh.lods[lod + 1].error <= maxError) {
+			lod++;
+		}
+		return lod;
+	}
+
+	void InstanceBatcher::submit(MeshHandle mesh, const MaterialPushConstants& material, const Instance* instances, uint32_t count) {
+		if (count == 0) {
+			return;
+		}
+		if (count > maxInstances - instanceCount) {
+			throw std::runtime_error("instance buffer is full!");
+		}
+
+		const PooledMesh& pooled = geometry->getMesh(mesh);
+		bool quantized = geometry->getLayout().isQuantized();
+		glm::mat4 dequantize = quantized ? pooled.quantization.getDequantizeMatrix() : glm::mat4(1.0f);
+
+		//Counting sort by LOD, so each level's instances end up contiguous
+		uint32_t lodStart[MAX_MESH_LODS + 1] = {};
+		float lodDistance[MAX_MESH_LODS];
+		std::fill(lodDistance, lodDistance + MAX_MESH_LODS, lodSelection ? FLT_MAX : 0.0f);
+		instanceLods.resize(count);
+		for (uint32_t i = 0; i < count; i++) {
+			float distance = 0.0f;
+			instanceLods[i] = lodSelection ? selectLod(pooled, instances[i].transform, cameraPosition, pixelsPerUnit, maxPixelError, distance) : 0;
+			lodStart[instanceLods[i] + 1]++;
+			lodDistance[instanceLods[i]] = std::min(lodDistance[instanceLods[i]], distance);
+		}
+		for (uint32_t lod = 0; lod < MAX_MESH_LODS; lod++) {
+			lodStart[lod + 1] += lodStart[lod];
+		}
+
+		//Built whole and written out in one go, the mapping is write combined
+		InstanceData* dst = instanceMapped[currentFrame] + instanceCount;
+		uint32_t cursor[MAX_MESH_LODS];
+		std::copy(lodStart, lodStart + MAX_MESH_LODS, cursor);
+		for (uint32_t i = 0; i < count; i++) {
+			glm::mat4 transform = quantized ? instances[i].transform * dequantize : instances[i].transform;
+			InstanceData packed;
+			for (int row = 0; row < 3; row++) {
+				packed.rows[row] = glm::vec4(transform[0][row], transform[1][row], transform[2][row], transform[3][row]);
+			}
+			packed.color = glm::packUnorm4x8(glm::clamp(instances[i].color, 0.0f, 1.0f));
+			dst[cursor[instanceLods[i]]++] = packed;
+		}
+
+		for (uint32_t lod = 0; lod < pooled.lodCount; lod++) {
+			uint32_t lodCount = lodStart[lod + 1] - lodStart[lod];
+			if (lodCount == 0) {
+				continue;
+			}
+			if (!batches.empty()) {
+				Batch& last = batches.back();
+				if (last.mesh == mesh && last.lod == lod && last.material.textureIndex == material.textureIndex &&
+					last.material.samplerIndex == material.samplerIndex) {
+					last.instanceCount += lodCount;
+					last.distance = std::min(last.distance, lodDistance[lod]);
+					instanceCount += lodCount;
+					continue;
+				}
+			}
+			Batch batch;
+			batch.mesh = mesh;
+			batch.material = material;
+			batch.firstInstance = instanceCount;
+			batch.instanceCount = lodCount;
+			batch.lod = lod;
+			batch.distance = lodDistance[lod];
+			batches.push_back(batch);
+			instanceCount += lodCount;
+		}
+	}
+
+	void InstanceBatcher::record(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, bool pushMaterial, IndirectDrawBuffer* indirect) {
+		geometry->bind(commandBuffer);
+		VkBuffer buffers[] = { instanceBuffers[currentFrame] };
+		VkDeviceSize offsets[] = { 0 };
+		vkCmdBindVertexBuffers(commandBuffer, 1, 1, buffers, offsets);
+
+		if (indirect != nullptr) {
+			size_t runStart = 0;
+			uint32_t firstDraw = 0;
+			for (size_t i = 0; i < batches.size(); i++) {
+				uint32_t drawIndex = indirect->addDraw(geometry->getMesh(batches[i].mesh), batches[i].instanceCount, batches[i].firstInstance, batches[i].lod);
+				if (i == runStart) {
+					firstDraw = drawIndex;
+				}
+				//Only a material change needs the CPU to step in
+				bool runEnds = i + 1 == batches.size() ||
+					batches[i + 1].material.textureIndex != batches[i].material.textureIndex ||
+					batches[i + 1].material.samplerIndex != batches[i].material.samplerIndex;
+				if (!runEnds) {
+					continue;
+				}
+				if (pushMaterial) {
+					vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT,
+						0, sizeof(MaterialPushConstants), &batches[i].material);
+				}
+				indirect->draw(commandBuffer, firstDraw, drawIndex - firstDraw + 1);
+				runStart = i + 1;
+			}
+			return;
+		}
+
+		for (const Batch& batch : batches) {
+			if (pushMaterial) {
+				vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT,
+					0, sizeof(MaterialPushConstants), &batch.material);
+			}
+			//firstInstance is where the batch starts in the instance buffer
+			geometry->draw(commandBuffer, batch.mesh, batch.instanceCount, batch.firstInstance, batch.lod);
+		}
+	}
+}
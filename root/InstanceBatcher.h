@@ -0,0 +1,110 @@
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#ifndef __INSTANCE_BATCHER_H__
+#define __INSTANCE_BATCHER_H__
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "LogicalDevice.h"
+#include "GeometryPool.h"
+#include "BindlessTable.h"
+#include "IndirectDrawBuffer.h"
+
+namespace vkn {
+
+	//What callers hand in for each copy of a mesh
+	struct Instance {
+		glm::mat4 transform;
+		glm::vec4 color = glm::vec4(1.0f);
+	};
+
+	//What actually sits in the instance buffer, 52 bytes. The transform is
+	//stored as the top three rows, the bottom row of an affine matrix is always
+	//(0, 0, 0, 1). Read at locations 4 to 7 by InstancedVertex.vert
+	struct InstanceData {
+		glm::vec4 rows[3];
+		uint32_t color;
+	};
+
+	//Turns (mesh, material, instances) submissions into one instanced draw each.
+	//Instances are packed into a per frame, persistently mapped vertex buffer
+	//that's bound at its own binding with VK_VERTEX_INPUT_RATE_INSTANCE, so
+	//100k copies of a mesh are a single vkCmdDrawIndexed.
+	//
+	//Meshes come out of a GeometryPool. When its layout is quantized each
+	//mesh's dequantize matrix is folded into the instance transforms here.
+	//
+	//Meshes with LODs get one picked per instance from its distance to the
+	//camera, and the instances of a submission are split into a batch per LOD.
+	class InstanceBatcher {
+	public:
+		//One run of instances that share a mesh, LOD and material
+		struct Batch {
+			MeshHandle mesh;
+			MaterialPushConstants material;
+			uint32_t firstInstance;
+			uint32_t instanceCount;
+			uint32_t lod;
+			//From the camera to the nearest instance's bounds, 0 without setLodSelection
+			float distance;
+		};
+
+		InstanceBatcher() {}
+		InstanceBatcher(LogicalDevice* device, GeometryPool* geometry, uint32_t framesInFlight, uint32_t maxInstances);
+		~InstanceBatcher();
+
+		//Binding and attributes for the instance stream, add these to the pipeline
+		//next to the vertex layout
+		static VkVertexInputBindingDescription getBindingDescription(uint32_t binding = 1);
+		static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions(uint32_t binding = 1);
+
+		//Call after the frame's fence has been waited on, drops last use's batches
+		void beginFrame(uint32_t frame);
+		//Submissions after this pick the coarsest LOD whose error stays under
+		//maxPixelError on screen. The camera is in the space instance transforms
+		//map into, pixelsPerUnit is how many pixels one unit covers at distance one,
+		//|proj[1][1]| * height / 2 for a perspective projection. Until it's called
+		//everything draws LOD 0. Batches also get their distance from the camera
+		void setLodSelection(const glm::vec3& cameraPosition, float pixelsPerUnit, float maxPixelError);
+		//Submissions for the same mesh and material back to back share a draw.
+		//Throws once the frame's instance buffer is full
+		void submit(MeshHandle mesh, const MaterialPushConstants& material, const Instance* instances, uint32_t count);
+		//Binds the geometry and instance buffers and draws every batch. Materials
+		//are only pushed when pushMaterial is set, the layout needs the range from
+		//BindlessTable::getPushConstantRange for that.
+		//With an indirect buffer the batches are written into it as commands and
+		//each run of one material is a single indirect draw. That needs the
+		//drawIndirectFirstInstance feature, and beginFrame called on the buffer
+		void record(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, bool pushMaterial, IndirectDrawBuffer* indirect = nullptr);
+
+		uint32_t getInstanceCount() { return instanceCount; }
+		uint32_t getBatchCount() { return static_cast<uint32_t>(batches.size()); }
+		uint32_t getMaxInstances() { return maxInstances; }
+		const std::vector<Batch>& getBatches() { return batches; }
+		VkBuffer getInstanceBuffer(uint32_t frame) { return instanceBuffers[frame]; }
+		GeometryPool* getGeometry() { return geometry; }
+
+	private:
+		LogicalDevice* device;
+		GeometryPool* geometry;
+		uint32_t maxInstances;
+
+		std::vector<VkBuffer> instanceBuffers;
+		std::vector<VkDeviceMemory> instanceMemory;
+		std::vector<InstanceData*> instanceMapped;
+
+		uint32_t currentFrame = 0;
+		uint32_t instanceCount = 0;
+		std::vector<Batch> batches;
+
+		bool lodSelection = false;
+		glm::vec3 cameraPosition = glm::vec3(0.0f);
+		float pixelsPerUnit = 0.0f;
+		float maxPixelError = 1.0f;
+		//Each instance's LOD, reused between submissions
+		std::vector<uint32_t> instanceLods;
+	};
+}
+
+#endif
@@ -27,16 +27,58 @@ namespace vkn {
 		}
 
 		//Select the features from the PhysicalDevice we want to add to the Logical Device
+		VkPhysicalDeviceFeatures supportedFeatures;
+		vkGetPhysicalDeviceFeatures(physicalDevice->getPhysicalDevice(), &supportedFeatures);
+
 		VkPhysicalDeviceFeatures deviceFeatures{};
 		deviceFeatures.samplerAnisotropy = VK_TRUE;
+		//Optional, textures get transcoded on the CPU when it's missing
+		deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+		//Optional, indirect draws fall back to one call per command or direct draws
+		deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+		deviceFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
 
 		std::vector<const char*> extensions = physicalDevice->getDeviceExtensions();
 
+		//Extension features get chained off a VkPhysicalDeviceFeatures2, which
+		//then replaces pEnabledFeatures
+		VkPhysicalDeviceFeatures2 deviceFeatures2{};
+		deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		deviceFeatures2.features = deviceFeatures;
+
+		vkGetPhysicalDeviceProperties(physicalDevice->getPhysicalDevice(), &properties);
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice->getPhysicalDevice(), &memoryProperties);
+		bool hasFeatures2 = properties.apiVersion >= VK_API_VERSION_1_1;
+
+		if (hasFeatures2 && physicalDevice->isExtensionEnabled(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME)) {
+			VkPhysicalDeviceDescriptorIndexingFeatures supportedIndexing{};
+			supportedIndexing.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+			VkPhysicalDeviceFeatures2 supported2{};
+			supported2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+			supported2.pNext = &supportedIndexing;
+			vkGetPhysicalDeviceFeatures2(physicalDevice->getPhysicalDevice(), &supported2);
+
+			//Only the bits the bindless table needs
+			descriptorIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+			descriptorIndexingFeatures.shaderSampledImageArrayNonUniformIndexing = supportedIndexing.shaderSampledImageArrayNonUniformIndexing;
+			descriptorIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind = supportedIndexing.descriptorBindingSampledImageUpdateAfterBind;
+			descriptorIndexingFeatures.descriptorBindingUpdateUnusedWhilePending = supportedIndexing.descriptorBindingUpdateUnusedWhilePending;
+			descriptorIndexingFeatures.descriptorBindingPartiallyBound = supportedIndexing.descriptorBindingPartiallyBound;
+			descriptorIndexingFeatures.runtimeDescriptorArray = supportedIndexing.runtimeDescriptorArray;
+			deviceFeatures2.pNext = &descriptorIndexingFeatures;
+		}
+
 		VkDeviceCreateInfo createInfo{};
 		createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 		createInfo.pQueueCreateInfos = queueCreateInfos.data();
 		createInfo.queueCreateInfoCount = static_cast<uint32_t> (queueCreateInfos.size());
-		createInfo.pEnabledFeatures = &deviceFeatures;
+		if (hasFeatures2) {
+			createInfo.pNext = &deviceFeatures2;
+			createInfo.pEnabledFeatures = nullptr;
+		}
+		else {
+			createInfo.pEnabledFeatures = &deviceFeatures;
+		}
 		createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
 		createInfo.ppEnabledExtensionNames = extensions.data();
 		if (validationEnabled) {
@@ -50,6 +92,12 @@ namespace vkn {
 		if (vkCreateDevice(physicalDevice->getPhysicalDevice(), &createInfo, nullptr, &device) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create logical device!");
 		}
+		enabledFeatures = deviceFeatures;
+		//The chain pointed at a local
+		descriptorIndexingFeatures.pNext = nullptr;
+
+		samplerCache = new vkn::SamplerCache(this);
+		descriptorLayoutCache = new vkn::DescriptorLayoutCache(this);
 
 		//Don't forget to add these back in somewhere in the main program
 		//vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
@@ -60,7 +108,114 @@ namespace vkn {
 		vkGetDeviceQueue(this->device, queueFamilyIndex, queueIndex, pQueue);
 	}
 
+	uint32_t LogicalDevice::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+		for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+			if (typeFilter & (1 << i) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+				return i;
+			}
+		}
+
+		throw std::runtime_error("failed to find suitable memory type!");
+	}
+
+	bool LogicalDevice::hasMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+		for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+			if (typeFilter & (1 << i) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	VkSampleCountFlagBits LogicalDevice::getMaxSampleCount(VkSampleCountFlagBits wanted) {
+		VkSampleCountFlags supported = properties.limits.framebufferColorSampleCounts & properties.limits.framebufferDepthSampleCounts;
+		//Counts are single bits, halve until one fits. 1 always does
+		uint32_t samples = wanted;
+		while (samples > VK_SAMPLE_COUNT_1_BIT && (supported & samples) == 0) {
+			samples >>= 1;
+		}
+		return static_cast<VkSampleCountFlagBits>(samples);
+	}
+
+	void LogicalDevice::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+		VkBuffer& buffer, VkDeviceMemory& bufferMemory) {
+		VkBufferCreateInfo bufferInfo{};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = size;
+		bufferInfo.usage = usage;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create buffer!");
+		}
+
+		//Gather memory requirements and allocate memory
+		VkMemoryRequirements memRequirements;
+		vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+
+		VkMemoryAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = memRequirements.size;
+		allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+
+		if (vkAllocateMemory(device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate buffer memory!");
+		}
+		vkBindBufferMemory(device, buffer, bufferMemory, 0);
+	}
+
+	void LogicalDevice::createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageTiling tiling,
+		VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory) {
+		//Create an image to move buffer data into
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.extent.width = width;
+		imageInfo.extent.height = height;
+		imageInfo.extent.depth = 1;
+		imageInfo.mipLevels = mipLevels;
+		imageInfo.arrayLayers = 1;
+		imageInfo.format = format;
+		imageInfo.tiling = tiling;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageInfo.usage = usage;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.flags = 0;
+
+		if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create image");
+		}
+
+		VkMemoryRequirements memRequirements;
+		vkGetImageMemoryRequirements(device, image, &memRequirements);
+
+		VkMemoryAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = memRequirements.size;
+		allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+
+		if (vkAllocateMemory(device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to allocate image memory!");
+		}
+		vkBindImageMemory(device, image, imageMemory, 0);
+	}
+
+	bool LogicalDevice::isBindlessSupported() {
+		return descriptorIndexingFeatures.shaderSampledImageArrayNonUniformIndexing &&
+			descriptorIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind &&
+			descriptorIndexingFeatures.descriptorBindingPartiallyBound &&
+			descriptorIndexingFeatures.runtimeDescriptorArray;
+	}
+
+	bool LogicalDevice::isDrawIndirectCountSupported() {
+		return physicalDevice->isExtensionEnabled(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+	}
+
 	LogicalDevice::~LogicalDevice() {
+		//Layouts can hold immutable samplers, so they go first
+		delete(descriptorLayoutCache);
+		delete(samplerCache);
 		vkDestroyDevice(device, nullptr);
 	}
 
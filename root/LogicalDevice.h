@@ -4,6 +4,8 @@
 #ifndef __LOGICAL_DEVICE_H__
 #define __LOGICAL_DEVICE_H__
 #include "PhysicalDevice.h"
+#include "SamplerCache.h"
+#include "DescriptorLayoutCache.h"
 
 namespace vkn {
 
@@ -19,10 +21,38 @@ namespace vkn {
 
 		void getDeviceQueue(uint32_t queueFamilyIndex, uint32_t queueIndex, VkQueue *pQueue);
 		VkDevice getDevice() { return device; }
+		vkn::PhysicalDevice* getPhysicalDevice() { return physicalDevice; }
+		//Queried once at creation, these never change
+		const VkPhysicalDeviceProperties& getProperties() { return properties; }
+		vkn::SamplerCache* getSamplerCache() { return samplerCache; }
+		vkn::DescriptorLayoutCache* getDescriptorLayoutCache() { return descriptorLayoutCache; }
+		const VkPhysicalDeviceFeatures& getEnabledFeatures() { return enabledFeatures; }
+		const VkPhysicalDeviceDescriptorIndexingFeatures& getDescriptorIndexingFeatures() { return descriptorIndexingFeatures; }
+		//Everything BindlessTable relies on was available and switched on
+		bool isBindlessSupported();
+		//The GPU can read the draw count out of a buffer (VK_KHR_draw_indirect_count)
+		bool isDrawIndirectCountSupported();
+		//Highest sample count up to wanted that color and depth attachments both support
+		VkSampleCountFlagBits getMaxSampleCount(VkSampleCountFlagBits wanted);
+
+		//Memory helpers. Anything that owns device memory goes through these
+		uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+		//findMemoryType without the throw, for memory that's nice to have (LAZILY_ALLOCATED)
+		bool hasMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+		void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+			VkBuffer& buffer, VkDeviceMemory& bufferMemory);
+		void createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageTiling tiling,
+			VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory);
 
 	private:
 		vkn::PhysicalDevice *physicalDevice;
 		VkDevice device;
+		VkPhysicalDeviceProperties properties;
+		VkPhysicalDeviceMemoryProperties memoryProperties;
+		VkPhysicalDeviceFeatures enabledFeatures{};
+		vkn::SamplerCache* samplerCache = nullptr;
+		vkn::DescriptorLayoutCache* descriptorLayoutCache = nullptr;
+		VkPhysicalDeviceDescriptorIndexingFeatures descriptorIndexingFeatures{};
 	};
 
 }
@@ -0,0 +1,119 @@
+#include "MappedFile.h"
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace vkn {
+
+#ifdef _WIN32
+
+	MappedFile::MappedFile(const std::string& path) {
+		fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (fileHandle == INVALID_HANDLE_VALUE) {
+			fileHandle = nullptr;
+			throw std::runtime_error("failed to open " + path + "!");
+		}
+
+		LARGE_INTEGER fileSize;
+		GetFileSizeEx(fileHandle, &fileSize);
+		size = static_cast<size_t>(fileSize.QuadPart);
+		//Can't map an empty file, but an empty view is still valid
+		if (size == 0) {
+			return;
+		}
+
+		mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mappingHandle == nullptr) {
+			CloseHandle(fileHandle);
+			fileHandle = nullptr;
+			throw std::runtime_error("failed to map " + path + "!");
+		}
+
+		data = static_cast<const unsigned char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+		if (data == nullptr) {
+			CloseHandle(mappingHandle);
+			CloseHandle(fileHandle);
+			mappingHandle = nullptr;
+			fileHandle = nullptr;
+			throw std::runtime_error("failed to map " + path + "!");
+		}
+	}
+
+	MappedFile::~MappedFile() {
+		if (data != nullptr) {
+			UnmapViewOfFile(data);
+		}
+		if (mappingHandle != nullptr) {
+			CloseHandle(mappingHandle);
+		}
+		if (fileHandle != nullptr) {
+			CloseHandle(fileHandle);
+		}
+	}
+
+	void MappedFile::prefetch(size_t offset, size_t length) {
+		//PrefetchVirtualMemory needs Windows 8, FILE_FLAG_SEQUENTIAL_SCAN already gets us read ahead
+		(void)offset;
+		(void)length;
+	}
+
+#else
+
+	MappedFile::MappedFile(const std::string& path) {
+		fileDescriptor = open(path.c_str(), O_RDONLY);
+		if (fileDescriptor < 0) {
+			throw std::runtime_error("failed to open " + path + "!");
+		}
+
+		struct stat fileInfo;
+		if (fstat(fileDescriptor, &fileInfo) != 0) {
+			close(fileDescriptor);
+			fileDescriptor = -1;
+			throw std::runtime_error("failed to stat " + path + "!");
+		}
+		size = static_cast<size_t>(fileInfo.st_size);
+		if (size == 0) {
+			return;
+		}
+
+		void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+		if (mapped == MAP_FAILED) {
+			close(fileDescriptor);
+			fileDescriptor = -1;
+			throw std::runtime_error("failed to map " + path + "!");
+		}
+		data = static_cast<const unsigned char*>(mapped);
+	}
+
+	MappedFile::~MappedFile() {
+		if (data != nullptr) {
+			munmap(const_cast<unsigned char*>(data), size);
+		}
+		if (fileDescriptor >= 0) {
+			close(fileDescriptor);
+		}
+	}
+
+	void MappedFile::prefetch(size_t offset, size_t length) {
+		if (data == nullptr || offset >= size) {
+			return;
+		}
+		//madvise wants a page aligned start
+		size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+		size_t start = offset & ~(pageSize - 1);
+		size_t end = offset + length < size ? offset + length : size;
+		madvise(const_cast<unsigned char*>(data) + start, end - start, MADV_WILLNEED);
+	}
+
+#endif
+}
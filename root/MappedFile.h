@@ -0,0 +1,38 @@
+#ifndef __MAPPED_FILE_H__
+#define __MAPPED_FILE_H__
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+namespace vkn {
+	//Read only view of a whole file through the OS page cache. Nothing is read
+	//until a page is touched, and nothing is copied into our own memory.
+	class MappedFile {
+	public:
+		MappedFile() {}
+		//Throws if the file can't be opened or mapped
+		MappedFile(const std::string& path);
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		const unsigned char* getData() { return data; }
+		size_t getSize() { return size; }
+		//Ask the OS to start paging a range in ahead of use
+		void prefetch(size_t offset, size_t length);
+
+	private:
+		const unsigned char* data = nullptr;
+		size_t size = 0;
+#ifdef _WIN32
+		void* fileHandle = nullptr;
+		void* mappingHandle = nullptr;
+#else
+		int fileDescriptor = -1;
+#endif
+	};
+}
+
+#endif
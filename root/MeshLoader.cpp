@@ -0,0 +1,1231 @@
+#include "MeshLoader.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <limits>
+#include <stdexcept>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+
+namespace vkn {
+
+	//OBJ files get split into chunks of about this size, on line boundaries,
+	//so every chunk can be parsed without knowing about the others
+	static const size_t OBJ_CHUNK_SIZE = 1 << 20;
+	//Corners are spread over this many independent hash tables by the top bits
+	//of their hash, so deduplication runs in parallel without any locking
+	static const uint32_t OBJ_SHARD_COUNT = 64;
+	static const uint32_t OBJ_SHARD_SHIFT = 26;
+	static const uint32_t OBJ_EMPTY_SLOT = std::numeric_limits<uint32_t>::max();
+	static const int32_t OBJ_BAD_INDEX = std::numeric_limits<int32_t>::min();
+
+	//glTF vertices and triangles are converted in batches this big
+	static const uint32_t GLB_BATCH_SIZE = 1 << 16;
+	static const uint32_t GLB_MAGIC = 0x46546C67; //"glTF"
+	static const uint32_t GLB_CHUNK_JSON = 0x4E4F534A;
+	static const uint32_t GLB_CHUNK_BIN = 0x004E4942;
+
+	MeshLoader::MeshLoader(ThreadPool* threadPool) {
+		this->threadPool = threadPool;
+	}
+
+	static std::string getExtension(const std::string& path) {
+		size_t dot = path.find_last_of('.');
+		if (dot == std::string::npos) {
+			return "";
+		}
+		std::string extension = path.substr(dot);
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+		return extension;
+	}
+
+	bool MeshLoader::isSupported(const std::string& path) {
+		std::string extension = getExtension(path);
+		return extension == ".obj" || extension == ".glb";
+	}
+
+	MeshInfo MeshLoader::load(const std::string& path, const Allocator& allocate) {
+		std::string extension = getExtension(path);
+		if (extension != ".obj" && extension != ".glb") {
+			throw std::runtime_error("unsupported mesh format " + path + "!");
+		}
+
+		MappedFile file(path);
+		//Both parsers read every byte, so get the OS reading ahead of them
+		file.prefetch(0, file.getSize());
+		try {
+			return extension == ".obj" ? loadObj(file, allocate) : loadGlb(file, allocate);
+		}
+		catch (const std::runtime_error& e) {
+			throw std::runtime_error(path + ": " + e.what());
+		}
+	}
+
+	MeshData* MeshLoader::load(const std::string& path) {
+		MeshData* data = new MeshData();
+		try {
+			data->info = load(path, [data](uint32_t vertexCount, uint32_t indexCount, Vertex*& vertices, uint32_t*& indices) {
+				data->vertices.resize(vertexCount);
+				data->indices.resize(indexCount);
+				vertices = data->vertices.data();
+				indices = data->indices.data();
+			});
+		}
+		catch (...) {
+			delete(data);
+			throw;
+		}
+		return data;
+	}
+
+	//--------------------------------------------------------------------------
+	//Wavefront OBJ
+	//
+	//  1. Split the file into chunks on line boundaries
+	//  2. Count what every chunk holds, in parallel
+	//  3. Prefix sum the counts so every chunk knows where its data goes
+	//  4. Parse every chunk into the shared arrays, in parallel
+	//  5. Hash every face corner (position/uv/normal triple) and bucket it by shard
+	//  6. Deduplicate each shard with its own hash table, in parallel
+	//  7. Prefix sum the unique counts and write vertices and indices out
+	//--------------------------------------------------------------------------
+
+	struct ObjCorner {
+		int32_t position;
+		int32_t texCoord;
+		int32_t normal;
+
+		bool operator==(const ObjCorner& other) const {
+			return position == other.position && texCoord == other.texCoord && normal == other.normal;
+		}
+	};
+
+	struct ObjChunk {
+		const char* begin;
+		const char* end;
+		//Counted in the first pass
+		uint32_t positionCount;
+		uint32_t texCoordCount;
+		uint32_t normalCount;
+		uint32_t cornerCount;
+		//Where this chunk's data starts in the shared arrays
+		uint32_t positionBase;
+		uint32_t texCoordBase;
+		uint32_t normalBase;
+		uint32_t cornerBase;
+		bool missingNormals;
+		bool malformed;
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+		//Corners per shard, then reused as the scatter cursor
+		uint32_t shardCounts[OBJ_SHARD_COUNT];
+	};
+
+	static bool isSpace(char c) {
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	static const char* skipSpace(const char* p, const char* end) {
+		while (p < end && isSpace(*p)) {
+			p++;
+		}
+		return p;
+	}
+
+	static const char* findLineEnd(const char* p, const char* end) {
+		const char* newline = static_cast<const char*>(std::memchr(p, '\n', static_cast<size_t>(end - p)));
+		return newline != nullptr ? newline : end;
+	}
+
+	//'v', 't' (vt), 'n' (vn), 'f', or 0 for anything we skip. Moves p past the keyword
+	static char getLineType(const char*& p, const char* lineEnd) {
+		p = skipSpace(p, lineEnd);
+		size_t length = static_cast<size_t>(lineEnd - p);
+		if (length >= 2 && p[0] == 'v' && isSpace(p[1])) {
+			p += 1;
+			return 'v';
+		}
+		if (length >= 2 && p[0] == 'f' && isSpace(p[1])) {
+			p += 1;
+			return 'f';
+		}
+		if (length >= 3 && p[0] == 'v' && (p[1] == 't' || p[1] == 'n') && isSpace(p[2])) {
+			p += 2;
+			return p[-1];
+		}
+		return 0;
+	}
+
+	//Locale independent and a lot quicker than strtof, covers everything exporters write
+	static bool parseFloat(const char*& p, const char* end, float& out) {
+		p = skipSpace(p, end);
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+')) {
+			negative = *p == '-';
+			p++;
+		}
+
+		const char* digits = p;
+		double value = 0.0;
+		while (p < end && *p >= '0' && *p <= '9') {
+			value = value * 10.0 + (*p - '0');
+			p++;
+		}
+		if (p < end && *p == '.') {
+			p++;
+			double fraction = 0.0;
+			double divisor = 1.0;
+			while (p < end && *p >= '0' && *p <= '9') {
+				fraction = fraction * 10.0 + (*p - '0');
+				divisor *= 10.0;
+				p++;
+			}
+			value += fraction / divisor;
+		}
+		if (p == digits) {
+			return false;
+		}
+
+		if (p < end && (*p == 'e' || *p == 'E')) {
+			p++;
+			bool negativeExponent = false;
+			if (p < end && (*p == '-' || *p == '+')) {
+				negativeExponent = *p == '-';
+				p++;
+			}
+			int exponent = 0;
+			while (p < end && *p >= '0' && *p <= '9') {
+				exponent = std::min(exponent * 10 + (*p - '0'), 400);
+				p++;
+			}
+			value *= std::pow(10.0, negativeExponent ? -exponent : exponent);
+		}
+
+		out = static_cast<float>(negative ? -value : value);
+		return true;
+	}
+
+	static bool parseInt(const char*& p, const char* end, int32_t& out) {
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+')) {
+			negative = *p == '-';
+			p++;
+		}
+		const char* digits = p;
+		int64_t value = 0;
+		while (p < end && *p >= '0' && *p <= '9') {
+			value = std::min<int64_t>(value * 10 + (*p - '0'), std::numeric_limits<int32_t>::max());
+			p++;
+		}
+		out = static_cast<int32_t>(negative ? -value : value);
+		return p != digits;
+	}
+
+	//OBJ indices are 1 based, negative ones count back from the last element defined
+	static int32_t resolveIndex(int32_t index, uint32_t definedSoFar) {
+		if (index > 0) {
+			return index - 1;
+		}
+		int64_t resolved = static_cast<int64_t>(definedSoFar) + index;
+		return index < 0 && resolved >= 0 ? static_cast<int32_t>(resolved) : OBJ_BAD_INDEX;
+	}
+
+	//One v, v/vt, v//vn or v/vt/vn token
+	static bool parseCorner(const char*& p, const char* end, const ObjChunk& chunk,
+		uint32_t positionsSoFar, uint32_t texCoordsSoFar, uint32_t normalsSoFar, ObjCorner& corner) {
+		int32_t index;
+		if (!parseInt(p, end, index)) {
+			return false;
+		}
+		corner.position = resolveIndex(index, chunk.positionBase + positionsSoFar);
+		corner.texCoord = -1;
+		corner.normal = -1;
+
+		if (p < end && *p == '/') {
+			p++;
+			if (p < end && *p != '/') {
+				if (!parseInt(p, end, index)) {
+					return false;
+				}
+				corner.texCoord = resolveIndex(index, chunk.texCoordBase + texCoordsSoFar);
+			}
+			if (p < end && *p == '/') {
+				p++;
+				if (!parseInt(p, end, index)) {
+					return false;
+				}
+				corner.normal = resolveIndex(index, chunk.normalBase + normalsSoFar);
+			}
+		}
+		return p == end || isSpace(*p);
+	}
+
+	static void countObjChunk(ObjChunk& chunk) {
+		for (const char* line = chunk.begin; line < chunk.end;) {
+			const char* lineEnd = findLineEnd(line, chunk.end);
+			const char* p = line;
+			switch (getLineType(p, lineEnd)) {
+			case 'v': chunk.positionCount++; break;
+			case 't': chunk.texCoordCount++; break;
+			case 'n': chunk.normalCount++; break;
+			case 'f': {
+				uint32_t tokens = 0;
+				while (true) {
+					p = skipSpace(p, lineEnd);
+					if (p >= lineEnd || *p == '#') {
+						break;
+					}
+					tokens++;
+					while (p < lineEnd && !isSpace(*p)) {
+						p++;
+					}
+				}
+				//Polygons get fanned into triangles
+				if (tokens >= 3) {
+					chunk.cornerCount += (tokens - 2) * 3;
+				}
+				break;
+			}
+			default: break;
+			}
+			line = lineEnd + 1;
+		}
+	}
+
+	static void parseObjChunk(ObjChunk& chunk, glm::vec3* positions, glm::vec3* colors, glm::vec2* texCoords, glm::vec3* normals, ObjCorner* corners) {
+		uint32_t positionCount = 0;
+		uint32_t texCoordCount = 0;
+		uint32_t normalCount = 0;
+		uint32_t cornerCount = 0;
+		chunk.boundsMin = glm::vec3(std::numeric_limits<float>::max());
+		chunk.boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+
+		for (const char* line = chunk.begin; line < chunk.end && !chunk.malformed;) {
+			const char* lineEnd = findLineEnd(line, chunk.end);
+			const char* p = line;
+			switch (getLineType(p, lineEnd)) {
+			case 'v': {
+				glm::vec3 position;
+				if (!parseFloat(p, lineEnd, position.x) || !parseFloat(p, lineEnd, position.y) || !parseFloat(p, lineEnd, position.z)) {
+					chunk.malformed = true;
+					break;
+				}
+				//Some exporters tack a vertex colour on the end
+				glm::vec3 color;
+				if (!parseFloat(p, lineEnd, color.r) || !parseFloat(p, lineEnd, color.g) || !parseFloat(p, lineEnd, color.b)) {
+					color = glm::vec3(1.0f);
+				}
+				positions[chunk.positionBase + positionCount] = position;
+				colors[chunk.positionBase + positionCount] = color;
+				positionCount++;
+				chunk.boundsMin = glm::min(chunk.boundsMin, position);
+				chunk.boundsMax = glm::max(chunk.boundsMax, position);
+				break;
+			}
+			case 't': {
+				glm::vec2 texCoord;
+				if (!parseFloat(p, lineEnd, texCoord.x)) {
+					chunk.malformed = true;
+					break;
+				}
+				if (!parseFloat(p, lineEnd, texCoord.y)) {
+					texCoord.y = 0.0f;
+				}
+				//OBJ puts the origin bottom left, Vulkan samples from the top left
+				texCoords[chunk.texCoordBase + texCoordCount] = glm::vec2(texCoord.x, 1.0f - texCoord.y);
+				texCoordCount++;
+				break;
+			}
+			case 'n': {
+				glm::vec3 normal;
+				if (!parseFloat(p, lineEnd, normal.x) || !parseFloat(p, lineEnd, normal.y) || !parseFloat(p, lineEnd, normal.z)) {
+					chunk.malformed = true;
+					break;
+				}
+				normals[chunk.normalBase + normalCount] = normal;
+				normalCount++;
+				break;
+			}
+			case 'f': {
+				ObjCorner first{};
+				ObjCorner previous{};
+				uint32_t tokens = 0;
+				while (true) {
+					p = skipSpace(p, lineEnd);
+					if (p >= lineEnd || *p == '#') {
+						break;
+					}
+					ObjCorner corner;
+					if (!parseCorner(p, lineEnd, chunk, positionCount, texCoordCount, normalCount, corner)) {
+						chunk.malformed = true;
+						break;
+					}
+					chunk.missingNormals |= corner.normal == -1;
+
+					if (tokens == 0) {
+						first = corner;
+					}
+					else if (tokens >= 2) {
+						ObjCorner* out = corners + chunk.cornerBase + cornerCount;
+						out[0] = first;
+						out[1] = previous;
+						out[2] = corner;
+						cornerCount += 3;
+					}
+					previous = corner;
+					tokens++;
+				}
+				break;
+			}
+			default: break;
+			}
+			line = lineEnd + 1;
+		}
+	}
+
+	static uint32_t hashCorner(const ObjCorner& corner) {
+		uint32_t h = static_cast<uint32_t>(corner.position) * 0x9E3779B1u;
+		h ^= static_cast<uint32_t>(corner.texCoord) * 0x85EBCA77u;
+		h ^= static_cast<uint32_t>(corner.normal) * 0xC2B2AE3Du;
+		//murmur3 finaliser, the shard comes from the top bits so they need mixing too
+		h ^= h >> 16;
+		h *= 0x85EBCA6Bu;
+		h ^= h >> 13;
+		h *= 0xC2B2AE35u;
+		h ^= h >> 16;
+		return h;
+	}
+
+	MeshInfo MeshLoader::loadObj(MappedFile& file, const Allocator& allocate) {
+		const char* data = reinterpret_cast<const char*>(file.getData());
+		const char* end = data + file.getSize();
+
+		std::vector<ObjChunk> chunks;
+		for (const char* p = data; p < end;) {
+			const char* chunkEnd = end;
+			if (static_cast<size_t>(end - p) > OBJ_CHUNK_SIZE) {
+				chunkEnd = findLineEnd(p + OBJ_CHUNK_SIZE, end);
+				chunkEnd = chunkEnd < end ? chunkEnd + 1 : end;
+			}
+			ObjChunk chunk{};
+			chunk.begin = p;
+			chunk.end = chunkEnd;
+			chunks.push_back(chunk);
+			p = chunkEnd;
+		}
+		uint32_t chunkCount = static_cast<uint32_t>(chunks.size());
+
+		threadPool->parallelFor(chunkCount, 1, [&](uint32_t begin, uint32_t end) {
+			for (uint32_t i = begin; i < end; i++) {
+				countObjChunk(chunks[i]);
+			}
+		});
+
+		uint64_t positionTotal = 0;
+		uint64_t texCoordTotal = 0;
+		uint64_t normalTotal = 0;
+		uint64_t cornerTotal = 0;
+		for (ObjChunk& chunk : chunks) {
+			chunk.positionBase = static_cast<uint32_t>(positionTotal);
+			chunk.texCoordBase = static_cast<uint32_t>(texCoordTotal);
+			chunk.normalBase = static_cast<uint32_t>(normalTotal);
+			chunk.cornerBase = static_cast<uint32_t>(cornerTotal);
+			positionTotal += chunk.positionCount;
+			texCoordTotal += chunk.texCoordCount;
+			normalTotal += chunk.normalCount;
+			cornerTotal += chunk.cornerCount;
+		}
+		if (cornerTotal == 0) {
+			throw std::runtime_error("mesh has no faces!");
+		}
+		//Vertex indices are 32 bit, and OBJ_BAD_INDEX has to stay out of range
+		if (cornerTotal >= std::numeric_limits<int32_t>::max() || positionTotal >= std::numeric_limits<int32_t>::max() ||
+			texCoordTotal >= std::numeric_limits<int32_t>::max() || normalTotal >= std::numeric_limits<int32_t>::max()) {
+			throw std::runtime_error("mesh is too big for 32 bit indices!");
+		}
+
+		std::vector<glm::vec3> positions(positionTotal);
+		std::vector<glm::vec3> colors(positionTotal);
+		std::vector<glm::vec2> texCoords(texCoordTotal);
+		std::vector<glm::vec3> normals(normalTotal);
+		std::vector<ObjCorner> corners(cornerTotal);
+
+		threadPool->parallelFor(chunkCount, 1, [&](uint32_t begin, uint32_t end) {
+			for (uint32_t i = begin; i < end; i++) {
+				parseObjChunk(chunks[i], positions.data(), colors.data(), texCoords.data(), normals.data(), corners.data());
+			}
+		});
+
+		//Check every index now that the totals are known, forward references are legal
+		std::vector<uint32_t> hashes(cornerTotal);
+		threadPool->parallelFor(chunkCount, 1, [&](uint32_t begin, uint32_t end) {
+			for (uint32_t i = begin; i < end; i++) {
+				ObjChunk& chunk = chunks[i];
+				for (uint32_t c = chunk.cornerBase; c < chunk.cornerBase + chunk.cornerCount; c++) {
+					const ObjCorner& corner = corners[c];
+					if (corner.position < 0 || corner.position >= static_cast<int64_t>(positionTotal) ||
+						corner.texCoord < -1 || corner.texCoord >= static_cast<int64_t>(texCoordTotal) ||
+						corner.normal < -1 || corner.normal >= static_cast<int64_t>(normalTotal)) {
+						chunk.malformed = true;
+						break;
+					}
+					hashes[c] = hashCorner(corner);
+					chunk.shardCounts[hashes[c] >> OBJ_SHARD_SHIFT]++;
+				}
+			}
+		});
+
+		MeshInfo info;
+		info.boundsMin = glm::vec3(std::numeric_limits<float>::max());
+		info.boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+		bool missingNormals = false;
+		for (ObjChunk& chunk : chunks) {
+			if (chunk.malformed) {
+				//Near enough to point someone at the right part of the file
+				size_t line = std::count(data, chunk.begin, '\n') + 1;
+				throw std::runtime_error("malformed data somewhere after line " + std::to_string(line) + "!");
+			}
+			missingNormals |= chunk.missingNormals;
+			if (chunk.positionCount > 0) {
+				info.boundsMin = glm::min(info.boundsMin, chunk.boundsMin);
+				info.boundsMax = glm::max(info.boundsMax, chunk.boundsMax);
+			}
+		}
+
+		//Shard major order, chunks in file order within each shard. Turns the
+		//per chunk counts into write cursors for the scatter
+		std::vector<uint32_t> shardStart(OBJ_SHARD_COUNT + 1, 0);
+		uint32_t running = 0;
+		for (uint32_t s = 0; s < OBJ_SHARD_COUNT; s++) {
+			shardStart[s] = running;
+			for (ObjChunk& chunk : chunks) {
+				uint32_t count = chunk.shardCounts[s];
+				chunk.shardCounts[s] = running;
+				running += count;
+			}
+		}
+		shardStart[OBJ_SHARD_COUNT] = running;
+
+		std::vector<uint32_t> order(cornerTotal);
+		threadPool->parallelFor(chunkCount, 1, [&](uint32_t begin, uint32_t end) {
+			for (uint32_t i = begin; i < end; i++) {
+				ObjChunk& chunk = chunks[i];
+				for (uint32_t c = chunk.cornerBase; c < chunk.cornerBase + chunk.cornerCount; c++) {
+					order[chunk.shardCounts[hashes[c] >> OBJ_SHARD_SHIFT]++] = c;
+				}
+			}
+		});
+
+		//Open addressing on the low hash bits. Every corner gets the shard local
+		//id of the first identical corner, and the firsts become the vertices
+		std::vector<uint32_t> localIds(cornerTotal);
+		std::vector<std::vector<uint32_t>> uniqueCorners(OBJ_SHARD_COUNT);
+		threadPool->parallelFor(OBJ_SHARD_COUNT, 1, [&](uint32_t begin, uint32_t end) {
+			for (uint32_t s = begin; s < end; s++) {
+				uint32_t count = shardStart[s + 1] - shardStart[s];
+				uint32_t tableSize = 16;
+				while (tableSize < count * 2) {
+					tableSize *= 2;
+				}
+				std::vector<uint32_t> table(tableSize, OBJ_EMPTY_SLOT);
+				std::vector<uint32_t>& unique = uniqueCorners[s];
+
+				for (uint32_t i = shardStart[s]; i < shardStart[s + 1]; i++) {
+					uint32_t c = order[i];
+					uint32_t slot = hashes[c] & (tableSize - 1);
+					while (true) {
+						uint32_t existing = table[slot];
+						if (existing == OBJ_EMPTY_SLOT) {
+							table[slot] = c;
+							localIds[c] = static_cast<uint32_t>(unique.size());
+							unique.push_back(c);
+							break;
+						}
+						if (corners[existing] == corners[c]) {
+							localIds[c] = localIds[existing];
+							break;
+						}
+						slot = (slot + 1) & (tableSize - 1);
+					}
+				}
+			}
+		});
+
+		std::vector<uint32_t> vertexBase(OBJ_SHARD_COUNT);
+		uint32_t vertexTotal = 0;
+		for (uint32_t s = 0; s < OBJ_SHARD_COUNT; s++) {
+			vertexBase[s] = vertexTotal;
+			vertexTotal += static_cast<uint32_t>(uniqueCorners[s].size());
+		}
+
+		//Smooth normals from area weighted face normals, shared by position
+		std::vector<glm::vec3> generatedNormals;
+		if (missingNormals) {
+			generatedNormals.resize(positionTotal, glm::vec3(0.0f));
+			for (uint64_t c = 0; c < cornerTotal; c += 3) {
+				const glm::vec3& a = positions[corners[c].position];
+				const glm::vec3& b = positions[corners[c + 1].position];
+				const glm::vec3& d = positions[corners[c + 2].position];
+				glm::vec3 faceNormal = glm::cross(b - a, d - a);
+				generatedNormals[corners[c].position] += faceNormal;
+				generatedNormals[corners[c + 1].position] += faceNormal;
+				generatedNormals[corners[c + 2].position] += faceNormal;
+			}
+			threadPool->parallelFor(static_cast<uint32_t>(positionTotal), GLB_BATCH_SIZE, [&](uint32_t begin, uint32_t end) {
+				for (uint32_t i = begin; i < end; i++) {
+					float length = glm::length(generatedNormals[i]);
+					generatedNormals[i] = length > 0.0f ? generatedNormals[i] / length : glm::vec3(0.0f, 0.0f, 1.0f);
+				}
+			});
+		}
+
+		info.vertexCount = vertexTotal;
+		info.indexCount = static_cast<uint32_t>(cornerTotal);
+		Vertex* outVertices = nullptr;
+		uint32_t* outIndices = nullptr;
+		allocate(info.vertexCount, info.indexCount, outVertices, outIndices);
+
+		//Each output element gets written exactly once, and whole, since the
+		//destination is probably write combined
+		threadPool->parallelFor(OBJ_SHARD_COUNT, 1, [&](uint32_t begin, uint32_t end) {
+			for (uint32_t s = begin; s < end; s++) {
+				const std::vector<uint32_t>& unique = uniqueCorners[s];
+				for (size_t l = 0; l < unique.size(); l++) {
+					const ObjCorner& corner = corners[unique[l]];
+					Vertex vertex;
+					vertex.pos = positions[corner.position];
+					vertex.color = colors[corner.position];
+					vertex.texCoord = corner.texCoord >= 0 ? texCoords[corner.texCoord] : glm::vec2(0.0f);
+					vertex.normal = corner.normal >= 0 ? normals[corner.normal] : generatedNormals[corner.position];
+					outVertices[vertexBase[s] + l] = vertex;
+				}
+				for (uint32_t i = shardStart[s]; i < shardStart[s + 1]; i++) {
+					uint32_t c = order[i];
+					outIndices[c] = vertexBase[s] + localIds[c];
+				}
+			}
+		});
+
+		return info;
+	}
+
+	//--------------------------------------------------------------------------
+	//Binary glTF
+	//
+	//The JSON is tiny next to the binary chunk, so it gets a quick serial parse.
+	//Vertex data is already indexed, so each primitive is converted in parallel
+	//batches straight from the mapped binary chunk to the output.
+	//--------------------------------------------------------------------------
+
+	//Just enough JSON for glTF
+	struct JsonValue {
+		enum class Type {
+			Null,
+			Boolean,
+			Number,
+			String,
+			Array,
+			Object
+		};
+
+		Type type = Type::Null;
+		bool boolean = false;
+		double number = 0.0;
+		std::string string;
+		std::vector<JsonValue> array;
+		std::vector<std::pair<std::string, JsonValue>> members;
+
+		const JsonValue* find(const std::string& key) const {
+			for (const auto& member : members) {
+				if (member.first == key) {
+					return &member.second;
+				}
+			}
+			return nullptr;
+		}
+
+		//Missing keys and the wrong types give back the fallback
+		double getNumber(const std::string& key, double fallback) const {
+			const JsonValue* value = find(key);
+			return value != nullptr && value->type == Type::Number ? value->number : fallback;
+		}
+
+		//Throws when the key is missing or isn't a sensible index
+		uint32_t getIndex(const std::string& key) const {
+			const JsonValue* value = find(key);
+			if (value == nullptr || value->type != Type::Number || value->number < 0.0 || value->number > std::numeric_limits<uint32_t>::max()) {
+				throw std::runtime_error("missing or invalid \"" + key + "\"!");
+			}
+			return static_cast<uint32_t>(value->number);
+		}
+
+		//Throws when out of range, or when this isn't an array
+		const JsonValue& at(uint32_t index) const {
+			if (type != Type::Array || index >= array.size()) {
+				throw std::runtime_error("index " + std::to_string(index) + " is out of range!");
+			}
+			return array[index];
+		}
+	};
+
+	class JsonParser {
+	public:
+		JsonParser(const char* begin, const char* end) : p(begin), end(end) {}
+
+		JsonValue parse() {
+			JsonValue value = parseValue(0);
+			skipSpace();
+			if (p != end) {
+				fail();
+			}
+			return value;
+		}
+
+	private:
+		//Deep enough for any real file, shallow enough not to blow the stack
+		static const uint32_t MAX_DEPTH = 64;
+
+		void fail() {
+			throw std::runtime_error("malformed JSON!");
+		}
+
+		void skipSpace() {
+			//glb pads the JSON chunk with spaces
+			while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r' || *p == '\0')) {
+				p++;
+			}
+		}
+
+		void expect(char c) {
+			skipSpace();
+			if (p >= end || *p != c) {
+				fail();
+			}
+			p++;
+		}
+
+		bool consume(const char* literal) {
+			size_t length = std::strlen(literal);
+			if (static_cast<size_t>(end - p) >= length && std::memcmp(p, literal, length) == 0) {
+				p += length;
+				return true;
+			}
+			return false;
+		}
+
+		JsonValue parseValue(uint32_t depth) {
+			if (depth > MAX_DEPTH) {
+				fail();
+			}
+			skipSpace();
+			if (p >= end) {
+				fail();
+			}
+
+			JsonValue value;
+			if (*p == '{') {
+				p++;
+				value.type = JsonValue::Type::Object;
+				skipSpace();
+				if (p < end && *p == '}') {
+					p++;
+					return value;
+				}
+				do {
+					skipSpace();
+					std::string key = parseString();
+					expect(':');
+					value.members.emplace_back(std::move(key), parseValue(depth + 1));
+					skipSpace();
+				} while (p < end && *p == ',' && ++p);
+				expect('}');
+			}
+			else if (*p == '[') {
+				p++;
+				value.type = JsonValue::Type::Array;
+				skipSpace();
+				if (p < end && *p == ']') {
+					p++;
+					return value;
+				}
+				do {
+					value.array.push_back(parseValue(depth + 1));
+					skipSpace();
+				} while (p < end && *p == ',' && ++p);
+				expect(']');
+			}
+			else if (*p == '"') {
+				value.type = JsonValue::Type::String;
+				value.string = parseString();
+			}
+			else if (consume("true")) {
+				value.type = JsonValue::Type::Boolean;
+				value.boolean = true;
+			}
+			else if (consume("false")) {
+				value.type = JsonValue::Type::Boolean;
+			}
+			else if (consume("null")) {
+				value.type = JsonValue::Type::Null;
+			}
+			else {
+				value.type = JsonValue::Type::Number;
+				value.number = parseNumber();
+			}
+			return value;
+		}
+
+		std::string parseString() {
+			if (p >= end || *p != '"') {
+				fail();
+			}
+			p++;
+			std::string out;
+			while (p < end && *p != '"') {
+				if (*p != '\\') {
+					out.push_back(*p++);
+					continue;
+				}
+				p++;
+				if (p >= end) {
+					fail();
+				}
+				char escape = *p++;
+				switch (escape) {
+				case 'b': out.push_back('\b'); break;
+				case 'f': out.push_back('\f'); break;
+				case 'n': out.push_back('\n'); break;
+				case 'r': out.push_back('\r'); break;
+				case 't': out.push_back('\t'); break;
+				case 'u': {
+					if (end - p < 4) {
+						fail();
+					}
+					uint32_t code = static_cast<uint32_t>(std::strtoul(std::string(p, 4).c_str(), nullptr, 16));
+					p += 4;
+					//Back to UTF-8. Surrogate pairs come out as two characters, names don't matter to us
+					if (code < 0x80) {
+						out.push_back(static_cast<char>(code));
+					}
+					else if (code < 0x800) {
+						out.push_back(static_cast<char>(0xC0 | (code >> 6)));
+						out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+					}
+					else {
+						out.push_back(static_cast<char>(0xE0 | (code >> 12)));
+						out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+						out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+					}
+					break;
+				}
+				default: out.push_back(escape); break;
+				}
+			}
+			if (p >= end) {
+				fail();
+			}
+			p++;
+			return out;
+		}
+
+		double parseNumber() {
+			const char* start = p;
+			while (p < end && ((*p >= '0' && *p <= '9') || *p == '-' || *p == '+' || *p == '.' || *p == 'e' || *p == 'E')) {
+				p++;
+			}
+			if (p == start) {
+				fail();
+			}
+			std::string token(start, p);
+			char* parsedEnd = nullptr;
+			double number = std::strtod(token.c_str(), &parsedEnd);
+			if (parsedEnd != token.c_str() + token.size()) {
+				fail();
+			}
+			return number;
+		}
+
+		const char* p;
+		const char* end;
+	};
+
+	//Strided view of one accessor inside the binary chunk
+	struct GlbAccessor {
+		const unsigned char* data = nullptr;
+		uint32_t count = 0;
+		uint32_t stride = 0;
+		uint32_t componentType = 0;
+		uint32_t componentCount = 0;
+		bool normalized = false;
+
+		static uint32_t getComponentSize(uint32_t componentType) {
+			switch (componentType) {
+			case 5120: case 5121: return 1;
+			case 5122: case 5123: return 2;
+			case 5125: case 5126: return 4;
+			default: throw std::runtime_error("unknown accessor component type!");
+			}
+		}
+
+		float get(uint32_t element, uint32_t component) const {
+			const unsigned char* in = data + static_cast<size_t>(element) * stride + static_cast<size_t>(component) * getComponentSize(componentType);
+			switch (componentType) {
+			case 5126: { float v; std::memcpy(&v, in, 4); return v; }
+			case 5121: { uint8_t v = *in; return normalized ? v / 255.0f : v; }
+			case 5123: { uint16_t v; std::memcpy(&v, in, 2); return normalized ? v / 65535.0f : v; }
+			case 5120: { int8_t v; std::memcpy(&v, in, 1); return normalized ? std::max(v / 127.0f, -1.0f) : v; }
+			case 5122: { int16_t v; std::memcpy(&v, in, 2); return normalized ? std::max(v / 32767.0f, -1.0f) : v; }
+			default: { uint32_t v; std::memcpy(&v, in, 4); return static_cast<float>(v); }
+			}
+		}
+
+		uint32_t getIndex(uint32_t element) const {
+			const unsigned char* in = data + static_cast<size_t>(element) * stride;
+			switch (componentType) {
+			case 5121: return *in;
+			case 5123: { uint16_t v; std::memcpy(&v, in, 2); return v; }
+			default: { uint32_t v; std::memcpy(&v, in, 4); return v; }
+			}
+		}
+	};
+
+	static GlbAccessor getGlbAccessor(const JsonValue& json, uint32_t index, const unsigned char* bin, uint64_t binSize) {
+		const JsonValue* accessors = json.find("accessors");
+		const JsonValue* bufferViews = json.find("bufferViews");
+		if (accessors == nullptr || bufferViews == nullptr) {
+			throw std::runtime_error("missing accessors or bufferViews!");
+		}
+		const JsonValue& accessor = accessors->at(index);
+		if (accessor.find("sparse") != nullptr) {
+			throw std::runtime_error("sparse accessors are not supported!");
+		}
+
+		GlbAccessor view;
+		view.count = accessor.getIndex("count");
+		view.componentType = accessor.getIndex("componentType");
+		const JsonValue* normalized = accessor.find("normalized");
+		view.normalized = normalized != nullptr && normalized->boolean;
+
+		const JsonValue* type = accessor.find("type");
+		std::string typeName = type != nullptr ? type->string : "";
+		if (typeName == "SCALAR") {
+			view.componentCount = 1;
+		}
+		else if (typeName == "VEC2") {
+			view.componentCount = 2;
+		}
+		else if (typeName == "VEC3") {
+			view.componentCount = 3;
+		}
+		else if (typeName == "VEC4") {
+			view.componentCount = 4;
+		}
+		else {
+			throw std::runtime_error("unsupported accessor type " + typeName + "!");
+		}
+		uint64_t elementSize = static_cast<uint64_t>(GlbAccessor::getComponentSize(view.componentType)) * view.componentCount;
+
+		const JsonValue& bufferView = bufferViews->at(accessor.getIndex("bufferView"));
+		if (bufferView.getNumber("buffer", 0.0) != 0.0) {
+			throw std::runtime_error("only the embedded binary buffer is supported!");
+		}
+		uint64_t viewOffset = static_cast<uint64_t>(bufferView.getNumber("byteOffset", 0.0));
+		uint64_t viewLength = bufferView.getIndex("byteLength");
+		uint64_t accessorOffset = static_cast<uint64_t>(accessor.getNumber("byteOffset", 0.0));
+		view.stride = static_cast<uint32_t>(bufferView.getNumber("byteStride", static_cast<double>(elementSize)));
+
+		if (viewOffset + viewLength > binSize || view.stride < elementSize ||
+			(view.count > 0 && accessorOffset + static_cast<uint64_t>(view.stride) * (view.count - 1) + elementSize > viewLength)) {
+			throw std::runtime_error("accessor " + std::to_string(index) + " is outside the binary chunk!");
+		}
+		view.data = bin + viewOffset + accessorOffset;
+		return view;
+	}
+
+	static glm::mat4 getGlbNodeTransform(const JsonValue& node) {
+		const JsonValue* matrix = node.find("matrix");
+		if (matrix != nullptr && matrix->array.size() == 16) {
+			//Column major, same as glm
+			glm::mat4 transform;
+			for (uint32_t i = 0; i < 16; i++) {
+				transform[i / 4][i % 4] = static_cast<float>(matrix->array[i].number);
+			}
+			return transform;
+		}
+
+		glm::vec3 translation(0.0f);
+		glm::quat rotation(1.0f, 0.0f, 0.0f, 0.0f);
+		glm::vec3 scale(1.0f);
+		const JsonValue* t = node.find("translation");
+		if (t != nullptr && t->array.size() == 3) {
+			translation = glm::vec3(t->array[0].number, t->array[1].number, t->array[2].number);
+		}
+		//glTF stores xyzw, glm constructs from wxyz
+		const JsonValue* r = node.find("rotation");
+		if (r != nullptr && r->array.size() == 4) {
+			rotation = glm::quat(static_cast<float>(r->array[3].number), static_cast<float>(r->array[0].number),
+				static_cast<float>(r->array[1].number), static_cast<float>(r->array[2].number));
+		}
+		const JsonValue* s = node.find("scale");
+		if (s != nullptr && s->array.size() == 3) {
+			scale = glm::vec3(s->array[0].number, s->array[1].number, s->array[2].number);
+		}
+		return glm::translate(glm::mat4(1.0f), translation) * glm::mat4_cast(rotation) * glm::scale(glm::mat4(1.0f), scale);
+	}
+
+	struct GlbPrimitive {
+		const JsonValue* primitive;
+		glm::mat4 transform;
+		uint32_t vertexBase;
+		uint32_t vertexCount;
+		uint32_t indexBase;
+		uint32_t indexCount;
+	};
+
+	static void collectGlbPrimitives(const JsonValue& json, uint32_t nodeIndex, const glm::mat4& parent, uint32_t depth, std::vector<GlbPrimitive>& out) {
+		//Node graphs are meant to be trees, this stops a broken one looping forever
+		if (depth > 64) {
+			throw std::runtime_error("node hierarchy is too deep!");
+		}
+		const JsonValue& node = json.find("nodes")->at(nodeIndex);
+		glm::mat4 transform = parent * getGlbNodeTransform(node);
+
+		if (node.find("mesh") != nullptr) {
+			const JsonValue* meshes = json.find("meshes");
+			if (meshes == nullptr) {
+				throw std::runtime_error("node refers to a mesh but there are none!");
+			}
+			const JsonValue* primitives = meshes->at(node.getIndex("mesh")).find("primitives");
+			if (primitives != nullptr) {
+				for (const JsonValue& primitive : primitives->array) {
+					//Only plain triangle lists, strips and fans are rare enough to skip
+					if (primitive.getNumber("mode", 4.0) != 4.0) {
+						continue;
+					}
+					out.push_back({ &primitive, transform, 0, 0, 0, 0 });
+				}
+			}
+		}
+
+		const JsonValue* children = node.find("children");
+		if (children != nullptr) {
+			for (const JsonValue& child : children->array) {
+				collectGlbPrimitives(json, static_cast<uint32_t>(child.number), transform, depth + 1, out);
+			}
+		}
+	}
+
+	MeshInfo MeshLoader::loadGlb(MappedFile& file, const Allocator& allocate) {
+		const unsigned char* data = file.getData();
+		uint64_t size = file.getSize();
+
+		uint32_t header[3];
+		if (size < sizeof(header)) {
+			throw std::runtime_error("file is too small to be a glb!");
+		}
+		std::memcpy(header, data, sizeof(header));
+		if (header[0] != GLB_MAGIC || header[1] != 2) {
+			throw std::runtime_error("not a version 2 glb file!");
+		}
+
+		//JSON has to come first, the binary chunk is optional
+		const char* jsonBegin = nullptr;
+		uint64_t jsonSize = 0;
+		const unsigned char* bin = nullptr;
+		uint64_t binSize = 0;
+		for (uint64_t offset = sizeof(header); offset + 8 <= size;) {
+			uint32_t chunkHeader[2];
+			std::memcpy(chunkHeader, data + offset, sizeof(chunkHeader));
+			uint64_t chunkSize = chunkHeader[0];
+			offset += 8;
+			if (chunkSize > size - offset) {
+				throw std::runtime_error("truncated glb chunk!");
+			}
+			if (chunkHeader[1] == GLB_CHUNK_JSON && jsonBegin == nullptr) {
+				jsonBegin = reinterpret_cast<const char*>(data + offset);
+				jsonSize = chunkSize;
+			}
+			else if (chunkHeader[1] == GLB_CHUNK_BIN && bin == nullptr) {
+				bin = data + offset;
+				binSize = chunkSize;
+			}
+			offset += (chunkSize + 3) & ~3ull;
+		}
+		if (jsonBegin == nullptr) {
+			throw std::runtime_error("glb has no JSON chunk!");
+		}
+
+		JsonValue json = JsonParser(jsonBegin, jsonBegin + jsonSize).parse();
+
+		//Walk the default scene so node transforms get baked in. Files without
+		//scenes just get every mesh as is
+		std::vector<GlbPrimitive> primitives;
+		const JsonValue* scenes = json.find("scenes");
+		if (scenes != nullptr && !scenes->array.empty() && json.find("nodes") != nullptr) {
+			const JsonValue* roots = scenes->at(static_cast<uint32_t>(json.getNumber("scene", 0.0))).find("nodes");
+			if (roots != nullptr) {
+				for (const JsonValue& root : roots->array) {
+					collectGlbPrimitives(json, static_cast<uint32_t>(root.number), glm::mat4(1.0f), 0, primitives);
+				}
+			}
+		}
+		else if (json.find("meshes") != nullptr) {
+			for (const JsonValue& mesh : json.find("meshes")->array) {
+				const JsonValue* meshPrimitives = mesh.find("primitives");
+				if (meshPrimitives == nullptr) {
+					continue;
+				}
+				for (const JsonValue& primitive : meshPrimitives->array) {
+					if (primitive.getNumber("mode", 4.0) == 4.0) {
+						primitives.push_back({ &primitive, glm::mat4(1.0f), 0, 0, 0, 0 });
+					}
+				}
+			}
+		}
+
+		uint64_t vertexTotal = 0;
+		uint64_t indexTotal = 0;
+		for (GlbPrimitive& primitive : primitives) {
+			const JsonValue* attributes = primitive.primitive->find("attributes");
+			if (attributes == nullptr) {
+				throw std::runtime_error("primitive has no attributes!");
+			}
+			primitive.vertexCount = getGlbAccessor(json, attributes->getIndex("POSITION"), bin, binSize).count;
+			primitive.indexCount = primitive.primitive->find("indices") != nullptr ?
+				getGlbAccessor(json, primitive.primitive->getIndex("indices"), bin, binSize).count : primitive.vertexCount;
+			//Drop any trailing partial triangle
+			primitive.indexCount -= primitive.indexCount % 3;
+			primitive.vertexBase = static_cast<uint32_t>(vertexTotal);
+			primitive.indexBase = static_cast<uint32_t>(indexTotal);
+			vertexTotal += primitive.vertexCount;
+			indexTotal += primitive.indexCount;
+			if (vertexTotal > std::numeric_limits<uint32_t>::max() || indexTotal > std::numeric_limits<uint32_t>::max()) {
+				throw std::runtime_error("mesh is too big for 32 bit indices!");
+			}
+		}
+		if (indexTotal == 0) {
+			throw std::runtime_error("mesh has no triangles!");
+		}
+
+		MeshInfo info;
+		info.vertexCount = static_cast<uint32_t>(vertexTotal);
+		info.indexCount = static_cast<uint32_t>(indexTotal);
+		info.boundsMin = glm::vec3(std::numeric_limits<float>::max());
+		info.boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+		Vertex* outVertices = nullptr;
+		uint32_t* outIndices = nullptr;
+		allocate(info.vertexCount, info.indexCount, outVertices, outIndices);
+
+		std::mutex boundsMutex;
+		std::atomic<bool> badIndex(false);
+		for (const GlbPrimitive& primitive : primitives) {
+			const JsonValue& attributes = *primitive.primitive->find("attributes");
+			GlbAccessor positions = getGlbAccessor(json, attributes.getIndex("POSITION"), bin, binSize);
+			GlbAccessor normals, texCoords, colors, indices;
+			bool hasNormals = attributes.find("NORMAL") != nullptr;
+			bool hasTexCoords = attributes.find("TEXCOORD_0") != nullptr;
+			bool hasColors = attributes.find("COLOR_0") != nullptr;
+			bool hasIndices = primitive.primitive->find("indices") != nullptr;
+			if (hasNormals) {
+				normals = getGlbAccessor(json, attributes.getIndex("NORMAL"), bin, binSize);
+			}
+			if (hasTexCoords) {
+				texCoords = getGlbAccessor(json, attributes.getIndex("TEXCOORD_0"), bin, binSize);
+			}
+			if (hasColors) {
+				colors = getGlbAccessor(json, attributes.getIndex("COLOR_0"), bin, binSize);
+			}
+			if (hasIndices) {
+				indices = getGlbAccessor(json, primitive.primitive->getIndex("indices"), bin, binSize);
+			}
+			//Every attribute is read up to the component the vertex needs, so a narrower
+			//accessor would run past its element
+			if ((hasNormals && (normals.count < primitive.vertexCount || normals.componentCount < 3)) ||
+				(hasTexCoords && (texCoords.count < primitive.vertexCount || texCoords.componentCount < 2)) ||
+				(hasColors && (colors.count < primitive.vertexCount || colors.componentCount < 3)) || positions.componentCount < 3) {
+				throw std::runtime_error("primitive attributes don't match!");
+			}
+
+			glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(primitive.transform)));
+			//Mirroring transforms turn the winding inside out
+			glm::mat3 linear(primitive.transform);
+			bool flipWinding = glm::dot(glm::cross(linear[0], linear[1]), linear[2]) < 0.0f;
+
+			auto readIndex = [&](uint32_t i) {
+				return hasIndices ? indices.getIndex(i) : i;
+			};
+
+			//Same area weighted smoothing as OBJ, done in object space
+			std::vector<glm::vec3> generatedNormals;
+			if (!hasNormals) {
+				generatedNormals.resize(primitive.vertexCount, glm::vec3(0.0f));
+				for (uint32_t i = 0; i < primitive.indexCount; i += 3) {
+					uint32_t a = readIndex(i);
+					uint32_t b = readIndex(i + 1);
+					uint32_t c = readIndex(i + 2);
+					if (a >= primitive.vertexCount || b >= primitive.vertexCount || c >= primitive.vertexCount) {
+						continue;
+					}
+					glm::vec3 pa(positions.get(a, 0), positions.get(a, 1), positions.get(a, 2));
+					glm::vec3 pb(positions.get(b, 0), positions.get(b, 1), positions.get(b, 2));
+					glm::vec3 pc(positions.get(c, 0), positions.get(c, 1), positions.get(c, 2));
+					glm::vec3 faceNormal = glm::cross(pb - pa, pc - pa);
+					generatedNormals[a] += faceNormal;
+					generatedNormals[b] += faceNormal;
+					generatedNormals[c] += faceNormal;
+				}
+			}
+
+			threadPool->parallelFor(primitive.vertexCount, GLB_BATCH_SIZE, [&](uint32_t begin, uint32_t end) {
+				glm::vec3 boundsMin(std::numeric_limits<float>::max());
+				glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+				for (uint32_t i = begin; i < end; i++) {
+					Vertex vertex;
+					glm::vec4 position = primitive.transform * glm::vec4(positions.get(i, 0), positions.get(i, 1), positions.get(i, 2), 1.0f);
+					vertex.pos = glm::vec3(position.x, position.y, position.z);
+
+					glm::vec3 normal = hasNormals ? glm::vec3(normals.get(i, 0), normals.get(i, 1), normals.get(i, 2)) : generatedNormals[i];
+					normal = normalMatrix * normal;
+					float length = glm::length(normal);
+					vertex.normal = length > 0.0f ? normal / length : glm::vec3(0.0f, 0.0f, 1.0f);
+
+					vertex.texCoord = hasTexCoords ? glm::vec2(texCoords.get(i, 0), texCoords.get(i, 1)) : glm::vec2(0.0f);
+					vertex.color = hasColors ? glm::vec3(colors.get(i, 0), colors.get(i, 1), colors.get(i, 2)) : glm::vec3(1.0f);
+
+					outVertices[primitive.vertexBase + i] = vertex;
+					boundsMin = glm::min(boundsMin, vertex.pos);
+					boundsMax = glm::max(boundsMax, vertex.pos);
+				}
+				std::lock_guard<std::mutex> lock(boundsMutex);
+				info.boundsMin = glm::min(info.boundsMin, boundsMin);
+				info.boundsMax = glm::max(info.boundsMax, boundsMax);
+			});
+
+			uint32_t triangleCount = primitive.indexCount / 3;
+			threadPool->parallelFor(triangleCount, GLB_BATCH_SIZE, [&](uint32_t begin, uint32_t end) {
+				for (uint32_t t = begin; t < end; t++) {
+					uint32_t triangle[3] = { readIndex(t * 3), readIndex(t * 3 + 1), readIndex(t * 3 + 2) };
+					if (triangle[0] >= primitive.vertexCount || triangle[1] >= primitive.vertexCount || triangle[2] >= primitive.vertexCount) {
+						badIndex = true;
+						return;
+					}
+					if (flipWinding) {
+						std::swap(triangle[1], triangle[2]);
+					}
+					uint32_t* out = outIndices + primitive.indexBase + t * 3;
+					out[0] = primitive.vertexBase + triangle[0];
+					out[1] = primitive.vertexBase + triangle[1];
+					out[2] = primitive.vertexBase + triangle[2];
+				}
+			});
+			if (badIndex) {
+				throw std::runtime_error("primitive index is out of range!");
+			}
+		}
+
+		return info;
+	}
+}
@@ -0,0 +1,74 @@
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#ifndef __MESH_LOADER_H__
+#define __MESH_LOADER_H__
+
+#include <string>
+#include <vector>
+#include <functional>
+#include "Vertex.h"
+#include "ThreadPool.h"
+#include "MappedFile.h"
+
+namespace vkn {
+
+	//Sizes and object space bounds of a loaded mesh
+	struct MeshInfo {
+		uint32_t vertexCount = 0;
+		uint32_t indexCount = 0;
+		glm::vec3 boundsMin = glm::vec3(0.0f);
+		glm::vec3 boundsMax = glm::vec3(0.0f);
+	};
+
+	//Most levels of detail a mesh can carry, full detail included
+	const uint32_t MAX_MESH_LODS = 8;
+
+	//One level of detail inside a mesh's index data. Every level indexes the same vertices
+	struct MeshLod {
+		uint32_t firstIndex = 0;
+		uint32_t indexCount = 0;
+		//Object space distance the simplified surface may be off by, 0 at full detail
+		float error = 0.0f;
+	};
+
+	//CPU side copy of a mesh, for when the data isn't going straight to the GPU
+	struct MeshData {
+		MeshInfo info;
+		std::vector<Vertex> vertices;
+		//Every level back to back, coarser ones after. info.indexCount covers them all
+		std::vector<uint32_t> indices;
+		//Empty until MeshSimplifier::generateLods, the indices are then a single full detail level
+		std::vector<MeshLod> lods;
+	};
+
+	//Loads triangle meshes from Wavefront OBJ and binary glTF (.glb) files.
+	//Files are memory mapped and parsed in chunks across the thread pool, and
+	//the final vertices and indices are written exactly once, straight into
+	//wherever the allocator says (normally a mapped staging buffer).
+	class MeshLoader {
+	public:
+		//Called once the final counts are known, from the thread that called load().
+		//Has to point vertices and indices at enough memory for vertexCount and indexCount.
+		using Allocator = std::function<void(uint32_t vertexCount, uint32_t indexCount, Vertex*& vertices, uint32_t*& indices)>;
+
+		MeshLoader() {}
+		MeshLoader(ThreadPool* threadPool);
+
+		//True for the file types load() understands
+		static bool isSupported(const std::string& path);
+
+		//Blocks until the mesh is loaded, helping out on the pool while it waits.
+		//Throws if the file can't be read or is malformed.
+		MeshInfo load(const std::string& path, const Allocator& allocate);
+		MeshData* load(const std::string& path);
+
+	private:
+		MeshInfo loadObj(MappedFile& file, const Allocator& allocate);
+		MeshInfo loadGlb(MappedFile& file, const Allocator& allocate);
+
+		ThreadPool* threadPool = nullptr;
+	};
+}
+
+#endif
@@ -0,0 +1,289 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <numeric>
+#include <cstring>
+
+namespace vkn {
+
+	void MeshOptimizer::optimize(MeshData& mesh, VertexCacheStats* before, VertexCacheStats* after) {
+		if (before != nullptr) {
+			*before = analyzeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+		}
+
+		optimizeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+		optimizeOverdraw(mesh.indices.data(), mesh.indices.size(), mesh.vertices.data(), mesh.vertices.size());
+		uint32_t vertexCount = optimizeVertexFetch(mesh.vertices.data(), mesh.vertices.size(), mesh.indices.data(), mesh.indices.size());
+		mesh.vertices.resize(vertexCount);
+		mesh.info.vertexCount = vertexCount;
+
+		if (after != nullptr) {
+			*after = analyzeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+		}
+	}
+
+	void MeshOptimizer::optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize) {
+		size_t triangleCount = indexCount / 3;
+		if (triangleCount == 0 || vertexCount == 0) {
+			return;
+		}
+
+		//Vertex to triangle adjacency, flattened. liveCount is how many of a
+		//vertex's triangles haven't been emitted yet
+		std::vector<uint32_t> liveCount(vertexCount, 0);
+		for (size_t i = 0; i < triangleCount * 3; i++) {
+			liveCount[indices[i]]++;
+		}
+		std::vector<uint32_t> adjacencyOffset(vertexCount + 1, 0);
+		for (size_t v = 0; v < vertexCount; v++) {
+			adjacencyOffset[v + 1] = adjacencyOffset[v] + liveCount[v];
+		}
+		std::vector<uint32_t> adjacency(triangleCount * 3);
+		std::vector<uint32_t> cursor(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+		for (size_t i = 0; i < triangleCount * 3; i++) {
+			adjacency[cursor[indices[i]]++] = static_cast<uint32_t>(i / 3);
+		}
+
+		std::vector<uint32_t> cacheTime(vertexCount, 0);
+		std::vector<uint8_t> emitted(triangleCount, 0);
+		std::vector<uint32_t> deadEnd;
+		deadEnd.reserve(triangleCount * 3);
+		std::vector<uint32_t> candidates;
+		std::vector<uint32_t> output;
+		output.reserve(triangleCount * 3);
+
+		//Timestamps start far enough ahead that every vertex begins outside the cache
+		uint32_t time = cacheSize + 1;
+		size_t nextUnvisited = 0;
+		int64_t fanning = 0;
+		while (fanning >= 0) {
+			//Emit every remaining triangle around the fanning vertex
+			candidates.clear();
+			uint32_t f = static_cast<uint32_t>(fanning);
+			for (uint32_t k = adjacencyOffset[f]; k < adjacencyOffset[f + 1]; k++) {
+				uint32_t t = adjacency[k];
+				if (emitted[t]) {
+					continue;
+				}
+				for (uint32_t c = 0; c < 3; c++) {
+					uint32_t v = indices[t * 3 + c];
+					output.push_back(v);
+					deadEnd.push_back(v);
+					candidates.push_back(v);
+					liveCount[v]--;
+					if (time - cacheTime[v] > cacheSize) {
+						cacheTime[v] = time++;
+					}
+				}
+				emitted[t] = 1;
+			}
+
+			//Next fan from the candidate that will still be in the cache once all
+			//of its triangles are done, preferring the oldest
+			fanning = -1;
+			uint32_t bestPriority = 0;
+			for (uint32_t v : candidates) {
+				if (liveCount[v] == 0) {
+					continue;
+				}
+				uint32_t priority = 0;
+				if (time - cacheTime[v] + 2 * liveCount[v] <= cacheSize) {
+					priority = time - cacheTime[v];
+				}
+				if (priority > bestPriority) {
+					bestPriority = priority;
+					fanning = v;
+				}
+			}
+
+			//Dead end. Try recently used vertices, then walk the input in order
+			if (fanning < 0) {
+				while (!deadEnd.empty() && fanning < 0) {
+					uint32_t v = deadEnd.back();
+					deadEnd.pop_back();
+					if (liveCount[v] > 0) {
+						fanning = v;
+					}
+				}
+				while (fanning < 0 && nextUnvisited < vertexCount) {
+					if (liveCount[nextUnvisited] > 0) {
+						fanning = static_cast<int64_t>(nextUnvisited);
+					}
+					else {
+						nextUnvisited++;
+					}
+				}
+			}
+		}
+
+		std::memcpy(indices, output.data(), output.size() * sizeof(uint32_t));
+	}
+
+	void MeshOptimizer::optimizeOverdraw(uint32_t* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount, float threshold, uint32_t cacheSize) {
+		size_t triangleCount = indexCount / 3;
+		if (triangleCount == 0 || vertexCount == 0) {
+			return;
+		}
+
+		std::vector<uint32_t> cacheTime(vertexCount, 0);
+		uint32_t time = cacheSize + 1;
+		auto countMisses = [&](size_t t) {
+			uint32_t misses = 0;
+			for (uint32_t c = 0; c < 3; c++) {
+				uint32_t v = indices[t * 3 + c];
+				if (time - cacheTime[v] > cacheSize) {
+					cacheTime[v] = time++;
+					misses++;
+				}
+			}
+			return misses;
+		};
+
+		//Hard boundaries are where a triangle misses on all three vertices, the
+		//cache has nothing to lose by a jump there
+		std::vector<size_t> hardStarts;
+		uint32_t totalMisses = 0;
+		for (size_t t = 0; t < triangleCount; t++) {
+			uint32_t misses = countMisses(t);
+			if (t == 0 || misses == 3) {
+				hardStarts.push_back(t);
+			}
+			totalMisses += misses;
+		}
+		hardStarts.push_back(triangleCount);
+
+		//Soft boundaries split the hard clusters further, wherever the cluster so
+		//far is already within threshold of the overall ACMR. Every cluster starts
+		//with a cold cache since it could end up after any other one
+		float targetAcmr = static_cast<float>(totalMisses) / triangleCount * threshold;
+		std::vector<size_t> clusterStarts;
+		for (size_t h = 0; h + 1 < hardStarts.size(); h++) {
+			size_t start = hardStarts[h];
+			size_t end = hardStarts[h + 1];
+			clusterStarts.push_back(start);
+			time += cacheSize + 1;
+			uint32_t misses = 0;
+			for (size_t t = start; t < end; t++) {
+				misses += countMisses(t);
+				size_t count = t - clusterStarts.back() + 1;
+				if (t + 1 < end && static_cast<float>(misses) <= targetAcmr * count) {
+					clusterStarts.push_back(t + 1);
+					time += cacheSize + 1;
+					misses = 0;
+				}
+			}
+		}
+		clusterStarts.push_back(triangleCount);
+		size_t clusterCount = clusterStarts.size() - 1;
+
+		//Area weighted centroids and normals, per cluster and for the whole mesh
+		std::vector<glm::vec3> clusterCentroid(clusterCount, glm::vec3(0.0f));
+		std::vector<glm::vec3> clusterNormal(clusterCount, glm::vec3(0.0f));
+		std::vector<float> clusterArea(clusterCount, 0.0f);
+		glm::vec3 meshCentroid(0.0f);
+		float meshArea = 0.0f;
+		for (size_t c = 0; c < clusterCount; c++) {
+			for (size_t t = clusterStarts[c]; t < clusterStarts[c + 1]; t++) {
+				const glm::vec3& a = vertices[indices[t * 3]].pos;
+				const glm::vec3& b = vertices[indices[t * 3 + 1]].pos;
+				const glm::vec3& d = vertices[indices[t * 3 + 2]].pos;
+				glm::vec3 normal = glm::cross(b - a, d - a);
+				float area = glm::length(normal);
+				glm::vec3 centroid = (a + b + d) * (area / 3.0f);
+				clusterNormal[c] += normal;
+				clusterCentroid[c] += centroid;
+				clusterArea[c] += area;
+				meshCentroid += centroid;
+				meshArea += area;
+			}
+		}
+		if (meshArea > 0.0f) {
+			meshCentroid /= meshArea;
+		}
+
+		//Clusters far out along their own normal are likely to occlude the rest
+		std::vector<float> score(clusterCount, 0.0f);
+		for (size_t c = 0; c < clusterCount; c++) {
+			float length = glm::length(clusterNormal[c]);
+			if (clusterArea[c] > 0.0f && length > 0.0f) {
+				glm::vec3 centroid = clusterCentroid[c] / clusterArea[c];
+				score[c] = glm::dot(centroid - meshCentroid, clusterNormal[c] / length);
+			}
+		}
+		std::vector<uint32_t> order(clusterCount);
+		std::iota(order.begin(), order.end(), 0);
+		std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return score[a] > score[b]; });
+
+		std::vector<uint32_t> output;
+		output.reserve(triangleCount * 3);
+		for (uint32_t c : order) {
+			output.insert(output.end(), indices + clusterStarts[c] * 3, indices + clusterStarts[c + 1] * 3);
+		}
+		std::memcpy(indices, output.data(), output.size() * sizeof(uint32_t));
+	}
+
+	uint32_t MeshOptimizer::optimizeVertexFetch(Vertex* vertices, size_t vertexCount, uint32_t* indices, size_t indexCount) {
+		const uint32_t unused = ~0u;
+		std::vector<uint32_t> remap(vertexCount, unused);
+		uint32_t next = 0;
+		for (size_t i = 0; i < indexCount; i++) {
+			uint32_t& target = remap[indices[i]];
+			if (target == unused) {
+				target = next++;
+			}
+			indices[i] = target;
+		}
+
+		std::vector<Vertex> reordered(next);
+		for (size_t v = 0; v < vertexCount; v++) {
+			if (remap[v] != unused) {
+				reordered[remap[v]] = vertices[v];
+			}
+		}
+		std::copy(reordered.begin(), reordered.end(), vertices);
+		return next;
+	}
+
+	VertexCacheStats MeshOptimizer::analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize) {
+		std::vector<uint32_t> cacheTime(vertexCount, 0);
+		std::vector<uint8_t> referenced(vertexCount, 0);
+		uint32_t time = cacheSize + 1;
+		size_t misses = 0;
+		size_t uniqueVertices = 0;
+		for (size_t i = 0; i < indexCount; i++) {
+			uint32_t v = indices[i];
+			if (!referenced[v]) {
+				referenced[v] = 1;
+				uniqueVertices++;
+			}
+			if (time - cacheTime[v] > cacheSize) {
+				cacheTime[v] = time++;
+				misses++;
+			}
+		}
+
+		VertexCacheStats stats;
+		size_t triangleCount = indexCount / 3;
+		stats.acmr = triangleCount > 0 ? static_cast<float>(misses) / triangleCount : 0.0f;
+		stats.atvr = uniqueVertices > 0 ? static_cast<float>(misses) / uniqueVertices : 0.0f;
+		return stats;
+	}
+
+	VkIndexType MeshOptimizer::selectIndexType(size_t vertexCount) {
+		return vertexCount <= 0xFFFF ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+	}
+
+	uint32_t MeshOptimizer::getIndexSize(VkIndexType indexType) {
+		return indexType == VK_INDEX_TYPE_UINT16 ? 2 : 4;
+	}
+
+	void MeshOptimizer::writeIndices(const uint32_t* indices, size_t indexCount, VkIndexType indexType, void* out) {
+		if (indexType == VK_INDEX_TYPE_UINT32) {
+			std::memcpy(out, indices, indexCount * sizeof(uint32_t));
+			return;
+		}
+		uint16_t* out16 = static_cast<uint16_t*>(out);
+		for (size_t i = 0; i < indexCount; i++) {
+			out16[i] = static_cast<uint16_t>(indices[i]);
+		}
+	}
+}
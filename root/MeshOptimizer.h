@@ -0,0 +1,58 @@
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#ifndef __MESH_OPTIMIZER_H__
+#define __MESH_OPTIMIZER_H__
+
+#include <vector>
+#include "Vertex.h"
+#include "MeshLoader.h"
+
+namespace vkn {
+
+	//Post-transform cache efficiency of an index buffer, measured on a simulated FIFO cache
+	struct VertexCacheStats {
+		//Average cache misses per triangle. 0.5 is the ideal for a big regular grid, 3 the worst
+		float acmr = 0.0f;
+		//Average transforms per vertex actually referenced. 1 is ideal
+		float atvr = 0.0f;
+	};
+
+	//Reorders mesh data so the GPU does less work drawing it. Nothing here changes
+	//what gets drawn, only the order triangles and vertices come in.
+	//Everything is static and touches no Vulkan objects, so it is safe on worker threads.
+	//
+	//The usual order is optimizeVertexCache, optimizeOverdraw, then optimizeVertexFetch,
+	//which is what optimize() does.
+	class MeshOptimizer {
+	public:
+		//Most GPUs reuse somewhere between 16 and 32 transformed vertices. Aiming
+		//low costs very little on the bigger ones.
+		static const uint32_t DEFAULT_CACHE_SIZE = 16;
+
+		//Runs the whole pipeline on a loaded mesh, dropping unreferenced vertices.
+		//before and after get the cache stats either side, if given
+		static void optimize(MeshData& mesh, VertexCacheStats* before = nullptr, VertexCacheStats* after = nullptr);
+
+		//Tipsify (Sander et al. 2007). Linear time triangle reordering for the vertex cache
+		static void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize = DEFAULT_CACHE_SIZE);
+		//Splits cache optimised triangles into clusters and draws the outward facing,
+		//outermost ones first so they occlude the rest. Clusters are only split where
+		//ACMR stays within threshold of what it was.
+		static void optimizeOverdraw(uint32_t* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount,
+			float threshold = 1.05f, uint32_t cacheSize = DEFAULT_CACHE_SIZE);
+		//Renumbers vertices in the order they are first used so fetches walk memory
+		//forwards. Returns the new vertex count, unreferenced vertices are dropped.
+		static uint32_t optimizeVertexFetch(Vertex* vertices, size_t vertexCount, uint32_t* indices, size_t indexCount);
+
+		static VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize = DEFAULT_CACHE_SIZE);
+
+		//16 bit whenever every vertex fits, keeping 0xFFFF free for primitive restart
+		static VkIndexType selectIndexType(size_t vertexCount);
+		static uint32_t getIndexSize(VkIndexType indexType);
+		//Writes indices as indexType, out needs indexCount * getIndexSize(indexType) bytes
+		static void writeIndices(const uint32_t* indices, size_t indexCount, VkIndexType indexType, void* out);
+	};
+}
+
+#endif
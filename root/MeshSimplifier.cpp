@@ -0,0 +1,316 @@
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace vkn {
+
+	//Sum of squared distances to a set of planes, weighted by triangle area.
+	//Kept in doubles, big flat meshes lose too much in floats
+	struct Quadric {
+		double a2 = 0.0, ab = 0.0, ac = 0.0, ad = 0.0;
+		double b2 = 0.0, bc = 0.0, bd = 0.0;
+		double c2 = 0.0, cd = 0.0;
+		double d2 = 0.0;
+		double weight = 0.0;
+	};
+
+	static void addPlane(Quadric& q, const glm::dvec3& n, double d, double weight) {
+		q.a2 += weight * n.x * n.x; q.ab += weight * n.x * n.y; q.ac += weight * n.x * n.z; q.ad += weight * n.x * d;
+		q.b2 += weight * n.y * n.y; q.bc += weight * n.y * n.z; q.bd += weight * n.y * d;
+		q.c2 += weight * n.z * n.z; q.cd += weight * n.z * d;
+		q.d2 += weight * d * d;
+		q.weight += weight;
+	}
+
+	static void addQuadric(Quadric& q, const Quadric& other) {
+		q.a2 += other.a2; q.ab += other.ab; q.ac += other.ac; q.ad += other.ad;
+		q.b2 += other.b2; q.bc += other.bc; q.bd += other.bd;
+		q.c2 += other.c2; q.cd += other.cd;
+		q.d2 += other.d2;
+		q.weight += other.weight;
+	}
+
+	//Mean squared distance from p to the planes
+	static double evaluate(const Quadric& a, const Quadric& b, const glm::vec3& p) {
+		double x = p.x, y = p.y, z = p.z;
+		double a2 = a.a2 + b.a2, ab = a.ab + b.ab, ac = a.ac + b.ac, ad = a.ad + b.ad;
+		double b2 = a.b2 + b.b2, bc = a.bc + b.bc, bd = a.bd + b.bd;
+		double c2 = a.c2 + b.c2, cd = a.cd + b.cd;
+		double d2 = a.d2 + b.d2;
+		double weight = a.weight + b.weight;
+		double error = a2 * x * x + 2.0 * ab * x * y + 2.0 * ac * x * z + 2.0 * ad * x
+			+ b2 * y * y + 2.0 * bc * y * z + 2.0 * bd * y
+			+ c2 * z * z + 2.0 * cd * z
+			+ d2;
+		return weight > 0.0 ? std::max(error, 0.0) / weight : 0.0;
+	}
+
+	//Maps every vertex to the first one sharing its position, seams split vertices
+	//that are really the same point on the surface
+	static std::vector<uint32_t> buildPositionRemap(const Vertex* vertices, size_t vertexCount) {
+		std::vector<uint32_t> order(vertexCount);
+		for (size_t i = 0; i < vertexCount; i++) {
+			order[i] = static_cast<uint32_t>(i);
+		}
+		std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+			const glm::vec3& pa = vertices[a].pos;
+			const glm::vec3& pb = vertices[b].pos;
+			if (pa.x != pb.x) return pa.x < pb.x;
+			if (pa.y != pb.y) return pa.y < pb.y;
+			if (pa.z != pb.z) return pa.z < pb.z;
+			return a < b;
+		});
+
+		std::vector<uint32_t> remap(vertexCount);
+		for (size_t i = 0; i < vertexCount; i++) {
+			bool same = i > 0 && vertices[order[i]].pos == vertices[order[i - 1]].pos;
+			remap[order[i]] = same ? remap[order[i - 1]] : order[i];
+		}
+		return remap;
+	}
+
+	float MeshSimplifier::simplify(const uint32_t* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount,
+		size_t targetIndexCount, float targetError, std::vector<uint32_t>& out) {
+		out.assign(indices, indices + indexCount - indexCount % 3);
+		if (out.empty() || vertexCount == 0 || targetIndexCount >= out.size()) {
+			return 0.0f;
+		}
+
+		std::vector<uint32_t> remap = buildPositionRemap(vertices, vertexCount);
+
+		//Seams: more than one vertex on the same position
+		std::vector<uint8_t> locked(vertexCount, 0);
+		std::vector<uint32_t> wedgeCount(vertexCount, 0);
+		for (size_t v = 0; v < vertexCount; v++) {
+			wedgeCount[remap[v]]++;
+		}
+		for (size_t v = 0; v < vertexCount; v++) {
+			if (wedgeCount[remap[v]] > 1) {
+				locked[remap[v]] = 1;
+			}
+		}
+
+		//Borders and non manifold edges: anything not shared by exactly two triangles
+		std::vector<uint64_t> edges;
+		edges.reserve(out.size());
+		for (size_t i = 0; i < out.size(); i += 3) {
+			for (int e = 0; e < 3; e++) {
+				uint32_t a = remap[out[i + e]];
+				uint32_t b = remap[out[i + (e + 1) % 3]];
+				if (a == b) {
+					continue;
+				}
+				edges.push_back((uint64_t(std::min(a, b)) << 32) | std::max(a, b));
+			}
+		}
+		std::sort(edges.begin(), edges.end());
+		for (size_t i = 0; i < edges.size();) {
+			size_t run = i + 1;
+			while (run < edges.size() && edges[run] == edges[i]) {
+				run++;
+			}
+			if (run - i != 2) {
+				locked[edges[i] >> 32] = 1;
+				locked[edges[i] & 0xFFFFFFFFu] = 1;
+			}
+			i = run;
+		}
+		//Flags were set on the shared position, spread them to every vertex on it
+		for (size_t v = 0; v < vertexCount; v++) {
+			locked[v] = locked[remap[v]];
+		}
+
+		//Every triangle's plane goes to its three corners
+		std::vector<Quadric> quadrics(vertexCount);
+		for (size_t i = 0; i < out.size(); i += 3) {
+			glm::dvec3 p0 = glm::dvec3(vertices[out[i]].pos);
+			glm::dvec3 p1 = glm::dvec3(vertices[out[i + 1]].pos);
+			glm::dvec3 p2 = glm::dvec3(vertices[out[i + 2]].pos);
+			glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+			double length = glm::length(normal);
+			if (length == 0.0) {
+				continue;
+			}
+			normal /= length;
+			double area = length * 0.5;
+			double d = -glm::dot(normal, p0);
+			for (int c = 0; c < 3; c++) {
+				addPlane(quadrics[remap[out[i + c]]], normal, d, area);
+			}
+		}
+
+		struct Collapse {
+			uint32_t from;
+			uint32_t to;
+			double error;
+		};
+
+		double maxError = 0.0;
+		double errorLimit = double(targetError) * double(targetError);
+		size_t targetTriangles = targetIndexCount / 3;
+		std::vector<uint32_t> adjacencyOffset;
+		std::vector<uint32_t> adjacency;
+		std::vector<double> bestError;
+		std::vector<uint32_t> bestTarget;
+		std::vector<uint32_t> collapseTarget(vertexCount);
+		std::vector<uint8_t> touched;
+		std::vector<Collapse> collapses;
+
+		//Each pass collapses as many edges as it can without two of them touching
+		//the same triangles, then rebuilds. A few dozen passes at most
+		while (out.size() / 3 > targetTriangles) {
+			size_t triangleCount = out.size() / 3;
+
+			//Vertex to triangle adjacency, flattened
+			adjacencyOffset.assign(vertexCount + 1, 0);
+			for (uint32_t index : out) {
+				adjacencyOffset[index + 1]++;
+			}
+			for (size_t v = 0; v < vertexCount; v++) {
+				adjacencyOffset[v + 1] += adjacencyOffset[v];
+			}
+			adjacency.resize(out.size());
+			std::vector<uint32_t> cursor(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+			for (size_t i = 0; i < out.size(); i++) {
+				adjacency[cursor[out[i]]++] = static_cast<uint32_t>(i / 3);
+			}
+
+			//Cheapest way out for every vertex that's allowed to go
+			bestError.assign(vertexCount, DBL_MAX);
+			bestTarget.assign(vertexCount, ~0u);
+			for (size_t i = 0; i < out.size(); i += 3) {
+				for (int e = 0; e < 3; e++) {
+					uint32_t a = out[i + e];
+					for (int k = 1; k < 3; k++) {
+						uint32_t b = out[i + (e + k) % 3];
+						if (locked[a] || remap[a] == remap[b]) {
+							continue;
+						}
+						double error = evaluate(quadrics[remap[a]], quadrics[remap[b]], vertices[b].pos);
+						if (error < bestError[a]) {
+							bestError[a] = error;
+							bestTarget[a] = b;
+						}
+					}
+				}
+			}
+			collapses.clear();
+			for (size_t v = 0; v < vertexCount; v++) {
+				if (bestTarget[v] != ~0u) {
+					collapses.push_back({ static_cast<uint32_t>(v), bestTarget[v], bestError[v] });
+				}
+			}
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.error < b.error; });
+
+			for (size_t v = 0; v < vertexCount; v++) {
+				collapseTarget[v] = static_cast<uint32_t>(v);
+			}
+			touched.assign(vertexCount, 0);
+			size_t collapsed = 0;
+			for (const Collapse& collapse : collapses) {
+				if (collapse.error > errorLimit || triangleCount <= targetTriangles) {
+					break;
+				}
+				if (touched[collapse.from] || touched[collapse.to]) {
+					continue;
+				}
+
+				//Triangles around from that stay have to keep facing the same way.
+				//Zero area counts as flipped, it's what a collapse across a seam gives
+				const glm::vec3& target = vertices[collapse.to].pos;
+				bool flips = false;
+				uint32_t removed = 0;
+				for (uint32_t k = adjacencyOffset[collapse.from]; k < adjacencyOffset[collapse.from + 1] && !flips; k++) {
+					const uint32_t* triangle = &out[adjacency[k] * 3];
+					if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to) {
+						removed++;
+						continue;
+					}
+					glm::vec3 p[3];
+					glm::vec3 q[3];
+					for (int c = 0; c < 3; c++) {
+						p[c] = vertices[triangle[c]].pos;
+						q[c] = triangle[c] == collapse.from ? target : p[c];
+					}
+					glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+					glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+					flips = glm::dot(before, after) <= 0.0f;
+				}
+				if (flips) {
+					continue;
+				}
+
+				collapseTarget[collapse.from] = collapse.to;
+				addQuadric(quadrics[remap[collapse.to]], quadrics[remap[collapse.from]]);
+				maxError = std::max(maxError, collapse.error);
+				triangleCount -= removed;
+				collapsed++;
+
+				//Nothing else this pass may change a triangle this one changed
+				touched[collapse.from] = 1;
+				touched[collapse.to] = 1;
+				for (uint32_t k = adjacencyOffset[collapse.from]; k < adjacencyOffset[collapse.from + 1]; k++) {
+					const uint32_t* triangle = &out[adjacency[k] * 3];
+					touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = 1;
+				}
+			}
+			if (collapsed == 0) {
+				break;
+			}
+
+			//Apply and drop what collapsed to nothing
+			size_t write = 0;
+			for (size_t i = 0; i < out.size(); i += 3) {
+				uint32_t a = collapseTarget[out[i]];
+				uint32_t b = collapseTarget[out[i + 1]];
+				uint32_t c = collapseTarget[out[i + 2]];
+				if (a == b || b == c || a == c) {
+					continue;
+				}
+				out[write++] = a;
+				out[write++] = b;
+				out[write++] = c;
+			}
+			out.resize(write);
+		}
+		return static_cast<float>(std::sqrt(maxError));
+	}
+
+	void MeshSimplifier::generateLods(MeshData& mesh, uint32_t maxLods, float reduction) {
+		//Any previous levels get replaced
+		uint32_t baseCount = mesh.lods.empty() ? static_cast<uint32_t>(mesh.indices.size()) : mesh.lods[0].indexCount;
+		mesh.indices.resize(baseCount);
+		mesh.lods.clear();
+		MeshLod full;
+		full.indexCount = baseCount;
+		mesh.lods.push_back(full);
+
+		//Each level starts from the last, so their errors add up
+		std::vector<uint32_t> simplified;
+		maxLods = std::min(maxLods, MAX_MESH_LODS);
+		while (mesh.lods.size() < maxLods) {
+			MeshLod previous = mesh.lods.back();
+			size_t target = static_cast<size_t>(previous.indexCount / 3 * reduction) * 3;
+			if (target == 0) {
+				break;
+			}
+			float error = simplify(mesh.indices.data() + previous.firstIndex, previous.indexCount, mesh.vertices.data(), mesh.vertices.size(),
+				target, FLT_MAX, simplified);
+			//Locked seams and borders stop it short eventually
+			if (simplified.empty() || simplified.size() > previous.indexCount * MIN_LOD_REDUCTION) {
+				break;
+			}
+			MeshOptimizer::optimizeVertexCache(simplified.data(), simplified.size(), mesh.vertices.size());
+
+			MeshLod level;
+			level.firstIndex = static_cast<uint32_t>(mesh.indices.size());
+			level.indexCount = static_cast<uint32_t>(simplified.size());
+			level.error = previous.error + error;
+			mesh.indices.insert(mesh.indices.end(), simplified.begin(), simplified.end());
+			mesh.lods.push_back(level);
+		}
+		mesh.info.indexCount = static_cast<uint32_t>(mesh.indices.size());
+	}
+}
@@ -0,0 +1,39 @@
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#ifndef __MESH_SIMPLIFIER_H__
+#define __MESH_SIMPLIFIER_H__
+
+#include <vector>
+#include "Vertex.h"
+#include "MeshLoader.h"
+
+namespace vkn {
+
+	//Builds levels of detail by edge collapse with quadric error metrics (Garland
+	//and Heckbert 1997). Vertices are only ever collapsed onto a neighbour, never
+	//moved, so every level indexes the original vertex buffer and a mesh's LODs
+	//only cost index memory.
+	//
+	//Vertices on UV or normal seams and on open borders stay where they are, which
+	//keeps the silhouette and texture layout intact at the cost of some reduction.
+	//Like MeshOptimizer everything is static and safe on worker threads.
+	class MeshSimplifier {
+	public:
+		//A level that doesn't get below this fraction of the one before isn't kept
+		static constexpr float MIN_LOD_REDUCTION = 0.85f;
+
+		//Collapses edges until the index count is at most targetIndexCount or the
+		//next collapse would be off by more than targetError. Result goes into out,
+		//returns the error actually reached as an object space distance
+		static float simplify(const uint32_t* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount,
+			size_t targetIndexCount, float targetError, std::vector<uint32_t>& out);
+
+		//Appends up to maxLods - 1 coarser levels to mesh.indices, each with around
+		//reduction times the triangles of the one before, and fills in mesh.lods.
+		//Run after MeshOptimizer::optimize, every level gets its own vertex cache pass
+		static void generateLods(MeshData& mesh, uint32_t maxLods = MAX_MESH_LODS, float reduction = 0.5f);
+	};
+}
+
+#endif
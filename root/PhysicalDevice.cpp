@@ -1,5 +1,6 @@
 #include "PhysicalDevice.h"
 #include <set>
+#include <cstring>
 
 using namespace vkn;
 
@@ -26,6 +27,35 @@ PhysicalDevice::PhysicalDevice(VulkanInstance* vknInstance, VkSurfaceKHR surface
 	if (physicalDevice == VK_NULL_HANDLE) {
 		throw std::runtime_error("failed to find a suitable GPU!");
 	}
+
+	for (const char* extension : optionalExtensions) {
+		if (supportsExtension(physicalDevice, extension)) {
+			deviceExtensions.push_back(extension);
+		}
+	}
+}
+
+bool PhysicalDevice::supportsExtension(VkPhysicalDevice device, const char* extension) {
+	uint32_t extensionCount;
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+	std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+	for (const auto& available : availableExtensions) {
+		if (strcmp(available.extensionName, extension) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool PhysicalDevice::isExtensionEnabled(const char* extension) {
+	for (const char* enabled : deviceExtensions) {
+		if (strcmp(enabled, extension) == 0) {
+			return true;
+		}
+	}
+	return false;
 }
 
 QueueFamilyIndices PhysicalDevice::findQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR surface) {
@@ -104,6 +134,24 @@ SwapChainSupportDetails PhysicalDevice::querySwapChainSupport(VkSurfaceKHR surfa
 	return querySwapChainSupport(this->getPhysicalDevice(), surface);
 }
 
+VkFormat PhysicalDevice::findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features) {
+	for (VkFormat format : candidates) {
+		VkFormatProperties properties;
+		vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &properties);
+		VkFormatFeatureFlags supported = tiling == VK_IMAGE_TILING_LINEAR ? properties.linearTilingFeatures : properties.optimalTilingFeatures;
+		if ((supported & features) == features) {
+			return format;
+		}
+	}
+	throw std::runtime_error("failed to find supported format!");
+}
+
+VkFormat PhysicalDevice::findDepthFormat(VkFormatFeatureFlags extraFeatures) {
+	//Full float depth first, nothing here needs stencil
+	return findSupportedFormat({ VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT },
+		VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | extraFeatures);
+}
+
 
 //Picks the device with the support we want
 //This includes queue families and such.
@@ -31,18 +31,27 @@ namespace vkn {
 
 		VkPhysicalDevice getPhysicalDevice() { return physicalDevice; }
 		std::vector<const char*> getDeviceExtensions() { return deviceExtensions; }
+		//True if the extension was requested (required or optional) and the device has it
+		bool isExtensionEnabled(const char* extension);
 		QueueFamilyIndices findQueueFamilies(VkSurfaceKHR);
 		SwapChainSupportDetails querySwapChainSupport(VkSurfaceKHR);
+		//First candidate that supports every feature with the given tiling
+		VkFormat findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
+		//Best depth attachment format. Pass SAMPLED_IMAGE if the depth gets read back in a shader
+		VkFormat findDepthFormat(VkFormatFeatureFlags extraFeatures = 0);
 
 	private:
 		bool isDeviceSuitable(VkPhysicalDevice device, VkSurfaceKHR surface);
 		bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+		bool supportsExtension(VkPhysicalDevice device, const char* extension);
 		QueueFamilyIndices findQueueFamilies(VkPhysicalDevice, VkSurfaceKHR);
 		SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device, VkSurfaceKHR surface);
 
 		VkPhysicalDevice physicalDevice;
 		VulkanInstance* instance;
 		std::vector<const char*> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+		//Turned on when available, features that need them check isExtensionEnabled first
+		std::vector<const char*> optionalExtensions = {VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME};
 		SwapChainSupportDetails swapChainSupport;
 	};
 
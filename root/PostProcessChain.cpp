@@ -0,0 +1,183 @@
+#include "PostProcessChain.h"
+#include "DescriptorWriter.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace vkn {
+
+	//Invocations per group. Filters pay for a border around every tile, so they
+	//get the bigger groups
+	static const uint32_t FILTER_GROUP_INVOCATIONS = 256;
+	static const uint32_t POINT_GROUP_INVOCATIONS = 64;
+	//What the shader's tile keeps per texel
+	static const uint32_t TILE_TEXEL_SIZE = 16;
+
+	PostProcessChain::PostProcessChain(LogicalDevice* device, const std::vector<PostProcessStage>& stages) {
+		this->device = device;
+
+		//0 the stage's input, 1 its output
+		std::vector<VkDescriptorSetLayoutBinding> bindings(2);
+		for (uint32_t i = 0; i < 2; i++) {
+			bindings[i].binding = i;
+			bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			bindings[i].descriptorCount = 1;
+			bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		}
+		layout = device->getDescriptorLayoutCache()->getLayout(bindings);
+		descriptors = new DescriptorAllocator(device, { { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2.0f } }, 4);
+
+		//A filter starts a new dispatch if this one already has one, or has
+		//already tonemapped its output. Tonemaps fold into whichever side is free
+		Dispatch current;
+		bool empty = true;
+		for (PostProcessStage stage : stages) {
+			if (stage == PostProcessStage::Tonemap) {
+				bool free = current.filter == Filter::None ? !current.tonemapInput : !current.tonemapOutput;
+				if (!free) {
+					dispatches.push_back(current);
+					current = Dispatch();
+				}
+				if (current.filter == Filter::None) {
+					current.tonemapInput = true;
+				}
+				else {
+					current.tonemapOutput = true;
+				}
+			}
+			else {
+				if (current.filter != Filter::None || current.tonemapOutput) {
+					dispatches.push_back(current);
+					current = Dispatch();
+				}
+				current.filter = stage == PostProcessStage::Blur ? Filter::Blur : Filter::Sharpen;
+			}
+			empty = false;
+		}
+		if (!empty) {
+			dispatches.push_back(current);
+		}
+
+		//Subgroup size is 1.1, guess at the common one without it
+		uint32_t subgroupSize = 32;
+		if (device->getProperties().apiVersion >= VK_API_VERSION_1_1) {
+			VkPhysicalDeviceSubgroupProperties subgroupProperties{};
+			subgroupProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+			VkPhysicalDeviceProperties2 properties{};
+			properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+			properties.pNext = &subgroupProperties;
+			vkGetPhysicalDeviceProperties2(device->getPhysicalDevice()->getPhysicalDevice(), &properties);
+			subgroupSize = std::max(1u, subgroupProperties.subgroupSize);
+		}
+		for (Dispatch& dispatch : dispatches) {
+			chooseGroupSize(dispatch, subgroupSize);
+		}
+	}
+
+	PostProcessChain::~PostProcessChain() {
+		for (Dispatch& dispatch : dispatches) {
+			delete(dispatch.pipeline);
+		}
+		delete(descriptors);
+	}
+
+	//As square as possible, a whole number of subgroups, and within the device's
+	//limits on group size, invocations and shared memory
+	void PostProcessChain::chooseGroupSize(Dispatch& dispatch, uint32_t subgroupSize) {
+		const VkPhysicalDeviceLimits& limits = device->getProperties().limits;
+		uint32_t invocations = dispatch.filter != Filter::None ? FILTER_GROUP_INVOCATIONS : POINT_GROUP_INVOCATIONS;
+		invocations = std::max(invocations, subgroupSize);
+		invocations = std::min(invocations, limits.maxComputeWorkGroupInvocations);
+		if (invocations >= subgroupSize) {
+			invocations -= invocations % subgroupSize;
+		}
+
+		uint32_t groupWidth = 1;
+		while ((groupWidth * 2) * (groupWidth * 2) <= invocations) {
+			groupWidth *= 2;
+		}
+		groupWidth = std::min(groupWidth, limits.maxComputeWorkGroupSize[0]);
+		uint32_t groupHeight = std::min(std::max(1u, invocations / groupWidth), limits.maxComputeWorkGroupSize[1]);
+
+		//Only filters have a tile to fit
+		while (dispatch.filter != Filter::None && groupHeight > 1 &&
+			(groupWidth + 2) * (groupHeight + 2) * TILE_TEXEL_SIZE > limits.maxComputeSharedMemorySize) {
+			groupHeight /= 2;
+		}
+		dispatch.groupWidth = groupWidth;
+		dispatch.groupHeight = groupHeight;
+	}
+
+	void PostProcessChain::buildPipelines(std::function<void(ComputePipeline*)> setShader) {
+		VkPushConstantRange range{};
+		range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		range.offset = 0;
+		range.size = sizeof(PushConstants);
+
+		for (Dispatch& dispatch : dispatches) {
+			dispatch.pipeline = new ComputePipeline(device);
+			setShader(dispatch.pipeline);
+			dispatch.pipeline->setSpecializationConstant(0, dispatch.groupWidth);
+			dispatch.pipeline->setSpecializationConstant(1, dispatch.groupHeight);
+			dispatch.pipeline->setSpecializationConstant(2, dispatch.tonemapInput ? 1 : 0);
+			dispatch.pipeline->setSpecializationConstant(3, static_cast<uint32_t>(dispatch.filter));
+			dispatch.pipeline->setSpecializationConstant(4, dispatch.tonemapOutput ? 1 : 0);
+			dispatch.pipeline->buildPipeline({ layout }, { range });
+		}
+	}
+
+	GraphResource PostProcessChain::addPasses(RenderGraph* graph, GraphResource input, uint32_t width, uint32_t height, VkImageUsageFlags outputUsage) {
+		this->width = width;
+		this->height = height;
+
+		//Each dispatch only needs the one before's output, so the graph gets to
+		//alias every other image
+		for (uint32_t i = 0; i < dispatches.size(); i++) {
+			Dispatch& dispatch = dispatches[i];
+			GraphImageDesc desc{};
+			desc.width = width;
+			desc.height = height;
+			desc.format = FORMAT;
+			desc.usage = VK_IMAGE_USAGE_STORAGE_BIT | (i + 1 == dispatches.size() ? outputUsage : 0);
+			desc.aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+
+			dispatch.input = i == 0 ? input : dispatches[i - 1].output;
+			dispatch.output = graph->createImage(desc);
+
+			uint32_t pass = graph->addPass([this, i](VkCommandBuffer commandBuffer) {
+				record(commandBuffer, i);
+			});
+			graph->read(pass, dispatch.input, GraphUsage::StorageCompute);
+			graph->write(pass, dispatch.output, GraphUsage::StorageCompute, true);
+		}
+		return dispatches.empty() ? input : dispatches.back().output;
+	}
+
+	void PostProcessChain::updateDescriptors(RenderGraph* graph) {
+		//The old graph's sets went with it
+		descriptors->reset();
+		DescriptorWriter writer(device);
+		for (Dispatch& dispatch : dispatches) {
+			dispatch.descriptorSet = descriptors->allocate(layout);
+			writer.writeImage(dispatch.descriptorSet, 0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, graph->getImageView(dispatch.input), VK_IMAGE_LAYOUT_GENERAL);
+			writer.writeImage(dispatch.descriptorSet, 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, graph->getImageView(dispatch.output), VK_IMAGE_LAYOUT_GENERAL);
+		}
+		writer.flush();
+	}
+
+	void PostProcessChain::record(VkCommandBuffer commandBuffer, uint32_t index) {
+		Dispatch& dispatch = dispatches[index];
+		dispatch.pipeline->bind(commandBuffer);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, dispatch.pipeline->getPipelineLayout(),
+			0, 1, &dispatch.descriptorSet, 0, nullptr);
+
+		PushConstants constants;
+		constants.width = static_cast<int32_t>(width);
+		constants.height = static_cast<int32_t>(height);
+		constants.exposure = settings.exposure;
+		constants.blurStrength = settings.blurStrength;
+		constants.sharpenStrength = settings.sharpenStrength;
+		vkCmdPushConstants(commandBuffer, dispatch.pipeline->getPipelineLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+		vkCmdDispatch(commandBuffer, ComputePipeline::getGroupCount(width, dispatch.groupWidth),
+			ComputePipeline::getGroupCount(height, dispatch.groupHeight), 1);
+	}
+}
@@ -0,0 +1,111 @@
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#ifndef __POST_PROCESS_CHAIN_H__
+#define __POST_PROCESS_CHAIN_H__
+
+#include <vector>
+#include <functional>
+#include "LogicalDevice.h"
+#include "ComputePipeline.h"
+#include "DescriptorAllocator.h"
+#include "RenderGraph.h"
+
+namespace vkn {
+
+	enum class PostProcessStage {
+		//Exposure and a filmic curve, HDR in and 0 to 1 out
+		Tonemap,
+		//3x3 gaussian
+		Blur,
+		//Unsharp mask over the 4 neighbours
+		Sharpen,
+	};
+
+	//Pushed every dispatch, so they can change any frame
+	struct PostProcessSettings {
+		float exposure = 1.0f;
+		//0 leaves the image alone, 1 is the full filter
+		float blurStrength = 0.5f;
+		float sharpenStrength = 0.5f;
+	};
+
+	//Full screen effects as compute dispatches over storage images, all run by
+	//PostProcess.comp with the stages picked by specialization constants.
+	//
+	//Stages are fused into as few dispatches as possible. Each dispatch does at
+	//most one filter (blur or sharpen), which loads its group's tile plus a one
+	//texel border into shared memory. A tonemap before the filter is applied
+	//to the tile as it's loaded, one after it to the result before it's stored,
+	//so only the filters ever make a trip through memory. Tonemap, Blur,
+	//Sharpen runs as two dispatches.
+	//
+	//Workgroup sizes are picked per dispatch from the device's subgroup size and
+	//limits. Filters get bigger groups, so less of the tile is border.
+	//
+	//Runs inside a RenderGraph. addPasses declares one pass per dispatch and
+	//the images between them, updateDescriptors has to follow the graph's compile.
+	class PostProcessChain {
+	public:
+		static const VkFormat FORMAT = VK_FORMAT_R16G16B16A16_SFLOAT;
+
+		PostProcessChain() {}
+		PostProcessChain(LogicalDevice* device, const std::vector<PostProcessStage>& stages);
+		~PostProcessChain();
+
+		//One pipeline per dispatch. setShader loads PostProcess.comp into each,
+		//the chain adds the specialization constants and builds it
+		void buildPipelines(std::function<void(ComputePipeline*)> setShader);
+
+		//input has to be a FORMAT storage image. Returns the image the last dispatch
+		//writes, a transient one with outputUsage on top of storage
+		GraphResource addPasses(RenderGraph* graph, GraphResource input, uint32_t width, uint32_t height, VkImageUsageFlags outputUsage);
+		//After the graph's compile, once the images exist
+		void updateDescriptors(RenderGraph* graph);
+
+		PostProcessSettings& getSettings() { return settings; }
+		uint32_t getDispatchCount() { return static_cast<uint32_t>(dispatches.size()); }
+
+	private:
+		//Matches PostProcess.comp's constant_ids
+		enum class Filter : uint32_t {
+			None = 0,
+			Blur = 1,
+			Sharpen = 2,
+		};
+
+		struct Dispatch {
+			bool tonemapInput = false;
+			Filter filter = Filter::None;
+			bool tonemapOutput = false;
+			uint32_t groupWidth = 8;
+			uint32_t groupHeight = 8;
+			ComputePipeline* pipeline = nullptr;
+			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+			GraphResource input = 0;
+			GraphResource output = 0;
+		};
+
+		struct PushConstants {
+			int32_t width;
+			int32_t height;
+			float exposure;
+			float blurStrength;
+			float sharpenStrength;
+		};
+
+		void chooseGroupSize(Dispatch& dispatch, uint32_t subgroupSize);
+		void record(VkCommandBuffer commandBuffer, uint32_t dispatch);
+
+		LogicalDevice* device;
+		std::vector<Dispatch> dispatches;
+		PostProcessSettings settings;
+		uint32_t width = 0;
+		uint32_t height = 0;
+
+		VkDescriptorSetLayout layout;
+		DescriptorAllocator* descriptors = nullptr;
+	};
+}
+
+#endif
@@ -0,0 +1,542 @@
+#include "RenderGraph.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace vkn {
+
+	RenderGraph::RenderGraph(LogicalDevice* device) {
+		this->device = device;
+	}
+
+	RenderGraph::~RenderGraph() {
+		destroyTransientImages();
+	}
+
+	void RenderGraph::getUsageAccess(GraphUsage usage, bool depthAspect, VkPipelineStageFlags& stages, VkAccessFlags& readAccess,
+		VkAccessFlags& writeAccess, VkImageLayout& layout) {
+		readAccess = 0;
+		writeAccess = 0;
+		layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		//Sampled depth is read in the read only depth layout, everything else in the shader one
+		VkImageLayout sampledLayout = depthAspect ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		switch (usage) {
+		case GraphUsage::ColorAttachment:
+			stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+			readAccess = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT;
+			writeAccess = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+			layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+			break;
+		case GraphUsage::DepthAttachment:
+			stages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+			readAccess = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+			writeAccess = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+			layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+			break;
+		case GraphUsage::DepthReadOnly:
+			stages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+			readAccess = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+			layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+			break;
+		case GraphUsage::SampledFragment:
+			stages = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+			readAccess = VK_ACCESS_SHADER_READ_BIT;
+			layout = sampledLayout;
+			break;
+		case GraphUsage::SampledCompute:
+			stages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			readAccess = VK_ACCESS_SHADER_READ_BIT;
+			layout = sampledLayout;
+			break;
+		case GraphUsage::StorageCompute:
+			stages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			readAccess = VK_ACCESS_SHADER_READ_BIT;
+			writeAccess = VK_ACCESS_SHADER_WRITE_BIT;
+			layout = VK_IMAGE_LAYOUT_GENERAL;
+			break;
+		case GraphUsage::TransferSrc:
+			stages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+			readAccess = VK_ACCESS_TRANSFER_READ_BIT;
+			layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+			break;
+		case GraphUsage::TransferDst:
+			stages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+			writeAccess = VK_ACCESS_TRANSFER_WRITE_BIT;
+			layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			break;
+		case GraphUsage::IndirectBuffer:
+			stages = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+			readAccess = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+			break;
+		case GraphUsage::VertexBuffer:
+			stages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+			readAccess = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+			break;
+		case GraphUsage::UniformBuffer:
+			stages = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			readAccess = VK_ACCESS_UNIFORM_READ_BIT;
+			break;
+		}
+	}
+
+	GraphResource RenderGraph::createImage(const GraphImageDesc& desc) {
+		Resource resource;
+		resource.image = true;
+		resource.imported = false;
+		resource.aspect = desc.aspect;
+		resource.desc = desc;
+		resources.push_back(resource);
+		return static_cast<GraphResource>(resources.size() - 1);
+	}
+
+	GraphResource RenderGraph::importImage(VkImage image, VkImageAspectFlags aspect, VkImageLayout initialLayout,
+		VkPipelineStageFlags initialStage, VkAccessFlags initialAccess, VkImageLayout finalLayout) {
+		Resource resource;
+		resource.image = true;
+		resource.imported = true;
+		resource.vkImage = image;
+		resource.aspect = aspect;
+		resource.initialLayout = initialLayout;
+		resource.initialStage = initialStage;
+		resource.initialAccess = initialAccess;
+		resource.finalLayout = finalLayout;
+		resources.push_back(resource);
+		return static_cast<GraphResource>(resources.size() - 1);
+	}
+
+	GraphResource RenderGraph::importBuffer(VkBuffer buffer, VkPipelineStageFlags initialStage, VkAccessFlags initialAccess) {
+		Resource resource;
+		resource.image = false;
+		resource.imported = true;
+		resource.buffer = buffer;
+		resource.initialStage = initialStage;
+		resource.initialAccess = initialAccess;
+		resources.push_back(resource);
+		return static_cast<GraphResource>(resources.size() - 1);
+	}
+
+	void RenderGraph::setImportedImage(GraphResource resource, VkImage image) {
+		resources[resource].vkImage = image;
+	}
+
+	void RenderGraph::setImportedBuffer(GraphResource resource, VkBuffer buffer) {
+		resources[resource].buffer = buffer;
+	}
+
+	uint32_t RenderGraph::addPass(std::function<void(VkCommandBuffer)> record) {
+		Pass pass;
+		pass.record = record;
+		passes.push_back(pass);
+		return static_cast<uint32_t>(passes.size() - 1);
+	}
+
+	void RenderGraph::read(uint32_t pass, GraphResource resource, GraphUsage usage) {
+		passes[pass].accesses.push_back({ resource, usage, false, false });
+	}
+
+	void RenderGraph::write(uint32_t pass, GraphResource resource, GraphUsage usage, bool discard) {
+		passes[pass].accesses.push_back({ resource, usage, true, discard });
+	}
+
+	void RenderGraph::setSideEffects(uint32_t pass) {
+		passes[pass].sideEffects = true;
+	}
+
+	VkImage RenderGraph::getImage(GraphResource resource) {
+		return resources[resource].vkImage;
+	}
+
+	VkImageView RenderGraph::getImageView(GraphResource resource) {
+		return resources[resource].view;
+	}
+
+	void RenderGraph::compile() {
+		destroyTransientImages();
+		imageBarriers.clear();
+		bufferBarriers.clear();
+
+		cull();
+		placeTransientImages();
+		createTransientImages();
+		buildBarriers();
+	}
+
+	//Walks back from the end. A pass stays if it has side effects or writes
+	//something still needed, and whatever it reads is then needed in turn.
+	//Imported resources are always needed, something outside the frame uses them
+	void RenderGraph::cull() {
+		std::vector<bool> needed(resources.size(), false);
+		for (size_t i = 0; i < resources.size(); i++) {
+			needed[i] = resources[i].imported;
+		}
+
+		culledPasses = 0;
+		for (size_t p = passes.size(); p-- > 0;) {
+			Pass& pass = passes[p];
+			bool keep = pass.sideEffects;
+			for (const Access& access : pass.accesses) {
+				keep = keep || (access.write && needed[access.resource]);
+			}
+			pass.culled = !keep;
+			if (!keep) {
+				culledPasses++;
+				continue;
+			}
+			//Anything written before a discard is overwritten unseen
+			for (const Access& access : pass.accesses) {
+				if (access.write && access.discard) {
+					needed[access.resource] = false;
+				}
+			}
+			for (const Access& access : pass.accesses) {
+				if (!access.write || !access.discard) {
+					needed[access.resource] = true;
+				}
+			}
+		}
+	}
+
+	//Lifetimes over the passes that survived. Transient images nothing uses
+	//never get created
+	void RenderGraph::placeTransientImages() {
+		for (Resource& resource : resources) {
+			resource.firstPass = ~0u;
+			resource.lastPass = 0;
+			resource.block = ~0u;
+		}
+		for (uint32_t p = 0; p < passes.size(); p++) {
+			if (passes[p].culled) {
+				continue;
+			}
+			for (const Access& access : passes[p].accesses) {
+				Resource& resource = resources[access.resource];
+				resource.firstPass = std::min(resource.firstPass, p);
+				resource.lastPass = std::max(resource.lastPass, p);
+			}
+		}
+	}
+
+	void RenderGraph::createTransientImages() {
+		std::vector<GraphResource> transients;
+		std::vector<VkMemoryRequirements> requirements(resources.size());
+		unaliasedMemorySize = 0;
+		for (GraphResource i = 0; i < resources.size(); i++) {
+			Resource& resource = resources[i];
+			if (resource.imported || !resource.image || resource.firstPass == ~0u) {
+				continue;
+			}
+
+			VkImageCreateInfo imageInfo{};
+			imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			imageInfo.imageType = VK_IMAGE_TYPE_2D;
+			imageInfo.extent.width = resource.desc.width;
+			imageInfo.extent.height = resource.desc.height;
+			imageInfo.extent.depth = 1;
+			imageInfo.mipLevels = 1;
+			imageInfo.arrayLayers = 1;
+			imageInfo.format = resource.desc.format;
+			imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			imageInfo.usage = resource.desc.usage;
+			imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			imageInfo.samples = resource.desc.samples;
+
+			if (vkCreateImage(device->getDevice(), &imageInfo, nullptr, &resource.vkImage) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create transient image!");
+			}
+			vkGetImageMemoryRequirements(device->getDevice(), resource.vkImage, &requirements[i]);
+			unaliasedMemorySize += requirements[i].size;
+			transients.push_back(i);
+		}
+
+		//Biggest first, each into the first block it fits alongside without its
+		//lifetime overlapping anyone already there. Everything sits at offset 0, so
+		//a block is as big as its biggest image
+		std::sort(transients.begin(), transients.end(), [&requirements](GraphResource a, GraphResource b) {
+			return requirements[a].size > requirements[b].size;
+		});
+		for (GraphResource i : transients) {
+			Resource& resource = resources[i];
+			bool lazy = (resource.desc.usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) != 0;
+			for (uint32_t b = 0; b < blocks.size() && resource.block == ~0u; b++) {
+				MemoryBlock& block = blocks[b];
+				if ((block.memoryTypeBits & requirements[i].memoryTypeBits) == 0 || block.lazy != lazy) {
+					continue;
+				}
+				bool overlaps = false;
+				for (GraphResource other : block.images) {
+					overlaps = overlaps || !(resources[other].lastPass < resource.firstPass || resource.lastPass < resources[other].firstPass);
+				}
+				if (!overlaps) {
+					resource.block = b;
+				}
+			}
+			if (resource.block == ~0u) {
+				blocks.push_back(MemoryBlock());
+				blocks.back().lazy = lazy;
+				resource.block = static_cast<uint32_t>(blocks.size() - 1);
+			}
+			MemoryBlock& block = blocks[resource.block];
+			block.size = std::max(block.size, requirements[i].size);
+			block.memoryTypeBits &= requirements[i].memoryTypeBits;
+			block.images.push_back(i);
+		}
+
+		transientMemorySize = 0;
+		lazyMemorySize = 0;
+		for (MemoryBlock& block : blocks) {
+			//Desktop GPUs mostly have no lazy memory, plain device local does the same job there
+			VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+			if (block.lazy && device->hasMemoryType(block.memoryTypeBits, properties | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT)) {
+				properties |= VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+				lazyMemorySize += block.size;
+			}
+
+			VkMemoryAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+			allocInfo.allocationSize = block.size;
+			allocInfo.memoryTypeIndex = device->findMemoryType(block.memoryTypeBits, properties);
+			if (vkAllocateMemory(device->getDevice(), &allocInfo, nullptr, &block.memory) != VK_SUCCESS) {
+				throw std::runtime_error("failed to allocate transient image memory!");
+			}
+			transientMemorySize += block.size;
+
+			for (GraphResource i : block.images) {
+				Resource& resource = resources[i];
+				vkBindImageMemory(device->getDevice(), resource.vkImage, block.memory, 0);
+
+				VkImageViewCreateInfo viewInfo{};
+				viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+				viewInfo.image = resource.vkImage;
+				viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+				viewInfo.format = resource.desc.format;
+				viewInfo.subresourceRange.aspectMask = resource.desc.aspect;
+				viewInfo.subresourceRange.baseMipLevel = 0;
+				viewInfo.subresourceRange.levelCount = 1;
+				viewInfo.subresourceRange.baseArrayLayer = 0;
+				viewInfo.subresourceRange.layerCount = 1;
+				if (vkCreateImageView(device->getDevice(), &viewInfo, nullptr, &resource.view) != VK_SUCCESS) {
+					throw std::runtime_error("failed to create transient image view!");
+				}
+			}
+		}
+	}
+
+	void RenderGraph::destroyTransientImages() {
+		for (Resource& resource : resources) {
+			if (resource.imported || resource.vkImage == VK_NULL_HANDLE) {
+				continue;
+			}
+			vkDestroyImageView(device->getDevice(), resource.view, nullptr);
+			vkDestroyImage(device->getDevice(), resource.vkImage, nullptr);
+			resource.view = VK_NULL_HANDLE;
+			resource.vkImage = VK_NULL_HANDLE;
+		}
+		for (MemoryBlock& block : blocks) {
+			vkFreeMemory(device->getDevice(), block.memory, nullptr);
+		}
+		blocks.clear();
+	}
+
+	void RenderGraph::buildBarriers() {
+		std::vector<State> states(resources.size());
+		for (size_t i = 0; i < resources.size(); i++) {
+			const Resource& resource = resources[i];
+			State& state = states[i];
+			state.layout = resource.initialLayout;
+			state.writeStages = resource.initialStage;
+			state.writeAccess = resource.initialAccess;
+			state.readStages = 0;
+			state.visibleStages = 0;
+			state.visibleAccess = 0;
+		}
+
+		//A transient image's memory was last touched by the other images in its
+		//block, earlier this frame or in the last one. Its first use waits on all of them
+		for (uint32_t b = 0; b < blocks.size(); b++) {
+			VkPipelineStageFlags blockStages = 0;
+			VkAccessFlags blockWrites = 0;
+			for (const Pass& pass : passes) {
+				for (const Access& access : pass.accesses) {
+					if (pass.culled || resources[access.resource].block != b) {
+						continue;
+					}
+					VkPipelineStageFlags stages;
+					VkAccessFlags readAccess, writeAccess;
+					VkImageLayout layout;
+					getUsageAccess(access.usage, (resources[access.resource].aspect & VK_IMAGE_ASPECT_DEPTH_BIT) != 0, stages, readAccess, writeAccess, layout);
+					blockStages |= stages;
+					blockWrites |= access.write ? writeAccess : 0;
+				}
+			}
+			for (GraphResource i : blocks[b].images) {
+				states[i].writeStages = blockStages;
+				states[i].writeAccess = blockWrites;
+			}
+		}
+
+		barrierBatches = 0;
+		for (Pass& pass : passes) {
+			pass.srcStages = 0;
+			pass.dstStages = 0;
+			pass.firstImageBarrier = static_cast<uint32_t>(imageBarriers.size());
+			pass.firstBufferBarrier = static_cast<uint32_t>(bufferBarriers.size());
+			if (pass.culled) {
+				pass.imageBarrierCount = 0;
+				pass.bufferBarrierCount = 0;
+				continue;
+			}
+
+			for (const Access& access : pass.accesses) {
+				const Resource& resource = resources[access.resource];
+				State& state = states[access.resource];
+				VkPipelineStageFlags stages;
+				VkAccessFlags readAccess, writeAccess;
+				VkImageLayout layout;
+				getUsageAccess(access.usage, (resource.aspect & VK_IMAGE_ASPECT_DEPTH_BIT) != 0, stages, readAccess, writeAccess, layout);
+				VkAccessFlags dstAccess = readAccess | (access.write ? writeAccess : 0);
+				bool layoutChanges = resource.image && state.layout != layout;
+
+				Barrier barrier;
+				barrier.resource = access.resource;
+				//Discarded contents don't need carrying over into the new layout
+				barrier.oldLayout = access.discard ? VK_IMAGE_LAYOUT_UNDEFINED : state.layout;
+				barrier.newLayout = resource.image ? layout : VK_IMAGE_LAYOUT_UNDEFINED;
+				barrier.dstAccess = dstAccess;
+				VkPipelineStageFlags srcStages = 0;
+				bool needed = false;
+
+				if (access.write || layoutChanges) {
+					//Write after write, read after write, and write after read. A layout
+					//change is a write as far as everyone else is concerned
+					srcStages = state.writeStages | state.readStages;
+					barrier.srcAccess = state.writeAccess;
+					needed = layoutChanges || srcStages != 0;
+					state.layout = resource.image ? layout : state.layout;
+					if (access.write) {
+						state.writeStages = stages;
+						state.writeAccess = writeAccess;
+						state.readStages = 0;
+						state.visibleStages = 0;
+						state.visibleAccess = 0;
+					}
+					else {
+						state.writeStages = stages;
+						state.writeAccess = 0;
+						state.readStages = stages;
+						state.visibleStages = stages;
+						state.visibleAccess = dstAccess;
+					}
+				}
+				else {
+					//Read after write, unless an earlier read already got the write made visible here
+					bool visible = (stages & ~state.visibleStages) == 0 && (dstAccess & ~state.visibleAccess) == 0;
+					if (!visible && state.writeStages != 0) {
+						srcStages = state.writeStages;
+						barrier.srcAccess = state.writeAccess;
+						needed = true;
+						state.visibleStages |= stages;
+						state.visibleAccess |= dstAccess;
+					}
+					state.readStages |= stages;
+				}
+
+				if (!needed) {
+					continue;
+				}
+				pass.srcStages |= srcStages;
+				pass.dstStages |= stages;
+				if (resource.image) {
+					imageBarriers.push_back(barrier);
+				}
+				else {
+					bufferBarriers.push_back(barrier);
+				}
+			}
+			pass.imageBarrierCount = static_cast<uint32_t>(imageBarriers.size()) - pass.firstImageBarrier;
+			pass.bufferBarrierCount = static_cast<uint32_t>(bufferBarriers.size()) - pass.firstBufferBarrier;
+			if (pass.imageBarrierCount + pass.bufferBarrierCount > 0) {
+				barrierBatches++;
+			}
+		}
+
+		finalSrcStages = 0;
+		firstFinalBarrier = static_cast<uint32_t>(imageBarriers.size());
+		for (GraphResource i = 0; i < resources.size(); i++) {
+			const Resource& resource = resources[i];
+			const State& state = states[i];
+			if (!resource.imported || !resource.image || resource.finalLayout == VK_IMAGE_LAYOUT_UNDEFINED ||
+				resource.finalLayout == state.layout) {
+				continue;
+			}
+			Barrier barrier;
+			barrier.resource = i;
+			barrier.oldLayout = state.layout;
+			barrier.newLayout = resource.finalLayout;
+			barrier.srcAccess = state.writeAccess;
+			barrier.dstAccess = 0;
+			imageBarriers.push_back(barrier);
+			finalSrcStages |= state.writeStages | state.readStages;
+		}
+		finalBarrierCount = static_cast<uint32_t>(imageBarriers.size()) - firstFinalBarrier;
+		if (finalBarrierCount > 0) {
+			barrierBatches++;
+		}
+	}
+
+	void RenderGraph::recordBarriers(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStages, VkPipelineStageFlags dstStages,
+		uint32_t firstImage, uint32_t imageCount, uint32_t firstBuffer, uint32_t bufferCount) {
+		std::vector<VkImageMemoryBarrier> images(imageCount);
+		for (uint32_t i = 0; i < imageCount; i++) {
+			const Barrier& barrier = imageBarriers[firstImage + i];
+			const Resource& resource = resources[barrier.resource];
+			VkImageMemoryBarrier& image = images[i];
+			image = {};
+			image.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			image.oldLayout = barrier.oldLayout;
+			image.newLayout = barrier.newLayout;
+			image.srcAccessMask = barrier.srcAccess;
+			image.dstAccessMask = barrier.dstAccess;
+			image.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			image.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			image.image = resource.vkImage;
+			image.subresourceRange.aspectMask = resource.aspect;
+			image.subresourceRange.baseMipLevel = 0;
+			image.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+			image.subresourceRange.baseArrayLayer = 0;
+			image.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+		}
+		std::vector<VkBufferMemoryBarrier> buffers(bufferCount);
+		for (uint32_t i = 0; i < bufferCount; i++) {
+			const Barrier& barrier = bufferBarriers[firstBuffer + i];
+			VkBufferMemoryBarrier& buffer = buffers[i];
+			buffer = {};
+			buffer.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			buffer.srcAccessMask = barrier.srcAccess;
+			buffer.dstAccessMask = barrier.dstAccess;
+			buffer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			buffer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			buffer.buffer = resources[barrier.resource].buffer;
+			buffer.offset = 0;
+			buffer.size = VK_WHOLE_SIZE;
+		}
+		//A first use with nothing before it still needs a stage to wait on
+		vkCmdPipelineBarrier(commandBuffer, srcStages != 0 ? srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStages, 0,
+			0, nullptr, bufferCount, buffers.data(), imageCount, images.data());
+	}
+
+	void RenderGraph::execute(VkCommandBuffer commandBuffer) {
+		for (Pass& pass : passes) {
+			if (pass.culled) {
+				continue;
+			}
+			if (pass.imageBarrierCount + pass.bufferBarrierCount > 0) {
+				recordBarriers(commandBuffer, pass.srcStages, pass.dstStages, pass.firstImageBarrier, pass.imageBarrierCount,
+					pass.firstBufferBarrier, pass.bufferBarrierCount);
+			}
+			pass.record(commandBuffer);
+		}
+		if (finalBarrierCount > 0) {
+			recordBarriers(commandBuffer, finalSrcStages, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, firstFinalBarrier, finalBarrierCount, 0, 0);
+		}
+	}
+}
@@ -0,0 +1,204 @@
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#ifndef __RENDER_GRAPH_H__
+#define __RENDER_GRAPH_H__
+
+#include <vector>
+#include <functional>
+#include "LogicalDevice.h"
+
+namespace vkn {
+
+	typedef uint32_t GraphResource;
+
+	//How a pass touches a resource. Decides the stages, access and, for images,
+	//the layout the graph puts it in before the pass runs
+	enum class GraphUsage {
+		ColorAttachment,
+		DepthAttachment,
+		//Depth tested but never written
+		DepthReadOnly,
+		SampledFragment,
+		SampledCompute,
+		StorageCompute,
+		TransferSrc,
+		TransferDst,
+		//Buffers only
+		IndirectBuffer,
+		VertexBuffer,
+		UniformBuffer,
+	};
+
+	//An image the graph owns. It only exists between its first and last use in a
+	//frame, so images whose uses don't overlap can share memory. With
+	//TRANSIENT_ATTACHMENT usage it goes in LAZILY_ALLOCATED memory where the
+	//device has any, which tilers may never back at all if it's never stored
+	struct GraphImageDesc {
+		uint32_t width;
+		uint32_t height;
+		VkFormat format;
+		VkImageUsageFlags usage;
+		VkImageAspectFlags aspect;
+		VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+	};
+
+	//A frame as a list of passes, each declaring what it reads and writes. From
+	//that compile works out:
+	//  which passes are needed. Passes whose writes nothing reads get dropped,
+	//  unless they write an imported resource or are marked as having side effects
+	//  every barrier and layout change, batched into one vkCmdPipelineBarrier
+	//  in front of each pass that needs any
+	//  memory for transient images, aliased between images whose lifetimes
+	//  in the frame don't overlap
+	//
+	//Passes run in the order they were added, the graph never reorders them.
+	//Render passes drawn inside a graph should be made with managedByGraph set,
+	//so they leave layouts and external dependencies to it.
+	//
+	//Built once (and again when sizes change), then executed every frame. An
+	//imported image can be swapped for another with the same usage between
+	//executes, which is how each frame gets its own swap chain image.
+	class RenderGraph {
+	public:
+		RenderGraph() {}
+		RenderGraph(LogicalDevice* device);
+		~RenderGraph();
+
+		GraphResource createImage(const GraphImageDesc& desc);
+		//initialStage and initialAccess are whatever last used the image before the
+		//frame, e.g. the stage the acquire semaphore waits at. The graph leaves it in
+		//finalLayout, unless that's UNDEFINED
+		GraphResource importImage(VkImage image, VkImageAspectFlags aspect, VkImageLayout initialLayout,
+			VkPipelineStageFlags initialStage, VkAccessFlags initialAccess, VkImageLayout finalLayout);
+		GraphResource importBuffer(VkBuffer buffer, VkPipelineStageFlags initialStage, VkAccessFlags initialAccess);
+		void setImportedImage(GraphResource resource, VkImage image);
+		void setImportedBuffer(GraphResource resource, VkBuffer buffer);
+
+		//Passes are recorded in the order they're added
+		uint32_t addPass(std::function<void(VkCommandBuffer)> record);
+		void read(uint32_t pass, GraphResource resource, GraphUsage usage);
+		//Unless discard is set the pass keeps what was there (a load, a depth test),
+		//which counts as reading it too. Set it for clears
+		void write(uint32_t pass, GraphResource resource, GraphUsage usage, bool discard = false);
+		//Writes something the graph can't see, so it's never culled
+		void setSideEffects(uint32_t pass);
+
+		//Culls, places transient images and works out every barrier. Creates the
+		//transient images, so their views are only there afterwards
+		void compile();
+		void execute(VkCommandBuffer commandBuffer);
+
+		VkImage getImage(GraphResource resource);
+		VkImageView getImageView(GraphResource resource);
+
+		uint32_t getPassCount() { return static_cast<uint32_t>(passes.size()); }
+		uint32_t getCulledPassCount() { return culledPasses; }
+		//vkCmdPipelineBarrier calls per execute
+		uint32_t getBarrierBatchCount() { return barrierBatches; }
+		//What the transient images take with and without aliasing
+		VkDeviceSize getTransientMemorySize() { return transientMemorySize; }
+		VkDeviceSize getUnaliasedMemorySize() { return unaliasedMemorySize; }
+		//The part of the transient memory that's lazily allocated
+		VkDeviceSize getLazyMemorySize() { return lazyMemorySize; }
+
+	private:
+		struct Access {
+			GraphResource resource;
+			GraphUsage usage;
+			bool write;
+			bool discard;
+		};
+
+		struct Pass {
+			std::function<void(VkCommandBuffer)> record;
+			std::vector<Access> accesses;
+			bool sideEffects = false;
+			bool culled = false;
+			//Filled by compile, indices into the barrier lists
+			VkPipelineStageFlags srcStages = 0;
+			VkPipelineStageFlags dstStages = 0;
+			uint32_t firstImageBarrier = 0;
+			uint32_t imageBarrierCount = 0;
+			uint32_t firstBufferBarrier = 0;
+			uint32_t bufferBarrierCount = 0;
+		};
+
+		struct Resource {
+			bool image;
+			bool imported;
+			VkImage vkImage = VK_NULL_HANDLE;
+			VkImageView view = VK_NULL_HANDLE;
+			VkBuffer buffer = VK_NULL_HANDLE;
+			VkImageAspectFlags aspect = 0;
+			GraphImageDesc desc{};
+			VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			VkPipelineStageFlags initialStage = 0;
+			VkAccessFlags initialAccess = 0;
+			VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			//Transient lifetime in pass order, and the memory block it lives in
+			uint32_t firstPass = ~0u;
+			uint32_t lastPass = 0;
+			uint32_t block = ~0u;
+		};
+
+		//Where a resource was left by the passes compiled so far
+		struct State {
+			VkImageLayout layout;
+			//Writes not yet made visible, and the stages that did them
+			VkPipelineStageFlags writeStages;
+			VkAccessFlags writeAccess;
+			//Reads since the last write, for write after read hazards
+			VkPipelineStageFlags readStages;
+			//Stages and access the last write has already been made visible to
+			VkPipelineStageFlags visibleStages;
+			VkAccessFlags visibleAccess;
+		};
+
+		struct MemoryBlock {
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			VkDeviceSize size = 0;
+			uint32_t memoryTypeBits = ~0u;
+			//Only transient attachments can go in lazily allocated memory
+			bool lazy = false;
+			std::vector<GraphResource> images;
+		};
+
+		struct Barrier {
+			GraphResource resource;
+			VkImageLayout oldLayout;
+			VkImageLayout newLayout;
+			VkAccessFlags srcAccess;
+			VkAccessFlags dstAccess;
+		};
+
+		static void getUsageAccess(GraphUsage usage, bool depthAspect, VkPipelineStageFlags& stages, VkAccessFlags& readAccess,
+			VkAccessFlags& writeAccess, VkImageLayout& layout);
+		void cull();
+		void placeTransientImages();
+		void createTransientImages();
+		void destroyTransientImages();
+		void buildBarriers();
+		void recordBarriers(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStages, VkPipelineStageFlags dstStages,
+			uint32_t firstImage, uint32_t imageCount, uint32_t firstBuffer, uint32_t bufferCount);
+
+		LogicalDevice* device;
+		std::vector<Pass> passes;
+		std::vector<Resource> resources;
+		std::vector<MemoryBlock> blocks;
+		std::vector<Barrier> imageBarriers;
+		std::vector<Barrier> bufferBarriers;
+		//Into the imported images' final layouts, after the last pass
+		VkPipelineStageFlags finalSrcStages = 0;
+		uint32_t firstFinalBarrier = 0;
+		uint32_t finalBarrierCount = 0;
+
+		uint32_t culledPasses = 0;
+		uint32_t barrierBatches = 0;
+		VkDeviceSize transientMemorySize = 0;
+		VkDeviceSize unaliasedMemorySize = 0;
+		VkDeviceSize lazyMemorySize = 0;
+	};
+}
+
+#endif
@@ -3,48 +3,152 @@
 namespace vkn {
 
 	RenderPass::RenderPass(LogicalDevice *logicalDevice, VkFormat format) {
+		device = logicalDevice;
+		attachments.colorFormat = format;
+		createRenderPass();
+	}
 
+	RenderPass::RenderPass(LogicalDevice *logicalDevice, const RenderPassAttachments& attachments) {
 		device = logicalDevice;
+		this->attachments = attachments;
+		createRenderPass();
+	}
+
+	void RenderPass::createRenderPass() {
+		std::vector<VkAttachmentDescription> descriptions;
+
+		//Multisampled color only lives past the pass if a later one loads it, the resolve target is what's kept
+		bool keepsColor = attachments.colorFinalLayout != VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
 		VkAttachmentDescription colorAttachment{};
-		colorAttachment.format = format;
-		colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT; //No multisampling (For now)
-		colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR; //What happens to data already in the attachment
-		colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE; //What happsn at the end of the renderpass
+		colorAttachment.format = attachments.colorFormat;
+		colorAttachment.samples = attachments.samples;
+		//What happens to data already in the attachment. Cleared unless an earlier pass drew into it
+		colorAttachment.loadOp = attachments.colorInitialLayout == VK_IMAGE_LAYOUT_UNDEFINED ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
+		colorAttachment.storeOp = hasResolve() && !keepsColor ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE; //What happsn at the end of the renderpass
 		colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE; //What happens to stencil data (we aren't using this)
 		colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE; //What happens to stencil data post-renderpass
-		colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED; //What format flag the image has prior to renderpass
-		colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR; //What format flag the image should have post-renderpass (Chosen here for swap chain)
+		colorAttachment.initialLayout = attachments.colorInitialLayout; //What format flag the image has prior to renderpass
+		colorAttachment.finalLayout = attachments.colorFinalLayout; //What format flag the image should have post-renderpass (PRESENT_SRC for swap chain)
+		if (hasResolve()) {
+			colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		}
+		if (attachments.managedByGraph) {
+			colorAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+			colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		}
 
 		VkAttachmentReference colorAttachmentRef{};
 		colorAttachmentRef.attachment = 0; //Attachment index. Think-- Frag Shader: layout(location = 0) out vec4
 		colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
+		if (hasColor()) {
+			descriptions.push_back(colorAttachment);
+		}
+
+		//Depth is only ever tested and written inside the pass unless something asks to keep it
+		VkAttachmentDescription depthAttachment{};
+		depthAttachment.format = attachments.depthFormat;
+		depthAttachment.samples = attachments.samples;
+		depthAttachment.loadOp = attachments.depthInitialLayout == VK_IMAGE_LAYOUT_UNDEFINED ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
+		depthAttachment.storeOp = attachments.storeDepth ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		depthAttachment.initialLayout = attachments.depthInitialLayout;
+		depthAttachment.finalLayout = attachments.depthFinalLayout;
+		if (attachments.managedByGraph) {
+			depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+			depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		}
+
+		VkAttachmentReference depthAttachmentRef{};
+		depthAttachmentRef.attachment = static_cast<uint32_t>(descriptions.size());
+		depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		if (hasDepth()) {
+			descriptions.push_back(depthAttachment);
+		}
+
+		//Written by the resolve at the end of the subpass, so whatever was there never matters
+		VkAttachmentDescription resolveAttachment{};
+		resolveAttachment.format = attachments.colorFormat;
+		resolveAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		resolveAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		resolveAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		resolveAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		resolveAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		resolveAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		resolveAttachment.finalLayout = attachments.colorFinalLayout;
+		if (attachments.managedByGraph) {
+			resolveAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+			resolveAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		}
+
+		VkAttachmentReference resolveAttachmentRef{};
+		resolveAttachmentRef.attachment = static_cast<uint32_t>(descriptions.size());
+		resolveAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+		if (hasResolve()) {
+			descriptions.push_back(resolveAttachment);
+		}
+
 		//A subpass that utilizes one attachment
 		//Every renderpass needs at least one subpass
 		VkSubpassDescription subpass{};
 		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS; //As opposed to compute shader pipeline or something
-		subpass.colorAttachmentCount = 1;
-		subpass.pColorAttachments = &colorAttachmentRef; //Could be a vector of all attachments needed
+		subpass.colorAttachmentCount = hasColor() ? 1 : 0;
+		subpass.pColorAttachments = hasColor() ? &colorAttachmentRef : nullptr; //Could be a vector of all attachments needed
+		subpass.pDepthStencilAttachment = hasDepth() ? &depthAttachmentRef : nullptr; //Only ever one of these
+		subpass.pResolveAttachments = hasResolve() ? &resolveAttachmentRef : nullptr; //One per color attachment
 
 		VkRenderPassCreateInfo renderPassInfo{};
 		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-		renderPassInfo.attachmentCount = 1;
-		renderPassInfo.pAttachments = &colorAttachment;
+		renderPassInfo.attachmentCount = static_cast<uint32_t>(descriptions.size());
+		renderPassInfo.pAttachments = descriptions.data();
 		renderPassInfo.subpassCount = 1;
 		renderPassInfo.pSubpasses = &subpass;
-		
-		//This comes up later... Not sure where at the moment
-		VkSubpassDependency dependency{};
-		dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-		dependency.dstSubpass = 0;
-		dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependency.srcAccessMask = 0;
-		dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
-		renderPassInfo.dependencyCount = 1;
-		renderPassInfo.pDependencies = &dependency;
+
+		//Waits for whatever last touched the attachments before this pass writes them.
+		//There's one depth image for every frame in flight, so that includes the
+		//previous frame's depth tests, and any compute that read it since
+		VkSubpassDependency dependencies[2]{};
+		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[0].dstSubpass = 0;
+		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[0].srcAccessMask = 0;
+		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		if (attachments.colorInitialLayout != VK_IMAGE_LAYOUT_UNDEFINED) {
+			dependencies[0].srcAccessMask |= VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+			dependencies[0].dstAccessMask |= VK_ACCESS_COLOR_ATTACHMENT_READ_BIT;
+		}
+		if (hasDepth()) {
+			dependencies[0].srcStageMask |= VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT |
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			dependencies[0].srcAccessMask |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+			dependencies[0].dstStageMask |= VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+			dependencies[0].dstAccessMask |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		}
+
+		//Makes kept depth visible to whatever comes next, a later pass or a compute shader.
+		//Presented color is covered by the semaphore instead
+		dependencies[1].srcSubpass = 0;
+		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+			VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+			VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		dependencies[1].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+			VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT;
+		bool keepsOutput = attachments.storeDepth || (hasColor() && keepsColor);
+
+		renderPassInfo.dependencyCount = keepsOutput ? 2 : 1;
+		renderPassInfo.pDependencies = dependencies;
+		if (attachments.managedByGraph) {
+			renderPassInfo.dependencyCount = 0;
+			renderPassInfo.pDependencies = nullptr;
+		}
 
 		if (vkCreateRenderPass(device->getDevice(), &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
 			throw std::runtime_error("Failed to create renderpass!");
@@ -7,17 +7,53 @@
 #include "LogicalDevice.h"
 
 namespace vkn {
+
+	//What a single subpass render pass writes to. Either format can be UNDEFINED to leave
+	//that attachment out, so depth only passes just skip the color. An attachment
+	//whose initial layout is UNDEFINED gets cleared, anything else is loaded as
+	//an earlier pass left it. That's how a frame gets split over several passes
+	struct RenderPassAttachments {
+		VkFormat colorFormat = VK_FORMAT_UNDEFINED;
+		VkImageLayout colorInitialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkImageLayout colorFinalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+		VkImageLayout depthInitialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkImageLayout depthFinalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		//Keep depth past the end of the pass, for a later pass or a shader to read
+		bool storeDepth = false;
+		//For passes drawn inside a RenderGraph. Attachments start and end in their
+		//attachment layouts and the pass has no external dependencies, the graph's
+		//barriers do both. The initial layouts then only pick clear or load
+		bool managedByGraph = false;
+		//Above 1 color and depth are multisampled and color resolves at the end of the
+		//pass into an extra single sample attachment, which takes the color final
+		//layout. The multisampled images are only stored when something loads them
+		//later (color not going to PRESENT_SRC, storeDepth), so they can be lazily allocated
+		VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+	};
+
 	class RenderPass{
 	public:
 		RenderPass() {}
+		//Color only, cleared and presented
 		RenderPass(LogicalDevice *logicalDevice, VkFormat format);
+		RenderPass(LogicalDevice *logicalDevice, const RenderPassAttachments& attachments);
 		~RenderPass();
 
 		VkRenderPass getRenderPass() { return renderPass; }
+		//Color comes first in the framebuffer, then depth, then the resolve target
+		bool hasColor() { return attachments.colorFormat != VK_FORMAT_UNDEFINED; }
+		bool hasDepth() { return attachments.depthFormat != VK_FORMAT_UNDEFINED; }
+		bool hasResolve() { return hasColor() && attachments.samples != VK_SAMPLE_COUNT_1_BIT; }
+		uint32_t getAttachmentCount() { return (hasColor() ? 1 : 0) + (hasDepth() ? 1 : 0) + (hasResolve() ? 1 : 0); }
+		VkSampleCountFlagBits getSampleCount() { return attachments.samples; }
 
 	private:
+		void createRenderPass();
+
 		VkRenderPass renderPass;
 		LogicalDevice* device;
+		RenderPassAttachments attachments;
 	};
 }
 
@@ -0,0 +1,180 @@
+#include "RenderQueue.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace vkn {
+
+	static const uint32_t OPAQUE_DEPTH_BITS = 19;
+	static const uint32_t TRANSLUCENT_DEPTH_BITS = 24;
+
+	//Depth is already scaled to [0, 1]
+	static uint64_t quantizeDepth(float depth, uint32_t bits) {
+		uint64_t maxValue = (uint64_t(1) << bits) - 1;
+		return static_cast<uint64_t>(std::min(std::max(depth, 0.0f), 1.0f) * maxValue);
+	}
+
+	static uint64_t materialBits(const MaterialPushConstants& material) {
+		return ((material.textureIndex & 0xFFFu) << 4) | (material.samplerIndex & 0xFu);
+	}
+
+	uint64_t RenderQueue::makeOpaqueKey(uint32_t pass, uint32_t pipeline, const MaterialPushConstants& material, MeshHandle mesh, float depth) {
+		return (uint64_t(pass & 0xF) << 60) |
+			(uint64_t(pipeline & 0xFF) << 51) |
+			(materialBits(material) << 35) |
+			(uint64_t(mesh & 0xFFFF) << 19) |
+			quantizeDepth(depth, OPAQUE_DEPTH_BITS);
+	}
+
+	uint64_t RenderQueue::makeTranslucentKey(uint32_t pass, uint32_t pipeline, const MaterialPushConstants& material, MeshHandle mesh, float depth) {
+		uint64_t farToNear = ((uint64_t(1) << TRANSLUCENT_DEPTH_BITS) - 1) - quantizeDepth(depth, TRANSLUCENT_DEPTH_BITS);
+		return (uint64_t(pass & 0xF) << 60) |
+			(uint64_t(1) << 59) |
+			(farToNear << 35) |
+			(uint64_t(pipeline & 0xFF) << 27) |
+			(materialBits(material) << 11) |
+			uint64_t(mesh & 0x7FF);
+	}
+
+	RenderQueue::RenderQueue(GeometryPool* geometry) {
+		this->geometry = geometry;
+	}
+
+	uint32_t RenderQueue::addPipeline(GraphicsPipeline* pipeline, uint32_t descriptorSetCount, bool pushMaterial) {
+		if (pipelines.size() >= MAX_PIPELINES) {
+			throw std::runtime_error("render queue has too many pipelines!");
+		}
+		pipelines.push_back({ pipeline, descriptorSetCount, pushMaterial });
+		return static_cast<uint32_t>(pipelines.size() - 1);
+	}
+
+	void RenderQueue::clear(float maxDepth) {
+		draws.clear();
+		items.clear();
+		depthScale = maxDepth > 0.0f ? 1.0f / maxDepth : 1.0f;
+		sorted = true;
+	}
+
+	void RenderQueue::add(uint32_t pass, uint32_t pipeline, const RenderDraw& draw, float depth, bool translucent) {
+		if (pass >= MAX_PASSES) {
+			throw std::runtime_error("render queue pass out of range!");
+		}
+		Item item;
+		item.key = translucent ? makeTranslucentKey(pass, pipeline, draw.material, draw.mesh, depth * depthScale) :
+			makeOpaqueKey(pass, pipeline, draw.material, draw.mesh, depth * depthScale);
+		item.pipeline = pipeline;
+		item.draw = static_cast<uint32_t>(draws.size());
+		sorted = sorted && (items.empty() || items.back().key <= item.key);
+		items.push_back(item);
+		draws.push_back(draw);
+	}
+
+	void RenderQueue::sort() {
+		if (sorted) {
+			return;
+		}
+
+		//One histogram pass for all eight bytes, then a scatter for each byte that
+		//isn't the same everywhere. Stable, so equal keys keep submission order
+		uint32_t counts[8][256] = {};
+		for (const Item& item : items) {
+			for (uint32_t byte = 0; byte < 8; byte++) {
+				counts[byte][(item.key >> (byte * 8)) & 0xFF]++;
+			}
+		}
+
+		scratch.resize(items.size());
+		uint32_t itemCount = static_cast<uint32_t>(items.size());
+		for (uint32_t byte = 0; byte < 8; byte++) {
+			uint32_t* count = counts[byte];
+			if (count[(items[0].key >> (byte * 8)) & 0xFF] == itemCount) {
+				continue;
+			}
+			uint32_t offsets[256];
+			uint32_t offset = 0;
+			for (uint32_t bucket = 0; bucket < 256; bucket++) {
+				offsets[bucket] = offset;
+				offset += count[bucket];
+			}
+			for (const Item& item : items) {
+				scratch[offsets[(item.key >> (byte * 8)) & 0xFF]++] = item;
+			}
+			items.swap(scratch);
+		}
+		sorted = true;
+	}
+
+	void RenderQueue::record(VkCommandBuffer commandBuffer, uint32_t pass, VkBuffer instanceBuffer, const VkDescriptorSet* descriptorSets,
+		IndirectDrawBuffer* indirect) {
+		pipelineBinds = 0;
+		materialPushes = 0;
+		sort();
+
+		//Pass is the top four bits, so a pass's draws are one contiguous range
+		auto begin = std::lower_bound(items.begin(), items.end(), uint64_t(pass) << 60, [](const Item& item, uint64_t key) { return item.key < key; });
+		auto end = std::lower_bound(begin, items.end(), uint64_t(pass + 1) << 60, [](const Item& item, uint64_t key) { return item.key < key; });
+		if (pass + 1 == MAX_PASSES) {
+			end = items.end();
+		}
+		if (begin == end) {
+			return;
+		}
+
+		geometry->bind(commandBuffer);
+		VkBuffer buffers[] = { instanceBuffer };
+		VkDeviceSize offsets[] = { 0 };
+		vkCmdBindVertexBuffers(commandBuffer, 1, 1, buffers, offsets);
+
+		uint32_t boundPipeline = ~0u;
+		VkPipelineLayout boundLayout = VK_NULL_HANDLE;
+		MaterialPushConstants pushedMaterial{};
+		bool materialPushed = false;
+		//Indirect commands waiting for the state they were added under to change
+		uint32_t firstDraw = 0;
+		uint32_t pendingDraws = 0;
+
+		for (auto it = begin; it != end; ++it) {
+			const Pipeline& pipeline = pipelines[it->pipeline];
+			const RenderDraw& draw = draws[it->draw];
+			VkPipelineLayout layout = pipeline.pipeline->getPipelineLayout();
+			bool pipelineChanges = it->pipeline != boundPipeline;
+			bool materialChanges = pipeline.pushMaterial && (!materialPushed || pipelineChanges ||
+				pushedMaterial.textureIndex != draw.material.textureIndex || pushedMaterial.samplerIndex != draw.material.samplerIndex);
+
+			if ((pipelineChanges || materialChanges) && pendingDraws > 0) {
+				indirect->draw(commandBuffer, firstDraw, pendingDraws);
+				pendingDraws = 0;
+			}
+			if (pipelineChanges) {
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.pipeline->getPipeline());
+				//Sets stay bound across pipelines that share a layout
+				if (layout != boundLayout && pipeline.descriptorSetCount > 0) {
+					vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0, pipeline.descriptorSetCount,
+						descriptorSets, 0, nullptr);
+				}
+				boundPipeline = it->pipeline;
+				boundLayout = layout;
+				pipelineBinds++;
+			}
+			if (materialChanges) {
+				vkCmdPushConstants(commandBuffer, layout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(MaterialPushConstants), &draw.material);
+				pushedMaterial = draw.material;
+				materialPushed = true;
+				materialPushes++;
+			}
+
+			if (indirect != nullptr) {
+				uint32_t drawIndex = indirect->addDraw(geometry->getMesh(draw.mesh), draw.instanceCount, draw.firstInstance, draw.lod);
+				if (pendingDraws == 0) {
+					firstDraw = drawIndex;
+				}
+				pendingDraws++;
+			}
+			else {
+				geometry->draw(commandBuffer, draw.mesh, draw.instanceCount, draw.firstInstance, draw.lod);
+			}
+		}
+		if (pendingDraws > 0) {
+			indirect->draw(commandBuffer, firstDraw, pendingDraws);
+		}
+	}
+}
@@ -0,0 +1,95 @@
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#ifndef __RENDER_QUEUE_H__
+#define __RENDER_QUEUE_H__
+
+#include <vector>
+#include "GraphicsPipeline.h"
+#include "GeometryPool.h"
+#include "BindlessTable.h"
+#include "IndirectDrawBuffer.h"
+
+namespace vkn {
+
+	//One instanced draw out of the shared geometry and instance buffers
+	struct RenderDraw {
+		MeshHandle mesh;
+		uint32_t lod;
+		MaterialPushConstants material;
+		uint32_t firstInstance;
+		uint32_t instanceCount;
+	};
+
+	//Collects a frame's draws, orders them by a 64 bit key and records them with
+	//as few binds as that order allows. Keys are, from the top bit down:
+	//
+	//  opaque       pass:4 | 0 | pipeline:8 | material:16 | mesh:16 | depth:19
+	//  translucent  pass:4 | 1 | far to near depth:24 | pipeline:8 | material:16 | mesh:11
+	//
+	//so within a pass opaque draws group by state and go front to back inside a
+	//group, and translucent draws come after them strictly back to front. Material
+	//is the texture index's low 12 bits and the sampler index's low 4 bits. Keys
+	//are only for ordering, the draws themselves keep their full values.
+	//
+	//Sorted with an 8 bit LSD radix sort, which skips any byte all keys share.
+	class RenderQueue {
+	public:
+		static const uint32_t MAX_PASSES = 16;
+		static const uint32_t MAX_PIPELINES = 256;
+
+		RenderQueue() {}
+		RenderQueue(GeometryPool* geometry);
+
+		//Draws using it bind descriptorSetCount of the sets given to record, from
+		//set 0, and push their material when pushMaterial is set
+		uint32_t addPipeline(GraphicsPipeline* pipeline, uint32_t descriptorSetCount, bool pushMaterial);
+
+		//Drops last frame's draws. Depths get spread over [0, maxDepth]
+		void clear(float maxDepth);
+		//depth is the draw's distance from the camera
+		void add(uint32_t pass, uint32_t pipeline, const RenderDraw& draw, float depth, bool translucent = false);
+		void sort();
+
+		//Records one pass's draws, in sorted order. Geometry and the instance buffer
+		//(at binding 1) are bound once. With a host writable indirect buffer each
+		//run of draws without a state change in between is one indirect draw
+		void record(VkCommandBuffer commandBuffer, uint32_t pass, VkBuffer instanceBuffer, const VkDescriptorSet* descriptorSets,
+			IndirectDrawBuffer* indirect = nullptr);
+
+		static uint64_t makeOpaqueKey(uint32_t pass, uint32_t pipeline, const MaterialPushConstants& material, MeshHandle mesh, float depth);
+		static uint64_t makeTranslucentKey(uint32_t pass, uint32_t pipeline, const MaterialPushConstants& material, MeshHandle mesh, float depth);
+
+		uint32_t getDrawCount() { return static_cast<uint32_t>(draws.size()); }
+		//From the last record, how many pipeline binds and material pushes it took
+		uint32_t getPipelineBinds() { return pipelineBinds; }
+		uint32_t getMaterialPushes() { return materialPushes; }
+
+	private:
+		struct Pipeline {
+			GraphicsPipeline* pipeline;
+			uint32_t descriptorSetCount;
+			bool pushMaterial;
+		};
+
+		struct Item {
+			uint64_t key;
+			uint32_t pipeline;
+			uint32_t draw;
+		};
+
+		GeometryPool* geometry;
+		std::vector<Pipeline> pipelines;
+		std::vector<RenderDraw> draws;
+		std::vector<Item> items;
+		//Radix sort ping pongs between this and items
+		std::vector<Item> scratch;
+		float depthScale = 1.0f;
+		bool sorted = true;
+
+		uint32_t pipelineBinds = 0;
+		uint32_t materialPushes = 0;
+	};
+}
+
+#endif
@@ -0,0 +1,130 @@
+#include "SamplerCache.h"
+#include "LogicalDevice.h"
+#include "Hash.h"
+
+namespace vkn {
+
+	SamplerCache::SamplerCache(LogicalDevice* logicalDevice) {
+		device = logicalDevice;
+		maxSamplers = device->getProperties().limits.maxSamplerAllocationCount;
+	}
+
+	SamplerCache::~SamplerCache() {
+		for (auto& entry : samplers) {
+			vkDestroySampler(device->getDevice(), entry.second, nullptr);
+		}
+	}
+
+	bool SamplerCache::SamplerKey::operator==(const SamplerKey& other) const {
+		return flags == other.flags && magFilter == other.magFilter && minFilter == other.minFilter &&
+			mipmapMode == other.mipmapMode && addressModeU == other.addressModeU && addressModeV == other.addressModeV &&
+			addressModeW == other.addressModeW && mipLodBias == other.mipLodBias && anisotropyEnable == other.anisotropyEnable &&
+			maxAnisotropy == other.maxAnisotropy && compareEnable == other.compareEnable && compareOp == other.compareOp &&
+			minLod == other.minLod && maxLod == other.maxLod && borderColor == other.borderColor &&
+			unnormalizedCoordinates == other.unnormalizedCoordinates;
+	}
+
+	size_t SamplerCache::SamplerKeyHash::operator()(const SamplerKey& key) const {
+		//Every field that takes part in ==
+		size_t hash = 0;
+		hashCombine(hash, key.flags);
+		hashCombine(hash, key.magFilter);
+		hashCombine(hash, key.minFilter);
+		hashCombine(hash, key.mipmapMode);
+		hashCombine(hash, key.addressModeU);
+		hashCombine(hash, key.addressModeV);
+		hashCombine(hash, key.addressModeW);
+		hashCombine(hash, key.mipLodBias);
+		hashCombine(hash, key.anisotropyEnable);
+		hashCombine(hash, key.maxAnisotropy);
+		hashCombine(hash, key.compareEnable);
+		hashCombine(hash, key.compareOp);
+		hashCombine(hash, key.minLod);
+		hashCombine(hash, key.maxLod);
+		hashCombine(hash, key.borderColor);
+		hashCombine(hash, key.unnormalizedCoordinates);
+		return hash;
+	}
+
+	SamplerCache::SamplerKey SamplerCache::makeKey(const VkSamplerCreateInfo& info) {
+		SamplerKey key;
+		key.flags = info.flags;
+		key.magFilter = info.magFilter;
+		key.minFilter = info.minFilter;
+		key.mipmapMode = info.mipmapMode;
+		key.addressModeU = info.addressModeU;
+		key.addressModeV = info.addressModeV;
+		key.addressModeW = info.addressModeW;
+		key.mipLodBias = info.mipLodBias;
+		key.anisotropyEnable = info.anisotropyEnable;
+		//Ignored when disabled, so don't let it split otherwise identical samplers
+		key.maxAnisotropy = info.anisotropyEnable ? info.maxAnisotropy : 1.0f;
+		key.compareEnable = info.compareEnable;
+		key.compareOp = info.compareEnable ? info.compareOp : VK_COMPARE_OP_NEVER;
+		key.minLod = info.minLod;
+		key.maxLod = info.maxLod;
+		key.borderColor = info.borderColor;
+		key.unnormalizedCoordinates = info.unnormalizedCoordinates;
+		return key;
+	}
+
+	const VkSampler* SamplerCache::findOrCreate(const VkSamplerCreateInfo& info) {
+		if (info.pNext != nullptr) {
+			throw std::runtime_error("sampler cache doesn't support pNext chains!");
+		}
+
+		SamplerKey key = makeKey(info);
+		std::lock_guard<std::mutex> lock(samplerMutex);
+
+		auto found = samplers.find(key);
+		if (found != samplers.end()) {
+			return &found->second;
+		}
+
+		if (samplers.size() >= maxSamplers) {
+			throw std::runtime_error("ran out of sampler allocations!");
+		}
+
+		VkSampler sampler;
+		if (vkCreateSampler(device->getDevice(), &info, nullptr, &sampler) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create texture sampler!");
+		}
+		return &samplers.emplace(key, sampler).first->second;
+	}
+
+	VkSampler SamplerCache::getSampler(const VkSamplerCreateInfo& info) {
+		return *findOrCreate(info);
+	}
+
+	VkSamplerCreateInfo SamplerCache::getDefaultCreateInfo() {
+		VkSamplerCreateInfo samplerInfo{};
+		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		samplerInfo.magFilter = VK_FILTER_LINEAR;
+		samplerInfo.minFilter = VK_FILTER_LINEAR;
+		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerInfo.anisotropyEnable = VK_TRUE;
+		samplerInfo.maxAnisotropy = device->getProperties().limits.maxSamplerAnisotropy;
+		samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+		samplerInfo.unnormalizedCoordinates = VK_FALSE;
+		samplerInfo.compareEnable = VK_FALSE;
+		samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		samplerInfo.mipLodBias = 0.0f;
+		samplerInfo.minLod = 0.0f;
+		samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+		return samplerInfo;
+	}
+
+	VkDescriptorSetLayoutBinding SamplerCache::getImmutableSamplerBinding(uint32_t binding, VkDescriptorType type,
+		VkShaderStageFlags stageFlags, const VkSamplerCreateInfo& info) {
+		VkDescriptorSetLayoutBinding layoutBinding{};
+		layoutBinding.binding = binding;
+		layoutBinding.descriptorType = type;
+		layoutBinding.descriptorCount = 1;
+		layoutBinding.stageFlags = stageFlags;
+		layoutBinding.pImmutableSamplers = findOrCreate(info);
+		return layoutBinding;
+	}
+}
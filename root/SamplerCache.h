@@ -0,0 +1,77 @@
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#ifndef __SAMPLER_CACHE_H__
+#define __SAMPLER_CACHE_H__
+
+#include <unordered_map>
+#include <mutex>
+
+namespace vkn {
+
+	class LogicalDevice;
+
+	//Hands out one shared VkSampler per unique sampler state. Samplers are
+	//immutable, so anything asking for the same state can use the same handle.
+	//Owned by LogicalDevice, and everything it returns lives until the device goes.
+	//Don't vkDestroySampler anything that came from here.
+	class SamplerCache {
+	public:
+		SamplerCache() {}
+		SamplerCache(LogicalDevice* device);
+		~SamplerCache();
+
+		VkSampler getSampler(const VkSamplerCreateInfo& info);
+		//Filled out with the repo's usual texture state: linear filtering and
+		//mips, repeat addressing, and the device's max anisotropy
+		VkSamplerCreateInfo getDefaultCreateInfo();
+
+		//Layout binding with the sampler baked in as pImmutableSamplers. Sets made
+		//from the layout never need the sampler written, only the image view.
+		//type is VK_DESCRIPTOR_TYPE_SAMPLER or VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER.
+		VkDescriptorSetLayoutBinding getImmutableSamplerBinding(uint32_t binding, VkDescriptorType type,
+			VkShaderStageFlags stageFlags, const VkSamplerCreateInfo& info);
+
+		uint32_t getSamplerCount() { return static_cast<uint32_t>(samplers.size()); }
+
+	private:
+		//Every field of VkSamplerCreateInfo that changes the sampler. pNext chains
+		//(ycbcr conversion, reduction mode) aren't supported.
+		struct SamplerKey {
+			VkSamplerCreateFlags flags;
+			VkFilter magFilter;
+			VkFilter minFilter;
+			VkSamplerMipmapMode mipmapMode;
+			VkSamplerAddressMode addressModeU;
+			VkSamplerAddressMode addressModeV;
+			VkSamplerAddressMode addressModeW;
+			float mipLodBias;
+			VkBool32 anisotropyEnable;
+			float maxAnisotropy;
+			VkBool32 compareEnable;
+			VkCompareOp compareOp;
+			float minLod;
+			float maxLod;
+			VkBorderColor borderColor;
+			VkBool32 unnormalizedCoordinates;
+
+			bool operator==(const SamplerKey& other) const;
+		};
+
+		struct SamplerKeyHash {
+			size_t operator()(const SamplerKey& key) const;
+		};
+
+		static SamplerKey makeKey(const VkSamplerCreateInfo& info);
+		//Returns a pointer that stays valid for the cache's lifetime
+		const VkSampler* findOrCreate(const VkSamplerCreateInfo& info);
+
+		LogicalDevice* device;
+		uint32_t maxSamplers;
+		std::mutex samplerMutex;
+		//Node based, so pointers to values survive rehashing. Needed for pImmutableSamplers
+		std::unordered_map<SamplerKey, VkSampler, SamplerKeyHash> samplers;
+	};
+}
+
+#endif
@@ -0,0 +1,367 @@
+#include "SpirvReflection.h"
+#include <algorithm>
+#include <unordered_map>
+#include <stdexcept>
+
+namespace vkn {
+
+	static const uint32_t SPIRV_MAGIC = 0x07230203;
+	static const uint32_t HEADER_WORDS = 5;
+
+	//Opcodes
+	static const uint32_t OP_ENTRY_POINT = 15;
+	static const uint32_t OP_TYPE_BOOL = 20;
+	static const uint32_t OP_TYPE_INT = 21;
+	static const uint32_t OP_TYPE_FLOAT = 22;
+	static const uint32_t OP_TYPE_VECTOR = 23;
+	static const uint32_t OP_TYPE_MATRIX = 24;
+	static const uint32_t OP_TYPE_IMAGE = 25;
+	static const uint32_t OP_TYPE_SAMPLER = 26;
+	static const uint32_t OP_TYPE_SAMPLED_IMAGE = 27;
+	static const uint32_t OP_TYPE_ARRAY = 28;
+	static const uint32_t OP_TYPE_RUNTIME_ARRAY = 29;
+	static const uint32_t OP_TYPE_STRUCT = 30;
+	static const uint32_t OP_TYPE_POINTER = 32;
+	static const uint32_t OP_CONSTANT = 43;
+	static const uint32_t OP_SPEC_CONSTANT = 50;
+	static const uint32_t OP_FUNCTION = 54;
+	static const uint32_t OP_VARIABLE = 59;
+	static const uint32_t OP_DECORATE = 71;
+	static const uint32_t OP_MEMBER_DECORATE = 72;
+
+	//Decorations
+	static const uint32_t DECORATION_BLOCK = 2;
+	static const uint32_t DECORATION_BUFFER_BLOCK = 3;
+	static const uint32_t DECORATION_ARRAY_STRIDE = 6;
+	static const uint32_t DECORATION_MATRIX_STRIDE = 7;
+	static const uint32_t DECORATION_BUILT_IN = 11;
+	static const uint32_t DECORATION_LOCATION = 30;
+	static const uint32_t DECORATION_BINDING = 33;
+	static const uint32_t DECORATION_DESCRIPTOR_SET = 34;
+	static const uint32_t DECORATION_OFFSET = 35;
+
+	//Storage classes
+	static const uint32_t STORAGE_UNIFORM_CONSTANT = 0;
+	static const uint32_t STORAGE_INPUT = 1;
+	static const uint32_t STORAGE_UNIFORM = 2;
+	static const uint32_t STORAGE_PUSH_CONSTANT = 9;
+	static const uint32_t STORAGE_STORAGE_BUFFER = 12;
+
+	//Image dimensions that change the descriptor type
+	static const uint32_t DIM_BUFFER = 5;
+	static const uint32_t DIM_SUBPASS_DATA = 6;
+
+	static const uint32_t NONE = ~0u;
+
+	namespace {
+		struct IdInfo {
+			//Word offset of the instruction defining the id, 0 if nothing does
+			uint32_t definition = 0;
+			uint32_t set = NONE;
+			uint32_t binding = NONE;
+			uint32_t location = NONE;
+			uint32_t arrayStride = 0;
+			bool builtIn = false;
+			bool block = false;
+			bool bufferBlock = false;
+			bool used = false;
+		};
+
+		struct Module {
+			const uint32_t* words;
+			std::vector<IdInfo> ids;
+			//Keyed by struct id << 32 | member
+			std::unordered_map<uint64_t, uint32_t> memberOffsets;
+			std::unordered_map<uint64_t, uint32_t> memberMatrixStrides;
+
+			//Ids come out of the module itself, so every lookup checks them against its bound
+			IdInfo& info(uint32_t id) {
+				if (id >= ids.size()) {
+					throw std::runtime_error("malformed spir-v id!");
+				}
+				return ids[id];
+			}
+			const IdInfo& info(uint32_t id) const {
+				if (id >= ids.size()) {
+					throw std::runtime_error("malformed spir-v id!");
+				}
+				return ids[id];
+			}
+
+			uint32_t opcode(uint32_t id) const {
+				return info(id).definition != 0 ? words[info(id).definition] & 0xFFFF : 0;
+			}
+			uint32_t wordCount(uint32_t id) const {
+				if (info(id).definition == 0) {
+					throw std::runtime_error("malformed spir-v, id is never defined!");
+				}
+				return words[info(id).definition] >> 16;
+			}
+			//Operand i of the id's definition, counting from the word after the opcode
+			uint32_t operand(uint32_t id, uint32_t i) const {
+				if (i + 1 >= wordCount(id)) {
+					throw std::runtime_error("malformed spir-v instruction!");
+				}
+				return words[info(id).definition + 1 + i];
+			}
+
+			uint32_t constantValue(uint32_t id) const {
+				uint32_t op = opcode(id);
+				if (op != OP_CONSTANT && op != OP_SPEC_CONSTANT) {
+					throw std::runtime_error("spir-v array length isn't a constant!");
+				}
+				return operand(id, 2);
+			}
+
+			uint32_t typeSize(uint32_t type, uint32_t matrixStride) const {
+				switch (opcode(type)) {
+				case OP_TYPE_BOOL:
+					return 4;
+				case OP_TYPE_INT:
+				case OP_TYPE_FLOAT:
+					return operand(type, 1) / 8;
+				case OP_TYPE_VECTOR:
+					return operand(type, 2) * typeSize(operand(type, 1), 0);
+				case OP_TYPE_MATRIX:
+					return operand(type, 2) * (matrixStride != 0 ? matrixStride : typeSize(operand(type, 1), 0));
+				case OP_TYPE_ARRAY: {
+					uint32_t stride = info(type).arrayStride != 0 ? ids[type].arrayStride : typeSize(operand(type, 1), matrixStride);
+					return constantValue(operand(type, 2)) * stride;
+				}
+				case OP_TYPE_STRUCT: {
+					uint32_t size = 0;
+					for (uint32_t member = 0; member + 2 < wordCount(type); member++) {
+						uint64_t key = (uint64_t(type) << 32) | member;
+						auto offset = memberOffsets.find(key);
+						auto stride = memberMatrixStrides.find(key);
+						uint32_t memberSize = typeSize(operand(type, 1 + member), stride != memberMatrixStrides.end() ? stride->second : 0);
+						size = std::max(size, (offset != memberOffsets.end() ? offset->second : 0) + memberSize);
+					}
+					return size;
+				}
+				default:
+					throw std::runtime_error("spir-v type has no size!");
+				}
+			}
+
+			VkFormat inputFormat(uint32_t type) const {
+				uint32_t components = 1;
+				if (opcode(type) == OP_TYPE_VECTOR) {
+					components = operand(type, 2);
+					type = operand(type, 1);
+				}
+				//Only 32 bit inputs, which is all the vertex layouts hand out
+				if (components < 1 || components > 4 || operand(type, 1) != 32) {
+					return VK_FORMAT_UNDEFINED;
+				}
+				static const VkFormat floatFormats[] = { VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT };
+				static const VkFormat intFormats[] = { VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT };
+				static const VkFormat uintFormats[] = { VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT };
+				if (opcode(type) == OP_TYPE_FLOAT) {
+					return floatFormats[components - 1];
+				}
+				return operand(type, 2) != 0 ? intFormats[components - 1] : uintFormats[components - 1];
+			}
+		};
+	}
+
+	static VkShaderStageFlagBits executionModelStage(uint32_t model) {
+		switch (model) {
+		case 0: return VK_SHADER_STAGE_VERTEX_BIT;
+		case 1: return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+		case 2: return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+		case 3: return VK_SHADER_STAGE_GEOMETRY_BIT;
+		case 4: return VK_SHADER_STAGE_FRAGMENT_BIT;
+		case 5: return VK_SHADER_STAGE_COMPUTE_BIT;
+		default:
+			throw std::runtime_error("unsupported spir-v execution model!");
+		}
+	}
+
+	//Throws unless the instruction has at least operandCount words after the opcode
+	static void checkOperands(uint32_t count, uint32_t operandCount) {
+		if (count < operandCount + 1) {
+			throw std::runtime_error("malformed spir-v instruction!");
+		}
+	}
+
+	SpirvReflection::SpirvReflection(const uint32_t* code, size_t size) {
+		size_t wordTotal = size / 4;
+		if (size % 4 != 0 || wordTotal < HEADER_WORDS || code[0] != SPIRV_MAGIC) {
+			throw std::runtime_error("shader isn't spir-v!");
+		}
+
+		Module module;
+		module.words = code;
+		module.ids.resize(code[3]);
+
+		//Globals come before any function, so one pass sees every definition
+		//before the function bodies that reference them
+		bool inFunctions = false;
+		std::vector<uint32_t> variables;
+		for (size_t word = HEADER_WORDS; word < wordTotal;) {
+			uint32_t opcode = code[word] & 0xFFFF;
+			uint32_t count = code[word] >> 16;
+			if (count == 0 || word + count > wordTotal) {
+				throw std::runtime_error("malformed spir-v instruction!");
+			}
+			const uint32_t* operands = code + word + 1;
+
+			if (opcode == OP_FUNCTION) {
+				inFunctions = true;
+			}
+			if (inFunctions) {
+				//Anything a function names is used. Literals that happen to look like
+				//a variable's id only ever keep a resource that could have gone
+				for (uint32_t i = 1; i < count; i++) {
+					if (operands[i - 1] < module.ids.size()) {
+						module.ids[operands[i - 1]].used = true;
+					}
+				}
+			}
+			else if (opcode == OP_ENTRY_POINT) {
+				checkOperands(count, 1);
+				stage = executionModelStage(operands[0]);
+			}
+			else if (opcode == OP_DECORATE) {
+				checkOperands(count, 2);
+				IdInfo& info = module.info(operands[0]);
+				auto literal = [&]() {
+					checkOperands(count, 3);
+					return operands[2];
+				};
+				switch (operands[1]) {
+				case DECORATION_BLOCK: info.block = true; break;
+				case DECORATION_BUFFER_BLOCK: info.bufferBlock = true; break;
+				case DECORATION_ARRAY_STRIDE: info.arrayStride = literal(); break;
+				case DECORATION_BUILT_IN: info.builtIn = true; break;
+				case DECORATION_LOCATION: info.location = literal(); break;
+				case DECORATION_BINDING: info.binding = literal(); break;
+				case DECORATION_DESCRIPTOR_SET: info.set = literal(); break;
+				}
+			}
+			else if (opcode == OP_MEMBER_DECORATE && count >= 5) {
+				uint64_t key = (uint64_t(operands[0]) << 32) | operands[1];
+				if (operands[2] == DECORATION_OFFSET) {
+					module.memberOffsets[key] = operands[3];
+				}
+				else if (operands[2] == DECORATION_MATRIX_STRIDE) {
+					module.memberMatrixStrides[key] = operands[3];
+				}
+				else if (operands[2] == DECORATION_BUILT_IN) {
+					//A built in block like gl_PerVertex
+					module.info(operands[0]).builtIn = true;
+				}
+			}
+			else if ((opcode >= OP_TYPE_BOOL && opcode <= OP_TYPE_POINTER) || opcode == OP_CONSTANT || opcode == OP_SPEC_CONSTANT) {
+				//Types define operand 0, constants operand 1
+				checkOperands(count, opcode >= OP_CONSTANT ? 2 : 1);
+				uint32_t id = opcode >= OP_CONSTANT ? operands[1] : operands[0];
+				module.info(id).definition = static_cast<uint32_t>(word);
+			}
+			else if (opcode == OP_VARIABLE) {
+				//Result type, id and storage class
+				checkOperands(count, 3);
+				module.info(operands[1]).definition = static_cast<uint32_t>(word);
+				variables.push_back(operands[1]);
+			}
+			word += count;
+		}
+
+		for (uint32_t variable : variables) {
+			const IdInfo& info = module.ids[variable];
+			if (!info.used) {
+				continue;
+			}
+			uint32_t storage = module.operand(variable, 2);
+			//Variable's type is a pointer, what it points at is the interesting part
+			uint32_t type = module.operand(module.operand(variable, 0), 2);
+
+			if (storage == STORAGE_PUSH_CONSTANT) {
+				uint32_t first = NONE;
+				for (uint32_t member = 0; member + 2 < module.wordCount(type); member++) {
+					auto offset = module.memberOffsets.find((uint64_t(type) << 32) | member);
+					first = std::min(first, offset != module.memberOffsets.end() ? offset->second : 0);
+				}
+				pushConstants.stageFlags = stage;
+				pushConstants.offset = first == NONE ? 0 : first;
+				pushConstants.size = module.typeSize(type, 0) - pushConstants.offset;
+				continue;
+			}
+
+			if (storage == STORAGE_INPUT) {
+				if (stage != VK_SHADER_STAGE_VERTEX_BIT || info.builtIn || module.info(type).builtIn || info.location == NONE) {
+					continue;
+				}
+				//Matrices take a location per column
+				uint32_t columns = 1;
+				if (module.opcode(type) == OP_TYPE_MATRIX) {
+					columns = module.operand(type, 2);
+					type = module.operand(type, 1);
+				}
+				for (uint32_t column = 0; column < columns; column++) {
+					inputs.push_back({ info.location + column, module.inputFormat(type) });
+				}
+				continue;
+			}
+
+			if (storage != STORAGE_UNIFORM_CONSTANT && storage != STORAGE_UNIFORM && storage != STORAGE_STORAGE_BUFFER) {
+				continue;
+			}
+
+			ReflectedBinding binding;
+			binding.set = info.set == NONE ? 0 : info.set;
+			binding.binding = info.binding == NONE ? 0 : info.binding;
+			binding.count = 1;
+			while (module.opcode(type) == OP_TYPE_ARRAY) {
+				binding.count *= module.constantValue(module.operand(type, 2));
+				type = module.operand(type, 1);
+			}
+			if (module.opcode(type) == OP_TYPE_RUNTIME_ARRAY) {
+				binding.count = 0;
+				type = module.operand(type, 1);
+			}
+
+			switch (module.opcode(type)) {
+			case OP_TYPE_SAMPLER:
+				binding.type = VK_DESCRIPTOR_TYPE_SAMPLER;
+				break;
+			case OP_TYPE_SAMPLED_IMAGE:
+				binding.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+				break;
+			case OP_TYPE_IMAGE: {
+				uint32_t dim = module.operand(type, 2);
+				//1 sampled, 2 read and written as storage
+				bool sampled = module.operand(type, 6) == 1;
+				if (dim == DIM_SUBPASS_DATA) {
+					binding.type = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+				}
+				else if (dim == DIM_BUFFER) {
+					binding.type = sampled ? VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER;
+				}
+				else {
+					binding.type = sampled ? VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+				}
+				break;
+			}
+			case OP_TYPE_STRUCT:
+				//Old style storage buffers are Uniform with BufferBlock
+				binding.type = storage == STORAGE_STORAGE_BUFFER || module.info(type).bufferBlock ?
+					VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+				break;
+			default:
+				throw std::runtime_error("unsupported spir-v resource type!");
+			}
+			bindings.push_back(binding);
+		}
+
+		std::sort(bindings.begin(), bindings.end(), [](const ReflectedBinding& a, const ReflectedBinding& b) {
+			return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+		});
+		//Aliased variables share a binding, keep one
+		bindings.erase(std::unique(bindings.begin(), bindings.end(), [](const ReflectedBinding& a, const ReflectedBinding& b) {
+			return a.set == b.set && a.binding == b.binding;
+		}), bindings.end());
+		std::sort(inputs.begin(), inputs.end(), [](const ReflectedInput& a, const ReflectedInput& b) { return a.location < b.location; });
+	}
+}
@@ -0,0 +1,56 @@
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#ifndef __SPIRV_REFLECTION_H__
+#define __SPIRV_REFLECTION_H__
+
+#include <vector>
+
+namespace vkn {
+
+	//One resource a shader actually reads or writes
+	struct ReflectedBinding {
+		uint32_t set;
+		uint32_t binding;
+		VkDescriptorType type;
+		//0 for runtime sized arrays, which need their layout from elsewhere
+		uint32_t count;
+	};
+
+	//A vertex shader input by location. Built in inputs aren't listed
+	struct ReflectedInput {
+		uint32_t location;
+		VkFormat format;
+	};
+
+	//Just enough of a SPIR-V parser to build pipeline layouts from the shader
+	//instead of by hand. Walks the module once for decorations, types and
+	//variables, and keeps only the variables some function in the module
+	//references, so declared but unused resources don't end up in layouts.
+	//
+	//Assumes one entry point per module, which is all glslangValidator emits for
+	//the repo's shaders. Throws on anything that isn't SPIR-V.
+	class SpirvReflection {
+	public:
+		SpirvReflection() {}
+		//size is in bytes
+		SpirvReflection(const uint32_t* code, size_t size);
+
+		VkShaderStageFlagBits getStage() { return stage; }
+		//Sorted by set, then binding
+		const std::vector<ReflectedBinding>& getBindings() { return bindings; }
+		//Vertex shaders only, sorted by location
+		const std::vector<ReflectedInput>& getInputs() { return inputs; }
+		//Size 0 without a push constant block. Offset is the first member's
+		bool hasPushConstants() { return pushConstants.size > 0; }
+		const VkPushConstantRange& getPushConstantRange() { return pushConstants; }
+
+	private:
+		VkShaderStageFlagBits stage = VK_SHADER_STAGE_ALL;
+		std::vector<ReflectedBinding> bindings;
+		std::vector<ReflectedInput> inputs;
+		VkPushConstantRange pushConstants{};
+	};
+}
+
+#endif
@@ -33,7 +33,12 @@ SwapChain::SwapChain(PhysicalDevice *device, LogicalDevice *lDevice, VkSurfaceKH
 	createInfo.imageArrayLayers = 1;
 	//Below indicates that we are rendering directly to the swap chain
 	//Opposed to using the swap chain as an intermediate processing buffer
-	createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+	imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+	//Unless post-processing is on, then the result gets blitted in. Only where the surface allows it
+	if (swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT) {
+		imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	}
+	createInfo.imageUsage = imageUsage;
 
 	vkn::QueueFamilyIndices indices = device->findQueueFamilies(surface);
 	uint32_t queueFamilyIndices[] = { indices.graphicsFamily.value(), indices.presentFamily.value() };
@@ -19,6 +19,7 @@ namespace vkn {
 		VkPresentModeKHR getPresentMode() { return presentMode; }
 		VkSwapchainKHR getSwapChain() { return swapChain; }
 		const std::vector<VkImage>& getImages() { return images; };
+		VkImageUsageFlags getImageUsage() { return imageUsage; }
 
 
 	private:
@@ -34,6 +35,7 @@ namespace vkn {
 		VkExtent2D extent;
 		VkSurfaceFormatKHR surfaceFormat;
 		VkPresentModeKHR presentMode;
+		VkImageUsageFlags imageUsage;
 		GLFWwindow* window;
 	};
 }
@@ -0,0 +1,718 @@
+#include "TextureLoader.h"
+
+#include <fstream>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+namespace vkn {
+
+	static uint32_t readU32(const std::vector<unsigned char>& file, size_t offset) {
+		uint32_t value;
+		memcpy(&value, file.data() + offset, sizeof(value));
+		return value;
+	}
+
+	static uint64_t readU64(const std::vector<unsigned char>& file, size_t offset) {
+		uint64_t value;
+		memcpy(&value, file.data() + offset, sizeof(value));
+		return value;
+	}
+
+	static uint32_t makeFourCC(const char* code) {
+		return uint32_t(uint8_t(code[0])) | (uint32_t(uint8_t(code[1])) << 8) |
+			(uint32_t(uint8_t(code[2])) << 16) | (uint32_t(uint8_t(code[3])) << 24);
+	}
+
+	//Formats we are willing to hand to the streamer as-is
+	static bool isSupportedFormat(VkFormat format) {
+		switch (format) {
+		case VK_FORMAT_R8G8B8A8_UNORM:
+		case VK_FORMAT_R8G8B8A8_SRGB:
+			return true;
+		default:
+			return TextureLoader::isBlockCompressed(format);
+		}
+	}
+
+	bool TextureLoader::isContainer(const std::string& path) {
+		size_t dot = path.find_last_of('.');
+		if (dot == std::string::npos) {
+			return false;
+		}
+		std::string extension = path.substr(dot + 1);
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return static_cast<char>(tolower(c)); });
+		return extension == "ktx2" || extension == "dds";
+	}
+
+	TextureData* TextureLoader::load(const std::string& path) {
+		std::ifstream file(path, std::ios::ate | std::ios::binary);
+		if (!file.is_open()) {
+			throw std::runtime_error("failed to open texture file " + path + "!");
+		}
+
+		size_t fileSize = (size_t)file.tellg();
+		std::vector<unsigned char> buffer(fileSize);
+		file.seekg(0);
+		file.read(reinterpret_cast<char*>(buffer.data()), fileSize);
+		file.close();
+
+		static const unsigned char ktx2Identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+		if (fileSize >= sizeof(ktx2Identifier) && memcmp(buffer.data(), ktx2Identifier, sizeof(ktx2Identifier)) == 0) {
+			return loadKtx2(buffer);
+		}
+		if (fileSize >= 4 && readU32(buffer, 0) == makeFourCC("DDS ")) {
+			return loadDds(buffer);
+		}
+		throw std::runtime_error("unrecognised texture container " + path + "!");
+	}
+
+	//Layout: identifier, 9 uint32 header fields, 32 byte index, then one
+	//{offset, length, uncompressedLength} entry per level, level 0 first
+	TextureData* TextureLoader::loadKtx2(const std::vector<unsigned char>& file) {
+		const size_t headerEnd = 12 + 9 * 4 + 32;
+		if (file.size() < headerEnd) {
+			throw std::runtime_error("truncated KTX2 header!");
+		}
+
+		VkFormat format = static_cast<VkFormat>(readU32(file, 12));
+		uint32_t width = readU32(file, 20);
+		uint32_t height = readU32(file, 24);
+		uint32_t depth = readU32(file, 28);
+		uint32_t layerCount = readU32(file, 32);
+		uint32_t faceCount = readU32(file, 36);
+		//0 asks the loader to generate mips, which we can't do for compressed data
+		uint32_t levelCount = std::max(readU32(file, 40), 1u);
+		uint32_t supercompression = readU32(file, 44);
+
+		if (!isSupportedFormat(format)) {
+			throw std::runtime_error("unsupported KTX2 format!");
+		}
+		if (supercompression != 0) {
+			throw std::runtime_error("supercompressed KTX2 files are not supported!");
+		}
+		if (width == 0 || height == 0 || depth > 1 || layerCount > 1 || faceCount != 1) {
+			throw std::runtime_error("only single 2D KTX2 images are supported!");
+		}
+		if (levelCount > static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1) {
+			throw std::runtime_error("KTX2 file has more levels than its size allows!");
+		}
+		if (file.size() < headerEnd + size_t(levelCount) * 24) {
+			throw std::runtime_error("truncated KTX2 level index!");
+		}
+
+		TextureData* data = new TextureData();
+		data->format = format;
+		data->width = width;
+		data->height = height;
+		packMips(data, levelCount);
+
+		for (uint32_t level = 0; level < levelCount; level++) {
+			size_t entry = headerEnd + size_t(level) * 24;
+			uint64_t byteOffset = readU64(file, entry);
+			uint64_t byteLength = readU64(file, entry + 8);
+			const TextureData::Mip& mip = data->mips[level];
+			if (byteLength != mip.size || byteOffset > file.size() || byteLength > file.size() - byteOffset) {
+				delete data;
+				throw std::runtime_error("KTX2 level data doesn't match its header!");
+			}
+			memcpy(data->pixels.data() + mip.offset, file.data() + byteOffset, static_cast<size_t>(byteLength));
+		}
+
+		return data;
+	}
+
+	//Handles both the legacy FourCC header and the DX10 extension
+	TextureData* TextureLoader::loadDds(const std::vector<unsigned char>& file) {
+		const size_t headerSize = 4 + 124;
+		if (file.size() < headerSize) {
+			throw std::runtime_error("truncated DDS header!");
+		}
+
+		const uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+		const uint32_t DDPF_FOURCC = 0x4;
+		const uint32_t DDPF_RGB = 0x40;
+		const uint32_t DDSCAPS2_CUBEMAP = 0x200;
+		const uint32_t DDSCAPS2_VOLUME = 0x200000;
+
+		uint32_t flags = readU32(file, 8);
+		uint32_t height = readU32(file, 12);
+		uint32_t width = readU32(file, 16);
+		uint32_t levelCount = (flags & DDSD_MIPMAPCOUNT) ? std::max(readU32(file, 28), 1u) : 1;
+		uint32_t pixelFlags = readU32(file, 80);
+		uint32_t fourCC = readU32(file, 84);
+		uint32_t caps2 = readU32(file, 112);
+
+		if (width == 0 || height == 0 || (caps2 & (DDSCAPS2_CUBEMAP | DDSCAPS2_VOLUME))) {
+			throw std::runtime_error("only single 2D DDS images are supported!");
+		}
+
+		size_t dataStart = headerSize;
+		VkFormat format = VK_FORMAT_UNDEFINED;
+		if ((pixelFlags & DDPF_FOURCC) && fourCC == makeFourCC("DX10")) {
+			if (file.size() < headerSize + 20) {
+				throw std::runtime_error("truncated DDS DX10 header!");
+			}
+			dataStart += 20;
+			uint32_t dxgiFormat = readU32(file, headerSize);
+			uint32_t dimension = readU32(file, headerSize + 4);
+			uint32_t arraySize = readU32(file, headerSize + 12);
+			//3 is DDS_DIMENSION_TEXTURE2D
+			if (dimension != 3 || arraySize > 1) {
+				throw std::runtime_error("only single 2D DDS images are supported!");
+			}
+			switch (dxgiFormat) {
+			case 28: format = VK_FORMAT_R8G8B8A8_UNORM; break;
+			case 29: format = VK_FORMAT_R8G8B8A8_SRGB; break;
+			case 71: format = VK_FORMAT_BC1_RGBA_UNORM_BLOCK; break;
+			case 72: format = VK_FORMAT_BC1_RGBA_SRGB_BLOCK; break;
+			case 77: format = VK_FORMAT_BC3_UNORM_BLOCK; break;
+			case 78: format = VK_FORMAT_BC3_SRGB_BLOCK; break;
+			case 83: format = VK_FORMAT_BC5_UNORM_BLOCK; break;
+			case 84: format = VK_FORMAT_BC5_SNORM_BLOCK; break;
+			case 98: format = VK_FORMAT_BC7_UNORM_BLOCK; break;
+			case 99: format = VK_FORMAT_BC7_SRGB_BLOCK; break;
+			}
+		}
+		else if (pixelFlags & DDPF_FOURCC) {
+			//Legacy files don't say what colour space they are in. Colour maps are
+			//the common case for DXT1/5, two channel ones are almost always normals.
+			if (fourCC == makeFourCC("DXT1")) {
+				format = VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+			}
+			else if (fourCC == makeFourCC("DXT5")) {
+				format = VK_FORMAT_BC3_SRGB_BLOCK;
+			}
+			else if (fourCC == makeFourCC("ATI2") || fourCC == makeFourCC("BC5U")) {
+				format = VK_FORMAT_BC5_UNORM_BLOCK;
+			}
+			else if (fourCC == makeFourCC("BC5S")) {
+				format = VK_FORMAT_BC5_SNORM_BLOCK;
+			}
+		}
+		else if ((pixelFlags & DDPF_RGB) && readU32(file, 88) == 32 &&
+			readU32(file, 92) == 0x000000FF && readU32(file, 96) == 0x0000FF00 && readU32(file, 100) == 0x00FF0000) {
+			format = VK_FORMAT_R8G8B8A8_SRGB;
+		}
+
+		if (format == VK_FORMAT_UNDEFINED) {
+			throw std::runtime_error("unsupported DDS format!");
+		}
+		if (levelCount > static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1) {
+			throw std::runtime_error("DDS file has more levels than its size allows!");
+		}
+
+		TextureData* data = new TextureData();
+		data->format = format;
+		data->width = width;
+		data->height = height;
+		packMips(data, levelCount);
+
+		//DDS levels are already packed back to back, exactly like TextureData
+		if (file.size() - dataStart < data->pixels.size()) {
+			delete data;
+			throw std::runtime_error("truncated DDS level data!");
+		}
+		memcpy(data->pixels.data(), file.data() + dataStart, data->pixels.size());
+
+		return data;
+	}
+
+	void TextureLoader::packMips(TextureData* data, uint32_t levelCount) {
+		data->mips.clear();
+		VkDeviceSize offset = 0;
+		for (uint32_t level = 0, w = data->width, h = data->height; level < levelCount; level++) {
+			TextureData::Mip mip;
+			mip.offset = offset;
+			mip.size = getMipSize(data->format, w, h);
+			mip.width = w;
+			mip.height = h;
+			data->mips.push_back(mip);
+
+			offset += mip.size;
+			w = std::max(w / 2, 1u);
+			h = std::max(h / 2, 1u);
+		}
+		data->pixels.resize(static_cast<size_t>(offset));
+	}
+
+	bool TextureLoader::isBlockCompressed(VkFormat format) {
+		switch (format) {
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+		case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+		case VK_FORMAT_BC3_UNORM_BLOCK:
+		case VK_FORMAT_BC3_SRGB_BLOCK:
+		case VK_FORMAT_BC5_UNORM_BLOCK:
+		case VK_FORMAT_BC5_SNORM_BLOCK:
+		case VK_FORMAT_BC7_UNORM_BLOCK:
+		case VK_FORMAT_BC7_SRGB_BLOCK:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	TextureLoader::FormatInfo TextureLoader::getFormatInfo(VkFormat format) {
+		switch (format) {
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+		case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+			return { 4, 4, 8 };
+		case VK_FORMAT_BC3_UNORM_BLOCK:
+		case VK_FORMAT_BC3_SRGB_BLOCK:
+		case VK_FORMAT_BC5_UNORM_BLOCK:
+		case VK_FORMAT_BC5_SNORM_BLOCK:
+		case VK_FORMAT_BC7_UNORM_BLOCK:
+		case VK_FORMAT_BC7_SRGB_BLOCK:
+			return { 4, 4, 16 };
+		case VK_FORMAT_R8G8_UNORM:
+		case VK_FORMAT_R8G8_SNORM:
+			return { 1, 1, 2 };
+		default:
+			return { 1, 1, 4 };
+		}
+	}
+
+	VkDeviceSize TextureLoader::getMipSize(VkFormat format, uint32_t width, uint32_t height) {
+		FormatInfo info = getFormatInfo(format);
+		VkDeviceSize blocksWide = (width + info.blockWidth - 1) / info.blockWidth;
+		VkDeviceSize blocksHigh = (height + info.blockHeight - 1) / info.blockHeight;
+		return blocksWide * blocksHigh * info.bytesPerBlock;
+	}
+
+	void TextureLoader::transcode(TextureData& data) {
+		if (!isBlockCompressed(data.format)) {
+			return;
+		}
+
+		VkFormat source = data.format;
+		switch (source) {
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+		case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+		case VK_FORMAT_BC3_SRGB_BLOCK:
+		case VK_FORMAT_BC7_SRGB_BLOCK:
+			data.format = VK_FORMAT_R8G8B8A8_SRGB;
+			break;
+		case VK_FORMAT_BC5_UNORM_BLOCK:
+			data.format = VK_FORMAT_R8G8_UNORM;
+			break;
+		case VK_FORMAT_BC5_SNORM_BLOCK:
+			data.format = VK_FORMAT_R8G8_SNORM;
+			break;
+		default:
+			data.format = VK_FORMAT_R8G8B8A8_UNORM;
+			break;
+		}
+
+		FormatInfo sourceInfo = getFormatInfo(source);
+		size_t texelSize = getFormatInfo(data.format).bytesPerBlock;
+		std::vector<TextureData::Mip> sourceMips = data.mips;
+		//Compressed blocks may live in memory we don't own, the output never does
+		std::vector<unsigned char> ownedPixels;
+		ownedPixels.swap(data.pixels);
+		const unsigned char* sourcePixels = data.source != nullptr ? data.source : ownedPixels.data();
+		data.source = nullptr;
+		packMips(&data, static_cast<uint32_t>(sourceMips.size()));
+
+		//Decode into a scratch 4x4 block, then copy out only the texels inside the mip
+		unsigned char texels[4 * 4 * 4];
+		size_t blockPitch = 4 * texelSize;
+		for (size_t level = 0; level < sourceMips.size(); level++) {
+			const TextureData::Mip& in = sourceMips[level];
+			const TextureData::Mip& out = data.mips[level];
+			uint32_t blocksWide = (in.width + 3) / 4;
+			uint32_t blocksHigh = (in.height + 3) / 4;
+			const unsigned char* block = sourcePixels + in.offset;
+
+			for (uint32_t by = 0; by < blocksHigh; by++) {
+				for (uint32_t bx = 0; bx < blocksWide; bx++, block += sourceInfo.bytesPerBlock) {
+					switch (source) {
+					case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+					case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+						decodeBc1(block, texels, blockPitch, false);
+						//No alpha in the RGB variants, the "transparent" entry is plain black
+						for (int i = 0; i < 16; i++) {
+							texels[i * 4 + 3] = 255;
+						}
+						break;
+					case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+					case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+						decodeBc1(block, texels, blockPitch, false);
+						break;
+					case VK_FORMAT_BC3_UNORM_BLOCK:
+					case VK_FORMAT_BC3_SRGB_BLOCK:
+						decodeBc1(block + 8, texels, blockPitch, true);
+						decodeBc4(block, texels + 3, blockPitch, 4, false);
+						break;
+					case VK_FORMAT_BC7_UNORM_BLOCK:
+					case VK_FORMAT_BC7_SRGB_BLOCK:
+						decodeBc7(block, texels, blockPitch);
+						break;
+					default:
+						decodeBc4(block, texels, blockPitch, 2, source == VK_FORMAT_BC5_SNORM_BLOCK);
+						decodeBc4(block + 8, texels + 1, blockPitch, 2, source == VK_FORMAT_BC5_SNORM_BLOCK);
+						break;
+					}
+
+					uint32_t copyWidth = std::min(4u, in.width - bx * 4);
+					uint32_t copyHeight = std::min(4u, in.height - by * 4);
+					for (uint32_t y = 0; y < copyHeight; y++) {
+						memcpy(data.pixels.data() + out.offset + ((size_t(by) * 4 + y) * out.width + size_t(bx) * 4) * texelSize,
+							texels + y * blockPitch, copyWidth * texelSize);
+					}
+				}
+			}
+		}
+	}
+
+	//Averages 2x2 blocks in linear space. Odd dimensions clamp at the edge.
+	void TextureLoader::generateMips(TextureData& data) {
+		//Function local static, so building it is safe with several workers in here at once
+		static const std::vector<float> srgbToLinear = []() {
+			std::vector<float> table(256);
+			for (int i = 0; i < 256; i++) {
+				float c = i / 255.0f;
+				table[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+			}
+			return table;
+		}();
+		auto linearToSrgb = [](float c) {
+			c = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+			return static_cast<unsigned char>(std::min(std::max(c * 255.0f + 0.5f, 0.0f), 255.0f));
+		};
+
+		uint32_t mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(data.width, data.height)))) + 1;
+		data.mips.clear();
+		data.mips.push_back({ 0, VkDeviceSize(data.width) * data.height * 4, data.width, data.height });
+
+		//Reserve up front so the source pointer stays valid while appending
+		VkDeviceSize total = 0;
+		for (uint32_t level = 0, w = data.width, h = data.height; level < mipLevels; level++) {
+			total += VkDeviceSize(w) * h * 4;
+			w = std::max(w / 2, 1u);
+			h = std::max(h / 2, 1u);
+		}
+		data.pixels.resize(total);
+
+		for (uint32_t level = 1; level < mipLevels; level++) {
+			const TextureData::Mip& src = data.mips[level - 1];
+			TextureData::Mip dst;
+			dst.width = std::max(src.width / 2, 1u);
+			dst.height = std::max(src.height / 2, 1u);
+			dst.offset = src.offset + src.size;
+			dst.size = VkDeviceSize(dst.width) * dst.height * 4;
+
+			const unsigned char* in = data.pixels.data() + src.offset;
+			unsigned char* out = data.pixels.data() + dst.offset;
+			for (uint32_t y = 0; y < dst.height; y++) {
+				uint32_t y0 = std::min(y * 2, src.height - 1);
+				uint32_t y1 = std::min(y * 2 + 1, src.height - 1);
+				for (uint32_t x = 0; x < dst.width; x++) {
+					uint32_t x0 = std::min(x * 2, src.width - 1);
+					uint32_t x1 = std::min(x * 2 + 1, src.width - 1);
+					const unsigned char* p[4] = {
+						in + (size_t(y0) * src.width + x0) * 4, in + (size_t(y0) * src.width + x1) * 4,
+						in + (size_t(y1) * src.width + x0) * 4, in + (size_t(y1) * src.width + x1) * 4
+					};
+					unsigned char* o = out + (size_t(y) * dst.width + x) * 4;
+					for (int c = 0; c < 3; c++) {
+						o[c] = linearToSrgb((srgbToLinear[p[0][c]] + srgbToLinear[p[1][c]] + srgbToLinear[p[2][c]] + srgbToLinear[p[3][c]]) * 0.25f);
+					}
+					o[3] = static_cast<unsigned char>((p[0][3] + p[1][3] + p[2][3] + p[3][3] + 2) / 4);
+				}
+			}
+			data.mips.push_back(dst);
+		}
+	}
+
+	//Two RGB565 endpoints plus a 2 bit index per texel. When color0 <= color1 the
+	//block is in 3 colour mode and index 3 is transparent black, except inside BC3.
+	void TextureLoader::decodeBc1(const unsigned char* block, unsigned char* out, size_t rowPitch, bool alwaysFourColor) {
+		uint32_t color0 = block[0] | (block[1] << 8);
+		uint32_t color1 = block[2] | (block[3] << 8);
+		uint32_t indices = block[4] | (block[5] << 8) | (block[6] << 16) | (uint32_t(block[7]) << 24);
+
+		unsigned char palette[4][4];
+		uint32_t endpoints[2] = { color0, color1 };
+		for (int i = 0; i < 2; i++) {
+			uint32_t r = (endpoints[i] >> 11) & 31;
+			uint32_t g = (endpoints[i] >> 5) & 63;
+			uint32_t b = endpoints[i] & 31;
+			palette[i][0] = static_cast<unsigned char>((r << 3) | (r >> 2));
+			palette[i][1] = static_cast<unsigned char>((g << 2) | (g >> 4));
+			palette[i][2] = static_cast<unsigned char>((b << 3) | (b >> 2));
+			palette[i][3] = 255;
+		}
+
+		for (int c = 0; c < 3; c++) {
+			if (alwaysFourColor || color0 > color1) {
+				palette[2][c] = static_cast<unsigned char>((2 * palette[0][c] + palette[1][c] + 1) / 3);
+				palette[3][c] = static_cast<unsigned char>((palette[0][c] + 2 * palette[1][c] + 1) / 3);
+			}
+			else {
+				palette[2][c] = static_cast<unsigned char>((palette[0][c] + palette[1][c] + 1) / 2);
+				palette[3][c] = 0;
+			}
+		}
+		palette[2][3] = 255;
+		palette[3][3] = (alwaysFourColor || color0 > color1) ? 255 : 0;
+
+		for (int i = 0; i < 16; i++) {
+			unsigned char* texel = out + (i / 4) * rowPitch + (i % 4) * 4;
+			memcpy(texel, palette[(indices >> (i * 2)) & 3], 4);
+		}
+	}
+
+	//Single channel block: two endpoints and a 3 bit index per texel. Also the
+	//alpha half of BC3 and each half of BC5.
+	void TextureLoader::decodeBc4(const unsigned char* block, unsigned char* out, size_t rowPitch, size_t pixelStride, bool isSigned) {
+		int endpoint0 = isSigned ? std::max(int(int8_t(block[0])), -127) : block[0];
+		int endpoint1 = isSigned ? std::max(int(int8_t(block[1])), -127) : block[1];
+
+		int palette[8];
+		palette[0] = endpoint0;
+		palette[1] = endpoint1;
+		if (endpoint0 > endpoint1) {
+			for (int i = 1; i < 7; i++) {
+				palette[i + 1] = static_cast<int>(std::floor(((7 - i) * endpoint0 + i * endpoint1) / 7.0f + 0.5f));
+			}
+		}
+		else {
+			for (int i = 1; i < 5; i++) {
+				palette[i + 1] = static_cast<int>(std::floor(((5 - i) * endpoint0 + i * endpoint1) / 5.0f + 0.5f));
+			}
+			palette[6] = isSigned ? -127 : 0;
+			palette[7] = isSigned ? 127 : 255;
+		}
+
+		uint64_t indices = 0;
+		for (int i = 0; i < 6; i++) {
+			indices |= uint64_t(block[2 + i]) << (8 * i);
+		}
+		for (int i = 0; i < 16; i++) {
+			int value = palette[(indices >> (i * 3)) & 7];
+			out[(i / 4) * rowPitch + (i % 4) * pixelStride] = isSigned ? static_cast<unsigned char>(int8_t(value)) : static_cast<unsigned char>(value);
+		}
+	}
+
+	//BC7 tables from the format spec
+
+	struct Bc7Mode {
+		uint32_t subsets;
+		uint32_t partitionBits;
+		uint32_t rotationBits;
+		uint32_t indexSelectionBits;
+		uint32_t colorBits;
+		uint32_t alphaBits;
+		uint32_t endpointPBits;
+		uint32_t sharedPBits;
+		uint32_t indexBits;
+		uint32_t indexBits2;
+	};
+
+	static const Bc7Mode bc7Modes[8] = {
+		{ 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+		{ 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+		{ 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+		{ 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+		{ 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+		{ 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+		{ 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+		{ 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 }
+	};
+
+	//Bit i set means texel i belongs to subset 1
+	static const uint16_t bc7Partitions2[64] = {
+		0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80, 0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+		0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE, 0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+		0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A, 0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+		0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C, 0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22
+	};
+
+	static const uint8_t bc7Partitions3[64][16] = {
+		{ 0,0,1,1,0,0,1,1,0,2,2,1,2,2,2,2 }, { 0,0,0,1,0,0,1,1,2,2,1,1,2,2,2,1 }, { 0,0,0,0,2,0,0,1,2,2,1,1,2,2,1,1 }, { 0,2,2,2,0,0,2,2,0,0,1,1,0,1,1,1 },
+		{ 0,0,0,0,0,0,0,0,1,1,2,2,1,1,2,2 }, { 0,0,1,1,0,0,1,1,0,0,2,2,0,0,2,2 }, { 0,0,2,2,0,0,2,2,1,1,1,1,1,1,1,1 }, { 0,0,1,1,0,0,1,1,2,2,1,1,2,2,1,1 },
+		{ 0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2 }, { 0,0,0,0,1,1,1,1,1,1,1,1,2,2,2,2 }, { 0,0,0,0,1,1,1,1,2,2,2,2,2,2,2,2 }, { 0,0,1,2,0,0,1,2,0,0,1,2,0,0,1,2 },
+		{ 0,1,1,2,0,1,1,2,0,1,1,2,0,1,1,2 }, { 0,1,2,2,0,1,2,2,0,1,2,2,0,1,2,2 }, { 0,0,1,1,0,1,1,2,1,1,2,2,1,2,2,2 }, { 0,0,1,1,2,0,0,1,2,2,0,0,2,2,2,0 },
+		{ 0,0,0,1,0,0,1,1,0,1,1,2,1,1,2,2 }, { 0,1,1,1,0,0,1,1,2,0,0,1,2,2,0,0 }, { 0,0,0,0,1,1,2,2,1,1,2,2,1,1,2,2 }, { 0,0,2,2,0,0,2,2,0,0,2,2,1,1,1,1 },
+		{ 0,1,1,1,0,1,1,1,0,2,2,2,0,2,2,2 }, { 0,0,0,1,0,0,0,1,2,2,2,1,2,2,2,1 }, { 0,0,0,0,0,0,1,1,0,1,2,2,0,1,2,2 }, { 0,0,0,0,1,1,0,0,2,2,1,0,2,2,1,0 },
+		{ 0,1,2,2,0,1,2,2,0,0,1,1,0,0,0,0 }, { 0,0,1,2,0,0,1,2,1,1,2,2,2,2,2,2 }, { 0,1,1,0,1,2,2,1,1,2,2,1,0,1,1,0 }, { 0,0,0,0,0,1,1,0,1,2,2,1,1,2,2,1 },
+		{ 0,0,2,2,1,1,0,2,1,1,0,2,0,0,2,2 }, { 0,1,1,0,0,1,1,0,2,0,0,2,2,2,2,2 }, { 0,0,1,1,0,1,2,2,0,1,2,2,0,0,1,1 }, { 0,0,0,0,2,0,0,0,2,2,1,1,2,2,2,1 },
+		{ 0,0,0,0,0,0,0,2,1,1,2,2,1,2,2,2 }, { 0,2,2,2,0,0,2,2,0,0,1,2,0,0,1,1 }, { 0,0,1,1,0,0,1,2,0,0,2,2,0,2,2,2 }, { 0,1,2,0,0,1,2,0,0,1,2,0,0,1,2,0 },
+		{ 0,0,0,0,1,1,1,1,2,2,2,2,0,0,0,0 }, { 0,1,2,0,1,2,0,1,2,0,1,2,0,1,2,0 }, { 0,1,2,0,2,0,1,2,1,2,0,1,0,1,2,0 }, { 0,0,1,1,2,2,0,0,1,1,2,2,0,0,1,1 },
+		{ 0,0,1,1,1,1,2,2,2,2,0,0,0,0,1,1 }, { 0,1,0,1,0,1,0,1,2,2,2,2,2,2,2,2 }, { 0,0,0,0,0,0,0,0,2,1,2,1,2,1,2,1 }, { 0,0,2,2,1,1,2,2,0,0,2,2,1,1,2,2 },
+		{ 0,0,2,2,0,0,1,1,0,0,2,2,0,0,1,1 }, { 0,2,2,0,1,2,2,1,0,2,2,0,1,2,2,1 }, { 0,1,0,1,2,2,2,2,2,2,2,2,0,1,0,1 }, { 0,0,0,0,2,1,2,1,2,1,2,1,2,1,2,1 },
+		{ 0,1,0,1,0,1,0,1,0,1,0,1,2,2,2,2 }, { 0,2,2,2,0,1,1,1,0,2,2,2,0,1,1,1 }, { 0,0,0,2,1,1,1,2,0,0,0,2,1,1,1,2 }, { 0,0,0,0,2,1,1,2,2,1,1,2,2,1,1,2 },
+		{ 0,2,2,2,0,1,1,1,0,1,1,1,0,2,2,2 }, { 0,0,0,2,1,1,1,2,1,1,1,2,0,0,0,2 }, { 0,1,1,0,0,1,1,0,0,1,1,0,2,2,2,2 }, { 0,0,0,0,0,0,0,0,2,1,1,2,2,1,1,2 },
+		{ 0,1,1,0,0,1,1,0,2,2,2,2,2,2,2,2 }, { 0,0,2,2,0,0,1,1,0,0,1,1,0,0,2,2 }, { 0,0,2,2,1,1,2,2,1,1,2,2,0,0,2,2 }, { 0,0,0,0,0,0,0,0,0,0,0,0,2,1,1,2 },
+		{ 0,0,0,2,0,0,0,1,0,0,0,2,0,0,0,1 }, { 0,2,2,2,1,2,2,2,0,2,2,2,1,2,2,2 }, { 0,1,0,1,2,2,2,2,2,2,2,2,2,2,2,2 }, { 0,1,1,1,2,0,1,1,2,2,0,1,2,2,2,0 }
+	};
+
+	//Anchor texels store their index with one bit less. Texel 0 always anchors subset 0.
+	static const uint8_t bc7Anchors2[64] = {
+		15,15,15,15,15,15,15,15,15,15,15,15,15,15,15,15, 15, 2, 8, 2, 2, 8, 8,15, 2, 8, 2, 2, 8, 8, 2, 2,
+		15,15, 6, 8, 2, 8,15,15, 2, 8, 2, 2, 2,15,15, 6,  6, 2, 6, 8,15,15, 2, 2,15,15,15,15,15, 2, 2,15
+	};
+
+	static const uint8_t bc7Anchors3Second[64] = {
+		 3, 3,15,15, 8, 3,15,15, 8, 8, 6, 6, 6, 5, 3, 3,  3, 3, 8,15, 3, 3, 6,10, 5, 8, 8, 6, 8, 5,15,15,
+		 8,15, 3, 5, 6,10, 8,15,15, 3,15, 5,15,15,15,15,  3,15, 5, 5, 5, 8, 5,10, 5,10, 8,13,15,12, 3, 3
+	};
+
+	static const uint8_t bc7Anchors3Third[64] = {
+		15, 8, 8, 3,15,15, 3, 8,15,15,15,15,15,15,15, 8, 15, 8,15, 3,15, 8,15, 8, 3,15, 6,10,15,15,10, 8,
+		15, 3,15,10,10, 8, 9,10, 6,15, 8,15, 3, 6, 6, 8, 15, 3,15,15,15,15,15,15,15,15,15,15, 3,15,15, 8
+	};
+
+	static const uint32_t bc7Weights2[4] = { 0, 21, 43, 64 };
+	static const uint32_t bc7Weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+	static const uint32_t bc7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	//Pulls fields out of a 128 bit block, least significant bit first
+	struct Bc7BitReader {
+		const unsigned char* block;
+		uint32_t position;
+
+		uint32_t read(uint32_t count) {
+			uint32_t value = 0;
+			for (uint32_t i = 0; i < count; i++, position++) {
+				value |= uint32_t((block[position >> 3] >> (position & 7)) & 1) << i;
+			}
+			return value;
+		}
+	};
+
+	static uint32_t bc7Interpolate(uint32_t e0, uint32_t e1, uint32_t index, uint32_t indexBits) {
+		const uint32_t* weights = indexBits == 2 ? bc7Weights2 : indexBits == 3 ? bc7Weights3 : bc7Weights4;
+		return ((64 - weights[index]) * e0 + weights[index] * e1 + 32) >> 6;
+	}
+
+	void TextureLoader::decodeBc7(const unsigned char* block, unsigned char* out, size_t rowPitch) {
+		uint32_t modeIndex = 0;
+		while (modeIndex < 8 && !(block[0] & (1 << modeIndex))) {
+			modeIndex++;
+		}
+		//Reserved mode, decodes to transparent black
+		if (modeIndex == 8) {
+			for (int y = 0; y < 4; y++) {
+				memset(out + y * rowPitch, 0, 16);
+			}
+			return;
+		}
+
+		const Bc7Mode& mode = bc7Modes[modeIndex];
+		Bc7BitReader reader = { block, modeIndex + 1 };
+		uint32_t partition = reader.read(mode.partitionBits);
+		uint32_t rotation = reader.read(mode.rotationBits);
+		uint32_t indexSelection = reader.read(mode.indexSelectionBits);
+
+		//[subset][endpoint][channel]
+		uint32_t endpoints[3][2][4];
+		for (uint32_t c = 0; c < 3; c++) {
+			for (uint32_t s = 0; s < mode.subsets; s++) {
+				endpoints[s][0][c] = reader.read(mode.colorBits);
+				endpoints[s][1][c] = reader.read(mode.colorBits);
+			}
+		}
+		for (uint32_t s = 0; s < mode.subsets; s++) {
+			endpoints[s][0][3] = reader.read(mode.alphaBits);
+			endpoints[s][1][3] = reader.read(mode.alphaBits);
+		}
+
+		uint32_t channels = mode.alphaBits > 0 ? 4 : 3;
+		uint32_t colorPrecision = mode.colorBits;
+		uint32_t alphaPrecision = mode.alphaBits;
+		if (mode.endpointPBits || mode.sharedPBits) {
+			for (uint32_t s = 0; s < mode.subsets; s++) {
+				uint32_t pBits[2];
+				pBits[0] = reader.read(1);
+				pBits[1] = mode.endpointPBits ? reader.read(1) : pBits[0];
+				for (uint32_t e = 0; e < 2; e++) {
+					for (uint32_t c = 0; c < channels; c++) {
+						endpoints[s][e][c] = (endpoints[s][e][c] << 1) | pBits[e];
+					}
+				}
+			}
+			colorPrecision++;
+			if (alphaPrecision > 0) {
+				alphaPrecision++;
+			}
+		}
+
+		//Replicate the top bits down to fill out 8 bits
+		for (uint32_t s = 0; s < mode.subsets; s++) {
+			for (uint32_t e = 0; e < 2; e++) {
+				for (uint32_t c = 0; c < 4; c++) {
+					uint32_t precision = c < 3 ? colorPrecision : alphaPrecision;
+					uint32_t& value = endpoints[s][e][c];
+					if (precision == 0) {
+						value = 255;
+						continue;
+					}
+					value <<= 8 - precision;
+					value |= value >> precision;
+				}
+			}
+		}
+
+		uint32_t subsetOf[16];
+		bool isAnchor[16];
+		for (uint32_t i = 0; i < 16; i++) {
+			if (mode.subsets == 2) {
+				subsetOf[i] = (bc7Partitions2[partition] >> i) & 1;
+				isAnchor[i] = i == 0 || i == bc7Anchors2[partition];
+			}
+			else if (mode.subsets == 3) {
+				subsetOf[i] = bc7Partitions3[partition][i];
+				isAnchor[i] = i == 0 || i == bc7Anchors3Second[partition] || i == bc7Anchors3Third[partition];
+			}
+			else {
+				subsetOf[i] = 0;
+				isAnchor[i] = i == 0;
+			}
+		}
+
+		uint32_t indices[16];
+		uint32_t indices2[16] = {};
+		for (uint32_t i = 0; i < 16; i++) {
+			indices[i] = reader.read(isAnchor[i] ? mode.indexBits - 1 : mode.indexBits);
+		}
+		if (mode.indexBits2 > 0) {
+			for (uint32_t i = 0; i < 16; i++) {
+				indices2[i] = reader.read(i == 0 ? mode.indexBits2 - 1 : mode.indexBits2);
+			}
+		}
+
+		for (uint32_t i = 0; i < 16; i++) {
+			const uint32_t (*e)[4] = endpoints[subsetOf[i]];
+			uint32_t colorIndex = indices[i];
+			uint32_t colorIndexBits = mode.indexBits;
+			uint32_t alphaIndex = indices[i];
+			uint32_t alphaIndexBits = mode.indexBits;
+			if (mode.indexBits2 > 0) {
+				//Modes 4 and 5 carry separate colour and alpha indices, mode 4 can swap which is which
+				if (indexSelection) {
+					colorIndex = indices2[i];
+					colorIndexBits = mode.indexBits2;
+				}
+				else {
+					alphaIndex = indices2[i];
+					alphaIndexBits = mode.indexBits2;
+				}
+			}
+
+			unsigned char texel[4];
+			for (uint32_t c = 0; c < 3; c++) {
+				texel[c] = static_cast<unsigned char>(bc7Interpolate(e[0][c], e[1][c], colorIndex, colorIndexBits));
+			}
+			texel[3] = static_cast<unsigned char>(bc7Interpolate(e[0][3], e[1][3], alphaIndex, alphaIndexBits));
+			if (rotation > 0) {
+				std::swap(texel[3], texel[rotation - 1]);
+			}
+			memcpy(out + (i / 4) * rowPitch + (i % 4) * 4, texel, 4);
+		}
+	}
+}
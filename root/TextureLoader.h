@@ -0,0 +1,76 @@
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#ifndef __TEXTURE_LOADER_H__
+#define __TEXTURE_LOADER_H__
+
+#include <string>
+#include <vector>
+
+namespace vkn {
+
+	//CPU side copy of a texture with every mip level packed back to back.
+	//Mip 0 is the full resolution image.
+	struct TextureData {
+		struct Mip {
+			VkDeviceSize offset;
+			VkDeviceSize size;
+			uint32_t width;
+			uint32_t height;
+		};
+
+		VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		std::vector<Mip> mips;
+		std::vector<unsigned char> pixels;
+		//When set, mip offsets are relative to this instead of pixels. Lets data
+		//be uploaded straight out of memory it doesn't own (a mapped asset pack),
+		//which then has to stay alive until the upload is done.
+		const unsigned char* source = nullptr;
+
+		const unsigned char* getPixels() const { return source != nullptr ? source : pixels.data(); }
+	};
+
+	//Reads pre-baked textures out of KTX2 and DDS containers. Block compressed
+	//payloads (BC1/BC3/BC5/BC7) and their mip chains are passed through untouched
+	//so they can be copied straight into the image.
+	//Everything here is static and touches no Vulkan objects, so it is safe on worker threads.
+	class TextureLoader {
+	public:
+		struct FormatInfo {
+			uint32_t blockWidth;
+			uint32_t blockHeight;
+			uint32_t bytesPerBlock;
+		};
+
+		//True for the file types load() understands, everything else goes through stb_image
+		static bool isContainer(const std::string& path);
+		//Throws if the file can't be read or holds something we don't handle
+		static TextureData* load(const std::string& path);
+		static TextureData* loadKtx2(const std::vector<unsigned char>& file);
+		static TextureData* loadDds(const std::vector<unsigned char>& file);
+
+		//Decompresses every mip in place for devices without textureCompressionBC.
+		//BC1/BC3/BC7 become RGBA8 and BC5 becomes RG8, keeping the colour space.
+		static void transcode(TextureData& data);
+		//Box filters level 0 down to 1x1, appending every level to data.pixels.
+		//Expects a single RGBA8 sRGB level.
+		static void generateMips(TextureData& data);
+
+		static bool isBlockCompressed(VkFormat format);
+		static FormatInfo getFormatInfo(VkFormat format);
+		//Tightly packed size of a single mip
+		static VkDeviceSize getMipSize(VkFormat format, uint32_t width, uint32_t height);
+
+	private:
+		static void packMips(TextureData* data, uint32_t levelCount);
+
+		//Each of these writes a 4x4 block of texels to out, rowPitch bytes apart
+		static void decodeBc1(const unsigned char* block, unsigned char* out, size_t rowPitch, bool alwaysFourColor);
+		static void decodeBc4(const unsigned char* block, unsigned char* out, size_t rowPitch, size_t pixelStride, bool isSigned);
+		static void decodeBc7(const unsigned char* block, unsigned char* out, size_t rowPitch);
+	};
+}
+
+#endif
@@ -0,0 +1,425 @@
+#include "TextureStreamer.h"
+#include <stb_image.h>
+
+#include <iostream>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+namespace vkn {
+
+	TextureStreamer::TextureStreamer(LogicalDevice* logicalDevice, ThreadPool* pool, uint32_t queueFamilyIndex, VkQueue uploadQueue, VkDeviceSize uploadBudget) {
+		device = logicalDevice;
+		threadPool = pool;
+		queue = uploadQueue;
+		transcodeBC = !device->getEnabledFeatures().textureCompressionBC;
+		//Keep every slot offset aligned for any texel/block size we copy
+		slotSize = (uploadBudget + 15) & ~VkDeviceSize(15);
+
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+		poolInfo.queueFamilyIndex = queueFamilyIndex;
+
+		if (vkCreateCommandPool(device->getDevice(), &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create texture upload command pool!");
+		}
+
+		//One persistently mapped staging buffer, carved into a region per slot
+		device->createBuffer(slotSize * UPLOAD_SLOTS, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingMemory);
+		void* mapped;
+		vkMapMemory(device->getDevice(), stagingMemory, 0, slotSize * UPLOAD_SLOTS, 0, &mapped);
+		stagingMapped = static_cast<unsigned char*>(mapped);
+
+		VkCommandBuffer commandBuffers[UPLOAD_SLOTS];
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = commandPool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandBufferCount = UPLOAD_SLOTS;
+		if (vkAllocateCommandBuffers(device->getDevice(), &allocInfo, commandBuffers) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate texture upload command buffers!");
+		}
+
+		VkFenceCreateInfo fenceInfo{};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		for (uint32_t i = 0; i < UPLOAD_SLOTS; i++) {
+			slots[i].commandBuffer = commandBuffers[i];
+			slots[i].stagingOffset = slotSize * i;
+			slots[i].inFlight = false;
+			if (vkCreateFence(device->getDevice(), &fenceInfo, nullptr, &slots[i].fence) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create texture upload fence!");
+			}
+		}
+
+		//1x1 white texture everything samples until its own data lands
+		TextureData* white = new TextureData();
+		white->width = 1;
+		white->height = 1;
+		white->pixels = { 255, 255, 255, 255 };
+		white->mips.push_back({ 0, 4, 1, 1 });
+		placeholder = request("placeholder", white);
+		flush();
+	}
+
+	TextureStreamer::~TextureStreamer() {
+		//Workers may still be writing into the decoded list
+		threadPool->wait();
+
+		for (uint32_t i = 0; i < UPLOAD_SLOTS; i++) {
+			if (slots[i].inFlight) {
+				vkWaitForFences(device->getDevice(), 1, &slots[i].fence, VK_TRUE, UINT64_MAX);
+			}
+			vkDestroyFence(device->getDevice(), slots[i].fence, nullptr);
+		}
+
+		for (auto& entry : decoded) {
+			delete entry.second;
+		}
+		for (RetiredView& retired : retiredViews) {
+			vkDestroyImageView(device->getDevice(), retired.view, nullptr);
+		}
+		for (Texture* texture : textures) {
+			destroyTexture(texture);
+		}
+
+		vkUnmapMemory(device->getDevice(), stagingMemory);
+		vkDestroyBuffer(device->getDevice(), stagingBuffer, nullptr);
+		vkFreeMemory(device->getDevice(), stagingMemory, nullptr);
+		vkDestroyCommandPool(device->getDevice(), commandPool, nullptr);
+	}
+
+	Texture* TextureStreamer::request(const std::string& path) {
+		Texture* texture = new Texture();
+		texture->path = path;
+		texture->fallback = placeholder;
+		textures.push_back(texture);
+
+		{
+			std::lock_guard<std::mutex> lock(decodedMutex);
+			outstandingDecodes++;
+		}
+		threadPool->submit([this, texture]() { decode(texture); });
+
+		return texture;
+	}
+
+	Texture* TextureStreamer::request(const std::string& name, TextureData* data) {
+		Texture* texture = new Texture();
+		texture->path = name;
+		texture->fallback = placeholder;
+		textures.push_back(texture);
+
+		//Decompressing is too slow for the render thread, hand it to a worker
+		if (transcodeBC && TextureLoader::isBlockCompressed(data->format)) {
+			{
+				std::lock_guard<std::mutex> lock(decodedMutex);
+				outstandingDecodes++;
+			}
+			threadPool->submit([this, texture, data]() {
+				TextureLoader::transcode(*data);
+				std::lock_guard<std::mutex> lock(decodedMutex);
+				decoded.push_back({ texture, data });
+				outstandingDecodes--;
+			});
+			return texture;
+		}
+
+		beginUpload(texture, data);
+		return texture;
+	}
+
+	//Runs on a worker thread. Must not touch any Vulkan objects.
+	void TextureStreamer::decode(Texture* texture) {
+		TextureData* data = nullptr;
+
+		if (TextureLoader::isContainer(texture->path)) {
+			try {
+				data = TextureLoader::load(texture->path);
+				if (transcodeBC) {
+					TextureLoader::transcode(*data);
+				}
+			}
+			catch (const std::exception& e) {
+				std::cerr << "failed to load texture image " << texture->path << ": " << e.what() << std::endl;
+				delete data;
+				data = nullptr;
+			}
+
+			std::lock_guard<std::mutex> lock(decodedMutex);
+			decoded.push_back({ texture, data });
+			outstandingDecodes--;
+			return;
+		}
+
+		int texWidth, texHeight, texChannels;
+		stbi_uc* pixels = stbi_load(texture->path.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+		if (pixels) {
+			data = new TextureData();
+			data->width = static_cast<uint32_t>(texWidth);
+			data->height = static_cast<uint32_t>(texHeight);
+			data->pixels.assign(pixels, pixels + static_cast<size_t>(texWidth) * texHeight * 4);
+			stbi_image_free(pixels);
+			TextureLoader::generateMips(*data);
+		}
+		else {
+			std::cerr << "failed to load texture image " << texture->path << ": " << stbi_failure_reason() << std::endl;
+		}
+
+		std::lock_guard<std::mutex> lock(decodedMutex);
+		decoded.push_back({ texture, data });
+		outstandingDecodes--;
+	}
+
+	//Creates the GPU image and queues every mip, smallest first
+	void TextureStreamer::beginUpload(Texture* texture, TextureData* data) {
+		texture->data = data;
+		texture->format = data->format;
+		texture->width = data->width;
+		texture->height = data->height;
+		texture->mipLevels = static_cast<uint32_t>(data->mips.size());
+		texture->residentMip = texture->mipLevels;
+		texture->pendingMips = texture->mipLevels;
+		texture->needsInitialTransition = true;
+
+		device->createImage(texture->width, texture->height, texture->mipLevels, texture->format, VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			texture->image, texture->memory);
+
+		for (uint32_t mip = texture->mipLevels; mip-- > 0;) {
+			pendingMips.insert({ data->mips[mip].size, { texture, mip, 0 } });
+		}
+	}
+
+	void TextureStreamer::update() {
+		frameCounter++;
+
+		//Oldest slot first. Stop at the first one still running so mips retire in order.
+		for (uint32_t i = 0; i < UPLOAD_SLOTS; i++) {
+			UploadSlot& slot = slots[(nextSlot + i) % UPLOAD_SLOTS];
+			if (!slot.inFlight) {
+				continue;
+			}
+			if (vkGetFenceStatus(device->getDevice(), slot.fence) != VK_SUCCESS) {
+				break;
+			}
+			retireSlot(slot);
+		}
+
+		while (!retiredViews.empty() && frameCounter - retiredViews.front().frame >= VIEW_RETIRE_FRAMES) {
+			vkDestroyImageView(device->getDevice(), retiredViews.front().view, nullptr);
+			retiredViews.erase(retiredViews.begin());
+		}
+
+		std::vector<std::pair<Texture*, TextureData*>> ready;
+		{
+			std::lock_guard<std::mutex> lock(decodedMutex);
+			ready.swap(decoded);
+		}
+		for (auto& entry : ready) {
+			if (entry.second == nullptr) {
+				entry.first->failed = true;
+				continue;
+			}
+			beginUpload(entry.first, entry.second);
+		}
+
+		UploadSlot& slot = slots[nextSlot];
+		if (!pendingMips.empty() && !slot.inFlight) {
+			recordSlot(slot);
+			nextSlot = (nextSlot + 1) % UPLOAD_SLOTS;
+		}
+	}
+
+	void TextureStreamer::flush() {
+		while (!isIdle()) {
+			update();
+			for (uint32_t i = 0; i < UPLOAD_SLOTS; i++) {
+				if (slots[i].inFlight) {
+					vkWaitForFences(device->getDevice(), 1, &slots[i].fence, VK_TRUE, UINT64_MAX);
+				}
+			}
+			if (pendingMips.empty()) {
+				//Nothing to record, so block on the workers instead of spinning
+				threadPool->wait();
+			}
+		}
+	}
+
+	bool TextureStreamer::isIdle() {
+		for (uint32_t i = 0; i < UPLOAD_SLOTS; i++) {
+			if (slots[i].inFlight) {
+				return false;
+			}
+		}
+		std::lock_guard<std::mutex> lock(decodedMutex);
+		return pendingMips.empty() && decoded.empty() && outstandingDecodes == 0;
+	}
+
+	//Copies as many pending rows as fit into this slot's staging region and submits
+	void TextureStreamer::recordSlot(UploadSlot& slot) {
+		vkResetCommandBuffer(slot.commandBuffer, 0);
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		vkBeginCommandBuffer(slot.commandBuffer, &beginInfo);
+
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = 1;
+
+		VkDeviceSize offset = 0;
+		while (!pendingMips.empty()) {
+			auto it = pendingMips.begin();
+			PendingMip& pending = it->second;
+			Texture* texture = pending.texture;
+			const TextureData::Mip& mip = texture->data->mips[pending.mip];
+
+			//Rows are rows of blocks, which for plain formats are just rows of texels
+			TextureLoader::FormatInfo formatInfo = TextureLoader::getFormatInfo(texture->format);
+			VkDeviceSize rowBytes = VkDeviceSize((mip.width + formatInfo.blockWidth - 1) / formatInfo.blockWidth) * formatInfo.bytesPerBlock;
+			uint32_t blockRows = (mip.height + formatInfo.blockHeight - 1) / formatInfo.blockHeight;
+			uint32_t rowsLeft = blockRows - pending.rowsDone;
+			uint32_t rowsThatFit = static_cast<uint32_t>((slotSize - offset) / rowBytes);
+			if (rowsThatFit == 0) {
+				break;
+			}
+			uint32_t rows = std::min(rowsLeft, rowsThatFit);
+
+			if (texture->needsInitialTransition) {
+				barrier.image = texture->image;
+				barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+				barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+				barrier.srcAccessMask = 0;
+				barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				barrier.subresourceRange.baseMipLevel = 0;
+				barrier.subresourceRange.levelCount = texture->mipLevels;
+				vkCmdPipelineBarrier(slot.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+					0, 0, nullptr, 0, nullptr, 1, &barrier);
+				texture->needsInitialTransition = false;
+			}
+
+			memcpy(stagingMapped + slot.stagingOffset + offset,
+				texture->data->getPixels() + mip.offset + rowBytes * pending.rowsDone,
+				static_cast<size_t>(rowBytes * rows));
+
+			VkBufferImageCopy region{};
+			region.bufferOffset = slot.stagingOffset + offset;
+			region.bufferRowLength = 0;
+			region.bufferImageHeight = 0;
+			region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			region.imageSubresource.mipLevel = pending.mip;
+			region.imageSubresource.baseArrayLayer = 0;
+			region.imageSubresource.layerCount = 1;
+			//The last block row may hang off the bottom of the mip, the extent stops at the edge
+			uint32_t firstTexelRow = pending.rowsDone * formatInfo.blockHeight;
+			region.imageOffset = { 0, static_cast<int32_t>(firstTexelRow), 0 };
+			region.imageExtent = { mip.width, std::min(rows * formatInfo.blockHeight, mip.height - firstTexelRow), 1 };
+			vkCmdCopyBufferToImage(slot.commandBuffer, stagingBuffer, texture->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+			offset += (rowBytes * rows + 15) & ~VkDeviceSize(15);
+			pending.rowsDone += rows;
+
+			if (pending.rowsDone < blockRows) {
+				//Slot is full, the rest of this mip goes next frame
+				break;
+			}
+
+			//Whole mip is in, hand it to the fragment shader
+			barrier.image = texture->image;
+			barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			barrier.subresourceRange.baseMipLevel = pending.mip;
+			barrier.subresourceRange.levelCount = 1;
+			vkCmdPipelineBarrier(slot.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+				0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+			slot.completedMips.push_back(texture);
+			pendingMips.erase(it);
+
+			//Everything is in staging, the CPU copy can go
+			texture->pendingMips--;
+			if (texture->pendingMips == 0) {
+				delete texture->data;
+				texture->data = nullptr;
+			}
+		}
+
+		vkEndCommandBuffer(slot.commandBuffer);
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &slot.commandBuffer;
+
+		vkResetFences(device->getDevice(), 1, &slot.fence);
+		if (vkQueueSubmit(queue, 1, &submitInfo, slot.fence) != VK_SUCCESS) {
+			throw std::runtime_error("failed to submit texture upload!");
+		}
+		slot.inFlight = true;
+	}
+
+	//Mips of a texture always finish smallest first (non-increasing sizes in the
+	//pending map, and equal sizes keep insertion order), so counting them is
+	//enough to know the resident range. Compressed tail mips all tie at one block.
+	void TextureStreamer::retireSlot(UploadSlot& slot) {
+		std::vector<Texture*> changed;
+		for (Texture* texture : slot.completedMips) {
+			texture->uploadedMips++;
+			texture->residentMip = texture->mipLevels - texture->uploadedMips;
+			if (changed.empty() || changed.back() != texture) {
+				changed.push_back(texture);
+			}
+		}
+		for (Texture* texture : changed) {
+			updateImageView(texture);
+		}
+
+		slot.completedMips.clear();
+		slot.inFlight = false;
+	}
+
+	void TextureStreamer::updateImageView(Texture* texture) {
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = texture->image;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = texture->format;
+		viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		viewInfo.subresourceRange.baseMipLevel = texture->residentMip;
+		viewInfo.subresourceRange.levelCount = texture->mipLevels - texture->residentMip;
+		viewInfo.subresourceRange.baseArrayLayer = 0;
+		viewInfo.subresourceRange.layerCount = 1;
+
+		VkImageView view;
+		if (vkCreateImageView(device->getDevice(), &viewInfo, nullptr, &view) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create texture image view!");
+		}
+
+		if (texture->imageView != VK_NULL_HANDLE) {
+			retiredViews.push_back({ texture->imageView, frameCounter });
+		}
+		texture->imageView = view;
+		texture->version++;
+	}
+
+	void TextureStreamer::destroyTexture(Texture* texture) {
+		if (texture->imageView != VK_NULL_HANDLE) {
+			vkDestroyImageView(device->getDevice(), texture->imageView, nullptr);
+		}
+		if (texture->image != VK_NULL_HANDLE) {
+			vkDestroyImage(device->getDevice(), texture->image, nullptr);
+			vkFreeMemory(device->getDevice(), texture->memory, nullptr);
+		}
+		delete texture->data;
+		delete texture;
+	}
+}
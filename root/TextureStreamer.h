@@ -0,0 +1,139 @@
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#ifndef __TEXTURE_STREAMER_H__
+#define __TEXTURE_STREAMER_H__
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include "LogicalDevice.h"
+#include "ThreadPool.h"
+#include "TextureLoader.h"
+
+namespace vkn {
+
+	//Handle returned by the streamer. Safe to use the moment it is requested,
+	//it just samples the placeholder until real data is on the GPU.
+	class Texture {
+	public:
+		//View over whatever mips are resident right now.
+		VkImageView getImageView() { return imageView != VK_NULL_HANDLE ? imageView : fallback->imageView; }
+		//Bumped every time getImageView() changes, so descriptor sets know to rewrite
+		uint32_t getVersion() { return version; }
+		bool isResident() { return image != VK_NULL_HANDLE && residentMip == 0; }
+		bool hasFailed() { return failed; }
+
+		uint32_t getWidth() { return width; }
+		uint32_t getHeight() { return height; }
+		uint32_t getMipLevels() { return mipLevels; }
+		VkFormat getFormat() { return format; }
+
+	private:
+		friend class TextureStreamer;
+
+		std::string path;
+		Texture* fallback = nullptr;
+		VkImage image = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkImageView imageView = VK_NULL_HANDLE;
+		VkFormat format = VK_FORMAT_UNDEFINED;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t mipLevels = 0;
+		//Lowest (most detailed) mip that has finished uploading. mipLevels means none.
+		uint32_t residentMip = 0;
+		uint32_t uploadedMips = 0;
+		uint32_t version = 0;
+		bool needsInitialTransition = false;
+		bool failed = false;
+
+		//Decoded data, released once every mip has been copied to staging
+		TextureData* data = nullptr;
+		uint32_t pendingMips = 0;
+	};
+
+	//Decodes textures on worker threads and trickles them onto the GPU a bit
+	//each frame. Smallest mips go first so everything gets a blurry version quickly.
+	class TextureStreamer {
+	public:
+		TextureStreamer() {}
+		TextureStreamer(LogicalDevice* device, ThreadPool* pool, uint32_t queueFamilyIndex, VkQueue queue)
+			: TextureStreamer(device, pool, queueFamilyIndex, queue, 16 * 1024 * 1024) {}
+		TextureStreamer(LogicalDevice* device, ThreadPool* pool, uint32_t queueFamilyIndex, VkQueue queue, VkDeviceSize uploadBudget);
+		~TextureStreamer();
+
+		//Returns immediately. Decode happens on the thread pool.
+		Texture* request(const std::string& path);
+		//Hand over data that has already been decoded (generated, or loaded from elsewhere)
+		Texture* request(const std::string& name, TextureData* data);
+		//Call once per frame from the render thread. Records at most one upload batch.
+		void update();
+		//Blocks until everything requested so far is resident
+		void flush();
+
+		Texture* getPlaceholder() { return placeholder; }
+		bool isIdle();
+
+	private:
+		struct PendingMip {
+			Texture* texture;
+			uint32_t mip;
+			uint32_t rowsDone;
+		};
+
+		struct UploadSlot {
+			VkCommandBuffer commandBuffer;
+			VkFence fence;
+			VkDeviceSize stagingOffset;
+			bool inFlight;
+			std::vector<Texture*> completedMips;
+		};
+
+		struct RetiredView {
+			VkImageView view;
+			uint64_t frame;
+		};
+
+		static const uint32_t UPLOAD_SLOTS = 2;
+		//Views can still be referenced by frames in flight when they get replaced
+		static const uint64_t VIEW_RETIRE_FRAMES = 4;
+
+		void decode(Texture* texture);
+		void beginUpload(Texture* texture, TextureData* data);
+		void retireSlot(UploadSlot& slot);
+		void recordSlot(UploadSlot& slot);
+		void updateImageView(Texture* texture);
+		void destroyTexture(Texture* texture);
+
+		LogicalDevice* device;
+		ThreadPool* threadPool;
+		//Device can't sample BC formats, decompress them on the worker instead
+		bool transcodeBC;
+		VkQueue queue;
+		VkCommandPool commandPool;
+
+		VkBuffer stagingBuffer;
+		VkDeviceMemory stagingMemory;
+		unsigned char* stagingMapped;
+		VkDeviceSize slotSize;
+
+		UploadSlot slots[UPLOAD_SLOTS];
+		uint32_t nextSlot = 0;
+		uint64_t frameCounter = 0;
+
+		std::vector<Texture*> textures;
+		Texture* placeholder = nullptr;
+		//Keyed on mip byte size so small mips from any texture jump the queue
+		std::multimap<VkDeviceSize, PendingMip> pendingMips;
+		std::vector<RetiredView> retiredViews;
+
+		//Filled by worker threads
+		std::mutex decodedMutex;
+		std::vector<std::pair<Texture*, TextureData*>> decoded;
+		uint32_t outstandingDecodes = 0;
+	};
+}
+
+#endif
@@ -0,0 +1,131 @@
+#include "ThreadPool.h"
+#include <atomic>
+#include <algorithm>
+
+namespace vkn {
+
+	ThreadPool::ThreadPool(uint32_t threadCount) {
+		if (threadCount == 0) {
+			uint32_t hardwareThreads = std::thread::hardware_concurrency();
+			threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+		}
+
+		for (uint32_t i = 0; i < threadCount; i++) {
+			workers.emplace_back(&ThreadPool::workerLoop, this);
+		}
+	}
+
+	ThreadPool::~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			stopping = true;
+		}
+		jobAvailable.notify_all();
+		for (std::thread& worker : workers) {
+			worker.join();
+		}
+	}
+
+	void ThreadPool::submit(std::function<void()> job) {
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			jobs.push_back(std::move(job));
+		}
+		jobAvailable.notify_one();
+	}
+
+	void ThreadPool::workerLoop() {
+		while (true) {
+			std::function<void()> job;
+			{
+				std::unique_lock<std::mutex> lock(queueMutex);
+				jobAvailable.wait(lock, [this] { return stopping || !jobs.empty(); });
+				//Finish whatever is queued before shutting down
+				if (jobs.empty()) {
+					return;
+				}
+				job = std::move(jobs.front());
+				jobs.pop_front();
+				activeJobs++;
+			}
+
+			job();
+
+			{
+				std::lock_guard<std::mutex> lock(queueMutex);
+				activeJobs--;
+				if (activeJobs == 0 && jobs.empty()) {
+					jobsFinished.notify_all();
+				}
+			}
+		}
+	}
+
+	//Lets a waiting thread steal a job off the queue
+	bool ThreadPool::runOne() {
+		std::function<void()> job;
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			if (jobs.empty()) {
+				return false;
+			}
+			job = std::move(jobs.front());
+			jobs.pop_front();
+			activeJobs++;
+		}
+
+		job();
+
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			activeJobs--;
+			if (activeJobs == 0 && jobs.empty()) {
+				jobsFinished.notify_all();
+			}
+		}
+		return true;
+	}
+
+	void ThreadPool::parallelFor(uint32_t count, uint32_t batchSize, const std::function<void(uint32_t, uint32_t)>& fn) {
+		if (count == 0) {
+			return;
+		}
+		batchSize = std::max(batchSize, 1u);
+		uint32_t batchCount = (count + batchSize - 1) / batchSize;
+
+		//Not worth the queue traffic for a single batch
+		if (batchCount == 1) {
+			fn(0, count);
+			return;
+		}
+
+		std::atomic<uint32_t> remaining(batchCount);
+		std::mutex doneMutex;
+		std::condition_variable done;
+
+		for (uint32_t batch = 0; batch < batchCount; batch++) {
+			uint32_t begin = batch * batchSize;
+			uint32_t end = std::min(begin + batchSize, count);
+			submit([&, begin, end]() {
+				fn(begin, end);
+				//Decrement under the lock so the caller can't return (and destroy
+				//these locals) between the count hitting zero and the notify
+				std::lock_guard<std::mutex> lock(doneMutex);
+				if (remaining.fetch_sub(1) == 1) {
+					done.notify_all();
+				}
+			});
+		}
+
+		//Help drain the queue rather than blocking straight away
+		while (remaining.load() > 0 && runOne()) {}
+
+		std::unique_lock<std::mutex> lock(doneMutex);
+		done.wait(lock, [&] { return remaining.load() == 0; });
+	}
+
+	void ThreadPool::wait() {
+		std::unique_lock<std::mutex> lock(queueMutex);
+		jobsFinished.wait(lock, [this] { return jobs.empty() && activeJobs == 0; });
+	}
+}
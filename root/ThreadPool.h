@@ -0,0 +1,46 @@
+#ifndef __THREAD_POOL_H__
+#define __THREAD_POOL_H__
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cstdint>
+
+namespace vkn {
+	//Fixed set of worker threads that chew through a shared job queue.
+	//Anything that would otherwise block the main thread (decoding, parsing)
+	//gets pushed in here.
+	class ThreadPool {
+	public:
+		//0 threads means "one per hardware thread, minus the main thread"
+		ThreadPool() : ThreadPool(0) {}
+		ThreadPool(uint32_t threadCount);
+		~ThreadPool();
+
+		void submit(std::function<void()> job);
+		//Splits [0, count) into batches and blocks until every batch has run.
+		//The calling thread helps out instead of sitting idle.
+		void parallelFor(uint32_t count, uint32_t batchSize, const std::function<void(uint32_t begin, uint32_t end)>& fn);
+		//Blocks until the queue is empty and no job is running
+		void wait();
+
+		uint32_t getThreadCount() { return static_cast<uint32_t>(workers.size()); }
+
+	private:
+		void workerLoop();
+		bool runOne();
+
+		std::vector<std::thread> workers;
+		std::deque<std::function<void()>> jobs;
+		std::mutex queueMutex;
+		std::condition_variable jobAvailable;
+		std::condition_variable jobsFinished;
+		uint32_t activeJobs = 0;
+		bool stopping = false;
+	};
+}
+
+#endif
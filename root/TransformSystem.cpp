@@ -0,0 +1,202 @@
+#include "TransformSystem.h"
+#include <atomic>
+#include <algorithm>
+#include <stdexcept>
+
+namespace vkn {
+
+	//Big enough that queueing a batch costs next to nothing next to running it
+	static const uint32_t TRANSFORM_BATCH_SIZE = 4096;
+
+	//Same as translate * mat4_cast(rotation) * scale, without the two full matrix products
+	static glm::mat4 composeLocal(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale) {
+		glm::mat3 r = glm::mat3_cast(rotation);
+		return glm::mat4(
+			glm::vec4(r[0] * scale.x, 0.0f),
+			glm::vec4(r[1] * scale.y, 0.0f),
+			glm::vec4(r[2] * scale.z, 0.0f),
+			glm::vec4(position, 1.0f));
+	}
+
+	TransformSystem::TransformSystem(ThreadPool* threadPool, uint32_t capacity) {
+		this->threadPool = threadPool;
+		positions.reserve(capacity);
+		rotations.reserve(capacity);
+		scales.reserve(capacity);
+		worldMatrices.reserve(capacity);
+		parents.reserve(capacity);
+		depths.reserve(capacity);
+		dirty.reserve(capacity);
+		slotToHandle.reserve(capacity);
+		handleToSlot.reserve(capacity);
+	}
+
+	TransformHandle TransformSystem::create(TransformHandle parent) {
+		if (parent != INVALID_TRANSFORM && parent >= handleToSlot.size()) {
+			throw std::runtime_error("transform parent doesn't exist!");
+		}
+		uint32_t parentSlot = parent == INVALID_TRANSFORM ? INVALID_TRANSFORM : handleToSlot[parent];
+		uint32_t depth = parentSlot == INVALID_TRANSFORM ? 0 : depths[parentSlot] + 1;
+		uint32_t slot = static_cast<uint32_t>(positions.size());
+		TransformHandle handle = static_cast<TransformHandle>(handleToSlot.size());
+
+		positions.push_back(glm::vec3(0.0f));
+		rotations.push_back(glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+		scales.push_back(glm::vec3(1.0f));
+		worldMatrices.push_back(glm::mat4(1.0f));
+		parents.push_back(parentSlot);
+		depths.push_back(depth);
+		dirty.push_back(1);
+		slotToHandle.push_back(handle);
+		handleToSlot.push_back(slot);
+		anyDirty = true;
+
+		//Appending to the deepest level or starting a new one keeps the order,
+		//anything else waits for a sort in the next update
+		uint32_t levelCount = getLevelCount();
+		if (sorted && levelCount > 0 && depth == levelCount - 1) {
+			levelStarts.back()++;
+		}
+		else if (sorted && depth == levelCount) {
+			levelStarts.push_back(slot + 1);
+		}
+		else {
+			sorted = false;
+		}
+		return handle;
+	}
+
+	void TransformSystem::markDirty(uint32_t slot) {
+		dirty[slot] = 1;
+		anyDirty = true;
+	}
+
+	void TransformSystem::setPosition(TransformHandle handle, const glm::vec3& position) {
+		uint32_t slot = handleToSlot[handle];
+		positions[slot] = position;
+		markDirty(slot);
+	}
+
+	void TransformSystem::setRotation(TransformHandle handle, const glm::quat& rotation) {
+		uint32_t slot = handleToSlot[handle];
+		rotations[slot] = rotation;
+		markDirty(slot);
+	}
+
+	void TransformSystem::setScale(TransformHandle handle, const glm::vec3& scale) {
+		uint32_t slot = handleToSlot[handle];
+		scales[slot] = scale;
+		markDirty(slot);
+	}
+
+	void TransformSystem::setLocal(TransformHandle handle, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale) {
+		uint32_t slot = handleToSlot[handle];
+		positions[slot] = position;
+		rotations[slot] = rotation;
+		scales[slot] = scale;
+		markDirty(slot);
+	}
+
+	TransformHandle TransformSystem::getParent(TransformHandle handle) {
+		uint32_t parentSlot = parents[handleToSlot[handle]];
+		return parentSlot == INVALID_TRANSFORM ? INVALID_TRANSFORM : slotToHandle[parentSlot];
+	}
+
+	void TransformSystem::sortByDepth() {
+		//Parents always have a lower depth, so a stable sort keeps them ahead of their children
+		uint32_t count = getCount();
+		uint32_t maxDepth = 0;
+		for (uint32_t slot = 0; slot < count; slot++) {
+			maxDepth = std::max(maxDepth, depths[slot]);
+		}
+		levelStarts.assign(maxDepth + 2, 0);
+		for (uint32_t slot = 0; slot < count; slot++) {
+			levelStarts[depths[slot] + 1]++;
+		}
+		for (uint32_t depth = 0; depth <= maxDepth; depth++) {
+			levelStarts[depth + 1] += levelStarts[depth];
+		}
+
+		std::vector<uint32_t> cursor(levelStarts.begin(), levelStarts.end() - 1);
+		std::vector<uint32_t> newSlots(count);
+		for (uint32_t slot = 0; slot < count; slot++) {
+			newSlots[slot] = cursor[depths[slot]]++;
+		}
+
+		std::vector<glm::vec3> newPositions(count);
+		std::vector<glm::quat> newRotations(count);
+		std::vector<glm::vec3> newScales(count);
+		std::vector<glm::mat4> newWorldMatrices(count);
+		std::vector<uint32_t> newParents(count);
+		std::vector<uint32_t> newDepths(count);
+		std::vector<uint8_t> newDirty(count);
+		std::vector<TransformHandle> newSlotToHandle(count);
+		for (uint32_t slot = 0; slot < count; slot++) {
+			uint32_t to = newSlots[slot];
+			newPositions[to] = positions[slot];
+			newRotations[to] = rotations[slot];
+			newScales[to] = scales[slot];
+			newWorldMatrices[to] = worldMatrices[slot];
+			newParents[to] = parents[slot] == INVALID_TRANSFORM ? INVALID_TRANSFORM : newSlots[parents[slot]];
+			newDepths[to] = depths[slot];
+			newDirty[to] = dirty[slot];
+			newSlotToHandle[to] = slotToHandle[slot];
+			handleToSlot[slotToHandle[slot]] = to;
+		}
+		positions.swap(newPositions);
+		rotations.swap(newRotations);
+		scales.swap(newScales);
+		worldMatrices.swap(newWorldMatrices);
+		parents.swap(newParents);
+		depths.swap(newDepths);
+		dirty.swap(newDirty);
+		slotToHandle.swap(newSlotToHandle);
+		sorted = true;
+	}
+
+	void TransformSystem::update() {
+		updatedCount = 0;
+		if (!anyDirty) {
+			return;
+		}
+		if (!sorted) {
+			sortByDepth();
+		}
+
+		//A level only reads the one above it, which is finished by the time it runs.
+		//Dirty flags trickle down as it goes, so a clean subtree costs one byte read per transform
+		std::atomic<uint32_t> updated(0);
+		auto updateRange = [&](uint32_t begin, uint32_t end) {
+			uint32_t batchUpdated = 0;
+			for (uint32_t slot = begin; slot < end; slot++) {
+				uint32_t parent = parents[slot];
+				if (parent != INVALID_TRANSFORM && dirty[parent]) {
+					dirty[slot] = 1;
+				}
+				if (!dirty[slot]) {
+					continue;
+				}
+				glm::mat4 local = composeLocal(positions[slot], rotations[slot], scales[slot]);
+				worldMatrices[slot] = parent == INVALID_TRANSFORM ? local : worldMatrices[parent] * local;
+				batchUpdated++;
+			}
+			updated += batchUpdated;
+		};
+
+		for (uint32_t level = 0; level < getLevelCount(); level++) {
+			uint32_t levelStart = levelStarts[level];
+			uint32_t levelSize = levelStarts[level + 1] - levelStart;
+			if (threadPool == nullptr) {
+				updateRange(levelStart, levelStart + levelSize);
+				continue;
+			}
+			threadPool->parallelFor(levelSize, TRANSFORM_BATCH_SIZE, [&](uint32_t begin, uint32_t end) {
+				updateRange(levelStart + begin, levelStart + end);
+			});
+		}
+
+		std::fill(dirty.begin(), dirty.end(), 0);
+		anyDirty = false;
+		updatedCount = updated;
+	}
+}
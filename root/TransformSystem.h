@@ -0,0 +1,80 @@
+#ifndef __TRANSFORM_SYSTEM_H__
+#define __TRANSFORM_SYSTEM_H__
+
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include "ThreadPool.h"
+
+namespace vkn {
+
+	typedef uint32_t TransformHandle;
+	const TransformHandle INVALID_TRANSFORM = ~0u;
+
+	//Local translation, rotation and scale for every object in the scene plus the
+	//world matrices they add up to, each kept in its own array (structure of
+	//arrays) so the update streams through memory.
+	//
+	//Storage is sorted by depth in the hierarchy, so every parent comes before
+	//its children and each level is one contiguous range. update() walks the
+	//levels in order and splits each one across the thread pool, and only
+	//recomputes transforms that were set since the last update or sit under one
+	//that was. Handles stay valid while the storage gets reordered underneath.
+	class TransformSystem {
+	public:
+		TransformSystem() {}
+		//Without a thread pool everything runs on the calling thread
+		TransformSystem(ThreadPool* threadPool, uint32_t capacity = 0);
+
+		//Starts out as the identity. Parents are fixed once created
+		TransformHandle create(TransformHandle parent = INVALID_TRANSFORM);
+
+		void setPosition(TransformHandle handle, const glm::vec3& position);
+		void setRotation(TransformHandle handle, const glm::quat& rotation);
+		void setScale(TransformHandle handle, const glm::vec3& scale);
+		void setLocal(TransformHandle handle, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale);
+
+		const glm::vec3& getPosition(TransformHandle handle) { return positions[handleToSlot[handle]]; }
+		const glm::quat& getRotation(TransformHandle handle) { return rotations[handleToSlot[handle]]; }
+		const glm::vec3& getScale(TransformHandle handle) { return scales[handleToSlot[handle]]; }
+		TransformHandle getParent(TransformHandle handle);
+		//As of the last update()
+		const glm::mat4& getWorldMatrix(TransformHandle handle) { return worldMatrices[handleToSlot[handle]]; }
+
+		//Brings every world matrix up to date. Does nothing when nothing changed
+		void update();
+
+		uint32_t getCount() { return static_cast<uint32_t>(positions.size()); }
+		uint32_t getLevelCount() { return static_cast<uint32_t>(levelStarts.size()) - 1; }
+		//How many world matrices the last update() recomputed
+		uint32_t getUpdatedCount() { return updatedCount; }
+
+	private:
+		//Counting sort of every array by depth, then fixes up parents and handles
+		void sortByDepth();
+		void markDirty(uint32_t slot);
+
+		ThreadPool* threadPool = nullptr;
+
+		//Indexed by slot
+		std::vector<glm::vec3> positions;
+		std::vector<glm::quat> rotations;
+		std::vector<glm::vec3> scales;
+		std::vector<glm::mat4> worldMatrices;
+		std::vector<uint32_t> parents;
+		std::vector<uint32_t> depths;
+		//Set by the setters, and during update() for everything under a dirty transform
+		std::vector<uint8_t> dirty;
+		std::vector<TransformHandle> slotToHandle;
+
+		std::vector<uint32_t> handleToSlot;
+		//levelStarts[d] is the first slot at depth d, with one past the end at the back
+		std::vector<uint32_t> levelStarts = { 0 };
+		bool sorted = true;
+		bool anyDirty = false;
+		uint32_t updatedCount = 0;
+	};
+}
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef __VERTEX_H__
+#define __VERTEX_H__
+
+#include <glm/glm.hpp>
+
+namespace vkn {
+
+	//Full precision vertex that loaders, the optimizer and the asset baker work
+	//with. What actually goes in a vertex buffer is decided by a VertexLayout.
+	struct Vertex {
+		glm::vec3 pos;
+		glm::vec3 color;
+		glm::vec2 texCoord;
+		glm::vec3 normal;
+	};
+}
+
+#endif
@@ -0,0 +1,201 @@
+#include "VertexLayout.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
+#include <stdexcept>
+#include <cstring>
+
+namespace vkn {
+
+	VertexQuantization VertexQuantization::fromBounds(const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+		VertexQuantization quantization;
+		quantization.offset = (boundsMin + boundsMax) * 0.5f;
+		glm::vec3 halfExtent = (boundsMax - boundsMin) * 0.5f;
+		quantization.scale = std::max(halfExtent.x, std::max(halfExtent.y, halfExtent.z));
+		if (!(quantization.scale > 0.0f)) {
+			quantization.scale = 1.0f;
+		}
+		return quantization;
+	}
+
+	glm::mat4 VertexQuantization::getDequantizeMatrix() const {
+		return glm::translate(glm::mat4(1.0f), offset) * glm::scale(glm::mat4(1.0f), glm::vec3(scale));
+	}
+
+	VertexLayout& VertexLayout::add(VertexAttribute attribute, AttributeEncoding encoding) {
+		Element element;
+		element.attribute = attribute;
+		element.encoding = encoding;
+		element.format = getFormat(encoding, attribute);
+		element.offset = stride;
+		elements.push_back(element);
+		stride += getSize(encoding, attribute);
+		return *this;
+	}
+
+	VertexLayout VertexLayout::getFullLayout() {
+		VertexLayout layout;
+		layout.add(VertexAttribute::Position, AttributeEncoding::Float32)
+			.add(VertexAttribute::Color, AttributeEncoding::Float32)
+			.add(VertexAttribute::TexCoord, AttributeEncoding::Float32)
+			.add(VertexAttribute::Normal, AttributeEncoding::Float32);
+		return layout;
+	}
+
+	VertexLayout VertexLayout::getQuantizedLayout() {
+		VertexLayout layout;
+		layout.add(VertexAttribute::Position, AttributeEncoding::Snorm16)
+			.add(VertexAttribute::Normal, AttributeEncoding::Octahedral)
+			.add(VertexAttribute::Color, AttributeEncoding::Unorm8)
+			.add(VertexAttribute::TexCoord, AttributeEncoding::Half);
+		return layout;
+	}
+
+	bool VertexLayout::isQuantized() const {
+		for (const Element& element : elements) {
+			if (element.attribute == VertexAttribute::Position && element.encoding != AttributeEncoding::Float32) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	VkVertexInputBindingDescription VertexLayout::getBindingDescription(uint32_t binding) const {
+		VkVertexInputBindingDescription bindingDescription{};
+		bindingDescription.binding = binding;
+		bindingDescription.stride = stride;
+		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+		return bindingDescription;
+	}
+
+	std::vector<VkVertexInputAttributeDescription> VertexLayout::getAttributeDescriptions(uint32_t binding) const {
+		std::vector<VkVertexInputAttributeDescription> attributeDescriptions(elements.size());
+		for (size_t i = 0; i < elements.size(); i++) {
+			attributeDescriptions[i].binding = binding;
+			attributeDescriptions[i].location = static_cast<uint32_t>(elements[i].attribute);
+			attributeDescriptions[i].format = elements[i].format;
+			attributeDescriptions[i].offset = elements[i].offset;
+		}
+		return attributeDescriptions;
+	}
+
+	uint32_t VertexLayout::getSize(AttributeEncoding encoding, VertexAttribute attribute) {
+		switch (encoding) {
+		case AttributeEncoding::Float32:
+			return attribute == VertexAttribute::TexCoord ? 8 : 12;
+		case AttributeEncoding::Snorm16:
+			return 8;
+		case AttributeEncoding::Half:
+			return attribute == VertexAttribute::TexCoord ? 4 : 8;
+		case AttributeEncoding::Octahedral:
+		case AttributeEncoding::Unorm8:
+			return 4;
+		}
+		return 0;
+	}
+
+	VkFormat VertexLayout::getFormat(AttributeEncoding encoding, VertexAttribute attribute) {
+		bool isTexCoord = attribute == VertexAttribute::TexCoord;
+		switch (encoding) {
+		case AttributeEncoding::Float32:
+			return isTexCoord ? VK_FORMAT_R32G32_SFLOAT : VK_FORMAT_R32G32B32_SFLOAT;
+		case AttributeEncoding::Snorm16:
+			//UVs tile outside [-1, 1] and colors are never negative
+			if (attribute == VertexAttribute::Position || attribute == VertexAttribute::Normal) {
+				//Three component 16 bit formats are barely supported for vertex input
+				return VK_FORMAT_R16G16B16A16_SNORM;
+			}
+			break;
+		case AttributeEncoding::Half:
+			return isTexCoord ? VK_FORMAT_R16G16_SFLOAT : VK_FORMAT_R16G16B16A16_SFLOAT;
+		case AttributeEncoding::Octahedral:
+			if (attribute == VertexAttribute::Normal) {
+				return VK_FORMAT_R16G16_SNORM;
+			}
+			break;
+		case AttributeEncoding::Unorm8:
+			if (attribute == VertexAttribute::Color) {
+				return VK_FORMAT_R8G8B8A8_UNORM;
+			}
+			break;
+		}
+		throw std::runtime_error("unsupported vertex attribute encoding!");
+	}
+
+	//Projects onto the octahedron |x| + |y| + |z| = 1 and folds the bottom half
+	//over the top. Undone in InstancedVertex.vert built with -DQUANTIZED
+	static glm::vec2 encodeOctahedral(const glm::vec3& normal) {
+		float sum = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+		if (sum == 0.0f) {
+			return glm::vec2(0.0f);
+		}
+		glm::vec3 n = normal / sum;
+		if (n.z >= 0.0f) {
+			return glm::vec2(n.x, n.y);
+		}
+		return glm::vec2((1.0f - std::abs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f),
+			(1.0f - std::abs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f));
+	}
+
+	void VertexLayout::pack(const Vertex* vertices, size_t count, const VertexQuantization& quantization, void* out) const {
+		unsigned char* dst = static_cast<unsigned char*>(out);
+		float inverseScale = 1.0f / quantization.scale;
+		//Each vertex is built here first, then written out whole. out is usually
+		//write combined staging memory
+		std::vector<unsigned char> packed(stride);
+
+		for (size_t v = 0; v < count; v++) {
+			const Vertex& vertex = vertices[v];
+			for (const Element& element : elements) {
+				unsigned char* p = packed.data() + element.offset;
+				glm::vec4 value;
+				switch (element.attribute) {
+				case VertexAttribute::Position:
+					value = glm::vec4(element.encoding == AttributeEncoding::Float32 ? vertex.pos : (vertex.pos - quantization.offset) * inverseScale, 1.0f);
+					break;
+				case VertexAttribute::Color:
+					value = glm::vec4(vertex.color, 1.0f);
+					break;
+				case VertexAttribute::TexCoord:
+					value = glm::vec4(vertex.texCoord, 0.0f, 0.0f);
+					break;
+				case VertexAttribute::Normal:
+					value = glm::vec4(vertex.normal, 0.0f);
+					break;
+				}
+
+				switch (element.encoding) {
+				case AttributeEncoding::Float32:
+					std::memcpy(p, &value.x, getSize(element.encoding, element.attribute));
+					break;
+				case AttributeEncoding::Snorm16: {
+					uint64_t bits = glm::packSnorm4x16(glm::clamp(value, -1.0f, 1.0f));
+					std::memcpy(p, &bits, sizeof(bits));
+					break;
+				}
+				case AttributeEncoding::Half:
+					if (element.attribute == VertexAttribute::TexCoord) {
+						uint32_t bits = glm::packHalf2x16(glm::vec2(value.x, value.y));
+						std::memcpy(p, &bits, sizeof(bits));
+					}
+					else {
+						uint64_t bits = glm::packHalf4x16(value);
+						std::memcpy(p, &bits, sizeof(bits));
+					}
+					break;
+				case AttributeEncoding::Octahedral: {
+					uint32_t bits = glm::packSnorm2x16(encodeOctahedral(glm::vec3(value.x, value.y, value.z)));
+					std::memcpy(p, &bits, sizeof(bits));
+					break;
+				}
+				case AttributeEncoding::Unorm8: {
+					uint32_t bits = glm::packUnorm4x8(glm::clamp(value, 0.0f, 1.0f));
+					std::memcpy(p, &bits, sizeof(bits));
+					break;
+				}
+				}
+			}
+			std::memcpy(dst + v * stride, packed.data(), stride);
+		}
+	}
+}
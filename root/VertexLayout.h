@@ -0,0 +1,87 @@
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#ifndef __VERTEX_LAYOUT_H__
+#define __VERTEX_LAYOUT_H__
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "Vertex.h"
+
+namespace vkn {
+
+	//Shader input location is the attribute's value, so every layout lines up
+	//with the same vertex shader inputs
+	enum class VertexAttribute : uint32_t {
+		Position = 0,
+		Color = 1,
+		TexCoord = 2,
+		Normal = 3
+	};
+
+	enum class AttributeEncoding {
+		//Same as vkn::Vertex, 4 bytes a component
+		Float32,
+		//xyzw snorm16, relative to the mesh bounds. 8 bytes
+		Snorm16,
+		//Half floats, 2 bytes a component (positions get padded to 4)
+		Half,
+		//Unit vector folded onto an octahedron, xy snorm16. 4 bytes. Normals only
+		Octahedral,
+		//rgba unorm8. 4 bytes. Colors only
+		Unorm8
+	};
+
+	//Snorm16 positions are stored as (pos - offset) / scale. The scale is the same
+	//on every axis so normals don't need correcting, which means dequantizing is
+	//just an extra translate and scale on the model matrix.
+	struct VertexQuantization {
+		glm::vec3 offset = glm::vec3(0.0f);
+		float scale = 1.0f;
+
+		static VertexQuantization fromBounds(const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+		glm::mat4 getDequantizeMatrix() const;
+	};
+
+	//Describes how vertices are laid out in a vertex buffer, generates the matching
+	//pipeline descriptions and packs vkn::Vertex data into it.
+	class VertexLayout {
+	public:
+		struct Element {
+			VertexAttribute attribute;
+			AttributeEncoding encoding;
+			VkFormat format;
+			uint32_t offset;
+		};
+
+		VertexLayout() {}
+
+		//Appends an attribute. Throws for encodings an attribute can't use
+		VertexLayout& add(VertexAttribute attribute, AttributeEncoding encoding);
+
+		//Matches vkn::Vertex exactly, 44 bytes
+		static VertexLayout getFullLayout();
+		//snorm16 position, octahedral normal, rgba8 color and half UVs, 20 bytes.
+		//Needs InstancedVertex.vert built with -DQUANTIZED for the normal
+		static VertexLayout getQuantizedLayout();
+
+		uint32_t getStride() const { return stride; }
+		const std::vector<Element>& getElements() const { return elements; }
+		bool isQuantized() const;
+		VkVertexInputBindingDescription getBindingDescription(uint32_t binding = 0) const;
+		std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions(uint32_t binding = 0) const;
+
+		//Writes count vertices to out, getStride() bytes apart. quantization is
+		//only used by Snorm16 positions
+		void pack(const Vertex* vertices, size_t count, const VertexQuantization& quantization, void* out) const;
+
+	private:
+		static uint32_t getSize(AttributeEncoding encoding, VertexAttribute attribute);
+		static VkFormat getFormat(AttributeEncoding encoding, VertexAttribute attribute);
+
+		std::vector<Element> elements;
+		uint32_t stride = 0;
+	};
+}
+
+#endif
@@ -30,7 +30,7 @@ void VulkanInstance::populateApplicationInfo(VkApplicationInfo& appInfo) {
 	appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
 	appInfo.pEngineName = "No Engine";
 	appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-	appInfo.apiVersion = VK_API_VERSION_1_0;
+	appInfo.apiVersion = VK_API_VERSION_1_1; //1.1 for vkGetPhysicalDeviceFeatures2
 }
 
 void VulkanInstance::getRequiredExtensions() {
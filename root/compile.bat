@@ -1,4 +1,11 @@
 C:\VulkanSDK\1.3.296.0\Bin/glslc.exe shaders/TriangleVertex.vert -o shaders/compiled/vert.spv
 C:\VulkanSDK\1.3.296.0\Bin/glslc.exe shaders/TriangleFragment.frag -o shaders/compiled/frag.spv
 C:\VulkanSDK\1.3.296.0\Bin/glslc.exe shaders/VertexShader.vert -o shaders/compiled/vertS.spv
+C:\VulkanSDK\1.3.296.0\Bin/glslc.exe shaders/BindlessFragment.frag -o shaders/compiled/bindlessFrag.spv
+C:\VulkanSDK\1.3.296.0\Bin/glslc.exe shaders/InstancedVertex.vert -o shaders/compiled/instancedVertS.spv
+C:\VulkanSDK\1.3.296.0\Bin/glslc.exe -DQUANTIZED shaders/InstancedVertex.vert -o shaders/compiled/quantizedInstancedVertS.spv
+C:\VulkanSDK\1.3.296.0\Bin/glslc.exe shaders/FrustumCull.comp -o shaders/compiled/frustumCull.spv
+C:\VulkanSDK\1.3.296.0\Bin/glslc.exe -DOCCLUSION shaders/FrustumCull.comp -o shaders/compiled/occlusionCull.spv
+C:\VulkanSDK\1.3.296.0\Bin/glslc.exe shaders/HiZDownsample.comp -o shaders/compiled/hizDownsample.spv
+C:\VulkanSDK\1.3.296.0\Bin/glslc.exe shaders/PostProcess.comp -o shaders/compiled/postProcess.spv
 pause
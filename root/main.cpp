@@ -1,5 +1,7 @@
 #define GLFW_INCLUDE_VULKAN
 #define GLM_FORCE_RADIANS
+//Vulkan's clip space depth runs 0 to 1, not OpenGL's -1 to 1
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 #include <GLFW/glfw3.h>
@@ -29,6 +31,98 @@
 #include "RenderPass.h"
 #include "GraphicsPipeline.h"
 #include "FrameBuffer.h"
+#include "ThreadPool.h"
+#include "TextureStreamer.h"
+#include "BindlessTable.h"
+#include "AssetPack.h"
+#include "Vertex.h"
+#include "MeshLoader.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "GeometryPool.h"
+#include "InstanceBatcher.h"
+#include "IndirectDrawBuffer.h"
+#include "ComputePipeline.h"
+#include "FrustumCuller.h"
+#include "CpuFrustumCuller.h"
+#include "HiZPyramid.h"
+#include "TransformSystem.h"
+#include "Bvh.h"
+#include "RenderQueue.h"
+#include "DescriptorAllocator.h"
+#include "DescriptorWriter.h"
+#include "RenderGraph.h"
+#include "PostProcessChain.h"
+
+//Baked by tools/AssetBaker. Entries are named after the loose file they came
+//from, and anything missing from the pack is loaded loose instead.
+const std::string ASSET_PACK_PATH = "root/assets.vknpack";
+
+//Upload vertices in the 20 byte quantized layout instead of full floats
+const bool QUANTIZE_VERTICES = true;
+
+//Starting size of the shared vertex and index buffers, grown to fit the model if it's bigger
+const uint32_t GEOMETRY_POOL_VERTICES = 1 << 20;
+const uint32_t GEOMETRY_POOL_INDICES = 1 << 22;
+
+//Copies of the model drawn per side of the grid, all in one instanced draw
+const uint32_t INSTANCE_GRID_SIZE = 1;
+const uint32_t MAX_INSTANCES = 1 << 17;
+
+//Batches go out as indirect commands instead of one vkCmdDrawIndexed each.
+//Needs drawIndirectFirstInstance, direct draws are used when it's missing
+const bool USE_INDIRECT_DRAWS = true;
+const uint32_t MAX_INDIRECT_DRAWS = 4096;
+
+//Cull instances against the view frustum in a compute pass and draw the
+//survivors with GPU written indirect commands. Takes over from the CPU written
+//indirect draws above, needs the same feature
+const bool GPU_FRUSTUM_CULLING = true;
+
+//When GPU culling isn't running, cull instances on the CPU before they're
+//submitted instead
+const bool CPU_FRUSTUM_CULLING = true;
+//Cull on the CPU by walking a BVH of the grid instead of testing every instance.
+//It's kept in the root's space, so spinning the grid never touches it. Off
+//tests every instance's sphere with CpuFrustumCuller's SIMD path instead
+const bool BVH_CULLING = true;
+//Each copy bobs up and down on its own, so the BVH gets its boxes refitted
+//every frame and rebuilt when they've drifted too far
+const bool BOB_INSTANCES = true;
+
+//Also cull against a depth pyramid built from the frame before. What that
+//hides gets tested again once this frame's depth is in. Needs GPU_FRUSTUM_CULLING
+const bool GPU_OCCLUSION_CULLING = true;
+
+//Lay depth down in a pass of its own first, then shade with an EQUAL depth
+//test so the fragment shader only runs once per pixel
+const bool DEPTH_PRE_PASS = true;
+
+//Draw into multisampled color and depth and resolve into the swap chain image
+//inside the render pass. Neither multisampled image is stored, so tilers never
+//write them out. Clamped to what the device supports. The pyramid samples
+//depth as a single sample image, so occlusion culling turns this off
+const VkSampleCountFlagBits MSAA_SAMPLES = VK_SAMPLE_COUNT_4_BIT;
+
+//Render into an HDR image and run these over it in compute before blitting
+//the result into the swap chain image. Needs the swap chain to take blits,
+//otherwise the scene goes straight to it as before
+const bool POST_PROCESSING = true;
+const std::vector<vkn::PostProcessStage> POST_PROCESS_STAGES = {
+	vkn::PostProcessStage::Tonemap, vkn::PostProcessStage::Blur, vkn::PostProcessStage::Sharpen
+};
+
+//Build coarser versions of loose models at load time (baked ones always have
+//them) and draw each instance with the coarsest one that's off by less than
+//LOD_PIXEL_ERROR pixels
+const bool GENERATE_LODS = true;
+const float LOD_PIXEL_ERROR = 1.0f;
+
+//Render queue passes, the depth pre-pass sorts ahead of shading
+const uint32_t DEPTH_QUEUE_PASS = 0;
+const uint32_t COLOR_QUEUE_PASS = 1;
+
+const float CAMERA_FAR_PLANE = 10.0f;
 
 const uint32_t WIDTH = 800;
 const uint32_t HEIGHT = 600;
@@ -52,49 +146,15 @@ const bool enableValidationLayers = true;
 #endif
 
 
-struct Vertex {
-	glm::vec2 pos;
-	glm::vec3 color;
-
-	//Defines the rate to sample data. How big is each chunk of data etc .
-	static VkVertexInputBindingDescription getBindingDescription() {
-		VkVertexInputBindingDescription bindingDescription{};
-		bindingDescription.binding = 0;
-		bindingDescription.stride = sizeof(Vertex);
-		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-		return bindingDescription;
-	}
-
-	//Defines how to extract data from bindings. We need one for each attr.
-	//Two here, in the case where we care about position and color
-	static std::array<VkVertexInputAttributeDescription, 2> getAttributeDescriptions() {
-		std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions{};
-		//Position description
-		attributeDescriptions[0].binding = 0;
-		attributeDescriptions[0].location = 0;
-		attributeDescriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
-		attributeDescriptions[0].offset = offsetof(Vertex, pos);
-
-		//Color description
-		attributeDescriptions[1].binding = 0;
-		attributeDescriptions[1].location = 1;
-		attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-		attributeDescriptions[1].offset = offsetof(Vertex, color);
-
-		return attributeDescriptions;
-
-	}
+//Drawn when no model is given on the command line
+const std::vector<vkn::Vertex> quadVertices = {
+	{{-0.5f, -0.5f, 0.0f}, {1.0f, 0.0f, 0.0f}, {1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}},
+	{{0.5f, -0.5f, 0.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f}, {0.0f, 0.0f, 1.0f}},
+	{{0.5f, 0.5f, 0.0f}, {0.0f, 0.0f, 1.0f}, {0.0f, 1.0f}, {0.0f, 0.0f, 1.0f}},
+	{{-0.5f, 0.5f, 0.0f}, {1.0f, 1.0f, 1.0f}, {1.0f, 1.0f}, {0.0f, 0.0f, 1.0f}}
 };
 
-const std::vector<Vertex> vertices = {
-	{{-0.5f, -0.5}, {1.0f, 0.0f, 0.0f}},
-	{{0.5f, -0.5f}, {0.0f, 1.0f, 0.0f}},
-	{{0.5f, 0.5f}, {0.0f, 0.0f, 1.0f}},
-	{{-0.5f, 0.5f}, {1.0f, 1.0f, 1.0f}}
-};
-
-const std::vector<uint16_t> indices = {
+const std::vector<uint32_t> quadIndices = {
 	0, 1, 2, 2, 3, 0
 };
 
@@ -133,6 +193,11 @@ int rateDeviceSuitability(VkPhysicalDevice device) {
 class HelloTriangleApplication {
 public:
 
+	//OBJ or glb to draw instead of the test quad
+	void setModelPath(const std::string& path) {
+		modelPath = path;
+	}
+
 	void run() {
 		initWindow();
 		initVulkan();
@@ -164,6 +229,7 @@ private:
 		window = glfwCreateWindow(WIDTH, HEIGHT, "Vulkan", nullptr, nullptr);
 		glfwSetWindowUserPointer(window, this);
 		glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
+		glfwSetMouseButtonCallback(window, mouseButtonCallback);
 	}
 
 	static void framebufferResizeCallback(GLFWwindow* window, int width, int height) {
@@ -171,6 +237,16 @@ private:
 		app->framebufferResized = true;
 	}
 
+	//Picked on the next frame, once the camera for it is known
+	static void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods) {
+		if (button != GLFW_MOUSE_BUTTON_LEFT || action != GLFW_PRESS) {
+			return;
+		}
+		auto app = reinterpret_cast<HelloTriangleApplication*>(glfwGetWindowUserPointer(window));
+		glfwGetCursorPos(window, &app->pickX, &app->pickY);
+		app->pickRequested = true;
+	}
+
 	void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& createInfo) {
 		createInfo = {};
 		createInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
@@ -186,6 +262,12 @@ private:
 		for (size_t i = 0; i < swapChainFramebuffers.size(); i++) {
 			delete(swapChainFramebuffers[i]);
 		}
+		delete(depthFramebuffer);
+		depthFramebuffer = nullptr;
+
+		//Takes the depth buffer with it
+		delete(renderGraph);
+		renderGraph = nullptr;
 
 		for (size_t i = 0; i < swapChainImageViews.size(); i++) {
 			vkDestroyImageView(vknDevice->getDevice(), swapChainImageViews[i], nullptr);
@@ -210,7 +292,13 @@ private:
 		//TODO Add reference to old swap chain. Differentiate between new and old swap chains
 		vknSwapChain = new vkn::SwapChain(vknPhysicalDevice, vknDevice, surface, window);
 		createImageViews();
+		createRenderGraph();
 		createFramebuffers();
+		//The pyramid follows the depth buffer's size
+		if (hiZPyramid != nullptr) {
+			hiZPyramid->resize(vknSwapChain->getExtent().width, vknSwapChain->getExtent().height, depthImageView);
+			frustumCuller->updatePyramid();
+		}
 
 	}
 
@@ -224,25 +312,254 @@ private:
 	void createImageViews() {
 		swapChainImageViews.resize(vknSwapChain->getImages().size());
 		for (size_t i = 0; i < vknSwapChain->getImages().size(); i++) {
-			swapChainImageViews[i] = createImageView(vknSwapChain->getImages()[i], vknSwapChain->getFormat().format);
+			swapChainImageViews[i] = createImageView(vknSwapChain->getImages()[i], vknSwapChain->getFormat().format, VK_IMAGE_ASPECT_COLOR_BIT);
+		}
+	}
+
+	//The frame as passes and what each of them touches, in the same order
+	//createRenderPasses splits it up. The graph works out every barrier and
+	//layout change between them, and owns the depth buffer as a transient
+	//image. One depth buffer is still shared by every frame in flight, its first
+	//use waits on whatever last touched it
+	void createRenderGraph() {
+		renderGraph = new vkn::RenderGraph(vknDevice);
+
+		//Swapped for the acquired image every frame. The acquire semaphore waits at
+		//color output, so that's the stage the image comes in from
+		swapChainTarget = renderGraph->importImage(vknSwapChain->getImages()[0], VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED,
+			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+
+		vkn::GraphImageDesc depthDesc{};
+		depthDesc.width = vknSwapChain->getExtent().width;
+		depthDesc.height = vknSwapChain->getExtent().height;
+		depthDesc.format = depthFormat;
+		depthDesc.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+		depthDesc.aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+		depthDesc.samples = msaaSamples;
+		//The pyramid build samples it
+		if (occlusionCulling) {
+			depthDesc.usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+		}
+		//Never outlives the one pass unless a pre-pass hands it on
+		if (depthPrePass == nullptr && !occlusionCulling) {
+			depthDesc.usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+		}
+		depthTarget = renderGraph->createImage(depthDesc);
+
+		//What the passes draw into when post-processing picks it up afterwards
+		if (postProcess != nullptr) {
+			vkn::GraphImageDesc sceneDesc{};
+			sceneDesc.width = vknSwapChain->getExtent().width;
+			sceneDesc.height = vknSwapChain->getExtent().height;
+			sceneDesc.format = colorFormat;
+			sceneDesc.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
+			sceneDesc.aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+			sceneColorTarget = renderGraph->createImage(sceneDesc);
+		}
+
+		//Only ever resolved from, so it can stay lazily allocated
+		if (msaaSamples != VK_SAMPLE_COUNT_1_BIT) {
+			vkn::GraphImageDesc colorDesc{};
+			colorDesc.width = vknSwapChain->getExtent().width;
+			colorDesc.height = vknSwapChain->getExtent().height;
+			colorDesc.format = colorFormat;
+			colorDesc.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+			colorDesc.aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+			colorDesc.samples = msaaSamples;
+			colorTarget = renderGraph->createImage(colorDesc);
 		}
+
+		//Compute work has to go in before the render passes start. The culler
+		//syncs its own buffers, the graph just has to keep it
+		uint32_t cullPass = renderGraph->addPass([this](VkCommandBuffer commandBuffer) {
+			if (frustumCuller != nullptr) {
+				frustumCuller->cull(commandBuffer, currentFrame, cullPipeline, cullMatrix);
+			}
+		});
+		renderGraph->setSideEffects(cullPass);
+
+		//With occlusion culling, whatever the first draws leave in the depth
+		//buffer builds the pyramid that decides what else gets drawn
+		if (depthPrePass != nullptr) {
+			uint32_t depthPass = renderGraph->addPass([this](VkCommandBuffer commandBuffer) {
+				beginRenderPass(commandBuffer, depthPrePass, depthFramebuffer);
+				drawScene(commandBuffer, depthPipeline, false);
+				vkCmdEndRenderPass(commandBuffer);
+			});
+			renderGraph->write(depthPass, depthTarget, vkn::GraphUsage::DepthAttachment, true);
+			if (depthLatePass != nullptr) {
+				addOcclusionPass();
+				uint32_t latePass = renderGraph->addPass([this](VkCommandBuffer commandBuffer) {
+					beginRenderPass(commandBuffer, depthLatePass, depthFramebuffer);
+					drawScene(commandBuffer, depthPipeline, true);
+					vkCmdEndRenderPass(commandBuffer);
+				});
+				renderGraph->write(latePass, depthTarget, vkn::GraphUsage::DepthAttachment);
+			}
+
+			//Depth is final, every pixel gets shaded once. Only tested, but it's
+			//still the pass's depth attachment
+			uint32_t colorPass = renderGraph->addPass([this](VkCommandBuffer commandBuffer) {
+				beginRenderPass(commandBuffer, vknRenderPass, swapChainFramebuffers[currentImageIndex]);
+				drawScene(commandBuffer, vknGraphicsPipeline, false);
+				drawScene(commandBuffer, vknGraphicsPipeline, true);
+				vkCmdEndRenderPass(commandBuffer);
+			});
+			writeColor(colorPass, true);
+			renderGraph->write(colorPass, depthTarget, vkn::GraphUsage::DepthAttachment);
+		}
+		else {
+			uint32_t colorPass = renderGraph->addPass([this](VkCommandBuffer commandBuffer) {
+				beginRenderPass(commandBuffer, vknRenderPass, swapChainFramebuffers[currentImageIndex]);
+				drawScene(commandBuffer, vknGraphicsPipeline, false);
+				vkCmdEndRenderPass(commandBuffer);
+			});
+			writeColor(colorPass, true);
+			renderGraph->write(colorPass, depthTarget, vkn::GraphUsage::DepthAttachment, true);
+			if (lateRenderPass != nullptr) {
+				addOcclusionPass();
+				uint32_t latePass = renderGraph->addPass([this](VkCommandBuffer commandBuffer) {
+					beginRenderPass(commandBuffer, lateRenderPass, swapChainFramebuffers[currentImageIndex]);
+					drawScene(commandBuffer, vknGraphicsPipeline, true);
+					vkCmdEndRenderPass(commandBuffer);
+				});
+				writeColor(latePass, false);
+				renderGraph->write(latePass, depthTarget, vkn::GraphUsage::DepthAttachment);
+			}
+		}
+
+		//The chain's passes, then its result goes out to the swap chain image
+		if (postProcess != nullptr) {
+			vkn::GraphResource processed = postProcess->addPasses(renderGraph, sceneColorTarget,
+				vknSwapChain->getExtent().width, vknSwapChain->getExtent().height, VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+			uint32_t presentPass = renderGraph->addPass([this, processed](VkCommandBuffer commandBuffer) {
+				blitToSwapChain(commandBuffer, processed);
+			});
+			renderGraph->read(presentPass, processed, vkn::GraphUsage::TransferSrc);
+			renderGraph->write(presentPass, swapChainTarget, vkn::GraphUsage::TransferDst, true);
+		}
+
+		renderGraph->compile();
+		depthImageView = renderGraph->getImageView(depthTarget);
+		if (msaaSamples != VK_SAMPLE_COUNT_1_BIT) {
+			colorImageView = renderGraph->getImageView(colorTarget);
+		}
+		if (postProcess != nullptr) {
+			sceneColorView = renderGraph->getImageView(sceneColorTarget);
+			postProcess->updateDescriptors(renderGraph);
+		}
+	}
+
+	//Same size, the blit just converts into the swap chain's format
+	void blitToSwapChain(VkCommandBuffer commandBuffer, vkn::GraphResource source) {
+		VkImageBlit blit{};
+		blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		blit.srcSubresource.mipLevel = 0;
+		blit.srcSubresource.baseArrayLayer = 0;
+		blit.srcSubresource.layerCount = 1;
+		blit.srcOffsets[1] = { static_cast<int32_t>(vknSwapChain->getExtent().width), static_cast<int32_t>(vknSwapChain->getExtent().height), 1 };
+		blit.dstSubresource = blit.srcSubresource;
+		blit.dstOffsets[1] = blit.srcOffsets[1];
+		vkCmdBlitImage(commandBuffer, renderGraph->getImage(source), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			renderGraph->getImage(swapChainTarget), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_NEAREST);
+	}
+
+	//With MSAA the pass draws into the multisampled target and resolves into
+	//the swap chain image (or the scene image), whose old contents never matter
+	void writeColor(uint32_t pass, bool discard) {
+		vkn::GraphResource target = postProcess != nullptr ? sceneColorTarget : swapChainTarget;
+		if (msaaSamples != VK_SAMPLE_COUNT_1_BIT) {
+			renderGraph->write(pass, colorTarget, vkn::GraphUsage::ColorAttachment, discard);
+			renderGraph->write(pass, target, vkn::GraphUsage::ColorAttachment, true);
+		}
+		else {
+			renderGraph->write(pass, target, vkn::GraphUsage::ColorAttachment, discard);
+		}
+	}
+
+	//Pyramid build and late cull between the early and late passes. Both only
+	//write their own buffers and images, which they sync themselves
+	void addOcclusionPass() {
+		uint32_t occlusionPass = renderGraph->addPass([this](VkCommandBuffer commandBuffer) {
+			cullOccluded(commandBuffer);
+		});
+		renderGraph->read(occlusionPass, depthTarget, vkn::GraphUsage::SampledCompute);
+		renderGraph->setSideEffects(occlusionPass);
+	}
+
+	//Where depth comes from decides how the frame is split up:
+	//  pre-pass            depth, main pass loads it and tests EQUAL
+	//  pre-pass, occlusion depth, pyramid, late depth, main pass
+	//  occlusion           main pass, pyramid, late pass loading color and depth
+	//  neither             main pass clears and tests its own depth
+	//Pipelines only care that formats match, so the late passes reuse the
+	//pipelines built for the first ones. The render graph does the layout
+	//changes, the layouts here only decide what gets cleared and what loaded
+	void createRenderPasses() {
+		vkn::RenderPassAttachments attachments;
+		attachments.colorFormat = colorFormat;
+		attachments.depthFormat = depthFormat;
+		attachments.managedByGraph = true;
+		attachments.samples = msaaSamples;
+
+		if (DEPTH_PRE_PASS) {
+			vkn::RenderPassAttachments depthOnly;
+			depthOnly.depthFormat = depthFormat;
+			depthOnly.managedByGraph = true;
+			depthOnly.samples = msaaSamples;
+			depthOnly.storeDepth = true;
+			depthPrePass = new vkn::RenderPass(vknDevice, depthOnly);
+			//Any initial layout but UNDEFINED just means load, the graph does the real one
+			if (occlusionCulling) {
+				depthOnly.depthInitialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+				depthLatePass = new vkn::RenderPass(vknDevice, depthOnly);
+			}
+			attachments.depthInitialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		}
+		else if (occlusionCulling) {
+			vkn::RenderPassAttachments late = attachments;
+			late.colorInitialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+			late.depthInitialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+			lateRenderPass = new vkn::RenderPass(vknDevice, late);
+
+			//Not presented, so the color is stored for the late pass to load
+			attachments.colorFinalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+			attachments.storeDepth = true;
+		}
+		vknRenderPass = new vkn::RenderPass(vknDevice, attachments);
 	}
 
 	void createFramebuffers() {
 		swapChainFramebuffers.resize(swapChainImageViews.size());
 		for (size_t i = 0; i < swapChainImageViews.size(); i++) {
-			VkImageView attachments[] = {
-				swapChainImageViews[i]
+			//Post-processing has every frame draw into the one scene image
+			VkImageView target = postProcess != nullptr ? sceneColorView : swapChainImageViews[i];
+			std::vector<VkImageView> attachments = {
+				target,
+				depthImageView
 			};
+			//Drawn into the multisampled image, resolved into the target
+			if (msaaSamples != VK_SAMPLE_COUNT_1_BIT) {
+				attachments = { colorImageView, depthImageView, target };
+			}
 
 			swapChainFramebuffers[i] = new vkn::FrameBuffer(vknDevice,
 				vknRenderPass,
 				vknSwapChain->getExtent().width,
 				vknSwapChain->getExtent().height,
 				1,
-				swapChainImageViews[i]);
+				attachments);
 
 		}
+		//Depth only passes all share the one depth buffer
+		if (depthPrePass != nullptr) {
+			depthFramebuffer = new vkn::FrameBuffer(vknDevice,
+				depthPrePass,
+				vknSwapChain->getExtent().width,
+				vknSwapChain->getExtent().height,
+				1,
+				depthImageView);
+		}
 	}
 
 	//Command pools manage the memory used in command buffers.
@@ -285,21 +602,39 @@ private:
 			throw std::runtime_error("failed to begin recording command buffer!");
 		}
 
+		//Passes, and the barriers between them, come from the graph. See createRenderGraph
+		currentImageIndex = imageIndex;
+		renderGraph->setImportedImage(swapChainTarget, vknSwapChain->getImages()[imageIndex]);
+		renderGraph->execute(commandBuffer);
+
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to record command buffer!");
+		}
+	}
+
+	//Clears whatever the pass doesn't load and sets the dynamic state
+	void beginRenderPass(VkCommandBuffer commandBuffer, vkn::RenderPass* pass, vkn::FrameBuffer* framebuffer) {
 		VkRenderPassBeginInfo renderPassInfo{};
 		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		//renderPassInfo.renderPass = renderPass;
-		renderPassInfo.renderPass = vknRenderPass->getRenderPass();
-		renderPassInfo.framebuffer = swapChainFramebuffers[imageIndex]->getFrameBuffer();
+		renderPassInfo.renderPass = pass->getRenderPass();
+		renderPassInfo.framebuffer = framebuffer->getFrameBuffer();
 		renderPassInfo.renderArea.offset = { 0, 0 };
 		renderPassInfo.renderArea.extent = vknSwapChain->getExtent();
 
-		VkClearValue clearColor = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
-		renderPassInfo.clearValueCount = 1;
-		renderPassInfo.pClearValues = &clearColor;
+		//Same order as the attachments. Depth clears to the far plane
+		VkClearValue clearValues[2]{};
+		uint32_t clearCount = 0;
+		if (pass->hasColor()) {
+			clearValues[clearCount++].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
+		}
+		if (pass->hasDepth()) {
+			clearValues[clearCount++].depthStencil = { 1.0f, 0 };
+		}
+		renderPassInfo.clearValueCount = clearCount;
+		renderPassInfo.pClearValues = clearValues;
 
 		//Time to record render pass into command buffer
 		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vknGraphicsPipeline->getPipeline());
 		//We call this because we are setting viewport and scissor dynamically
 				//Viewport that will be used
 		VkViewport viewport{};
@@ -316,23 +651,66 @@ private:
 		scissor.offset = { 0, 0 };
 		scissor.extent = vknSwapChain->getExtent();
 		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+	}
+
+	//late draws what the rebuilt pyramid revealed, so it only does anything with occlusion culling
+	void drawScene(VkCommandBuffer commandBuffer, vkn::GraphicsPipeline* pipeline, bool late) {
+		//CPU side batches go through the render queue, which does its own binding
+		if (frustumCuller == nullptr) {
+			if (!late) {
+				VkDescriptorSet sets[] = { descriptorSets[currentFrame], bindlessTable != nullptr ? bindlessTable->getDescriptorSet(currentFrame) : VK_NULL_HANDLE };
+				renderQueue->record(commandBuffer, pipeline == depthPipeline ? DEPTH_QUEUE_PASS : COLOR_QUEUE_PASS,
+					instanceBatcher->getInstanceBuffer(currentFrame), sets, indirectDraws);
+			}
+			return;
+		}
 
-		VkBuffer vertexBuffers[] = { vertexBuffer };
-		VkDeviceSize offsets[] = { 0 };
-		vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
-		vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT16);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->getPipeline());
 
 		//Update Uniform Buffers
 		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-			vknGraphicsPipeline->getPipelineLayout(), 0, 1, &descriptorSets[currentFrame], 0, nullptr);
+			pipeline->getPipelineLayout(), 0, 1, &descriptorSets[currentFrame], 0, nullptr);
+
+		//The whole texture table is bound once, each draw just pushes its material.
+		//Depth only draws have no use for it
+		bool pushMaterial = pipeline == vknGraphicsPipeline && bindlessTable != nullptr;
+		if (pushMaterial) {
+			VkDescriptorSet bindlessSet = bindlessTable->getDescriptorSet(currentFrame);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+				pipeline->getPipelineLayout(), 1, 1, &bindlessSet, 0, nullptr);
+		}
 
-		vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
-		//vkCmdDraw(commandBuffer, static_cast<uint32_t>(vertices.size()), 1, 0, 0);
+		//One draw per mesh and material, however many copies there are
+		if (late) {
+			frustumCuller->drawLate(commandBuffer, pipeline->getPipelineLayout(), pushMaterial);
+		}
+		else {
+			frustumCuller->draw(commandBuffer, pipeline->getPipelineLayout(), pushMaterial);
+		}
+	}
 
-		vkCmdEndRenderPass(commandBuffer);
-		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
-			throw std::runtime_error("failed to record command buffer!");
+	//Every batch once per pass it's drawn in, sorted by state and distance
+	void fillRenderQueue() {
+		renderQueue->clear(CAMERA_FAR_PLANE);
+		for (const vkn::InstanceBatcher::Batch& batch : instanceBatcher->getBatches()) {
+			vkn::RenderDraw draw;
+			draw.mesh = batch.mesh;
+			draw.lod = batch.lod;
+			draw.material = batch.material;
+			draw.firstInstance = batch.firstInstance;
+			draw.instanceCount = batch.instanceCount;
+			if (depthPipeline != nullptr) {
+				renderQueue->add(DEPTH_QUEUE_PASS, depthQueuePipeline, draw, batch.distance);
+			}
+			renderQueue->add(COLOR_QUEUE_PASS, colorQueuePipeline, draw, batch.distance);
 		}
+		renderQueue->sort();
+	}
+
+	//Between the early and late passes, outside any render pass
+	void cullOccluded(VkCommandBuffer commandBuffer) {
+		hiZPyramid->build(commandBuffer, hiZPipeline);
+		frustumCuller->cullLate(commandBuffer, cullPipeline);
 	}
 
 	//Semafores alert to when gpu work is done.
@@ -360,6 +738,13 @@ private:
 
 	void drawFrame() {
 		vkWaitForFences(vknDevice->getDevice(), 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+		allocateFrameDescriptorSets(currentFrame);
+
+		//Push the next batch of streamed texture data
+		textureStreamer->update();
+		if (bindlessTable != nullptr) {
+			bindlessTable->beginFrame(currentFrame);
+		}
 
 		uint32_t imageIndex;
 		VkResult result = vkAcquireNextImageKHR(vknDevice->getDevice(), vknSwapChain->getSwapChain(), UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex); //Get next swapchain image
@@ -375,6 +760,20 @@ private:
 		//Update Uniform Buffer
 		updateUniformBuffer(currentFrame);
 
+		instanceBatcher->beginFrame(currentFrame);
+		if (indirectDraws != nullptr) {
+			indirectDraws->beginFrame(currentFrame);
+		}
+		if (cpuCuller != nullptr) {
+			submitVisibleInstances();
+		}
+		else {
+			instanceBatcher->submit(meshHandle, material, instances.data(), static_cast<uint32_t>(instances.size()));
+		}
+		if (renderQueue != nullptr) {
+			fillRenderQueue();
+		}
+
 		//Only reset the fences if we are submitting work
 		vkResetFences(vknDevice->getDevice(), 1, &inFlightFences[currentFrame]);
 
@@ -448,308 +847,173 @@ private:
 
 		vknSwapChain = new vkn::SwapChain(vknPhysicalDevice, vknDevice, surface, window);
 
+		//Occlusion culling splits the frame around the pyramid build, so the passes depend on it
+		occlusionCulling = GPU_FRUSTUM_CULLING && GPU_OCCLUSION_CULLING && vknDevice->getEnabledFeatures().drawIndirectFirstInstance;
+		depthFormat = vknPhysicalDevice->findDepthFormat(occlusionCulling ? VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT : 0);
+		msaaSamples = occlusionCulling ? VK_SAMPLE_COUNT_1_BIT : vknDevice->getMaxSampleCount(MSAA_SAMPLES);
+		//The chain's result gets blitted in, so the swap chain has to take blits
+		VkFormatProperties swapFormatProperties;
+		vkGetPhysicalDeviceFormatProperties(vknPhysicalDevice->getPhysicalDevice(), vknSwapChain->getFormat().format, &swapFormatProperties);
+		postProcessing = POST_PROCESSING && (vknSwapChain->getImageUsage() & VK_IMAGE_USAGE_TRANSFER_DST_BIT) &&
+			(swapFormatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT);
+		colorFormat = postProcessing ? vkn::PostProcessChain::FORMAT : vknSwapChain->getFormat().format;
+
 		createImageViews();
 		//createRenderPass();
-		vknRenderPass = new vkn::RenderPass(vknDevice, vknSwapChain->getFormat().format);
-		createDescriptorSetLayout();
+		createRenderPasses();
+		//Bindless needs descriptor indexing, otherwise stick with untextured geometry
+		if (vknDevice->isBindlessSupported()) {
+			bindlessTable = new vkn::BindlessTable(vknDevice, MAX_FRAMES_IN_FLIGHT, 16384, 64);
+		}
+		openAssetPack();
 		//createGraphicsPipeline();
 		vknGraphicsPipeline = new vkn::GraphicsPipeline(vknDevice, vknRenderPass);
-		vknGraphicsPipeline->setVertexShader("root/shaders/compiled/vertS.spv");
-		vknGraphicsPipeline->setFragmentShader("root/shaders/compiled/frag.spv");
-		auto bindingDescription = Vertex::getBindingDescription();
-		auto attributeDescriptions = Vertex::getAttributeDescriptions();
-		vknGraphicsPipeline->addBindingDescription(bindingDescription);
-		for (size_t i = 0; i < attributeDescriptions.size(); i++) {
-			vknGraphicsPipeline->addAttributeDescription(attributeDescriptions[i]);
+		vertexLayout = QUANTIZE_VERTICES ? vkn::VertexLayout::getQuantizedLayout() : vkn::VertexLayout::getFullLayout();
+		setPipelineShaders(vknGraphicsPipeline, QUANTIZE_VERTICES ? "root/shaders/compiled/quantizedInstancedVertS.spv" : "root/shaders/compiled/instancedVertS.spv",
+			bindlessTable != nullptr ? "root/shaders/compiled/bindlessFrag.spv" : "root/shaders/compiled/frag.spv");
+		vknGraphicsPipeline->setVertexLayout(vertexLayout);
+		//Per instance transforms and tints come in on their own binding
+		vknGraphicsPipeline->addBindingDescription(vkn::InstanceBatcher::getBindingDescription(1));
+		for (const VkVertexInputAttributeDescription& attribute : vkn::InstanceBatcher::getAttributeDescriptions(1)) {
+			vknGraphicsPipeline->addAttributeDescription(attribute);
+		}
+		//After a pre-pass depth is already final, only the visible surface passes
+		if (DEPTH_PRE_PASS) {
+			vknGraphicsPipeline->setDepthState(true, false, VK_COMPARE_OP_EQUAL);
+		}
+		else {
+			vknGraphicsPipeline->setDepthState(true, true, VK_COMPARE_OP_LESS);
+		}
+		vknGraphicsPipeline->setSampleCount(msaaSamples);
+		//The bindless set's arrays are runtime sized, so the table provides that layout
+		if (bindlessTable != nullptr) {
+			vknGraphicsPipeline->buildReflectedPipeline({ { 1, bindlessTable->getLayout() } });
+		}
+		else {
+			vknGraphicsPipeline->buildReflectedPipeline();
+		}
+		//Set 0 is the vertex shader's UBO. The layout cache owns it
+		descriptorSetLayout = vknGraphicsPipeline->getDescriptorSetLayout(0);
+
+		//Same vertex shader and inputs, no fragment shader
+		if (depthPrePass != nullptr) {
+			depthPipeline = new vkn::GraphicsPipeline(vknDevice, depthPrePass);
+			setPipelineShaders(depthPipeline, QUANTIZE_VERTICES ? "root/shaders/compiled/quantizedInstancedVertS.spv" : "root/shaders/compiled/instancedVertS.spv", "");
+			depthPipeline->setVertexLayout(vertexLayout);
+			depthPipeline->addBindingDescription(vkn::InstanceBatcher::getBindingDescription(1));
+			for (const VkVertexInputAttributeDescription& attribute : vkn::InstanceBatcher::getAttributeDescriptions(1)) {
+				depthPipeline->addAttributeDescription(attribute);
+			}
+			depthPipeline->setDepthState(true, true, VK_COMPARE_OP_LESS);
+			depthPipeline->setSampleCount(msaaSamples);
+			//Reflects the same UBO binding, so the cache hands back the same set 0 layout
+			depthPipeline->buildReflectedPipeline();
 		}
-		vknGraphicsPipeline->buildPipeline(descriptorSetLayout);
 
+		if (postProcessing) {
+			postProcess = new vkn::PostProcessChain(vknDevice, POST_PROCESS_STAGES);
+			postProcess->buildPipelines([this](vkn::ComputePipeline* pipeline) {
+				setComputeShader(pipeline, "root/shaders/compiled/postProcess.spv");
+			});
+		}
+		createRenderGraph();
 
 		createFramebuffers();
 		createCommandPool();
-		createTextureImage();
-		createTextureImageView();
+		//Textures decode on the pool and upload over the next few frames
+		threadPool = new vkn::ThreadPool();
+		textureStreamer = new vkn::TextureStreamer(vknDevice, threadPool, indices.graphicsFamily.value(), graphicsQueue);
+		texture = requestTexture("root/textures/test.jpg");
 		createTextureSampler();
-		createVertexBuffer();
-		createIndexBuffer();
+		if (bindlessTable != nullptr) {
+			material.textureIndex = bindlessTable->addTexture(texture);
+			material.samplerIndex = bindlessTable->addSampler(textureSampler);
+		}
+		createMeshBuffers();
+		createInstances();
 		createUniformBuffers();
-		createDescriptorPool();
-		createDescriptorSets();
+		createDescriptorAllocators();
 		createCommandBuffers();
 		createSyncObjects();
 	}
 
-	VkImageView createImageView(VkImage image, VkFormat format) {
-		VkImageViewCreateInfo viewInfo{};
-		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-		viewInfo.image = image;
-		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-		viewInfo.format = format;
-
-		//What the image is used for. In this case, color target with no mipmapping and a single layer
-		viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		viewInfo.subresourceRange.baseMipLevel = 0;
-		viewInfo.subresourceRange.levelCount = 1;
-		viewInfo.subresourceRange.baseArrayLayer = 0;
-		viewInfo.subresourceRange.layerCount = 1;
-
-		VkImageView imageView;
-		if (vkCreateImageView(vknDevice->getDevice(), &viewInfo, nullptr, &imageView) != VK_SUCCESS) {
-			throw std::runtime_error("failed to create image views!");
+	void openAssetPack() {
+		std::ifstream probe(ASSET_PACK_PATH);
+		if (!probe.good()) {
+			return;
 		}
-		return imageView;
-	}
-
-	//Images must be viewed through an image view
-	void createTextureImageView() {
-		createImageView(textureImage, VK_FORMAT_R8G8B8_SRGB);
+		probe.close();
+		assetPack = new vkn::AssetPack(ASSET_PACK_PATH);
 	}
 
-	void createTextureSampler() {
-		VkSamplerCreateInfo samplerInfo{};
-		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-		samplerInfo.magFilter = VK_FILTER_LINEAR;
-		samplerInfo.minFilter = VK_FILTER_LINEAR;
-		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-
-		samplerInfo.anisotropyEnable = VK_TRUE;
-		//We need to get device properties to find out what the max anisotropy param can be
-		VkPhysicalDeviceProperties properties{};
-		vkGetPhysicalDeviceProperties(vknPhysicalDevice->getPhysicalDevice(), &properties);
-		samplerInfo.maxAnisotropy = properties.limits.maxSamplerAnisotropy;
-
-		samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
-		samplerInfo.unnormalizedCoordinates = VK_FALSE;
-		samplerInfo.compareEnable = VK_FALSE;
-		samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
-		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-		samplerInfo.mipLodBias = 0.0f;
-		samplerInfo.minLod = 0.0f;
-		samplerInfo.maxLod = 0.0f;
-
-		if (vkCreateSampler(vknDevice->getDevice(), &samplerInfo, nullptr, &textureSampler) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to create texture sampler!");
+	void setPipelineShaders(vkn::GraphicsPipeline* pipeline, const std::string& vertex, const std::string& fragment) {
+		const uint32_t* code;
+		size_t size;
+		if (assetPack != nullptr && assetPack->contains(vertex)) {
+			assetPack->getShader(vertex, code, size);
+			pipeline->setVertexShader(code, size);
 		}
-	}
-
-	void createTextureImage() {
-		//Load the image
-		int texWidth, texHeight, texChannels;
-		stbi_uc* pixels = stbi_load("root/textures/test.jpg", &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-		VkDeviceSize imageSize = texWidth * texHeight * 4;
-		if (!pixels) {
-			throw std::runtime_error("failed to load texture image!");
-		}
-
-		//Create Staging buffer to move to GPU
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingBufferMemory;
-		createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			stagingBuffer, stagingBufferMemory);
-		//Map memory
-		void* data;
-		vkMapMemory(vknDevice->getDevice(), stagingBufferMemory, 0, imageSize, 0, &data);
-		memcpy(data, pixels, static_cast<size_t>(imageSize));
-		vkUnmapMemory(vknDevice->getDevice(), stagingBufferMemory);
-
-		//Clean up original pixel array
-		stbi_image_free(pixels);
-
-		createImage(texWidth, texHeight, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, textureImage, textureImageMemory);
-
-		transitionImageLayout(textureImage, VK_FORMAT_R8G8B8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-		copyBufferToImage(stagingBuffer, textureImage, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
-		transitionImageLayout(textureImage, VK_FORMAT_R8G8B8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-		
-		vkDestroyBuffer(vknDevice->getDevice(), stagingBuffer, nullptr);
-		vkFreeMemory(vknDevice->getDevice(), stagingBufferMemory, nullptr);
-	}
-
-	void createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling,
-		VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory) {
-		//Create an image to move buffer data into
-		VkImageCreateInfo imageInfo{};
-		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-		imageInfo.imageType = VK_IMAGE_TYPE_2D;
-		imageInfo.extent.width = width;
-		imageInfo.extent.height = height;
-		imageInfo.extent.depth = 1;
-		imageInfo.mipLevels = 1;
-		imageInfo.arrayLayers = 1;
-		imageInfo.format = format;
-		imageInfo.tiling = tiling;
-		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		imageInfo.usage = usage;
-		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-		imageInfo.flags = 0;
-
-		if (vkCreateImage(vknDevice->getDevice(), &imageInfo, nullptr, &image) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to create image");
-		}
-
-		VkMemoryRequirements memRequirements;
-		vkGetImageMemoryRequirements(vknDevice->getDevice(), image, &memRequirements);
-
-		VkMemoryAllocateInfo allocInfo{};
-		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		allocInfo.allocationSize = memRequirements.size;
-		allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-		if (vkAllocateMemory(vknDevice->getDevice(), &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to allocate image memory!");
-		}
-		vkBindImageMemory(vknDevice->getDevice(), image, imageMemory, 0);
-	}
-
-	void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout) {
-		VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-		VkPipelineStageFlags sourceStage;
-		VkPipelineStageFlags destinationStage;
-
-		VkImageMemoryBarrier barrier{};
-		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-		barrier.oldLayout = oldLayout;
-		barrier.newLayout = newLayout;
-		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-		barrier.image = image;
-		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		barrier.subresourceRange.baseMipLevel = 0;
-		barrier.subresourceRange.levelCount = 1;
-		barrier.subresourceRange.baseArrayLayer = 0;
-		barrier.subresourceRange.layerCount = 1;
-
-		if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
-			barrier.srcAccessMask = 0;
-			barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			sourceStage = VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT;
-			destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		else {
+			pipeline->setVertexShader(vertex);
 		}
-
-		else if(oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL){
-			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-			sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-			destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		//Depth only
+		if (fragment.empty()) {
+			return;
+		}
+		if (assetPack != nullptr && assetPack->contains(fragment)) {
+			assetPack->getShader(fragment, code, size);
+			pipeline->setFragmentShader(code, size);
 		}
-		
 		else {
-			throw std::invalid_argument("unsupported layout transition!");
+			pipeline->setFragmentShader(fragment);
 		}
-
-		vkCmdPipelineBarrier(commandBuffer, sourceStage, destinationStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
-
-
-		endSingleTimeCommands(commandBuffer);
 	}
 
-	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
-		VkPhysicalDeviceMemoryProperties memProperties;
-		vkGetPhysicalDeviceMemoryProperties(vknPhysicalDevice->getPhysicalDevice(), &memProperties);
-
-		for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-			if (typeFilter & (1 << i) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-				return i;
-			}
+	void setComputeShader(vkn::ComputePipeline* pipeline, const std::string& compute) {
+		if (assetPack != nullptr && assetPack->contains(compute)) {
+			const uint32_t* code;
+			size_t size;
+			assetPack->getShader(compute, code, size);
+			pipeline->setComputeShader(code, size);
+		}
+		else {
+			pipeline->setComputeShader(compute);
 		}
-
-		throw std::runtime_error("failed to find suitable memory type!");
-	}
-
-	void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
-		VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-		VkBufferCopy copyRegion{};
-		copyRegion.size = size;
-		vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-
-		endSingleTimeCommands(commandBuffer);
-	}
-
-	void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height) {
-		VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-		VkBufferImageCopy region{};
-		region.bufferOffset = 0;
-		region.bufferRowLength = 0;
-		region.bufferImageHeight = 0;
-
-		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		region.imageSubresource.mipLevel = 0;
-		region.imageSubresource.baseArrayLayer = 0;
-		region.imageSubresource.layerCount = 1;
-
-		region.imageOffset = { 0, 0, 0 };
-		region.imageExtent = { width, height, 1 };
-
-		vkCmdCopyBufferToImage(
-			commandBuffer,
-			buffer,
-			image,
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			1,
-			&region
-		);
-
-		endSingleTimeCommands(commandBuffer);
 	}
 
-	VkCommandBuffer beginSingleTimeCommands() {
-		VkCommandBufferAllocateInfo allocInfo{};
-		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-		allocInfo.commandPool = commandPool;
-		allocInfo.commandBufferCount = 1;
-
-		VkCommandBuffer commandBuffer;
-		vkAllocateCommandBuffers(vknDevice->getDevice(), &allocInfo, &commandBuffer);
-
-		VkCommandBufferBeginInfo beginInfo{};
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-		vkBeginCommandBuffer(commandBuffer, &beginInfo);
-
-		return commandBuffer;
+	//Baked textures skip decoding entirely and upload from the mapped pack
+	vkn::Texture* requestTexture(const std::string& path) {
+		if (assetPack != nullptr && assetPack->contains(path)) {
+			return textureStreamer->request(path, assetPack->getTexture(path));
+		}
+		return textureStreamer->request(path);
 	}
 
-	void endSingleTimeCommands(VkCommandBuffer commandBuffer) {
-		vkEndCommandBuffer(commandBuffer);
-
-		//Submit command buffer to graphics queue
-		VkSubmitInfo submitInfo{};
-		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &commandBuffer;
+	VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags) {
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = image;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = format;
 
-		vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-		vkQueueWaitIdle(graphicsQueue);
+		//What the image is used for. Color or depth target with no mipmapping and a single layer
+		viewInfo.subresourceRange.aspectMask = aspectFlags;
+		viewInfo.subresourceRange.baseMipLevel = 0;
+		viewInfo.subresourceRange.levelCount = 1;
+		viewInfo.subresourceRange.baseArrayLayer = 0;
+		viewInfo.subresourceRange.layerCount = 1;
 
-		vkFreeCommandBuffers(vknDevice->getDevice(), commandPool, 1, &commandBuffer);
+		VkImageView imageView;
+		if (vkCreateImageView(vknDevice->getDevice(), &viewInfo, nullptr, &imageView) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create image views!");
+		}
+		return imageView;
 	}
 
-	void createDescriptorSetLayout() {
-		VkDescriptorSetLayoutBinding uboLayoutBinding{};
-		uboLayoutBinding.binding = 0;
-		uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		uboLayoutBinding.descriptorCount = 1;
-		uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-		uboLayoutBinding.pImmutableSamplers = nullptr;
-
-		VkDescriptorSetLayoutCreateInfo layoutInfo{};
-		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-		layoutInfo.bindingCount = 1;
-		layoutInfo.pBindings = &uboLayoutBinding;
-
-		if (vkCreateDescriptorSetLayout(vknDevice->getDevice(), &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to create descriptor set layout!");
-		}
+	//Samplers come out of the device's cache, which also owns them
+	void createTextureSampler() {
+		vkn::SamplerCache* samplerCache = vknDevice->getSamplerCache();
+		textureSampler = samplerCache->getSampler(samplerCache->getDefaultCreateInfo());
 	}
 
 	void createUniformBuffers() {
@@ -760,7 +1024,7 @@ private:
 		uniformBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
 
 		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-			createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+			vknDevice->createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
 				VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, uniformBuffers[i], uniformBuffersMemory[i]);
 			vkMapMemory(vknDevice->getDevice(), uniformBuffersMemory[i], 0, bufferSize, 0, &uniformBuffersMapped[i]);
 		}
@@ -771,132 +1035,270 @@ private:
 		auto currentTime = std::chrono::high_resolution_clock::now();
 		float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
 
+		//The root spins the grid, parents never change so nothing gets sorted again
+		sceneTransforms->setRotation(sceneRoot, glm::angleAxis(time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f)));
+		if (BOB_INSTANCES) {
+			float height = 0.25f / INSTANCE_GRID_SIZE;
+			for (size_t i = 0; i < instances.size(); i++) {
+				sceneTransforms->setPosition(instanceTransforms[i], instanceHomes[i] + glm::vec3(0.0f, 0.0f, height * std::sin(2.0f * time + 0.7f * i)));
+			}
+		}
+		sceneTransforms->update();
+		for (size_t i = 0; i < instances.size(); i++) {
+			instances[i].transform = sceneTransforms->getWorldMatrix(instanceTransforms[i]) * meshTransform;
+		}
+		//Only the copies moved in the root's space, the spin doesn't count
+		if (BOB_INSTANCES) {
+			glm::vec3 boundsMin, boundsMax;
+			for (uint32_t i = 0; i < instances.size(); i++) {
+				getInstanceBounds(i, boundsMin, boundsMax);
+				sceneBvh->setBounds(instanceBvhHandles[i], boundsMin, boundsMax);
+			}
+			sceneBvh->update();
+		}
+
 		UniformBufferObject ubo{};
-		ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+		ubo.model = glm::mat4(1.0f);
 		ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-		ubo.proj = glm::perspective(glm::radians(45.0f), vknSwapChain->getExtent().width / (float) vknSwapChain->getExtent().height, 0.1f, 10.0f);
+		ubo.proj = glm::perspective(glm::radians(45.0f), vknSwapChain->getExtent().width / (float) vknSwapChain->getExtent().height, 0.1f, CAMERA_FAR_PLANE);
 		ubo.proj[1][1] *= -1;
+		//In the space instance transforms take meshes to, ubo.model is applied after them
+		cullMatrix = ubo.proj * ubo.view * ubo.model;
+		if (pickRequested) {
+			pickInstance(cullMatrix);
+			pickRequested = false;
+		}
+		//Same space for picking LODs, the camera sits at the origin of view space
+		glm::vec3 cameraPosition = glm::vec3(glm::inverse(ubo.view * ubo.model)[3]);
+		instanceBatcher->setLodSelection(cameraPosition, std::abs(ubo.proj[1][1]) * vknSwapChain->getExtent().height * 0.5f, LOD_PIXEL_ERROR);
 
 		memcpy(uniformBuffersMapped[currentImage], &ubo, sizeof(ubo));
 	}
 
-	void createDescriptorPool(){
-		VkDescriptorPoolSize poolSize{};
-		poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		poolSize.descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-
-		VkDescriptorPoolCreateInfo poolInfo{};
-		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-		poolInfo.poolSizeCount = 1;
-		poolInfo.pPoolSizes = &poolSize;
-		poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-
-		if (vkCreateDescriptorPool(vknDevice->getDevice(), &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to create descriptor pool!");
+	//One allocator per frame in flight, its sets only live until that frame comes around again
+	void createDescriptorAllocators() {
+		frameDescriptors.resize(MAX_FRAMES_IN_FLIGHT);
+		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+			frameDescriptors[i] = new vkn::DescriptorAllocator(vknDevice, { { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.0f } });
 		}
+		descriptorSets.resize(MAX_FRAMES_IN_FLIGHT, VK_NULL_HANDLE);
+
+		//The whole set is one VkDescriptorBufferInfo for the UBO
+		VkDescriptorUpdateTemplateEntry uboEntry{};
+		uboEntry.dstBinding = 0;
+		uboEntry.dstArrayElement = 0;
+		uboEntry.descriptorCount = 1;
+		uboEntry.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		uboEntry.offset = 0;
+		uboEntry.stride = sizeof(VkDescriptorBufferInfo);
+		frameSetTemplate = new vkn::DescriptorTemplate(vknDevice, descriptorSetLayout, { uboEntry });
 	}
 
-	void createDescriptorSets() {
-		std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, descriptorSetLayout);
-		
-		VkDescriptorSetAllocateInfo allocInfo{};
-		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-		allocInfo.descriptorPool = descriptorPool;
-		allocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-		allocInfo.pSetLayouts = layouts.data();
+	//Call once the frame's fence has signalled. Everything allocated for the frame
+	//last time goes back in one reset, then this frame's sets are made fresh
+	void allocateFrameDescriptorSets(uint32_t frame) {
+		frameDescriptors[frame]->reset();
+		descriptorSets[frame] = frameDescriptors[frame]->allocate(descriptorSetLayout);
+
+		VkDescriptorBufferInfo bufferInfo{};
+		bufferInfo.buffer = uniformBuffers[frame];
+		bufferInfo.offset = 0;
+		bufferInfo.range = sizeof(UniformBufferObject);
+		frameSetTemplate->update(descriptorSets[frame], &bufferInfo);
+	}
 
-		descriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
-		if (vkAllocateDescriptorSets(vknDevice->getDevice(), &allocInfo, descriptorSets.data()) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to allocate descriptor sets");
+	//Suballocated out of the geometry pool. Comes from the asset pack when the
+	//model was baked (already optimised by the baker), the file itself when it
+	//wasn't, and the test quad when there's no model at all
+	void createMeshBuffers() {
+		vkn::MeshInfo info;
+		const vkn::Vertex* vertices;
+		const void* indices;
+		VkIndexType sourceIndexType;
+		const vkn::MeshLod* lods = nullptr;
+		uint32_t lodCount = 0;
+		vkn::MeshData* loaded = nullptr;
+		if (modelPath.empty()) {
+			info.vertexCount = static_cast<uint32_t>(quadVertices.size());
+			info.indexCount = static_cast<uint32_t>(quadIndices.size());
+			info.boundsMin = glm::vec3(-0.5f, -0.5f, 0.0f);
+			info.boundsMax = glm::vec3(0.5f, 0.5f, 0.0f);
+			vertices = quadVertices.data();
+			indices = quadIndices.data();
+			sourceIndexType = VK_INDEX_TYPE_UINT32;
+		}
+		else if (assetPack != nullptr && assetPack->contains(modelPath)) {
+			vkn::MeshView mesh = assetPack->getMesh(modelPath);
+			if (mesh.vertexStride != sizeof(vkn::Vertex)) {
+				throw std::runtime_error("baked mesh " + modelPath + " doesn't match this build, rebake the asset pack!");
+			}
+			info.vertexCount = mesh.vertexCount;
+			info.indexCount = mesh.indexCount;
+			info.boundsMin = mesh.boundsMin;
+			info.boundsMax = mesh.boundsMax;
+			vertices = static_cast<const vkn::Vertex*>(mesh.vertices);
+			indices = mesh.indices;
+			sourceIndexType = mesh.indexType;
+			lods = mesh.lods;
+			lodCount = mesh.lodCount;
+		}
+		else {
+			vkn::MeshLoader loader(threadPool);
+			loaded = loader.load(modelPath);
+			vkn::MeshOptimizer::optimize(*loaded);
+			if (GENERATE_LODS) {
+				vkn::MeshSimplifier::generateLods(*loaded);
+				lods = loaded->lods.data();
+				lodCount = static_cast<uint32_t>(loaded->lods.size());
+			}
+			info = loaded->info;
+			vertices = loaded->vertices.data();
+			indices = loaded->indices.data();
+			sourceIndexType = VK_INDEX_TYPE_UINT32;
 		}
 
-		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-			VkDescriptorBufferInfo bufferInfo{};
-			bufferInfo.buffer = uniformBuffers[i];
-			bufferInfo.offset = 0;
-			bufferInfo.range = sizeof(UniformBufferObject);
-
-			VkWriteDescriptorSet descriptorWrite{};
-			descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			descriptorWrite.dstSet = descriptorSets[i];
-			descriptorWrite.dstBinding = 0;
-			descriptorWrite.dstArrayElement = 0;
-			descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-			descriptorWrite.descriptorCount = 1;
-			descriptorWrite.pBufferInfo = &bufferInfo;
-			descriptorWrite.pImageInfo = nullptr;
-			descriptorWrite.pTexelBufferView = nullptr;
-
-			vkUpdateDescriptorSets(vknDevice->getDevice(), 1, &descriptorWrite, 0, nullptr);
+		//Indices are stored relative to each mesh's first vertex, so 16 bits is
+		//enough as long as no single mesh goes over 65535 vertices
+		geometryPool = new vkn::GeometryPool(vknDevice, vknPhysicalDevice->findQueueFamilies(surface).graphicsFamily.value(),
+			graphicsQueue, vertexLayout, std::max(GEOMETRY_POOL_VERTICES, info.vertexCount), std::max(GEOMETRY_POOL_INDICES, info.indexCount),
+			vkn::MeshOptimizer::selectIndexType(info.vertexCount));
+		meshHandle = geometryPool->addMesh(vertices, info.vertexCount, indices, sourceIndexType, info.indexCount, info.boundsMin, info.boundsMax,
+			lods, lodCount);
+		geometryPool->flush();
+		delete(loaded);
+
+		//Models are usually Y up, our camera is Z up
+		if (!modelPath.empty()) {
+			glm::vec3 center = (info.boundsMin + info.boundsMax) * 0.5f;
+			glm::vec3 extent = info.boundsMax - info.boundsMin;
+			float largest = std::max(extent.x, std::max(extent.y, extent.z));
+			float scale = largest > 0.0f ? 1.5f / largest : 1.0f;
+			meshTransform = glm::rotate(glm::mat4(1.0f), glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f)) *
+				glm::scale(glm::mat4(1.0f), glm::vec3(scale)) * glm::translate(glm::mat4(1.0f), -center);
 		}
 	}
 
-	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory) {
-		VkBufferCreateInfo bufferInfo{};
-		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-		bufferInfo.size = size;
-		bufferInfo.usage = usage;
-		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-		if (vkCreateBuffer(vknDevice->getDevice(), &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
-			throw std::runtime_error("failed to create vertex buffer!");
+	//A grid of shrunk copies of the mesh filling the same space as one. The
+	//batcher folds in the dequantizing matrix itself
+	void createInstances() {
+		instanceBatcher = new vkn::InstanceBatcher(vknDevice, geometryPool, MAX_FRAMES_IN_FLIGHT, MAX_INSTANCES);
+		if (GPU_FRUSTUM_CULLING && vknDevice->getEnabledFeatures().drawIndirectFirstInstance) {
+			//Built from the depth buffer, the culler reads it
+			if (occlusionCulling) {
+				hiZPyramid = new vkn::HiZPyramid(vknDevice, vknSwapChain->getExtent().width, vknSwapChain->getExtent().height, depthImageView);
+				hiZPipeline = new vkn::ComputePipeline(vknDevice);
+				setComputeShader(hiZPipeline, "root/shaders/compiled/hizDownsample.spv");
+				hiZPipeline->buildPipeline({ hiZPyramid->getLayout() }, { hiZPyramid->getPushConstantRange() });
+			}
+			frustumCuller = new vkn::FrustumCuller(vknDevice, instanceBatcher, MAX_FRAMES_IN_FLIGHT, MAX_INDIRECT_DRAWS, hiZPyramid);
+			cullPipeline = new vkn::ComputePipeline(vknDevice);
+			setComputeShader(cullPipeline, occlusionCulling ? "root/shaders/compiled/occlusionCull.spv" : "root/shaders/compiled/frustumCull.spv");
+			cullPipeline->buildPipeline({ frustumCuller->getLayout() }, { frustumCuller->getPushConstantRange() });
+		}
+		else if (USE_INDIRECT_DRAWS && vknDevice->getEnabledFeatures().drawIndirectFirstInstance) {
+			indirectDraws = new vkn::IndirectDrawBuffer(vknDevice, MAX_FRAMES_IN_FLIGHT, MAX_INDIRECT_DRAWS);
+		}
+		if (frustumCuller == nullptr && CPU_FRUSTUM_CULLING) {
+			cpuCuller = new vkn::CpuFrustumCuller(INSTANCE_GRID_SIZE * INSTANCE_GRID_SIZE);
+		}
+		if (frustumCuller == nullptr) {
+			renderQueue = new vkn::RenderQueue(geometryPool);
+			colorQueuePipeline = renderQueue->addPipeline(vknGraphicsPipeline, bindlessTable != nullptr ? 2 : 1, bindlessTable != nullptr);
+			if (depthPipeline != nullptr) {
+				depthQueuePipeline = renderQueue->addPipeline(depthPipeline, 1, false);
+			}
 		}
 
-		//Gather memory requirements and allocate memory
-		VkMemoryRequirements memRequirements;
-		vkGetBufferMemoryRequirements(vknDevice->getDevice(), buffer, &memRequirements);
-
-		VkMemoryAllocateInfo allocInfo{};
-		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		allocInfo.allocationSize = memRequirements.size;
-		allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-		if (vkAllocateMemory(vknDevice->getDevice(), &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-			throw std::runtime_error("failed to allocate vertex buffer memory!");
+		//Every copy hangs off one root that spins the whole grid
+		sceneTransforms = new vkn::TransformSystem(threadPool, INSTANCE_GRID_SIZE * INSTANCE_GRID_SIZE + 1);
+		sceneRoot = sceneTransforms->create();
+		float spacing = 1.5f / INSTANCE_GRID_SIZE;
+		float start = -0.5f * spacing * (INSTANCE_GRID_SIZE - 1);
+		instances.resize(INSTANCE_GRID_SIZE * INSTANCE_GRID_SIZE);
+		instanceTransforms.resize(instances.size());
+		instanceHomes.resize(instances.size());
+		for (uint32_t y = 0; y < INSTANCE_GRID_SIZE; y++) {
+			for (uint32_t x = 0; x < INSTANCE_GRID_SIZE; x++) {
+				vkn::Instance& instance = instances[y * INSTANCE_GRID_SIZE + x];
+				vkn::TransformHandle transform = sceneTransforms->create(sceneRoot);
+				instanceHomes[y * INSTANCE_GRID_SIZE + x] = glm::vec3(start + x * spacing, start + y * spacing, 0.0f);
+				sceneTransforms->setLocal(transform, instanceHomes[y * INSTANCE_GRID_SIZE + x],
+					glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(1.0f / INSTANCE_GRID_SIZE));
+				instanceTransforms[y * INSTANCE_GRID_SIZE + x] = transform;
+				instance.color = INSTANCE_GRID_SIZE > 1 ? glm::vec4(0.5f + 0.5f * x / (INSTANCE_GRID_SIZE - 1), 0.5f + 0.5f * y / (INSTANCE_GRID_SIZE - 1), 1.0f, 1.0f) : glm::vec4(1.0f);
+			}
 		}
-		vkBindBufferMemory(vknDevice->getDevice(), buffer, bufferMemory, 0);
 
+		//Boxes in the root's space, so only the copies' own movement refits them
+		sceneTransforms->update();
+		sceneBvh = new vkn::Bvh();
+		instanceBvhHandles.resize(instances.size());
+		for (uint32_t i = 0; i < instances.size(); i++) {
+			glm::vec3 boundsMin, boundsMax;
+			getInstanceBounds(i, boundsMin, boundsMax);
+			instanceBvhHandles[i] = sceneBvh->insert(boundsMin, boundsMax, i);
+		}
+		sceneBvh->update();
 	}
 
-	//Current implimentation is not very general.
-	//This could be much more generalized
-	void createVertexBuffer() {
-		VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingBufferMemory;
-		createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
-
-		void* data;
-		vkMapMemory(vknDevice->getDevice(), stagingBufferMemory, 0, bufferSize, 0, &data);
-		memcpy(data, vertices.data(), (size_t) bufferSize);
-		vkUnmapMemory(vknDevice->getDevice(), stagingBufferMemory);
-
-		createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferMemory);
-		copyBuffer(stagingBuffer, vertexBuffer, bufferSize);
-
-		vkDestroyBuffer(vknDevice->getDevice(), stagingBuffer, nullptr);
-		vkFreeMemory(vknDevice->getDevice(), stagingBufferMemory, nullptr);
+	//The mesh's box around an instance, in the root's space. Transforms have to be up to date
+	void getInstanceBounds(uint32_t instance, glm::vec3& boundsMin, glm::vec3& boundsMax) {
+		const vkn::PooledMesh& mesh = geometryPool->getMesh(meshHandle);
+		glm::mat4 transform = glm::inverse(sceneTransforms->getWorldMatrix(sceneRoot)) *
+			sceneTransforms->getWorldMatrix(instanceTransforms[instance]) * meshTransform;
+		boundsMin = glm::vec3(std::numeric_limits<float>::max());
+		boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+		for (int corner = 0; corner < 8; corner++) {
+			glm::vec3 local((corner & 1) ? mesh.boundsMax.x : mesh.boundsMin.x, (corner & 2) ? mesh.boundsMax.y : mesh.boundsMin.y,
+				(corner & 4) ? mesh.boundsMax.z : mesh.boundsMin.z);
+			glm::vec3 point = glm::vec3(transform * glm::vec4(local, 1.0f));
+			boundsMin = glm::min(boundsMin, point);
+			boundsMax = glm::max(boundsMax, point);
+		}
 	}
 
-	void createIndexBuffer() {
-		VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingBufferMemory;
-		createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-			VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
-
-		void* data;
-		vkMapMemory(vknDevice->getDevice(), stagingBufferMemory, 0, bufferSize, 0, &data);
-		memcpy(data, indices.data(), (size_t) bufferSize);
-		vkUnmapMemory(vknDevice->getDevice(), stagingBufferMemory);
-
-		createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexBufferMemory);
+	//Casts a ray through the clicked pixel and tints the nearest instance it hits
+	void pickInstance(const glm::mat4& clip) {
+		int width, height;
+		glfwGetWindowSize(window, &width, &height);
+		if (width == 0 || height == 0) {
+			return;
+		}
+		//Into the root's space like the BVH. Clip y already points down the screen
+		glm::mat4 inverse = glm::inverse(clip * sceneTransforms->getWorldMatrix(sceneRoot));
+		glm::vec2 ndc(2.0f * float(pickX) / width - 1.0f, 2.0f * float(pickY) / height - 1.0f);
+		glm::vec4 nearPoint = inverse * glm::vec4(ndc, 0.0f, 1.0f);
+		glm::vec4 farPoint = inverse * glm::vec4(ndc, 1.0f, 1.0f);
+		glm::vec3 origin = glm::vec3(nearPoint) / nearPoint.w;
+		glm::vec3 direction = glm::vec3(farPoint) / farPoint.w - origin;
+
+		vkn::BvhRayHit hit;
+		if (sceneBvh->raycast(origin, direction, 1.0f, hit)) {
+			instances[hit.userData].color = glm::vec4(1.0f, 0.3f, 0.3f, 1.0f);
+		}
+	}
 
-		copyBuffer(stagingBuffer, indexBuffer, bufferSize);
+	//Bounding spheres are refreshed from the instance transforms every frame, and
+	//only what's inside the frustum gets packed into the instance buffer
+	void submitVisibleInstances() {
+		if (BVH_CULLING) {
+			sceneBvh->queryFrustum(vkn::Frustum::fromMatrix(cullMatrix * sceneTransforms->getWorldMatrix(sceneRoot)), visibleInstances);
+		}
+		else {
+			const vkn::PooledMesh& mesh = geometryPool->getMesh(meshHandle);
+			glm::vec3 center = (mesh.boundsMin + mesh.boundsMax) * 0.5f;
+			float radius = glm::length(mesh.boundsMax - mesh.boundsMin) * 0.5f;
+			uint32_t count = static_cast<uint32_t>(instances.size());
+			cpuCuller->resize(count);
+			cpuCuller->transformSpheres(center, radius, &instances[0].transform, count, 0, sizeof(vkn::Instance));
+			cpuCuller->cull(vkn::Frustum::fromMatrix(cullMatrix), visibleInstances);
+		}
 
-		vkDestroyBuffer(vknDevice->getDevice(), stagingBuffer, nullptr);
-		vkFreeMemory(vknDevice->getDevice(), stagingBufferMemory, nullptr);
+		culledInstances.resize(visibleInstances.size());
+		for (size_t i = 0; i < visibleInstances.size(); i++) {
+			culledInstances[i] = instances[visibleInstances[i]];
+		}
+		instanceBatcher->submit(meshHandle, material, culledInstances.data(), static_cast<uint32_t>(culledInstances.size()));
 	}
 
 	void mainLoop() {
@@ -912,26 +1314,40 @@ private:
 	void cleanup() {
 		cleanupSwapChain();
 		delete(vknGraphicsPipeline);
+		delete(depthPipeline);
 		delete(vknRenderPass);
-
-		vkDestroySampler(vknDevice->getDevice(), textureSampler, nullptr);
-		vkDestroyImageView(vknDevice->getDevice(), textureImageView, nullptr);
-		vkDestroyImage(vknDevice->getDevice(), textureImage, nullptr);
-		vkFreeMemory(vknDevice->getDevice(), textureImageMemory, nullptr);
+		delete(lateRenderPass);
+		delete(depthPrePass);
+		delete(depthLatePass);
+
+		delete(bindlessTable);
+		delete(textureStreamer);
+		delete(sceneBvh);
+		delete(sceneTransforms);
+		delete(threadPool);
+		//After the streamer, pending uploads may still have been reading from it
+		delete(assetPack);
 
 		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
 			vkDestroyBuffer(vknDevice->getDevice(), uniformBuffers[i], nullptr);
 			vkFreeMemory(vknDevice->getDevice(), uniformBuffersMemory[i], nullptr);
 		}
 
-		vkDestroyDescriptorPool(vknDevice->getDevice(), descriptorPool, nullptr);
-		vkDestroyDescriptorSetLayout(vknDevice->getDevice(), descriptorSetLayout, nullptr);
-
-		vkDestroyBuffer(vknDevice->getDevice(), indexBuffer, nullptr);
-		vkFreeMemory(vknDevice->getDevice(), indexBufferMemory, nullptr);
+		for (vkn::DescriptorAllocator* allocator : frameDescriptors) {
+			delete(allocator);
+		}
+		delete(frameSetTemplate);
 
-		vkDestroyBuffer(vknDevice->getDevice(), vertexBuffer, nullptr);
-		vkFreeMemory(vknDevice->getDevice(), vertexBufferMemory, nullptr);
+		delete(cullPipeline);
+		delete(frustumCuller);
+		delete(cpuCuller);
+		delete(renderQueue);
+		delete(hiZPipeline);
+		delete(hiZPyramid);
+		delete(postProcess);
+		delete(indirectDraws);
+		delete(instanceBatcher);
+		delete(geometryPool);
 
 
 		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
@@ -984,12 +1400,38 @@ private:
 
 	std::vector<VkImageView> swapChainImageViews;
 
+	//Depth buffer, recreated with the swap chain. The render graph owns it
+	VkFormat depthFormat;
+	VkImageView depthImageView;
+	//Multisampled color, only there when msaaSamples is above 1. Also the graph's
+	VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_1_BIT;
+	VkImageView colorImageView = VK_NULL_HANDLE;
+	//What the passes draw in, the swap chain's format unless post-processing is on
+	VkFormat colorFormat;
+	bool postProcessing = false;
+	vkn::PostProcessChain* postProcess = nullptr;
+	VkImageView sceneColorView = VK_NULL_HANDLE;
+
+	//The frame's passes, see createRenderGraph
+	vkn::RenderGraph* renderGraph = nullptr;
+	vkn::GraphResource swapChainTarget;
+	vkn::GraphResource depthTarget;
+	vkn::GraphResource colorTarget;
+	vkn::GraphResource sceneColorTarget;
+	uint32_t currentImageIndex = 0;
+
 	//Holds the pipeline layout
 	vkn::RenderPass *vknRenderPass;
 	vkn::GraphicsPipeline *vknGraphicsPipeline;
+	//Optional passes, see createRenderPasses
+	vkn::RenderPass* lateRenderPass = nullptr;
+	vkn::RenderPass* depthPrePass = nullptr;
+	vkn::RenderPass* depthLatePass = nullptr;
+	vkn::GraphicsPipeline* depthPipeline = nullptr;
 
 	//Framebuffers
 	std::vector<vkn::FrameBuffer*> swapChainFramebuffers;
+	vkn::FrameBuffer* depthFramebuffer = nullptr;
 
 	//Command Buffers
 	VkCommandPool commandPool;
@@ -1005,10 +1447,37 @@ private:
 	bool framebufferResized = false;
 
 	//Vertex buffer data
-	VkBuffer vertexBuffer;
-	VkDeviceMemory vertexBufferMemory;
-	VkBuffer indexBuffer;
-	VkDeviceMemory indexBufferMemory;
+	std::string modelPath;
+	vkn::VertexLayout vertexLayout;
+	//Centres the mesh and scales it to fit the view
+	glm::mat4 meshTransform = glm::mat4(1.0f);
+	vkn::GeometryPool* geometryPool = nullptr;
+	vkn::MeshHandle meshHandle = vkn::INVALID_MESH;
+	vkn::InstanceBatcher* instanceBatcher = nullptr;
+	vkn::IndirectDrawBuffer* indirectDraws = nullptr;
+	vkn::FrustumCuller* frustumCuller = nullptr;
+	vkn::CpuFrustumCuller* cpuCuller = nullptr;
+	vkn::RenderQueue* renderQueue = nullptr;
+	uint32_t colorQueuePipeline = 0;
+	uint32_t depthQueuePipeline = 0;
+	std::vector<uint32_t> visibleInstances;
+	std::vector<vkn::Instance> culledInstances;
+	vkn::ComputePipeline* cullPipeline = nullptr;
+	glm::mat4 cullMatrix;
+	bool occlusionCulling = false;
+	vkn::HiZPyramid* hiZPyramid = nullptr;
+	vkn::ComputePipeline* hiZPipeline = nullptr;
+	std::vector<vkn::Instance> instances;
+	vkn::TransformSystem* sceneTransforms = nullptr;
+	vkn::TransformHandle sceneRoot = vkn::INVALID_TRANSFORM;
+	std::vector<vkn::TransformHandle> instanceTransforms;
+	//Where each copy sits in the grid before bobbing
+	std::vector<glm::vec3> instanceHomes;
+	vkn::Bvh* sceneBvh = nullptr;
+	std::vector<vkn::BvhHandle> instanceBvhHandles;
+	bool pickRequested = false;
+	double pickX = 0.0;
+	double pickY = 0.0;
 
 	//Uniform buffer data
 	std::vector<VkBuffer> uniformBuffers;
@@ -1017,19 +1486,30 @@ private:
 
 	//Descriptor Sets and Pools
 	VkDescriptorSetLayout descriptorSetLayout;
-	VkDescriptorPool descriptorPool;
+	std::vector<vkn::DescriptorAllocator*> frameDescriptors;
+	vkn::DescriptorTemplate* frameSetTemplate = nullptr;
 	std::vector<VkDescriptorSet> descriptorSets;
 
 	//Texturing Properties
-	VkImage textureImage;
-	VkDeviceMemory textureImageMemory;
-	VkImageView textureImageView;
+	vkn::ThreadPool* threadPool;
+	vkn::TextureStreamer* textureStreamer;
+	vkn::Texture* texture;
 	VkSampler textureSampler;
 
+	//Null when there is no baked pack next to the executable
+	vkn::AssetPack* assetPack = nullptr;
+
+	//Null when the device can't do descriptor indexing
+	vkn::BindlessTable* bindlessTable = nullptr;
+	vkn::MaterialPushConstants material{};
+
 };
 
-int main() {
+int main(int argc, char** argv) {
 	HelloTriangleApplication app;
+	if (argc > 1) {
+		app.setModelPath(argv[1]);
+	}
 
 	try {
 		app.run();
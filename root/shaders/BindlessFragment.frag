@@ -0,0 +1,24 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_EXT_nonuniform_qualifier : require
+
+//Fragment shader that pulls its texture out of the bindless table
+
+layout(set = 1, binding = 0) uniform texture2D textures[];
+layout(set = 1, binding = 1) uniform sampler samplers[];
+
+layout(push_constant) uniform Material {
+	uint textureIndex;
+	uint samplerIndex;
+} material;
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
+
+layout(location = 0) out vec4 outColor;
+
+void main(){
+	//nonuniformEXT keeps this correct once the index comes from per instance data
+	vec4 texel = texture(sampler2D(textures[nonuniformEXT(material.textureIndex)], samplers[nonuniformEXT(material.samplerIndex)]), fragTexCoord);
+	outColor = vec4(fragColor, 1.0) * texel;
+}
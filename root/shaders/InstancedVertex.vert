@@ -0,0 +1,58 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Vertex Shader for vkn::InstanceBatcher draws
+// Compiled twice, with -DQUANTIZED for vkn::VertexLayout::getQuantizedLayout()
+// and without for the full float layout. The instance transform already
+// carries the dequantizing scale and offset, ubo.model is shared by the scene
+
+layout(binding = 0) uniform UniformBufferObject {
+	mat4 model;
+	mat4 view;
+	mat4 proj;
+} ubo;
+
+layout(location = 0) in vec4 inPosition;
+layout(location = 1) in vec4 inColor;
+layout(location = 2) in vec2 inTexCoord;
+#ifdef QUANTIZED
+layout(location = 3) in vec2 inNormal;
+#else
+layout(location = 3) in vec3 inNormal;
+#endif
+
+//Per instance, the top three rows of the transform and a tint
+layout(location = 4) in vec4 inInstanceRow0;
+layout(location = 5) in vec4 inInstanceRow1;
+layout(location = 6) in vec4 inInstanceRow2;
+layout(location = 7) in vec4 inInstanceColor;
+
+//A depth pre-pass runs this same shader, and the main pass tests EQUAL against it
+invariant gl_Position;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+
+//Unfolds the octahedron encoding from VertexLayout.cpp
+vec3 decodeOctahedral(vec2 p) {
+	vec3 n = vec3(p, 1.0 - abs(p.x) - abs(p.y));
+	float t = max(-n.z, 0.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
+
+void main(){
+	mat4 instance = transpose(mat4(inInstanceRow0, inInstanceRow1, inInstanceRow2, vec4(0.0, 0.0, 0.0, 1.0)));
+	mat4 model = ubo.model * instance;
+	gl_Position = ubo.proj * ubo.view * model * vec4(inPosition.xyz, 1.0);
+#ifdef QUANTIZED
+	vec3 normal = normalize(mat3(model) * decodeOctahedral(inNormal));
+#else
+	vec3 normal = normalize(mat3(model) * inNormal);
+#endif
+	//Cheap fixed light so loaded models have some shape to them
+	float light = 0.35 + 0.65 * max(dot(normal, normalize(vec3(0.4, 0.3, 1.0))), 0.0);
+	fragColor = inColor.rgb * inInstanceColor.rgb * light;
+	fragTexCoord = inTexCoord;
+}
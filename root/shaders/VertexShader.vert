@@ -9,12 +9,19 @@ layout(binding = 0) uniform UniformBufferObject {
 	mat4 proj;
 } ubo;
 
-layout(location = 0) in vec2 inPosition;
+layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
+layout(location = 2) in vec2 inTexCoord;
+layout(location = 3) in vec3 inNormal;
 
 layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
 
 void main(){
-	gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 0.0, 1.0);
-	fragColor = inColor;
+	gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0);
+	//Cheap fixed light so loaded models have some shape to them
+	vec3 normal = normalize(mat3(ubo.model) * inNormal);
+	float light = 0.35 + 0.65 * max(dot(normal, normalize(vec3(0.4, 0.3, 1.0))), 0.0);
+	fragColor = inColor * light;
+	fragTexCoord = inTexCoord;
 }
\ No newline at end of file
@@ -0,0 +1,239 @@
+//Bakes loose assets into a single .vknpack for vkn::AssetPack to map at startup.
+//
+//  AssetBaker <output.vknpack> <asset paths...>
+//
+//Each asset is named after the path it was given with, so run it from the same
+//directory the renderer runs from (e.g. AssetBaker root/assets.vknpack root/shaders/compiled/vertS.spv).
+//Types are picked by extension:
+//  .spv                      shader, copied as is
+//  .ktx2 .dds                texture, kept block compressed with its own mips
+//  .jpg .png .tga .bmp       texture, decoded to RGBA8 with a full mip chain
+//  .obj .glb                 mesh, optimised, with LODs and in the renderer's vertex format
+//
+//Build it with TextureLoader.cpp, MeshLoader.cpp, MeshOptimizer.cpp, MeshSimplifier.cpp, ThreadPool.cpp and MappedFile.cpp,
+//it needs no Vulkan device.
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cctype>
+#include <cstdio>
+#include <stdexcept>
+#include <algorithm>
+#include "../AssetPack.h"
+#include "../TextureLoader.h"
+#include "../MeshLoader.h"
+#include "../MeshOptimizer.h"
+#include "../MeshSimplifier.h"
+
+static std::string getExtension(const std::string& path) {
+	size_t dot = path.find_last_of('.');
+	if (dot == std::string::npos) {
+		return "";
+	}
+	std::string extension = path.substr(dot);
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+	return extension;
+}
+
+static std::vector<unsigned char> readFile(const std::string& path) {
+	std::ifstream file(path, std::ios::ate | std::ios::binary);
+	if (!file.is_open()) {
+		throw std::runtime_error("failed to open " + path + "!");
+	}
+	size_t fileSize = static_cast<size_t>(file.tellg());
+	std::vector<unsigned char> buffer(fileSize);
+	file.seekg(0);
+	file.read(reinterpret_cast<char*>(buffer.data()), fileSize);
+	return buffer;
+}
+
+static uint64_t alignUp(uint64_t value) {
+	return (value + vkn::PACK_ALIGNMENT - 1) & ~(vkn::PACK_ALIGNMENT - 1);
+}
+
+static void append(std::vector<unsigned char>& blob, const void* data, size_t size) {
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	blob.insert(blob.end(), bytes, bytes + size);
+}
+
+static std::vector<unsigned char> bakeShader(const std::string& path) {
+	std::vector<unsigned char> blob = readFile(path);
+	if (blob.size() == 0 || blob.size() % 4 != 0) {
+		throw std::runtime_error(path + " is not SPIR-V!");
+	}
+	return blob;
+}
+
+static vkn::TextureData* loadImage(const std::string& path) {
+	int texWidth, texHeight, texChannels;
+	stbi_uc* pixels = stbi_load(path.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+	if (!pixels) {
+		throw std::runtime_error("failed to load texture image " + path + "!");
+	}
+
+	vkn::TextureData* data = new vkn::TextureData();
+	data->width = static_cast<uint32_t>(texWidth);
+	data->height = static_cast<uint32_t>(texHeight);
+	data->pixels.assign(pixels, pixels + size_t(texWidth) * texHeight * 4);
+	stbi_image_free(pixels);
+
+	vkn::TextureLoader::generateMips(*data);
+	return data;
+}
+
+//Same layout the streamer reads: header, mip table, then every mip on an aligned offset
+static std::vector<unsigned char> bakeTexture(const std::string& path) {
+	vkn::TextureData* data = vkn::TextureLoader::isContainer(path) ? vkn::TextureLoader::load(path) : loadImage(path);
+
+	vkn::PackTexture header;
+	header.format = static_cast<uint32_t>(data->format);
+	header.width = data->width;
+	header.height = data->height;
+	header.mipCount = static_cast<uint32_t>(data->mips.size());
+
+	std::vector<vkn::PackMip> mips(data->mips.size());
+	uint64_t offset = alignUp(sizeof(vkn::PackTexture) + sizeof(vkn::PackMip) * mips.size());
+	for (size_t i = 0; i < mips.size(); i++) {
+		mips[i].offset = offset;
+		mips[i].size = data->mips[i].size;
+		mips[i].width = data->mips[i].width;
+		mips[i].height = data->mips[i].height;
+		offset = alignUp(offset + mips[i].size);
+	}
+
+	std::vector<unsigned char> blob;
+	blob.reserve(static_cast<size_t>(offset));
+	append(blob, &header, sizeof(header));
+	append(blob, mips.data(), sizeof(vkn::PackMip) * mips.size());
+	for (size_t i = 0; i < mips.size(); i++) {
+		blob.resize(static_cast<size_t>(mips[i].offset), 0);
+		append(blob, data->getPixels() + data->mips[i].offset, static_cast<size_t>(data->mips[i].size));
+	}
+
+	delete(data);
+	return blob;
+}
+
+//Header, vertices, then indices, both starting aligned
+static std::vector<unsigned char> bakeMesh(const std::string& path, vkn::ThreadPool* threadPool) {
+	vkn::MeshLoader loader(threadPool);
+	vkn::MeshData* data = loader.load(path);
+
+	vkn::VertexCacheStats before, after;
+	vkn::MeshOptimizer::optimize(*data, &before, &after);
+	std::cout << path << ": ACMR " << before.acmr << " -> " << after.acmr
+		<< ", ATVR " << before.atvr << " -> " << after.atvr << std::endl;
+	vkn::MeshSimplifier::generateLods(*data);
+	std::cout << path << ": " << data->lods.size() << " LODs, last has " << data->lods.back().indexCount / 3 << " triangles" << std::endl;
+	VkIndexType indexType = vkn::MeshOptimizer::selectIndexType(data->vertices.size());
+
+	vkn::PackMesh header{};
+	header.vertexCount = data->info.vertexCount;
+	header.vertexStride = sizeof(vkn::Vertex);
+	header.indexCount = data->info.indexCount;
+	header.indexSize = vkn::MeshOptimizer::getIndexSize(indexType);
+	header.vertexOffset = alignUp(sizeof(vkn::PackMesh));
+	header.indexOffset = alignUp(header.vertexOffset + sizeof(vkn::Vertex) * data->vertices.size());
+	for (int i = 0; i < 3; i++) {
+		header.boundsMin[i] = data->info.boundsMin[i];
+		header.boundsMax[i] = data->info.boundsMax[i];
+	}
+	header.lodCount = static_cast<uint32_t>(data->lods.size());
+	std::copy(data->lods.begin(), data->lods.end(), header.lods);
+
+	std::vector<unsigned char> blob;
+	append(blob, &header, sizeof(header));
+	blob.resize(static_cast<size_t>(header.vertexOffset), 0);
+	append(blob, data->vertices.data(), sizeof(vkn::Vertex) * data->vertices.size());
+	blob.resize(static_cast<size_t>(header.indexOffset) + header.indexSize * data->indices.size(), 0);
+	vkn::MeshOptimizer::writeIndices(data->indices.data(), data->indices.size(), indexType, blob.data() + header.indexOffset);
+
+	delete(data);
+	return blob;
+}
+
+int main(int argc, char** argv) {
+	if (argc < 3) {
+		std::cerr << "usage: AssetBaker <output.vknpack> <asset paths...>" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::ofstream out(argv[1], std::ios::binary | std::ios::trunc);
+	if (!out.is_open()) {
+		std::cerr << "failed to open " << argv[1] << "!" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	vkn::ThreadPool threadPool;
+	std::vector<vkn::PackEntry> index;
+	uint64_t position = alignUp(sizeof(vkn::PackHeader));
+	out.seekp(static_cast<std::streamoff>(position));
+
+	try {
+		for (int i = 2; i < argc; i++) {
+			std::string path = argv[i];
+			if (path.size() >= vkn::PACK_NAME_LENGTH) {
+				throw std::runtime_error(path + " is too long for a pack entry name!");
+			}
+
+			vkn::PackEntry entry{};
+			std::vector<unsigned char> blob;
+			std::string extension = getExtension(path);
+			if (extension == ".spv") {
+				entry.type = vkn::PackAssetType::Shader;
+				blob = bakeShader(path);
+			}
+			else if (extension == ".ktx2" || extension == ".dds" || extension == ".jpg" || extension == ".jpeg" ||
+				extension == ".png" || extension == ".tga" || extension == ".bmp") {
+				entry.type = vkn::PackAssetType::Texture;
+				blob = bakeTexture(path);
+			}
+			else if (vkn::MeshLoader::isSupported(path)) {
+				entry.type = vkn::PackAssetType::Mesh;
+				blob = bakeMesh(path, &threadPool);
+			}
+			else {
+				throw std::runtime_error("don't know how to bake " + path + "!");
+			}
+
+			std::memcpy(entry.name, path.c_str(), path.size() + 1);
+			entry.offset = position;
+			entry.size = blob.size();
+			index.push_back(entry);
+
+			out.write(reinterpret_cast<const char*>(blob.data()), blob.size());
+			//Pad so the next blob starts aligned
+			uint64_t next = alignUp(position + blob.size());
+			std::vector<char> padding(static_cast<size_t>(next - position - blob.size()), 0);
+			out.write(padding.data(), padding.size());
+			position = next;
+
+			std::cout << path << " (" << blob.size() << " bytes)" << std::endl;
+		}
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		out.close();
+		std::remove(argv[1]);
+		return EXIT_FAILURE;
+	}
+
+	out.write(reinterpret_cast<const char*>(index.data()), sizeof(vkn::PackEntry) * index.size());
+
+	vkn::PackHeader header{};
+	header.magic = vkn::PACK_MAGIC;
+	header.version = vkn::PACK_VERSION;
+	header.entryCount = static_cast<uint32_t>(index.size());
+	header.indexOffset = position;
+	out.seekp(0);
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	std::cout << "wrote " << index.size() << " assets to " << argv[1] << std::endl;
+	return EXIT_SUCCESS;
+}